@@ -28,6 +28,9 @@
 /* Authors:  Zack Rusin <zackr@vmware.com>
  */
 
+#include "util/list.h"
+#include "util/simple_mtx.h"
+#include "util/u_atomic.h"
 #include "util/u_debug.h"
 
 #include "util/u_memory.h"
@@ -225,3 +228,231 @@ void cso_cache_set_delete_cso_callback(struct cso_cache *sc,
    sc->delete_cso = delete_cso;
    sc->delete_cso_ctx = ctx;
 }
+
+
+/* Nothing is evicted from the shared cache, so past this many states of a
+ * type, new ones go to the context's own cache.
+ */
+#define CSO_SHARED_CACHE_MAX_ENTRIES 4096
+#define CSO_SHARED_TABLE_MIN_SIZE    64
+
+struct cso_shared_entry {
+   unsigned hash_key;
+   unsigned key_size;
+   void *state;
+};
+
+struct cso_shared_table {
+   unsigned size;   /* power of two, at least twice count */
+   unsigned count;
+   struct cso_shared_table *retired;   /* the smaller table this replaced */
+   struct cso_shared_entry *slots[];
+};
+
+struct cso_shared_cache {
+   struct list_head link;
+   struct pipe_screen *screen;
+   unsigned refcount;
+
+   simple_mtx_t lock;
+   struct cso_shared_table *tables[CSO_CACHE_MAX];
+};
+
+static simple_mtx_t shared_caches_lock = _SIMPLE_MTX_INITIALIZER_NP;
+static struct list_head shared_caches = { &shared_caches, &shared_caches };
+
+/* cso_construct_key() xors the words of the state, mix it before using the
+ * low bits.
+ */
+static inline unsigned
+cso_shared_slot(unsigned hash_key)
+{
+   hash_key ^= hash_key >> 16;
+   hash_key *= 0x85ebca6b;
+   hash_key ^= hash_key >> 13;
+   hash_key *= 0xc2b2ae35;
+   hash_key ^= hash_key >> 16;
+   return hash_key;
+}
+
+static struct cso_shared_table *
+cso_shared_table_create(unsigned size)
+{
+   struct cso_shared_table *table =
+      CALLOC(1, sizeof(*table) + size * sizeof(table->slots[0]));
+   if (table)
+      table->size = size;
+   return table;
+}
+
+static void
+cso_shared_table_add(struct cso_shared_table *table,
+                     struct cso_shared_entry *entry)
+{
+   unsigned mask = table->size - 1;
+   unsigned i = cso_shared_slot(entry->hash_key) & mask;
+
+   while (table->slots[i])
+      i = (i + 1) & mask;
+
+   /* publish the entry after its contents */
+   p_atomic_set(&table->slots[i], entry);
+   table->count++;
+}
+
+struct cso_shared_cache *
+cso_shared_cache_attach(struct pipe_screen *screen)
+{
+   struct cso_shared_cache *cache;
+
+   simple_mtx_lock(&shared_caches_lock);
+
+   list_for_each_entry(struct cso_shared_cache, cache, &shared_caches, link) {
+      if (cache->screen == screen) {
+         cache->refcount++;
+         simple_mtx_unlock(&shared_caches_lock);
+         return cache;
+      }
+   }
+
+   cache = CALLOC_STRUCT(cso_shared_cache);
+   if (!cache)
+      goto fail;
+
+   for (unsigned i = 0; i < CSO_CACHE_MAX; i++) {
+      cache->tables[i] = cso_shared_table_create(CSO_SHARED_TABLE_MIN_SIZE);
+      if (!cache->tables[i]) {
+         while (i--)
+            FREE(cache->tables[i]);
+         FREE(cache);
+         cache = NULL;
+         goto fail;
+      }
+   }
+
+   cache->screen = screen;
+   cache->refcount = 1;
+   simple_mtx_init(&cache->lock, mtx_plain);
+   list_addtail(&cache->link, &shared_caches);
+
+fail:
+   simple_mtx_unlock(&shared_caches_lock);
+   return cache;
+}
+
+/**
+ * Drop a context's reference.  The last one deletes the states with its
+ * pipe_context, which must not have any of them bound anymore.
+ */
+void
+cso_shared_cache_detach(struct cso_shared_cache *cache,
+                        struct pipe_context *pipe)
+{
+   simple_mtx_lock(&shared_caches_lock);
+   bool last = --cache->refcount == 0;
+   if (last)
+      list_del(&cache->link);
+   simple_mtx_unlock(&shared_caches_lock);
+
+   if (!last)
+      return;
+
+   for (unsigned type = 0; type < CSO_CACHE_MAX; type++) {
+      struct cso_shared_table *table = cache->tables[type];
+
+      for (unsigned i = 0; i < table->size; i++) {
+         if (table->slots[i]) {
+            cso_delete_state(pipe, table->slots[i]->state, type);
+            FREE(table->slots[i]);
+         }
+      }
+
+      while (table) {
+         struct cso_shared_table *retired = table->retired;
+         FREE(table);
+         table = retired;
+      }
+   }
+
+   simple_mtx_destroy(&cache->lock);
+   FREE(cache);
+}
+
+static void *
+cso_shared_table_find(struct cso_shared_table *table, unsigned hash_key,
+                      const void *templ, unsigned key_size)
+{
+   unsigned mask = table->size - 1;
+
+   for (unsigned i = cso_shared_slot(hash_key) & mask;; i = (i + 1) & mask) {
+      struct cso_shared_entry *entry = p_atomic_read(&table->slots[i]);
+
+      if (!entry)
+         return NULL;
+
+      if (entry->hash_key == hash_key && entry->key_size == key_size &&
+          !memcmp(entry->state, templ, key_size))
+         return entry->state;
+   }
+}
+
+/**
+ * Return the state of the given template, or NULL.  Can be called from any
+ * thread without locking.
+ */
+void *
+cso_shared_cache_find(struct cso_shared_cache *cache,
+                      enum cso_cache_type type, unsigned hash_key,
+                      const void *templ, unsigned key_size)
+{
+   return cso_shared_table_find(p_atomic_read(&cache->tables[type]),
+                                hash_key, templ, key_size);
+}
+
+/**
+ * Add a state created by the caller, whose first key_size bytes are the
+ * template.  Returns the state to use, which is another one if a different
+ * context added the same template first, or NULL if the cache is full.
+ */
+void *
+cso_shared_cache_insert(struct cso_shared_cache *cache,
+                        enum cso_cache_type type, unsigned hash_key,
+                        unsigned key_size, void *state)
+{
+   simple_mtx_lock(&cache->lock);
+
+   struct cso_shared_table *table = cache->tables[type];
+   void *found = cso_shared_table_find(table, hash_key, state, key_size);
+   if (found || table->count >= CSO_SHARED_CACHE_MAX_ENTRIES)
+      goto out;
+
+   if ((table->count + 1) * 2 > table->size) {
+      struct cso_shared_table *larger = cso_shared_table_create(table->size * 2);
+      if (!larger)
+         goto out;
+
+      /* the stored hash keys avoid hashing the states again */
+      for (unsigned i = 0; i < table->size; i++) {
+         if (table->slots[i])
+            cso_shared_table_add(larger, table->slots[i]);
+      }
+
+      larger->retired = table;
+      p_atomic_set(&cache->tables[type], larger);
+      table = larger;
+   }
+
+   struct cso_shared_entry *entry = MALLOC_STRUCT(cso_shared_entry);
+   if (!entry)
+      goto out;
+
+   entry->hash_key = hash_key;
+   entry->key_size = key_size;
+   entry->state = state;
+   cso_shared_table_add(table, entry);
+   found = state;
+
+out:
+   simple_mtx_unlock(&cache->lock);
+   return found;
+}
@@ -168,6 +168,29 @@ void cso_set_maximum_cache_size(struct cso_cache *sc, int number);
 void cso_delete_state(struct pipe_context *pipe, void *state,
                       enum cso_cache_type type);
 
+/**
+ * Screen-wide cache of blend, depth/stencil/alpha, rasterizer, sampler and
+ * vertex elements states, shared by the cso_contexts of a screen that
+ * supports PIPE_CAP_SHAREABLE_STATES.
+ *
+ * Lookups don't take any lock.  Each type has an open addressing table of
+ * entries that are only ever added, with the hash key stored next to each
+ * state.  Inserts are serialized, and a table that fills up is replaced by a
+ * larger copy while the old one is kept around for the lookups that may
+ * still be walking it.  States are deleted when the last context detaches.
+ */
+struct cso_shared_cache;
+
+struct cso_shared_cache *cso_shared_cache_attach(struct pipe_screen *screen);
+void cso_shared_cache_detach(struct cso_shared_cache *cache,
+                             struct pipe_context *pipe);
+void *cso_shared_cache_find(struct cso_shared_cache *cache,
+                            enum cso_cache_type type, unsigned hash_key,
+                            const void *templ, unsigned key_size);
+void *cso_shared_cache_insert(struct cso_shared_cache *cache,
+                              enum cso_cache_type type, unsigned hash_key,
+                              unsigned key_size, void *state);
+
 static inline unsigned
 cso_construct_key(void *key, int key_size)
 {
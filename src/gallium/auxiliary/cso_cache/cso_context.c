@@ -77,6 +77,9 @@ struct cso_context {
 
    uint32_t max_fs_samplerviews : 16;
 
+   struct cso_shared_cache *shared;
+   struct cso_cache_stats stats;
+
    unsigned saved_state;  /**< bitmask of CSO_BIT_x flags */
    unsigned saved_compute_state;  /**< bitmask of CSO_BIT_COMPUTE_x flags */
 
@@ -260,6 +263,10 @@ cso_create_context(struct pipe_context *pipe, unsigned flags)
    if (!(flags & CSO_NO_VBUF))
       cso_init_vbuf(ctx, flags);
 
+   if ((flags & CSO_SHARED_CACHE) &&
+       pipe->screen->get_param(pipe->screen, PIPE_CAP_SHAREABLE_STATES))
+      ctx->shared = cso_shared_cache_attach(pipe->screen);
+
    /* Enable for testing: */
    if (0) cso_set_maximum_cache_size(&ctx->cache, 4);
 
@@ -418,6 +425,8 @@ void cso_destroy_context( struct cso_context *ctx )
 {
    cso_unbind_context(ctx);
    cso_cache_delete(&ctx->cache);
+   if (ctx->shared)
+      cso_shared_cache_detach(ctx->shared, ctx->pipe);
 
    if (ctx->vbuf)
       u_vbuf_destroy(ctx->vbuf);
@@ -425,6 +434,69 @@ void cso_destroy_context( struct cso_context *ctx )
 }
 
 
+void
+cso_get_cache_stats(struct cso_context *ctx, struct cso_cache_stats *stats)
+{
+   *stats = ctx->stats;
+}
+
+/**
+ * Look the state of a template up in the screen-wide cache, then in the
+ * context's own cache.
+ */
+static inline void *
+cso_find_cached(struct cso_context *ctx, enum cso_cache_type type,
+                unsigned hash_key, const void *templ, unsigned key_size)
+{
+   if (ctx->shared) {
+      void *cso = cso_shared_cache_find(ctx->shared, type, hash_key,
+                                        templ, key_size);
+      if (cso) {
+         ctx->stats.shared_hits++;
+         return cso;
+      }
+   }
+
+   struct cso_hash_iter iter =
+      cso_find_state_template(&ctx->cache, hash_key, type,
+                              (void *)templ, key_size);
+   if (cso_hash_iter_is_null(iter)) {
+      ctx->stats.misses++;
+      return NULL;
+   }
+
+   ctx->stats.hits++;
+   return cso_hash_iter_data(iter);
+}
+
+/**
+ * Add a new state, to the screen-wide cache if possible.  Returns the state
+ * to use, or NULL if out of memory, in which case the state is freed.
+ */
+static void *
+cso_add_cached(struct cso_context *ctx, enum cso_cache_type type,
+               unsigned hash_key, unsigned key_size, void *cso)
+{
+   if (ctx->shared) {
+      void *shared = cso_shared_cache_insert(ctx->shared, type, hash_key,
+                                             key_size, cso);
+      if (shared) {
+         /* another context created the same state first */
+         if (shared != cso)
+            cso_delete_state(ctx->pipe, cso, type);
+         return shared;
+      }
+   }
+
+   struct cso_hash_iter iter = cso_insert_state(&ctx->cache, hash_key,
+                                                type, cso);
+   if (cso_hash_iter_is_null(iter)) {
+      FREE(cso);
+      return NULL;
+   }
+   return cso;
+}
+
 /* Those function will either find the state of the given template
  * in the cache or they will create a new state from the given
  * template, insert it in the cache and return it.
@@ -439,18 +511,17 @@ enum pipe_error cso_set_blend(struct cso_context *ctx,
                               const struct pipe_blend_state *templ)
 {
    unsigned key_size, hash_key;
-   struct cso_hash_iter iter;
+   struct cso_blend *cso;
    void *handle;
 
    key_size = templ->independent_blend_enable ?
       sizeof(struct pipe_blend_state) :
       (char *)&(templ->rt[1]) - (char *)templ;
    hash_key = cso_construct_key((void*)templ, key_size);
-   iter = cso_find_state_template(&ctx->cache, hash_key, CSO_BLEND,
-                                  (void*)templ, key_size);
+   cso = cso_find_cached(ctx, CSO_BLEND, hash_key, templ, key_size);
 
-   if (cso_hash_iter_is_null(iter)) {
-      struct cso_blend *cso = MALLOC(sizeof(struct cso_blend));
+   if (!cso) {
+      cso = MALLOC(sizeof(struct cso_blend));
       if (!cso)
          return PIPE_ERROR_OUT_OF_MEMORY;
 
@@ -458,17 +529,11 @@ enum pipe_error cso_set_blend(struct cso_context *ctx,
       memcpy(&cso->state, templ, key_size);
       cso->data = ctx->pipe->create_blend_state(ctx->pipe, &cso->state);
 
-      iter = cso_insert_state(&ctx->cache, hash_key, CSO_BLEND, cso);
-      if (cso_hash_iter_is_null(iter)) {
-         FREE(cso);
+      cso = cso_add_cached(ctx, CSO_BLEND, hash_key, key_size, cso);
+      if (!cso)
          return PIPE_ERROR_OUT_OF_MEMORY;
-      }
-
-      handle = cso->data;
-   }
-   else {
-      handle = ((struct cso_blend *)cso_hash_iter_data(iter))->data;
    }
+   handle = cso->data;
 
    if (ctx->blend != handle) {
       ctx->blend = handle;
@@ -502,15 +567,12 @@ cso_set_depth_stencil_alpha(struct cso_context *ctx,
 {
    unsigned key_size = sizeof(struct pipe_depth_stencil_alpha_state);
    unsigned hash_key = cso_construct_key((void*)templ, key_size);
-   struct cso_hash_iter iter = cso_find_state_template(&ctx->cache,
-                                                       hash_key,
-                                                       CSO_DEPTH_STENCIL_ALPHA,
-                                                       (void*)templ, key_size);
+   struct cso_depth_stencil_alpha *cso =
+      cso_find_cached(ctx, CSO_DEPTH_STENCIL_ALPHA, hash_key, templ, key_size);
    void *handle;
 
-   if (cso_hash_iter_is_null(iter)) {
-      struct cso_depth_stencil_alpha *cso =
-         MALLOC(sizeof(struct cso_depth_stencil_alpha));
+   if (!cso) {
+      cso = MALLOC(sizeof(struct cso_depth_stencil_alpha));
       if (!cso)
          return PIPE_ERROR_OUT_OF_MEMORY;
 
@@ -518,19 +580,11 @@ cso_set_depth_stencil_alpha(struct cso_context *ctx,
       cso->data = ctx->pipe->create_depth_stencil_alpha_state(ctx->pipe,
                                                               &cso->state);
 
-      iter = cso_insert_state(&ctx->cache, hash_key,
-                              CSO_DEPTH_STENCIL_ALPHA, cso);
-      if (cso_hash_iter_is_null(iter)) {
-         FREE(cso);
+      cso = cso_add_cached(ctx, CSO_DEPTH_STENCIL_ALPHA, hash_key, key_size, cso);
+      if (!cso)
          return PIPE_ERROR_OUT_OF_MEMORY;
-      }
-
-      handle = cso->data;
-   }
-   else {
-      handle = ((struct cso_depth_stencil_alpha *)
-                cso_hash_iter_data(iter))->data;
    }
+   handle = cso->data;
 
    if (ctx->depth_stencil != handle) {
       ctx->depth_stencil = handle;
@@ -564,10 +618,8 @@ enum pipe_error cso_set_rasterizer(struct cso_context *ctx,
 {
    unsigned key_size = sizeof(struct pipe_rasterizer_state);
    unsigned hash_key = cso_construct_key((void*)templ, key_size);
-   struct cso_hash_iter iter = cso_find_state_template(&ctx->cache,
-                                                       hash_key,
-                                                       CSO_RASTERIZER,
-                                                       (void*)templ, key_size);
+   struct cso_rasterizer *cso =
+      cso_find_cached(ctx, CSO_RASTERIZER, hash_key, templ, key_size);
    void *handle = NULL;
 
    /* We can't have both point_quad_rasterization (sprites) and point_smooth
@@ -575,25 +627,19 @@ enum pipe_error cso_set_rasterizer(struct cso_context *ctx,
     */
    assert(!(templ->point_quad_rasterization && templ->point_smooth));
 
-   if (cso_hash_iter_is_null(iter)) {
-      struct cso_rasterizer *cso = MALLOC(sizeof(struct cso_rasterizer));
+   if (!cso) {
+      cso = MALLOC(sizeof(struct cso_rasterizer));
       if (!cso)
          return PIPE_ERROR_OUT_OF_MEMORY;
 
       memcpy(&cso->state, templ, sizeof(*templ));
       cso->data = ctx->pipe->create_rasterizer_state(ctx->pipe, &cso->state);
 
-      iter = cso_insert_state(&ctx->cache, hash_key, CSO_RASTERIZER, cso);
-      if (cso_hash_iter_is_null(iter)) {
-         FREE(cso);
+      cso = cso_add_cached(ctx, CSO_RASTERIZER, hash_key, key_size, cso);
+      if (!cso)
          return PIPE_ERROR_OUT_OF_MEMORY;
-      }
-
-      handle = cso->data;
-   }
-   else {
-      handle = ((struct cso_rasterizer *)cso_hash_iter_data(iter))->data;
    }
+   handle = cso->data;
 
    if (ctx->rasterizer != handle) {
       ctx->rasterizer = handle;
@@ -1030,7 +1076,7 @@ cso_set_vertex_elements_direct(struct cso_context *ctx,
                                const struct cso_velems_state *velems)
 {
    unsigned key_size, hash_key;
-   struct cso_hash_iter iter;
+   struct cso_velements *cso;
    void *handle;
 
    /* Need to include the count into the stored state data too.
@@ -1041,11 +1087,10 @@ cso_set_vertex_elements_direct(struct cso_context *ctx,
    key_size = sizeof(struct pipe_vertex_element) * velems->count +
               sizeof(unsigned);
    hash_key = cso_construct_key((void*)velems, key_size);
-   iter = cso_find_state_template(&ctx->cache, hash_key, CSO_VELEMENTS,
-                                  (void*)velems, key_size);
+   cso = cso_find_cached(ctx, CSO_VELEMENTS, hash_key, velems, key_size);
 
-   if (cso_hash_iter_is_null(iter)) {
-      struct cso_velements *cso = MALLOC(sizeof(struct cso_velements));
+   if (!cso) {
+      cso = MALLOC(sizeof(struct cso_velements));
       if (!cso)
          return;
 
@@ -1060,17 +1105,11 @@ cso_set_vertex_elements_direct(struct cso_context *ctx,
       cso->data = ctx->pipe->create_vertex_elements_state(ctx->pipe, new_count,
                                                           new_elems);
 
-      iter = cso_insert_state(&ctx->cache, hash_key, CSO_VELEMENTS, cso);
-      if (cso_hash_iter_is_null(iter)) {
-         FREE(cso);
+      cso = cso_add_cached(ctx, CSO_VELEMENTS, hash_key, key_size, cso);
+      if (!cso)
          return;
-      }
-
-      handle = cso->data;
-   }
-   else {
-      handle = ((struct cso_velements *)cso_hash_iter_data(iter))->data;
    }
+   handle = cso->data;
 
    if (ctx->velements != handle) {
       ctx->velements = handle;
@@ -1218,13 +1257,10 @@ set_sampler(struct cso_context *ctx, enum pipe_shader_type shader_stage,
             unsigned idx, const struct pipe_sampler_state *templ, size_t key_size)
 {
    unsigned hash_key = cso_construct_key((void*)templ, key_size);
-   struct cso_sampler *cso;
-   struct cso_hash_iter iter =
-      cso_find_state_template(&ctx->cache,
-                              hash_key, CSO_SAMPLER,
-                              (void *) templ, key_size);
+   struct cso_sampler *cso =
+      cso_find_cached(ctx, CSO_SAMPLER, hash_key, templ, key_size);
 
-   if (cso_hash_iter_is_null(iter)) {
+   if (!cso) {
       cso = MALLOC(sizeof(struct cso_sampler));
       if (!cso)
          return false;
@@ -1233,13 +1269,7 @@ set_sampler(struct cso_context *ctx, enum pipe_shader_type shader_stage,
       cso->data = ctx->pipe->create_sampler_state(ctx->pipe, &cso->state);
       cso->hash_key = hash_key;
 
-      iter = cso_insert_state(&ctx->cache, hash_key, CSO_SAMPLER, cso);
-      if (cso_hash_iter_is_null(iter)) {
-         FREE(cso);
-         return false;
-      }
-   } else {
-      cso = cso_hash_iter_data(iter);
+      cso = cso_add_cached(ctx, CSO_SAMPLER, hash_key, key_size, cso);
    }
    return cso;
 }
@@ -45,6 +45,10 @@ struct u_vbuf;
 #define CSO_NO_USER_VERTEX_BUFFERS (1 << 0)
 #define CSO_NO_64B_VERTEX_BUFFERS  (1 << 1)
 #define CSO_NO_VBUF  (1 << 2)
+/* Share states with the other contexts of the screen that use this flag, if
+ * the screen supports PIPE_CAP_SHAREABLE_STATES.
+ */
+#define CSO_SHARED_CACHE  (1 << 3)
 
 struct cso_context *cso_create_context(struct pipe_context *pipe,
                                        unsigned flags);
@@ -52,6 +56,16 @@ void cso_unbind_context(struct cso_context *ctx);
 void cso_destroy_context( struct cso_context *cso );
 struct pipe_context *cso_get_pipe_context(struct cso_context *cso);
 
+/* State lookups of a context since it was created. */
+struct cso_cache_stats {
+   unsigned hits;          /* found in the context's own cache */
+   unsigned shared_hits;   /* found in the screen-wide cache */
+   unsigned misses;        /* created a new state */
+};
+
+void cso_get_cache_stats(struct cso_context *cso,
+                         struct cso_cache_stats *stats);
+
 
 enum pipe_error cso_set_blend( struct cso_context *cso,
                                const struct pipe_blend_state *blend );
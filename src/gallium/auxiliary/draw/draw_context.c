@@ -1276,6 +1276,23 @@ void draw_collect_primitives_generated(struct draw_context *draw,
    draw->collect_primgen = enable;
 }
 
+/**
+ * Returns the vertex reuse statistics accumulated by the vsplit front end
+ * for indexed draws since the last reset.
+ */
+void
+draw_get_vertex_cache_stats(struct draw_context *draw,
+                            struct draw_vertex_cache_stats *stats)
+{
+   *stats = draw->pt.vcache_stats;
+}
+
+void
+draw_reset_vertex_cache_stats(struct draw_context *draw)
+{
+   memset(&draw->pt.vcache_stats, 0, sizeof(draw->pt.vcache_stats));
+}
+
 /**
  * Computes clipper invocation statistics.
  *
@@ -360,6 +360,25 @@ void
 draw_collect_primitives_generated(struct draw_context *draw,
                                   bool eanble);
 
+/**
+ * Vertex reuse statistics for indexed draws.
+ *
+ * The average cache miss ratio (ACMR) is fetches / primitives, and the
+ * number of times each vertex is shaded is fetches / unique vertices.
+ */
+struct draw_vertex_cache_stats {
+   uint64_t indices;     /**< indices consumed */
+   uint64_t fetches;     /**< vertices fetched and shaded */
+   uint64_t primitives;  /**< primitives assembled */
+};
+
+void
+draw_get_vertex_cache_stats(struct draw_context *draw,
+                            struct draw_vertex_cache_stats *stats);
+
+void
+draw_reset_vertex_cache_stats(struct draw_context *draw);
+
 /*******************************************************************************
  * Draw pipeline
  */
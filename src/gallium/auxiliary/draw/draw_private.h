@@ -46,6 +46,8 @@
 
 #include "tgsi/tgsi_scan.h"
 
+#include "draw_context.h"
+
 #ifdef DRAW_LLVM_AVAILABLE
 struct gallivm_state;
 #endif
@@ -202,6 +204,9 @@ struct draw_context
          struct draw_pt_front_end *vsplit;
       } front;
 
+      /** vertex reuse statistics of the vsplit front end */
+      struct draw_vertex_cache_stats vcache_stats;
+
       struct pipe_vertex_buffer vertex_buffer[PIPE_MAX_ATTRIBS];
       unsigned nr_vertex_buffers;
 
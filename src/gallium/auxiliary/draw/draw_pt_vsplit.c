@@ -25,17 +25,33 @@
 
 #include "util/u_math.h"
 #include "util/u_memory.h"
+#include "util/u_prim.h"
 
 #include "draw/draw_context.h"
 #include "draw/draw_private.h"
 #include "draw/draw_pt.h"
+#include "draw/draw_vbuf.h"
 
-#define SEGMENT_SIZE 1024
-#define MAP_SIZE     256
+/* Max unique vertices fetched per segment, and max indices per segment of
+ * list primitives, which are split when the unique vertices run out.
+ */
+#define SEGMENT_SIZE       1024
+#define SEGMENT_ELTS_SIZE  (4 * SEGMENT_SIZE)
+
+/* Set associative fetch -> draw element cache */
+#define MAP_WAYS     4
+#define MAP_SETS     256
+#define MAP_SIZE     (MAP_WAYS * MAP_SETS)
 
 /* The largest possible index within an index buffer */
 #define MAX_ELT_IDX 0xffffffff
 
+struct vsplit_cache_entry {
+   unsigned fetch;
+   ushort draw;
+   ushort gen;     /* entry is valid when it matches cache.gen */
+};
+
 struct vsplit_frontend {
    struct draw_pt_front_end base;
    struct draw_context *draw;
@@ -46,17 +62,21 @@ struct vsplit_frontend {
 
    unsigned max_vertices;
    ushort segment_size;
+   ushort segment_elts_size;
+
+   /* vertices per primitive for list primitives, zero otherwise */
+   ushort list_prim_size;
 
    /* buffers for splitting */
    unsigned fetch_elts[SEGMENT_SIZE];
-   ushort draw_elts[SEGMENT_SIZE];
+   ushort draw_elts[SEGMENT_ELTS_SIZE];
    ushort identity_draw_elts[SEGMENT_SIZE];
 
    struct {
       /* map a fetch element to a draw element */
-      unsigned fetches[MAP_SIZE];
-      ushort draws[MAP_SIZE];
-      boolean has_max_fetch;
+      struct vsplit_cache_entry entries[MAP_SIZE];
+      ubyte next_way[MAP_SETS];
+      ushort gen;
 
       ushort num_fetch_elts;
       ushort num_draw_elts;
@@ -67,8 +87,13 @@ struct vsplit_frontend {
 static void
 vsplit_clear_cache(struct vsplit_frontend *vsplit)
 {
-   memset(vsplit->cache.fetches, 0xff, sizeof(vsplit->cache.fetches));
-   vsplit->cache.has_max_fetch = FALSE;
+   /* Invalidate all entries by bumping the generation, only touching
+    * them when the generation wraps around.
+    */
+   if (++vsplit->cache.gen == 0) {
+      memset(vsplit->cache.entries, 0, sizeof(vsplit->cache.entries));
+      vsplit->cache.gen = 1;
+   }
    vsplit->cache.num_fetch_elts = 0;
    vsplit->cache.num_draw_elts = 0;
 }
@@ -77,35 +102,70 @@ vsplit_clear_cache(struct vsplit_frontend *vsplit)
 static void
 vsplit_flush_cache(struct vsplit_frontend *vsplit, unsigned flags)
 {
+   struct draw_vertex_cache_stats *stats = &vsplit->draw->pt.vcache_stats;
+
+   stats->indices += vsplit->cache.num_draw_elts;
+   stats->fetches += vsplit->cache.num_fetch_elts;
+
    vsplit->middle->run(vsplit->middle,
          vsplit->fetch_elts, vsplit->cache.num_fetch_elts,
          vsplit->draw_elts, vsplit->cache.num_draw_elts, flags);
 }
 
 
+/**
+ * Count the primitives of a whole draw.  Segments of strips and fans share
+ * vertices, so this can't be done per segment.
+ */
+static void
+vsplit_count_primitives(struct vsplit_frontend *vsplit, unsigned count)
+{
+   struct draw_vertex_cache_stats *stats = &vsplit->draw->pt.vcache_stats;
+
+   switch (vsplit->prim) {
+   case PIPE_PRIM_PATCHES:
+      stats->primitives += count / vsplit->draw->pt.vertices_per_patch;
+      break;
+   case PIPE_PRIM_POLYGON:
+      stats->primitives += count >= 3;
+      break;
+   default:
+      stats->primitives += u_decomposed_prims_for_vertices(vsplit->prim, count);
+      break;
+   }
+}
+
+
 /**
  * Add a fetch element and add it to the draw elements.
  */
 static inline void
 vsplit_add_cache(struct vsplit_frontend *vsplit, unsigned fetch)
 {
-   unsigned hash;
-
-   hash = fetch % MAP_SIZE;
+   const unsigned set = fetch % MAP_SETS;
+   struct vsplit_cache_entry *entries =
+      &vsplit->cache.entries[set * MAP_WAYS];
+   const ushort gen = vsplit->cache.gen;
+   unsigned way;
+
+   for (way = 0; way < MAP_WAYS; way++) {
+      if (entries[way].gen == gen && entries[way].fetch == fetch)
+         break;
+   }
 
-   /* If the value isn't in the cache or it's an overflow due to the
-    * element bias */
-   if (vsplit->cache.fetches[hash] != fetch) {
-      /* update cache */
-      vsplit->cache.fetches[hash] = fetch;
-      vsplit->cache.draws[hash] = vsplit->cache.num_fetch_elts;
+   if (way == MAP_WAYS) {
+      /* update cache, replacing the oldest entry of the set */
+      way = vsplit->cache.next_way[set]++ % MAP_WAYS;
+      entries[way].fetch = fetch;
+      entries[way].draw = vsplit->cache.num_fetch_elts;
+      entries[way].gen = gen;
 
       /* add fetch */
       assert(vsplit->cache.num_fetch_elts < vsplit->segment_size);
       vsplit->fetch_elts[vsplit->cache.num_fetch_elts++] = fetch;
    }
 
-   vsplit->draw_elts[vsplit->cache.num_draw_elts++] = vsplit->cache.draws[hash];
+   vsplit->draw_elts[vsplit->cache.num_draw_elts++] = entries[way].draw;
 }
 
 
@@ -128,12 +188,6 @@ vsplit_add_cache_ubyte(struct vsplit_frontend *vsplit, const ubyte *elts,
    unsigned elt_idx;
    elt_idx = vsplit_get_base_idx(start, fetch);
    elt_idx = (unsigned)((int)(DRAW_GET_IDX(elts, elt_idx)) + elt_bias);
-   /* unlike the uint case this can only happen with elt_bias */
-   if (elt_bias && elt_idx == DRAW_MAX_FETCH_IDX && !vsplit->cache.has_max_fetch) {
-      unsigned hash = elt_idx % MAP_SIZE;
-      vsplit->cache.fetches[hash] = 0;
-      vsplit->cache.has_max_fetch = TRUE;
-   }
    vsplit_add_cache(vsplit, elt_idx);
 }
 
@@ -146,12 +200,6 @@ vsplit_add_cache_ushort(struct vsplit_frontend *vsplit, const ushort *elts,
    unsigned elt_idx;
    elt_idx = vsplit_get_base_idx(start, fetch);
    elt_idx = (unsigned)((int)(DRAW_GET_IDX(elts, elt_idx)) + elt_bias);
-   /* unlike the uint case this can only happen with elt_bias */
-   if (elt_bias && elt_idx == DRAW_MAX_FETCH_IDX && !vsplit->cache.has_max_fetch) {
-      unsigned hash = elt_idx % MAP_SIZE;
-      vsplit->cache.fetches[hash] = 0;
-      vsplit->cache.has_max_fetch = TRUE;
-   }
    vsplit_add_cache(vsplit, elt_idx);
 }
 
@@ -171,13 +219,6 @@ vsplit_add_cache_uint(struct vsplit_frontend *vsplit, const uint *elts,
     */
    elt_idx = vsplit_get_base_idx(start, fetch);
    elt_idx = (unsigned)((int)(DRAW_GET_IDX(elts, elt_idx)) + elt_bias);
-   /* Take care for DRAW_MAX_FETCH_IDX (since cache is initialized to -1). */
-   if (elt_idx == DRAW_MAX_FETCH_IDX && !vsplit->cache.has_max_fetch) {
-      unsigned hash = elt_idx % MAP_SIZE;
-      /* force update - any value will do except DRAW_MAX_FETCH_IDX */
-      vsplit->cache.fetches[hash] = 0;
-      vsplit->cache.has_max_fetch = TRUE;
-   }
    vsplit_add_cache(vsplit, elt_idx);
 }
 
@@ -233,7 +274,36 @@ vsplit_prepare(struct draw_pt_front_end *frontend,
    vsplit->middle = middle;
    middle->prepare(middle, vsplit->prim, opt, &vsplit->max_vertices);
 
-   vsplit->segment_size = MIN2(SEGMENT_SIZE, vsplit->max_vertices);
+   /* The emit middle ends hand each segment's indices straight to the
+    * render, which can't take more than max_indices at a time.
+    */
+   unsigned max_elts = SEGMENT_ELTS_SIZE;
+   if (vsplit->draw->render)
+      max_elts = MIN2(max_elts, vsplit->draw->render->max_indices);
+
+   vsplit->segment_size = MIN3(SEGMENT_SIZE, vsplit->max_vertices, max_elts);
+   vsplit->segment_elts_size = vsplit->segment_size;
+   vsplit->list_prim_size = 0;
+
+   /* Segments of list primitives are cut wherever the unique vertices
+    * fill the fetch buffer, so they can hold more indices than that.
+    */
+   if (vsplit->draw->pt.user.eltSize) {
+      unsigned first, incr;
+
+      if (in_prim == PIPE_PRIM_PATCHES) {
+         first = incr = vsplit->draw->pt.vertices_per_patch;
+      } else {
+         draw_pt_split_prim(in_prim, &first, &incr);
+      }
+
+      unsigned elts_size = incr ? max_elts - max_elts % incr : 0;
+      if (first == incr && incr && incr <= vsplit->segment_size &&
+          elts_size > vsplit->segment_size) {
+         vsplit->list_prim_size = incr;
+         vsplit->segment_elts_size = elts_size;
+      }
+   }
 }
 
 
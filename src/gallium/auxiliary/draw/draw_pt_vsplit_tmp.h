@@ -47,6 +47,9 @@ CONCAT(vsplit_primitive_, ELT_TYPE)(struct vsplit_frontend *vsplit,
    const unsigned start = istart;
    const unsigned end = istart + icount;
 
+   /* This is tried once per draw, before any splitting. */
+   vsplit_count_primitives(vsplit, icount);
+
    /* If the index buffer overflows we'll need to run
     * through the normal paths */
    if (end >= draw->pt.user.eltMax ||
@@ -117,9 +120,52 @@ CONCAT(vsplit_primitive_, ELT_TYPE)(struct vsplit_frontend *vsplit,
       draw_elts = vsplit->draw_elts;
    }
 
-   return vsplit->middle->run_linear_elts(vsplit->middle,
-                                          fetch_start, fetch_count,
-                                          draw_elts, icount, 0x0);
+   if (!vsplit->middle->run_linear_elts(vsplit->middle,
+                                        fetch_start, fetch_count,
+                                        draw_elts, icount, 0x0))
+      return FALSE;
+
+   draw->pt.vcache_stats.indices += icount;
+   draw->pt.vcache_stats.fetches += fetch_count;
+
+   return TRUE;
+}
+
+/**
+ * Use the cache to prepare the fetch and draw elements of a segment of list
+ * primitives.  The segment may reference more unique vertices than fit in
+ * the fetch buffer, in which case it is flushed at a primitive boundary
+ * whenever the buffer fills up.
+ */
+static void
+CONCAT(vsplit_segment_list_, ELT_TYPE)(struct vsplit_frontend *vsplit,
+                                       unsigned flags,
+                                       unsigned istart, unsigned icount)
+{
+   struct draw_context *draw = vsplit->draw;
+   const ELT_TYPE *ib = (const ELT_TYPE *) draw->pt.user.elts;
+   const int ibias = draw->pt.user.eltBias;
+   const unsigned prim_size = vsplit->list_prim_size;
+   unsigned seg_flags = flags & DRAW_SPLIT_BEFORE;
+   unsigned i, j;
+
+   assert(icount <= vsplit->segment_elts_size);
+   assert(icount % prim_size == 0);
+
+   vsplit_clear_cache(vsplit);
+
+   for (i = 0; i < icount; i += prim_size) {
+      if (vsplit->cache.num_fetch_elts + prim_size > vsplit->segment_size) {
+         vsplit_flush_cache(vsplit, seg_flags | DRAW_SPLIT_AFTER);
+         vsplit_clear_cache(vsplit);
+         seg_flags = DRAW_SPLIT_BEFORE;
+      }
+
+      for (j = 0; j < prim_size; j++)
+         ADD_CACHE(vsplit, ib, istart, i + j, ibias);
+   }
+
+   vsplit_flush_cache(vsplit, seg_flags | (flags & DRAW_SPLIT_AFTER));
 }
 
 /**
@@ -140,6 +186,12 @@ CONCAT(vsplit_segment_cache_, ELT_TYPE)(struct vsplit_frontend *vsplit,
    const int ibias = draw->pt.user.eltBias;
    unsigned i;
 
+   if (vsplit->list_prim_size && icount > vsplit->segment_size) {
+      assert(!spoken && !close);
+      CONCAT(vsplit_segment_list_, ELT_TYPE)(vsplit, flags, istart, icount);
+      return;
+   }
+
    assert(icount + !!close <= vsplit->segment_size);
 
    vsplit_clear_cache(vsplit);
@@ -209,7 +261,7 @@ CONCAT(vsplit_segment_fan_, ELT_TYPE)(struct vsplit_frontend *vsplit,
 #define LOCAL_VARS                                                         \
    struct vsplit_frontend *vsplit = (struct vsplit_frontend *) frontend;   \
    const enum pipe_prim_type prim = vsplit->prim;                          \
-   const unsigned max_count_simple = vsplit->segment_size;                 \
+   const unsigned max_count_simple = vsplit->segment_elts_size;            \
    const unsigned max_count_loop = vsplit->segment_size - 1;               \
    const unsigned max_count_fan = vsplit->segment_size;
 
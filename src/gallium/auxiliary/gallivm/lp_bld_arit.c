@@ -82,6 +82,37 @@
 #define LOG_POLY_DEGREE 4
 
 
+/**
+ * Call a min/max intrinsic chosen by lp_build_min_simple/lp_build_max_simple.
+ *
+ * The AVX-512 variants take an extra rounding/SAE operand, which we set to
+ * the current direction (i.e. no exception suppression, like SSE/AVX).
+ */
+static LLVMValueRef
+lp_build_minmax_intrinsic(struct lp_build_context *bld,
+                          const char *intrinsic,
+                          unsigned intr_size,
+                          LLVMValueRef a,
+                          LLVMValueRef b)
+{
+   if (intr_size == 512) {
+      LLVMTypeRef i32t = LLVMInt32TypeInContext(bld->gallivm->context);
+      LLVMValueRef args[3];
+
+      assert(bld->type.width * bld->type.length == 512);
+
+      args[0] = a;
+      args[1] = b;
+      args[2] = LLVMConstInt(i32t, 4, 0); /* _MM_FROUND_CUR_DIRECTION */
+      return lp_build_intrinsic(bld->gallivm->builder, intrinsic,
+                                bld->vec_type, args, 3, 0);
+   }
+
+   return lp_build_intrinsic_binary_anylength(bld->gallivm, intrinsic,
+                                              bld->type, intr_size, a, b);
+}
+
+
 /**
  * Generate min(a, b)
  * No checks for special case values of a or b = 1 or 0 are done.
@@ -114,6 +145,11 @@ lp_build_min_simple(struct lp_build_context *bld,
             intrinsic = "llvm.x86.sse.min.ps";
             intr_size = 128;
          }
+         else if (type.length == 16 && lp_native_vector_width >= 512 &&
+                  util_get_cpu_caps()->has_avx512f) {
+            intrinsic = "llvm.x86.avx512.min.ps.512";
+            intr_size = 512;
+         }
          else {
             intrinsic = "llvm.x86.avx.min.ps.256";
             intr_size = 256;
@@ -128,6 +164,11 @@ lp_build_min_simple(struct lp_build_context *bld,
             intrinsic = "llvm.x86.sse2.min.pd";
             intr_size = 128;
          }
+         else if (type.length == 8 && lp_native_vector_width >= 512 &&
+                  util_get_cpu_caps()->has_avx512f) {
+            intrinsic = "llvm.x86.avx512.min.pd.512";
+            intr_size = 512;
+         }
          else {
             intrinsic = "llvm.x86.avx.min.pd.256";
             intr_size = 256;
@@ -176,15 +217,11 @@ lp_build_min_simple(struct lp_build_context *bld,
       if (util_get_cpu_caps()->has_sse && type.floating &&
           nan_behavior == GALLIVM_NAN_RETURN_OTHER) {
          LLVMValueRef isnan, min;
-         min = lp_build_intrinsic_binary_anylength(bld->gallivm, intrinsic,
-                                                   type,
-                                                   intr_size, a, b);
+         min = lp_build_minmax_intrinsic(bld, intrinsic, intr_size, a, b);
          isnan = lp_build_isnan(bld, b);
          return lp_build_select(bld, isnan, a, min);
       } else {
-         return lp_build_intrinsic_binary_anylength(bld->gallivm, intrinsic,
-                                                    type,
-                                                    intr_size, a, b);
+         return lp_build_minmax_intrinsic(bld, intrinsic, intr_size, a, b);
       }
    }
 
@@ -268,6 +305,11 @@ lp_build_max_simple(struct lp_build_context *bld,
             intrinsic = "llvm.x86.sse.max.ps";
             intr_size = 128;
          }
+         else if (type.length == 16 && lp_native_vector_width >= 512 &&
+                  util_get_cpu_caps()->has_avx512f) {
+            intrinsic = "llvm.x86.avx512.max.ps.512";
+            intr_size = 512;
+         }
          else {
             intrinsic = "llvm.x86.avx.max.ps.256";
             intr_size = 256;
@@ -282,6 +324,11 @@ lp_build_max_simple(struct lp_build_context *bld,
             intrinsic = "llvm.x86.sse2.max.pd";
             intr_size = 128;
          }
+         else if (type.length == 8 && lp_native_vector_width >= 512 &&
+                  util_get_cpu_caps()->has_avx512f) {
+            intrinsic = "llvm.x86.avx512.max.pd.512";
+            intr_size = 512;
+         }
          else {
             intrinsic = "llvm.x86.avx.max.pd.256";
             intr_size = 256;
@@ -324,15 +371,11 @@ lp_build_max_simple(struct lp_build_context *bld,
       if (util_get_cpu_caps()->has_sse && type.floating &&
           nan_behavior == GALLIVM_NAN_RETURN_OTHER) {
          LLVMValueRef isnan, max;
-         max = lp_build_intrinsic_binary_anylength(bld->gallivm, intrinsic,
-                                                   type,
-                                                   intr_size, a, b);
+         max = lp_build_minmax_intrinsic(bld, intrinsic, intr_size, a, b);
          isnan = lp_build_isnan(bld, b);
          return lp_build_select(bld, isnan, a, max);
       } else {
-         return lp_build_intrinsic_binary_anylength(bld->gallivm, intrinsic,
-                                                    type,
-                                                    intr_size, a, b);
+         return lp_build_minmax_intrinsic(bld, intrinsic, intr_size, a, b);
       }
    }
 
@@ -1344,6 +1387,10 @@ lp_build_lerp_simple(struct lp_build_context *bld,
          } else if (bld->type.width == 16 && bld->type.length == 16 && util_get_cpu_caps()->has_avx2) {
             res = lp_build_intrinsic_binary(builder, "llvm.x86.avx2.pmul.hr.sw", bld->vec_type, x, lp_build_shl_imm(bld, delta, 7));
             res = lp_build_and(bld, res, lp_build_const_int_vec(bld->gallivm, bld->type, 0xff));
+         } else if (bld->type.width == 16 && bld->type.length == 32 &&
+                    lp_native_vector_width >= 512 && util_get_cpu_caps()->has_avx512bw) {
+            res = lp_build_intrinsic_binary(builder, "llvm.x86.avx512.pmul.hr.sw.512", bld->vec_type, x, lp_build_shl_imm(bld, delta, 7));
+            res = lp_build_and(bld, res, lp_build_const_int_vec(bld->gallivm, bld->type, 0xff));
          } else {
             res = lp_build_mul(bld, x, delta);
             res = lp_build_shr_imm(bld, res, half_width);
@@ -1918,6 +1965,20 @@ lp_build_iround_nearest_sse2(struct lp_build_context *bld,
       res = lp_build_intrinsic_unary(builder, intrinsic,
                                      ret_type, arg);
    }
+   else if (type.width * type.length == 512) {
+      LLVMValueRef args[4];
+
+      assert(lp_native_vector_width >= 512 && util_get_cpu_caps()->has_avx512f);
+
+      /* Only the masked form exists, so pass an all-ones mask. */
+      args[0] = a;
+      args[1] = LLVMGetUndef(ret_type);
+      args[2] = LLVMConstInt(LLVMInt16TypeInContext(bld->gallivm->context),
+                             0xffff, 0);
+      args[3] = LLVMConstInt(i32t, 4, 0); /* _MM_FROUND_CUR_DIRECTION */
+      res = lp_build_intrinsic(builder, "llvm.x86.avx512.mask.cvtps2dq.512",
+                               ret_type, args, 4, 0);
+   }
    else {
       if (type.width* type.length == 128) {
          intrinsic = "llvm.x86.sse2.cvtps2dq";
@@ -2359,7 +2420,9 @@ lp_build_iround(struct lp_build_context *bld,
 
    if ((util_get_cpu_caps()->has_sse2 &&
        ((type.width == 32) && (type.length == 1 || type.length == 4))) ||
-       (util_get_cpu_caps()->has_avx && type.width == 32 && type.length == 8)) {
+       (util_get_cpu_caps()->has_avx && type.width == 32 && type.length == 8) ||
+       (lp_native_vector_width >= 512 && util_get_cpu_caps()->has_avx512f &&
+        type.width == 32 && type.length == 16)) {
       return lp_build_iround_nearest_sse2(bld, a);
    }
    if (arch_rounding_available(type)) {
@@ -31,6 +31,7 @@
 #include "util/macros.h"
 #include "util/u_cpu_detect.h"
 #include "util/u_debug.h"
+#include "util/u_inlines.h"
 #include "util/u_memory.h"
 #include "util/os_time.h"
 #include "lp_bld.h"
@@ -63,6 +64,7 @@ static const struct debug_named_value lp_bld_perf_flags[] = {
    { "no_quad_lod", GALLIVM_PERF_NO_QUAD_LOD, "disable quad_lod optimization" },
    { "no_aos_sampling", GALLIVM_PERF_NO_AOS_SAMPLING, "disable aos sampling optimization" },
    { "nopt",   GALLIVM_PERF_NO_OPT, "disable optimization passes to speed up shader compilation" },
+   { "avx512", GALLIVM_PERF_AVX512, "use 512 bit vectors when the cpu supports AVX-512" },
    DEBUG_NAMED_VALUE_END
 };
 
@@ -440,7 +442,8 @@ lp_build_init(void)
    lp_set_target_options();
 
    // Default to 256 until we're confident llvmpipe with 512 is as correct and not slower than 256
-   lp_native_vector_width = MIN2(util_get_cpu_caps()->max_vector_bits, 256);
+   lp_native_vector_width = MIN2(util_get_cpu_caps()->max_vector_bits,
+                                 (gallivm_perf & GALLIVM_PERF_AVX512) ? 512 : 256);
 
    lp_native_vector_width = debug_get_num_option("LP_NATIVE_VECTOR_WIDTH",
                                                  lp_native_vector_width);
@@ -485,6 +488,7 @@ gallivm_create(const char *name, LLVMContextRef context,
 
    gallivm = CALLOC_STRUCT(gallivm_state);
    if (gallivm) {
+      pipe_reference_init(&gallivm->reference, 1);
       if (!init_gallivm_state(gallivm, name, context, cache)) {
          FREE(gallivm);
          gallivm = NULL;
@@ -508,6 +512,25 @@ gallivm_destroy(struct gallivm_state *gallivm)
 }
 
 
+/**
+ * Update a reference to a gallivm_state object, destroying the previously
+ * referenced one once nothing else refers to it.
+ * gallivm_create() returns an object with a single reference, so owners
+ * which never share their module can keep using gallivm_destroy().
+ */
+void
+gallivm_reference(struct gallivm_state **ptr, struct gallivm_state *gallivm)
+{
+   struct gallivm_state *old = *ptr;
+
+   if (pipe_reference(old ? &old->reference : NULL,
+                      gallivm ? &gallivm->reference : NULL)) {
+      gallivm_destroy(old);
+   }
+   *ptr = gallivm;
+}
+
+
 /**
  * Validate a function.
  * Verification is only done with debug builds.
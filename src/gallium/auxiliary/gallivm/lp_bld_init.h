@@ -31,6 +31,7 @@
 
 
 #include "pipe/p_compiler.h"
+#include "pipe/p_state.h"
 #include "util/u_pointer.h" // for func_pointer
 #include "lp_bld.h"
 #include <llvm-c/ExecutionEngine.h>
@@ -42,6 +43,10 @@ extern "C" {
 struct lp_cached_code;
 struct gallivm_state
 {
+   /* Several variants may emit their functions into one module and share
+    * the resulting code, which then lives until the last one lets go.
+    */
+   struct pipe_reference reference;
    char *module_name;
    LLVMModuleRef module;
    LLVMExecutionEngineRef engine;
@@ -80,6 +85,9 @@ gallivm_create(const char *name, LLVMContextRef context,
 void
 gallivm_destroy(struct gallivm_state *gallivm);
 
+void
+gallivm_reference(struct gallivm_state **ptr, struct gallivm_state *gallivm);
+
 void
 gallivm_free_ir(struct gallivm_state *gallivm);
 
@@ -922,6 +922,10 @@ do_alu_action(struct lp_build_nir_context *bld_base,
    case nir_op_fsqrt:
       result = lp_build_sqrt(get_flt_bld(bld_base, src_bit_size[0]), src[0]);
       break;
+   case nir_op_fsub:
+      result = lp_build_sub(get_flt_bld(bld_base, src_bit_size[0]),
+                            src[0], src[1]);
+      break;
    case nir_op_ftrunc:
       result = lp_build_trunc(get_flt_bld(bld_base, src_bit_size[0]), src[0]);
       break;
@@ -1260,12 +1264,21 @@ visit_alu(struct lp_build_nir_context *bld_base,
                            result[0], temp_chan);
       }
    } else if (is_aos(bld_base)) {
-      if (instr->op == nir_op_fmul) {
-         if (LLVMIsConstant(src[0])) {
-            src[0] = lp_nir_aos_conv_const(gallivm, src[0], 1);
-         }
-         if (LLVMIsConstant(src[1])) {
-            src[1] = lp_nir_aos_conv_const(gallivm, src[1], 1);
+      if (instr->op == nir_op_fmul ||
+          instr->op == nir_op_fadd ||
+          instr->op == nir_op_fsub ||
+          instr->op == nir_op_fmin ||
+          instr->op == nir_op_fmax) {
+         for (unsigned i = 0; i < 2; i++) {
+            if (LLVMIsConstant(src[i])) {
+               /* vec4 constants were already swizzled by load_const and
+                * scalars are splatted.  The linear analysis rejects any
+                * other immediate size.
+                */
+               unsigned nc = LLVMGetVectorSize(LLVMTypeOf(src[i]));
+               assert(nc == 1 || nc == 4);
+               src[i] = lp_nir_aos_conv_const(gallivm, src[i], nc);
+            }
          }
       }
       result[0] = do_alu_action(bld_base, instr, src_bit_size, src);
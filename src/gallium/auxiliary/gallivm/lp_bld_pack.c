@@ -153,6 +153,34 @@ lp_build_const_unpack_shuffle_16wide(struct gallivm_state *gallivm,
    return LLVMConstVector(elems, 16);
 }
 
+/**
+ * Build shuffle vectors that match UNPACKxx instructions operating
+ * independently on each 128-bit lane of a 512-bit (AVX-512) vector, i.e.
+ * lp_build_const_unpack_shuffle_half generalized to four lanes.
+ */
+static LLVMValueRef
+lp_build_const_unpack_shuffle_lanes(struct gallivm_state *gallivm,
+                                    unsigned n, unsigned lo_hi)
+{
+   LLVMValueRef elems[LP_MAX_VECTOR_LENGTH];
+   unsigned lane_len = n / 4;
+   unsigned lane, i;
+
+   assert(n <= LP_MAX_VECTOR_LENGTH);
+   assert(lo_hi < 2);
+
+   for (lane = 0; lane < 4; ++lane) {
+      unsigned base = lane * lane_len;
+      for (i = 0; i < lane_len / 2; ++i) {
+         unsigned j = base + lo_hi * (lane_len / 2) + i;
+         elems[base + 2*i + 0] = lp_build_const_int32(gallivm, j);
+         elems[base + 2*i + 1] = lp_build_const_int32(gallivm, n + j);
+      }
+   }
+
+   return LLVMConstVector(elems, n);
+}
+
 /**
  * Build shuffle vectors that match PACKxx (SSE) instructions or
  * VPERM (Altivec).
@@ -487,6 +515,14 @@ lp_build_unpack2_native(struct gallivm_state *gallivm,
    if (src_type.length * src_type.width == 256 && util_get_cpu_caps()->has_avx2) {
       *dst_lo = lp_build_interleave2_half(gallivm, src_type, src, msb, 0);
       *dst_hi = lp_build_interleave2_half(gallivm, src_type, src, msb, 1);
+   } else if (src_type.length * src_type.width == 512 &&
+              lp_native_vector_width >= 512 &&
+              util_get_cpu_caps()->has_avx512bw) {
+      LLVMValueRef shuffle;
+      shuffle = lp_build_const_unpack_shuffle_lanes(gallivm, src_type.length, 0);
+      *dst_lo = LLVMBuildShuffleVector(builder, src, msb, shuffle, "");
+      shuffle = lp_build_const_unpack_shuffle_lanes(gallivm, src_type.length, 1);
+      *dst_hi = LLVMBuildShuffleVector(builder, src, msb, shuffle, "");
    } else {
       *dst_lo = lp_build_interleave2(gallivm, src_type, src, msb, 0);
       *dst_hi = lp_build_interleave2(gallivm, src_type, src, msb, 1);
@@ -716,6 +752,9 @@ lp_build_pack2(struct gallivm_state *gallivm,
  *   hi =   h0 __ h1 __ h2 __ h3 __ h4 __ h5 __ h6 __ h7 __
  *   res =  l0 l1 l2 l3 h0 h1 h2 h3 l4 l5 l6 l7 h4 h5 h6 h7
  *
+ * With avx512bw the same happens independently for each of the four 128bit
+ * lanes.
+ *
  * This will only change the number of bits the values are represented, not the
  * values themselves.
  *
@@ -738,7 +777,7 @@ lp_build_pack2_native(struct gallivm_state *gallivm,
    assert(src_type.width == dst_type.width * 2);
    assert(src_type.length * 2 == dst_type.length);
 
-   /* At this point only have special case for avx2 */
+   /* At this point only have special cases for avx2 and avx512bw */
    if (src_type.length * src_type.width == 256 &&
        util_get_cpu_caps()->has_avx2) {
       switch(src_type.width) {
@@ -758,6 +797,26 @@ lp_build_pack2_native(struct gallivm_state *gallivm,
          break;
       }
    }
+   else if (src_type.length * src_type.width == 512 &&
+            lp_native_vector_width >= 512 &&
+            util_get_cpu_caps()->has_avx512bw) {
+      switch(src_type.width) {
+      case 32:
+         if (dst_type.sign) {
+            intrinsic = "llvm.x86.avx512.packssdw.512";
+         } else {
+            intrinsic = "llvm.x86.avx512.packusdw.512";
+         }
+         break;
+      case 16:
+         if (dst_type.sign) {
+            intrinsic = "llvm.x86.avx512.packsswb.512";
+         } else {
+            intrinsic = "llvm.x86.avx512.packuswb.512";
+         }
+         break;
+      }
+   }
    if (intrinsic) {
       LLVMTypeRef intr_vec_type = lp_build_vec_type(gallivm, intr_type);
       return lp_build_intrinsic_binary(builder, intrinsic, intr_vec_type,
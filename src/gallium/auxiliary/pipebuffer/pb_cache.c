@@ -27,10 +27,27 @@
  **************************************************************************/
 
 #include "pb_cache.h"
+#include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/os_time.h"
 
 
+static unsigned
+pb_cache_size_class(pb_size size)
+{
+   if (size < (1ull << PB_CACHE_MIN_CLASS_LOG2))
+      return 0;
+
+   unsigned log2 = util_logbase2_64(size);
+   if (log2 >= PB_CACHE_MAX_CLASS_LOG2)
+      return PB_CACHE_NUM_SIZE_CLASSES - 1;
+
+   /* the two bits below the most significant one pick the quarter */
+   unsigned quarter = (size >> (log2 - 2)) & (PB_CACHE_CLASSES_PER_LOG2 - 1);
+   return 1 + (log2 - PB_CACHE_MIN_CLASS_LOG2) * PB_CACHE_CLASSES_PER_LOG2 +
+          quarter;
+}
+
 /**
  * Actually destroy the buffer.
  */
@@ -42,36 +59,33 @@ destroy_buffer_locked(struct pb_cache_entry *entry)
 
    assert(!pipe_is_referenced(&buf->reference));
    if (list_is_linked(&entry->head)) {
+      struct pb_cache_bucket *bucket = &mgr->buckets[entry->bucket_index];
+
       list_del(&entry->head);
+      list_del(&entry->lru);
       assert(mgr->num_buffers);
       --mgr->num_buffers;
       mgr->cache_size -= buf->size;
+      --bucket->stats.num_buffers;
+      bucket->stats.size -= buf->size;
    }
    mgr->destroy_buffer(mgr->winsys, buf);
 }
 
 /**
- * Free as many cache buffers from the list head as possible.
+ * Free the buffers that have been unused for too long.  They are all at
+ * the start of the LRU list, so this only looks at the ones it frees and
+ * the next one.
  */
 static void
-release_expired_buffers_locked(struct list_head *cache,
-                               int64_t current_time)
+release_expired_buffers_locked(struct pb_cache *mgr, int64_t current_time)
 {
-   struct list_head *curr, *next;
-   struct pb_cache_entry *entry;
-
-   curr = cache->next;
-   next = curr->next;
-   while (curr != cache) {
-      entry = list_entry(curr, struct pb_cache_entry, head);
-
+   list_for_each_entry_safe(struct pb_cache_entry, entry, &mgr->lru, lru) {
       if (!os_time_timeout(entry->start, entry->end, current_time))
          break;
 
+      mgr->buckets[entry->bucket_index].stats.expired++;
       destroy_buffer_locked(entry);
-
-      curr = next;
-      next = curr->next;
    }
 }
 
@@ -83,30 +97,44 @@ void
 pb_cache_add_buffer(struct pb_cache_entry *entry)
 {
    struct pb_cache *mgr = entry->mgr;
-   struct list_head *cache = &mgr->buckets[entry->bucket_index];
+   struct pb_cache_bucket *bucket = &mgr->buckets[entry->bucket_index];
    struct pb_buffer *buf = entry->buffer;
-   unsigned i;
 
    simple_mtx_lock(&mgr->mutex);
    assert(!pipe_is_referenced(&buf->reference));
 
    int64_t current_time = os_time_get();
 
-   for (i = 0; i < mgr->num_heaps; i++)
-      release_expired_buffers_locked(&mgr->buckets[i], current_time);
+   release_expired_buffers_locked(mgr, current_time);
+
+   if (!bucket->size_classes) {
+      bucket->size_classes = MALLOC(PB_CACHE_NUM_SIZE_CLASSES *
+                                    sizeof(struct list_head));
+      if (bucket->size_classes) {
+         for (unsigned i = 0; i < PB_CACHE_NUM_SIZE_CLASSES; i++)
+            list_inithead(&bucket->size_classes[i]);
+      }
+   }
 
    /* Directly release any buffer that exceeds the limit. */
-   if (mgr->cache_size + buf->size > mgr->max_cache_size) {
+   if (mgr->cache_size + buf->size > mgr->max_cache_size ||
+       bucket->stats.size + buf->size > bucket->max_size ||
+       !bucket->size_classes) {
+      bucket->stats.rejected++;
       mgr->destroy_buffer(mgr->winsys, buf);
       simple_mtx_unlock(&mgr->mutex);
       return;
    }
 
-   entry->start = os_time_get();
+   entry->start = current_time;
    entry->end = entry->start + mgr->usecs;
-   list_addtail(&entry->head, cache);
+   list_addtail(&entry->head,
+                &bucket->size_classes[pb_cache_size_class(buf->size)]);
+   list_addtail(&entry->lru, &mgr->lru);
    ++mgr->num_buffers;
    mgr->cache_size += buf->size;
+   ++bucket->stats.num_buffers;
+   bucket->stats.size += buf->size;
    simple_mtx_unlock(&mgr->mutex);
 }
 
@@ -117,7 +145,8 @@ pb_cache_add_buffer(struct pb_cache_entry *entry)
  */
 static int
 pb_cache_is_buffer_compat(struct pb_cache_entry *entry,
-                          pb_size size, unsigned alignment, unsigned usage)
+                          pb_size size, pb_size max_size,
+                          unsigned alignment, unsigned usage)
 {
    struct pb_cache *mgr = entry->mgr;
    struct pb_buffer *buf = entry->buffer;
@@ -126,11 +155,7 @@ pb_cache_is_buffer_compat(struct pb_cache_entry *entry,
       return 0;
 
    /* be lenient with size */
-   if (buf->size < size ||
-       buf->size > (unsigned) (mgr->size_factor * size))
-      return 0;
-
-   if (usage & mgr->bypass_usage)
+   if (buf->size < size || buf->size > max_size)
       return 0;
 
    if (!pb_check_alignment(alignment, 1u << buf->alignment_log2))
@@ -148,58 +173,41 @@ pb_cache_reclaim_buffer(struct pb_cache *mgr, pb_size size,
                         unsigned alignment, unsigned usage,
                         unsigned bucket_index)
 {
-   struct pb_cache_entry *entry;
-   struct pb_cache_entry *cur_entry;
-   struct list_head *cur, *next;
-   int64_t now;
-   int ret = 0;
+   struct pb_cache_entry *entry = NULL;
 
    assert(bucket_index < mgr->num_heaps);
-   struct list_head *cache = &mgr->buckets[bucket_index];
-
-   simple_mtx_lock(&mgr->mutex);
+   struct pb_cache_bucket *bucket = &mgr->buckets[bucket_index];
 
-   entry = NULL;
-   cur = cache->next;
-   next = cur->next;
-
-   /* search in the expired buffers, freeing them in the process */
-   now = os_time_get();
-   while (cur != cache) {
-      cur_entry = list_entry(cur, struct pb_cache_entry, head);
-
-      if (!entry && (ret = pb_cache_is_buffer_compat(cur_entry, size,
-                                                     alignment, usage)) > 0)
-         entry = cur_entry;
-      else if (os_time_timeout(cur_entry->start, cur_entry->end, now))
-         destroy_buffer_locked(cur_entry);
-      else
-         /* This buffer (and all hereafter) are still hot in cache */
-         break;
-
-      /* the buffer is busy (and probably all remaining ones too) */
-      if (ret == -1)
-         break;
+   if (usage & mgr->bypass_usage)
+      return NULL;
 
-      cur = next;
-      next = cur->next;
-   }
+   pb_size max_size = (pb_size)(mgr->size_factor * (double)size);
+   unsigned first_class = pb_cache_size_class(size);
+   unsigned last_class = pb_cache_size_class(MAX2(max_size, size));
 
-   /* keep searching in the hot buffers */
-   if (!entry && ret != -1) {
-      while (cur != cache) {
-         cur_entry = list_entry(cur, struct pb_cache_entry, head);
-         ret = pb_cache_is_buffer_compat(cur_entry, size, alignment, usage);
+   simple_mtx_lock(&mgr->mutex);
 
+   release_expired_buffers_locked(mgr, os_time_get());
+
+   /* Smaller classes are searched first so that the closest size is
+    * returned.  Within a class, the oldest buffers come first, which are
+    * the most likely to be idle: once one is busy, the rest of the class
+    * is skipped.
+    */
+   for (unsigned i = first_class;
+        i <= last_class && !entry && bucket->size_classes; i++) {
+      list_for_each_entry(struct pb_cache_entry, cur_entry,
+                          &bucket->size_classes[i], head) {
+         int ret = pb_cache_is_buffer_compat(cur_entry, size, max_size,
+                                             alignment, usage);
          if (ret > 0) {
             entry = cur_entry;
             break;
          }
-         if (ret == -1)
+         if (ret < 0) {
+            bucket->stats.busy++;
             break;
-         /* no need to check the timeout here */
-         cur = next;
-         next = cur->next;
+         }
       }
    }
 
@@ -209,13 +217,18 @@ pb_cache_reclaim_buffer(struct pb_cache *mgr, pb_size size,
 
       mgr->cache_size -= buf->size;
       list_del(&entry->head);
+      list_del(&entry->lru);
       --mgr->num_buffers;
+      bucket->stats.hits++;
+      --bucket->stats.num_buffers;
+      bucket->stats.size -= buf->size;
       simple_mtx_unlock(&mgr->mutex);
       /* Increase refcount */
       pipe_reference_init(&buf->reference, 1);
       return buf;
    }
 
+   bucket->stats.misses++;
    simple_mtx_unlock(&mgr->mutex);
    return NULL;
 }
@@ -226,23 +239,9 @@ pb_cache_reclaim_buffer(struct pb_cache *mgr, pb_size size,
 void
 pb_cache_release_all_buffers(struct pb_cache *mgr)
 {
-   struct list_head *curr, *next;
-   struct pb_cache_entry *buf;
-   unsigned i;
-
    simple_mtx_lock(&mgr->mutex);
-   for (i = 0; i < mgr->num_heaps; i++) {
-      struct list_head *cache = &mgr->buckets[i];
-
-      curr = cache->next;
-      next = curr->next;
-      while (curr != cache) {
-         buf = list_entry(curr, struct pb_cache_entry, head);
-         destroy_buffer_locked(buf);
-         curr = next;
-         next = curr->next;
-      }
-   }
+   list_for_each_entry_safe(struct pb_cache_entry, entry, &mgr->lru, lru)
+      destroy_buffer_locked(entry);
    simple_mtx_unlock(&mgr->mutex);
 }
 
@@ -286,13 +285,14 @@ pb_cache_init(struct pb_cache *mgr, uint num_heaps,
 {
    unsigned i;
 
-   mgr->buckets = CALLOC(num_heaps, sizeof(struct list_head));
+   mgr->buckets = CALLOC(num_heaps, sizeof(struct pb_cache_bucket));
    if (!mgr->buckets)
       return;
 
    for (i = 0; i < num_heaps; i++)
-      list_inithead(&mgr->buckets[i]);
+      mgr->buckets[i].max_size = UINT64_MAX;
 
+   list_inithead(&mgr->lru);
    (void) simple_mtx_init(&mgr->mutex, mtx_plain);
    mgr->winsys = winsys;
    mgr->cache_size = 0;
@@ -314,6 +314,34 @@ pb_cache_deinit(struct pb_cache *mgr)
 {
    pb_cache_release_all_buffers(mgr);
    simple_mtx_destroy(&mgr->mutex);
+   for (unsigned i = 0; i < mgr->num_heaps; i++)
+      FREE(mgr->buckets[i].size_classes);
    FREE(mgr->buckets);
    mgr->buckets = NULL;
 }
+
+/**
+ * Limit the total size of the unused buffers of one bucket, on top of the
+ * limit of the whole cache.  Buffers released past it are destroyed.
+ */
+void
+pb_cache_set_bucket_max_size(struct pb_cache *mgr, unsigned bucket_index,
+                             uint64_t max_size)
+{
+   assert(bucket_index < mgr->num_heaps);
+
+   simple_mtx_lock(&mgr->mutex);
+   mgr->buckets[bucket_index].max_size = max_size;
+   simple_mtx_unlock(&mgr->mutex);
+}
+
+void
+pb_cache_get_stats(struct pb_cache *mgr, unsigned bucket_index,
+                   struct pb_cache_stats *stats)
+{
+   assert(bucket_index < mgr->num_heaps);
+
+   simple_mtx_lock(&mgr->mutex);
+   *stats = mgr->buckets[bucket_index].stats;
+   simple_mtx_unlock(&mgr->mutex);
+}
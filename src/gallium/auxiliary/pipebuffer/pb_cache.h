@@ -34,24 +34,60 @@
 #include "util/list.h"
 #include "os/os_thread.h"
 
+/* Within a bucket, unused buffers are kept in one list per size class, with
+ * four classes per power of two from 4 KiB to 1 TiB, so that a reclaim only
+ * looks at the few classes the requested size and size_factor allow.
+ */
+#define PB_CACHE_MIN_CLASS_LOG2     12
+#define PB_CACHE_MAX_CLASS_LOG2     40
+#define PB_CACHE_CLASSES_PER_LOG2   4
+#define PB_CACHE_NUM_SIZE_CLASSES \
+   ((PB_CACHE_MAX_CLASS_LOG2 - PB_CACHE_MIN_CLASS_LOG2) * \
+    PB_CACHE_CLASSES_PER_LOG2 + 2)
+
 /**
  * Statically inserted into the driver-specific buffer structure.
  */
 struct pb_cache_entry
 {
-   struct list_head head;
+   struct list_head head; /**< In the list of its size class */
+   struct list_head lru;  /**< In the list of all cached buffers */
    struct pb_buffer *buffer; /**< Pointer to the structure this is part of. */
    struct pb_cache *mgr;
    int64_t start, end; /**< Caching time interval */
    unsigned bucket_index;
 };
 
+struct pb_cache_stats
+{
+   uint64_t hits;     /**< reclaims that returned a buffer */
+   uint64_t misses;   /**< reclaims that didn't */
+   uint64_t busy;     /**< compatible buffers skipped by can_reclaim */
+   uint64_t expired;  /**< buffers destroyed after being unused for usecs */
+   uint64_t rejected; /**< buffers destroyed because a limit was reached */
+   uint64_t size;     /**< total size of the unused buffers */
+   unsigned num_buffers;
+};
+
+struct pb_cache_bucket
+{
+   /* Allocated when the first buffer is added. */
+   struct list_head *size_classes;
+   uint64_t max_size;
+   struct pb_cache_stats stats;
+};
+
 struct pb_cache
 {
    /* The cache is divided into buckets for minimizing cache misses.
     * The driver controls which buffer goes into which bucket.
     */
-   struct list_head *buckets;
+   struct pb_cache_bucket *buckets;
+
+   /* All unused buffers from the oldest to the most recently added, which
+    * is also the order they expire in.
+    */
+   struct list_head lru;
 
    simple_mtx_t mutex;
    void *winsys;
@@ -81,5 +117,9 @@ void pb_cache_init(struct pb_cache *mgr, uint num_heaps,
                    void (*destroy_buffer)(void *winsys, struct pb_buffer *buf),
                    bool (*can_reclaim)(void *winsys, struct pb_buffer *buf));
 void pb_cache_deinit(struct pb_cache *mgr);
+void pb_cache_set_bucket_max_size(struct pb_cache *mgr, unsigned bucket_index,
+                                  uint64_t max_size);
+void pb_cache_get_stats(struct pb_cache *mgr, unsigned bucket_index,
+                        struct pb_cache_stats *stats);
 
 #endif
@@ -40,6 +40,12 @@
 
 #define DRAW_DBG 0
 
+/* Number of vertices converted at a time */
+#define TRANSLATE_GENERIC_BATCH 64
+
+/* Largest vertex element, R64G64B64A64_FLOAT */
+#define TRANSLATE_GENERIC_MAX_INPUT_SIZE 32
+
 typedef void (*emit_func)(const void *attrib, void *ptr);
 
 
@@ -54,11 +60,15 @@ struct translate_generic {
                     unsigned width);
       unsigned buffer;
       unsigned input_offset;
+      unsigned input_size;
       unsigned instance_divisor;
 
       emit_func emit;
       unsigned output_offset;
 
+      /* non-zero if emit just copies this many bytes of the fetched dwords */
+      unsigned emit_size;
+
       const uint8_t *input_ptr;
       unsigned input_stride;
       unsigned max_index;
@@ -584,65 +594,131 @@ get_emit_func(enum pipe_format format)
    }
 }
 
-static ALWAYS_INLINE void PIPE_CDECL
-generic_run_one(struct translate_generic *tg,
-                unsigned elt,
-                unsigned start_instance,
-                unsigned instance_id,
-                void *vert)
+/**
+ * memcpy() with the common vertex element sizes inlined.
+ */
+static ALWAYS_INLINE void
+copy_element(void *restrict dst, const void *restrict src, unsigned size)
+{
+   switch (size) {
+   case 4:
+      memcpy(dst, src, 4);
+      break;
+   case 8:
+      memcpy(dst, src, 8);
+      break;
+   case 12:
+      memcpy(dst, src, 12);
+      break;
+   case 16:
+      memcpy(dst, src, 16);
+      break;
+   default:
+      memcpy(dst, src, size);
+      break;
+   }
+}
+
+/**
+ * Fetch vertex attributes for up to TRANSLATE_GENERIC_BATCH vertices.
+ *
+ * Attributes are converted one at a time for the whole batch, so the
+ * elements are gathered into a packed array and unpacked with a single
+ * call, which lets u_format use its vectorized functions.  Vertices come
+ * from elts if it is non-NULL, and are start, start + 1, ... otherwise.
+ */
+static void
+generic_run_batch(struct translate_generic *tg,
+                  const unsigned *elts,
+                  unsigned start,
+                  unsigned count,
+                  unsigned start_instance,
+                  unsigned instance_id,
+                  uint8_t *vert)
 {
+   const unsigned stride = tg->translate.key.output_stride;
    unsigned nr_attrs = tg->nr_attrib;
-   unsigned attr;
+   unsigned attr, i;
+
+   assert(count <= TRANSLATE_GENERIC_BATCH);
 
    for (attr = 0; attr < nr_attrs; attr++) {
-      float data[4];
-      uint8_t *dst = (uint8_t *)vert + tg->attrib[attr].output_offset;
+      uint8_t *dst = vert + tg->attrib[attr].output_offset;
+      int copy_size = tg->attrib[attr].copy_size;
 
       if (tg->attrib[attr].type == TRANSLATE_ELEMENT_NORMAL) {
-         const uint8_t *src;
-         unsigned index;
-         int copy_size;
+         const unsigned input_stride = tg->attrib[attr].input_stride;
+         const unsigned max_index = tg->attrib[attr].max_index;
+         const uint8_t *input_ptr = tg->attrib[attr].input_ptr;
 
          if (tg->attrib[attr].instance_divisor) {
-            index = start_instance;
-            index += (instance_id  / tg->attrib[attr].instance_divisor);
-            /* XXX we need to clamp the index here too, but to a
+            /* Every vertex of the batch gets the same value.
+             *
+             * XXX we need to clamp the index here too, but to a
              * per-array max value, not the draw->pt.max_index value
              * that's being given to us via translate->set_buffer().
              */
-         }
-         else {
-            index = elt;
-            /* clamp to avoid going out of bounds */
-            index = MIN2(index, tg->attrib[attr].max_index);
-         }
-
-         src = tg->attrib[attr].input_ptr +
-               (ptrdiff_t)tg->attrib[attr].input_stride * index;
-
-         copy_size = tg->attrib[attr].copy_size;
-         if (likely(copy_size >= 0)) {
-            memcpy(dst, src, copy_size);
+            unsigned index = start_instance +
+               instance_id / tg->attrib[attr].instance_divisor;
+            const uint8_t *src = input_ptr + (ptrdiff_t)input_stride * index;
+
+            if (likely(copy_size >= 0)) {
+               for (i = 0; i < count; i++)
+                  copy_element(dst + i * stride, src, copy_size);
+            } else {
+               float data[4];
+               tg->attrib[attr].fetch(data, src, 1);
+               for (i = 0; i < count; i++)
+                  tg->attrib[attr].emit(data, dst + i * stride);
+            }
+         } else if (likely(copy_size >= 0)) {
+            for (i = 0; i < count; i++) {
+               /* clamp to avoid going out of bounds */
+               unsigned index = MIN2(elts ? elts[i] : start + i, max_index);
+               copy_element(dst + i * stride,
+                            input_ptr + (ptrdiff_t)input_stride * index,
+                            copy_size);
+            }
          } else {
-            tg->attrib[attr].fetch(data, src, 1);
-
-            if (0)
-               debug_printf("Fetch linear attr %d  from %p  stride %d  index %d: "
-                         " %f, %f, %f, %f \n",
-                         attr,
-                         tg->attrib[attr].input_ptr,
-                         tg->attrib[attr].input_stride,
-                         index,
-                         data[0], data[1],data[2], data[3]);
-
-            tg->attrib[attr].emit(data, dst);
+            const unsigned input_size = tg->attrib[attr].input_size;
+            uint8_t packed[TRANSLATE_GENERIC_BATCH * TRANSLATE_GENERIC_MAX_INPUT_SIZE];
+            float data[TRANSLATE_GENERIC_BATCH][4];
+            const uint8_t *src;
+
+            if (!elts && input_stride == input_size &&
+                start + count - 1 <= max_index) {
+               /* tightly packed and in bounds: no need to gather */
+               src = input_ptr + (ptrdiff_t)input_stride * start;
+            } else {
+               for (i = 0; i < count; i++) {
+                  /* clamp to avoid going out of bounds */
+                  unsigned index = MIN2(elts ? elts[i] : start + i, max_index);
+                  copy_element(packed + i * input_size,
+                               input_ptr + (ptrdiff_t)input_stride * index,
+                               input_size);
+               }
+               src = packed;
+            }
+
+            tg->attrib[attr].fetch(data, src, count);
+
+            if (tg->attrib[attr].emit_size) {
+               const unsigned emit_size = tg->attrib[attr].emit_size;
+               for (i = 0; i < count; i++)
+                  copy_element(dst + i * stride, data[i], emit_size);
+            } else {
+               for (i = 0; i < count; i++)
+                  tg->attrib[attr].emit(data[i], dst + i * stride);
+            }
          }
       } else {
-         if (likely(tg->attrib[attr].copy_size >= 0)) {
-            memcpy(data, &instance_id, 4);
+         if (likely(copy_size >= 0)) {
+            for (i = 0; i < count; i++)
+               memcpy(dst + i * stride, &instance_id, 4);
          } else {
-            data[0] = (float)instance_id;
-            tg->attrib[attr].emit(data, dst);
+            float data[4] = { (float)instance_id };
+            for (i = 0; i < count; i++)
+               tg->attrib[attr].emit(data, dst + i * stride);
          }
       }
    }
@@ -660,12 +736,14 @@ generic_run_elts(struct translate *translate,
                  void *output_buffer)
 {
    struct translate_generic *tg = translate_generic(translate);
-   char *vert = output_buffer;
-   unsigned i;
-
-   for (i = 0; i < count; i++) {
-      generic_run_one(tg, *elts++, start_instance, instance_id, vert);
-      vert += tg->translate.key.output_stride;
+   uint8_t *vert = output_buffer;
+
+   while (count) {
+      unsigned n = MIN2(count, TRANSLATE_GENERIC_BATCH);
+      generic_run_batch(tg, elts, 0, n, start_instance, instance_id, vert);
+      elts += n;
+      count -= n;
+      vert += n * tg->translate.key.output_stride;
    }
 }
 
@@ -678,12 +756,17 @@ generic_run_elts16(struct translate *translate,
                    void *output_buffer)
 {
    struct translate_generic *tg = translate_generic(translate);
-   char *vert = output_buffer;
+   uint8_t *vert = output_buffer;
+   unsigned batch[TRANSLATE_GENERIC_BATCH];
    unsigned i;
 
-   for (i = 0; i < count; i++) {
-      generic_run_one(tg, *elts++, start_instance, instance_id, vert);
-      vert += tg->translate.key.output_stride;
+   while (count) {
+      unsigned n = MIN2(count, TRANSLATE_GENERIC_BATCH);
+      for (i = 0; i < n; i++)
+         batch[i] = *elts++;
+      generic_run_batch(tg, batch, 0, n, start_instance, instance_id, vert);
+      count -= n;
+      vert += n * tg->translate.key.output_stride;
    }
 }
 
@@ -696,12 +779,17 @@ generic_run_elts8(struct translate *translate,
                   void *output_buffer)
 {
    struct translate_generic *tg = translate_generic(translate);
-   char *vert = output_buffer;
+   uint8_t *vert = output_buffer;
+   unsigned batch[TRANSLATE_GENERIC_BATCH];
    unsigned i;
 
-   for (i = 0; i < count; i++) {
-      generic_run_one(tg, *elts++, start_instance, instance_id, vert);
-      vert += tg->translate.key.output_stride;
+   while (count) {
+      unsigned n = MIN2(count, TRANSLATE_GENERIC_BATCH);
+      for (i = 0; i < n; i++)
+         batch[i] = *elts++;
+      generic_run_batch(tg, batch, 0, n, start_instance, instance_id, vert);
+      count -= n;
+      vert += n * tg->translate.key.output_stride;
    }
 }
 
@@ -714,12 +802,14 @@ generic_run(struct translate *translate,
             void *output_buffer)
 {
    struct translate_generic *tg = translate_generic(translate);
-   char *vert = output_buffer;
-   unsigned i;
-
-   for (i = 0; i < count; i++) {
-      generic_run_one(tg, start + i, start_instance, instance_id, vert);
-      vert += tg->translate.key.output_stride;
+   uint8_t *vert = output_buffer;
+
+   while (count) {
+      unsigned n = MIN2(count, TRANSLATE_GENERIC_BATCH);
+      generic_run_batch(tg, NULL, start, n, start_instance, instance_id, vert);
+      start += n;
+      count -= n;
+      vert += n * tg->translate.key.output_stride;
    }
 }
 
@@ -775,6 +865,29 @@ is_legal_int_format_combo(const struct util_format_description *src,
    return TRUE;
 }
 
+/**
+ * Whether emitting to the format is a plain copy of the 32-bit float or
+ * integer channels fetched.
+ */
+static boolean
+is_dword_copy_format(const struct util_format_description *desc)
+{
+   unsigned i;
+
+   if (desc->layout != UTIL_FORMAT_LAYOUT_PLAIN)
+      return FALSE;
+
+   for (i = 0; i < desc->nr_channels; i++) {
+      if (desc->channel[i].size != 32 ||
+          desc->channel[i].normalized ||
+          !(desc->channel[i].type == UTIL_FORMAT_TYPE_FLOAT ||
+            desc->channel[i].pure_integer) ||
+          desc->swizzle[i] != PIPE_SWIZZLE_X + i)
+         return FALSE;
+   }
+   return TRUE;
+}
+
 struct translate *
 translate_generic_create(const struct translate_key *key)
 {
@@ -815,6 +928,7 @@ translate_generic_create(const struct translate_key *key)
       tg->attrib[i].fetch = unpack->unpack_rgba;
       tg->attrib[i].buffer = key->element[i].input_buffer;
       tg->attrib[i].input_offset = key->element[i].input_offset;
+      tg->attrib[i].input_size = util_format_get_blocksize(key->element[i].input_format);
       tg->attrib[i].instance_divisor = key->element[i].instance_divisor;
 
       tg->attrib[i].output_offset = key->element[i].output_offset;
@@ -832,10 +946,22 @@ translate_generic_create(const struct translate_key *key)
             tg->attrib[i].copy_size = format_desc->block.bits >> 3;
       }
 
-      if (tg->attrib[i].copy_size < 0)
+      if (tg->attrib[i].copy_size < 0 &&
+          tg->attrib[i].input_size > TRANSLATE_GENERIC_MAX_INPUT_SIZE) {
+         FREE(tg);
+         return NULL;
+      }
+
+      if (tg->attrib[i].copy_size < 0) {
+         const struct util_format_description *out_format_desc =
+               util_format_description(key->element[i].output_format);
+
          tg->attrib[i].emit = get_emit_func(key->element[i].output_format);
-      else
+         if (is_dword_copy_format(out_format_desc))
+            tg->attrib[i].emit_size = out_format_desc->block.bits / 8;
+      } else {
          tg->attrib[i].emit  = NULL;
+      }
    }
 
    tg->nr_attrib = key->nr_elements;
@@ -30,6 +30,7 @@
 #include "util/u_inlines.h"
 #include "util/u_memory.h"
 #include "util/u_upload_mgr.h"
+#include "util/os_time.h"
 #include "driver_trace/tr_context.h"
 #include "util/log.h"
 #include "compiler/shader_info.h"
@@ -188,9 +189,8 @@ tc_drop_vertex_state_references(struct pipe_vertex_state *dst, int num_refs)
    offsetof(struct pipe_draw_info, min_index)
 
 static void
-tc_batch_execute(void *job, UNUSED void *gdata, int thread_index)
+tc_batch_execute(struct tc_batch *batch)
 {
-   struct tc_batch *batch = job;
    struct pipe_context *pipe = batch->tc->pipe;
    uint64_t *last = &batch->slots[batch->num_total_slots];
 
@@ -208,7 +208,18 @@ tc_batch_execute(void *job, UNUSED void *gdata, int thread_index)
       tc_printf("CALL: %s", tc_call_names[call->call_id]);
 #endif
 
-      iter += execute_func[call->call_id](pipe, call, last);
+      uint16_t num_slots = execute_func[call->call_id](pipe, call, last);
+
+      /* Consecutive single draws are merged into one call, see
+       * tc_call_draw_single.
+       */
+      if (call->call_id == TC_CALL_draw_single) {
+         unsigned num_draws = num_slots / call->num_slots;
+
+         batch->tc->num_single_draws += num_draws;
+         batch->tc->num_merged_draws += num_draws - 1;
+      }
+      iter += num_slots;
    }
 
    /* Add the fence to the list of fences for the driver to signal at the next
@@ -240,6 +251,51 @@ tc_batch_execute(void *job, UNUSED void *gdata, int thread_index)
    batch->last_mergeable_call = NULL;
 }
 
+/* The driver thread: execute flushed batches in ring order, sleeping on the
+ * "ready" fence of the next one when there is nothing to do.
+ */
+static int
+tc_queue_thread_func(void *data)
+{
+   struct threaded_context *tc = data;
+   UNUSED unsigned num_executed = 0;
+   unsigned index = 0;
+
+   u_thread_setname("gdrv0");
+
+   while (true) {
+      struct tc_batch *batch = &tc->batch_slots[index];
+
+      util_queue_fence_wait(&batch->ready);
+      if (p_atomic_read(&tc->queue_thread_exit))
+         break;
+      util_queue_fence_reset(&batch->ready);
+
+      /* Pairs with the increment in tc_batch_flush. */
+      UNUSED unsigned num_flushed = p_atomic_read(&tc->num_flushed_batches);
+      assert(num_flushed > num_executed++);
+
+      tc_batch_execute(batch);
+      util_queue_fence_signal(&batch->fence);
+
+      index = (index + 1) % TC_MAX_BATCHES;
+   }
+   return 0;
+}
+
+/* Wait for the driver thread to finish, and account for the stall. */
+static void
+tc_wait_driver_thread(struct threaded_context *tc, struct util_queue_fence *fence)
+{
+   if (util_queue_fence_is_signalled(fence))
+      return;
+
+   int64_t start = os_time_get_nano();
+   util_queue_fence_wait(fence);
+   tc->stall_time_ns += os_time_get_nano() - start;
+   tc->num_stalls++;
+}
+
 static void
 tc_begin_next_buffer_list(struct threaded_context *tc)
 {
@@ -273,10 +329,18 @@ tc_batch_flush(struct threaded_context *tc)
       tc_unflushed_batch_token_reference(&next->token, NULL);
    }
 
-   util_queue_add_job(&tc->queue, next, &next->fence, tc_batch_execute,
-                      NULL, 0);
+   /* Hand the batch over to the driver thread. */
+   util_queue_fence_reset(&next->fence);
+   p_atomic_inc(&tc->num_flushed_batches);
+   util_queue_fence_signal(&next->ready);
+
    tc->last = tc->next;
    tc->next = (tc->next + 1) % TC_MAX_BATCHES;
+
+   /* Wait for the driver thread to be done with the batch we record into
+    * next, if all of them are in flight.
+    */
+   tc_wait_driver_thread(tc, &tc->batch_slots[tc->next].fence);
    tc_begin_next_buffer_list(tc);
 }
 
@@ -292,8 +356,23 @@ tc_add_sized_call(struct threaded_context *tc, enum tc_call_id id,
    assert(num_slots <= TC_SLOTS_PER_BATCH);
    tc_debug_check(tc);
 
-   if (unlikely(next->num_total_slots + num_slots > TC_SLOTS_PER_BATCH)) {
+   if (unlikely(next->num_total_slots + num_slots > TC_SLOTS_PER_BATCH ||
+                next->num_total_slots >= tc->batch_slot_limit)) {
+      bool driver_idle = util_queue_fence_is_signalled(&tc->batch_slots[tc->last].fence);
+      unsigned num_stalls = tc->num_stalls;
+
       tc_batch_flush(tc);
+
+      /* Adapt the batch size: if we had to wait for a free batch, the driver
+       * thread is the bottleneck and larger batches cost it less overhead.
+       * If it had already executed everything, it's waiting for us, so give
+       * it work sooner.
+       */
+      if (tc->num_stalls != num_stalls)
+         tc->batch_slot_limit = MIN2(tc->batch_slot_limit * 2, TC_SLOTS_PER_BATCH);
+      else if (driver_idle)
+         tc->batch_slot_limit = MAX2(tc->batch_slot_limit / 2, TC_MIN_SLOTS_PER_BATCH);
+
       next = &tc->batch_slots[tc->next];
       tc_assert(next->num_total_slots == 0);
       tc_assert(next->last_mergeable_call == NULL);
@@ -396,7 +475,7 @@ _tc_sync(struct threaded_context *tc, UNUSED const char *info, UNUSED const char
 
    /* Only wait for queued calls... */
    if (!util_queue_fence_is_signalled(&last->fence)) {
-      util_queue_fence_wait(&last->fence);
+      tc_wait_driver_thread(tc, &last->fence);
       synced = true;
    }
 
@@ -411,7 +490,7 @@ _tc_sync(struct threaded_context *tc, UNUSED const char *info, UNUSED const char
    if (next->num_total_slots) {
       p_atomic_add(&tc->num_direct_slots, next->num_total_slots);
       tc->bytes_mapped_estimate = 0;
-      tc_batch_execute(next, NULL, 0);
+      tc_batch_execute(next);
       tc_begin_next_buffer_list(tc);
       synced = true;
    }
@@ -1067,13 +1146,48 @@ tc_render_condition(struct pipe_context *_pipe,
       return pipe->create_##name##_state(pipe, state); \
    }
 
-#define TC_CSO_BIND(name, ...) TC_FUNC1(bind_##name##_state, , void *, , , ##__VA_ARGS__)
+/* Binds of the CSO that is already bound are dropped, see bound_* in
+ * threaded_context.
+ */
+#define TC_CSO_BIND(name, ...) \
+   struct tc_call_bind_##name##_state { \
+      struct tc_call_base base; \
+      void *state; \
+   }; \
+   \
+   static uint16_t \
+   tc_call_bind_##name##_state(struct pipe_context *pipe, void *call, uint64_t *last) \
+   { \
+      pipe->bind_##name##_state(pipe, to_call(call, tc_call_bind_##name##_state)->state); \
+      return call_size(tc_call_bind_##name##_state); \
+   } \
+   \
+   static void \
+   tc_bind_##name##_state(struct pipe_context *_pipe, void *state) \
+   { \
+      struct threaded_context *tc = threaded_context(_pipe); \
+      \
+      if (state == tc->bound_##name) { \
+         tc->num_redundant_binds++; \
+         return; \
+      } \
+      tc->bound_##name = state; \
+      \
+      struct tc_call_bind_##name##_state *p = \
+         tc_add_call(tc, TC_CALL_bind_##name##_state, tc_call_bind_##name##_state); \
+      p->state = state; \
+      __VA_ARGS__; \
+   }
+
 #define TC_CSO_DELETE(name) TC_FUNC1(delete_##name##_state, , void *, , )
+#define TC_CSO_DELETE_BOUND(name) \
+   TC_FUNC1(delete_##name##_state, , void *, , , \
+            if (tc->bound_##name == param) tc->bound_##name = NULL)
 
 #define TC_CSO(name, sname, ...) \
    TC_CSO_CREATE(name, sname) \
    TC_CSO_BIND(name, ##__VA_ARGS__) \
-   TC_CSO_DELETE(name)
+   TC_CSO_DELETE_BOUND(name)
 
 #define TC_CSO_WHOLE(name) TC_CSO(name, name)
 #define TC_CSO_SHADER(name) TC_CSO(name, shader)
@@ -1091,7 +1205,7 @@ TC_CSO_SHADER_TRACK(tes)
 TC_CSO_CREATE(sampler, sampler)
 TC_CSO_DELETE(sampler)
 TC_CSO_BIND(vertex_elements)
-TC_CSO_DELETE(vertex_elements)
+TC_CSO_DELETE_BOUND(vertex_elements)
 
 static void *
 tc_create_vertex_elements_state(struct pipe_context *_pipe, unsigned count,
@@ -3045,7 +3159,7 @@ tc_set_context_param(struct pipe_context *_pipe,
 
    if (param == PIPE_CONTEXT_PARAM_PIN_THREADS_TO_L3_CACHE) {
       /* Pin the gallium thread as requested. */
-      util_set_thread_affinity(tc->queue.threads[0],
+      util_set_thread_affinity(tc->queue_thread,
                                util_get_cpu_caps()->L3_affinity_mask[value],
                                NULL, util_get_cpu_caps()->num_cpu_mask_bits);
 
@@ -4404,15 +4518,33 @@ tc_destroy(struct pipe_context *_pipe)
 
    tc_sync(tc);
 
-   if (util_queue_is_initialized(&tc->queue)) {
-      util_queue_destroy(&tc->queue);
+   if (tc->queue_thread_created) {
+      /* The driver thread is idle now, waiting for the next batch. */
+      p_atomic_set(&tc->queue_thread_exit, true);
+      util_queue_fence_signal(&tc->batch_slots[tc->next].ready);
+      thrd_join(tc->queue_thread, NULL);
 
       for (unsigned i = 0; i < TC_MAX_BATCHES; i++) {
+         if (!util_queue_fence_is_signalled(&tc->batch_slots[i].ready))
+            util_queue_fence_signal(&tc->batch_slots[i].ready);
+         util_queue_fence_destroy(&tc->batch_slots[i].ready);
          util_queue_fence_destroy(&tc->batch_slots[i].fence);
          assert(!tc->batch_slots[i].token);
       }
    }
 
+   if (tc->print_stats) {
+      mesa_logi("threaded context: %u batches, %u slots offloaded, "
+                "%u slots executed directly, %u syncs, "
+                "%u stalls for %.3f ms, final batch size %u slots, "
+                "%u of %u single draws merged, %u redundant binds skipped",
+                tc->num_flushed_batches, tc->num_offloaded_slots,
+                tc->num_direct_slots, tc->num_syncs, tc->num_stalls,
+                tc->stall_time_ns / 1000000.0, tc->batch_slot_limit,
+                tc->num_merged_draws, tc->num_single_draws,
+                tc->num_redundant_binds);
+   }
+
    slab_destroy_child(&tc->pool_transfers);
    assert(tc->batch_slots[tc->next].num_total_slots == 0);
    pipe->destroy(pipe);
@@ -4432,6 +4564,15 @@ static const tc_execute execute_func[TC_NUM_CALLS] = {
 #undef CALL
 };
 
+/**
+ * CPU time used by the driver thread, for the HUD.
+ */
+int64_t
+threaded_context_get_thread_time_nano(struct threaded_context *tc)
+{
+   return util_thread_get_time_nano(tc->queue_thread);
+}
+
 void tc_driver_internal_flush_notify(struct threaded_context *tc)
 {
    /* Allow drivers to call this function even for internal contexts that
@@ -4511,12 +4652,8 @@ threaded_context_create(struct pipe_context *pipe,
 
    tc->use_forced_staging_uploads = true;
 
-   /* The queue size is the number of batches "waiting". Batches are removed
-    * from the queue before being executed, so keep one tc_batch slot for that
-    * execution. Also, keep one unused slot for an unflushed batch.
-    */
-   if (!util_queue_init(&tc->queue, "gdrv", TC_MAX_BATCHES - 2, 1, 0, NULL))
-      goto fail;
+   tc->batch_slot_limit = TC_SLOTS_PER_BATCH;
+   tc->print_stats = debug_get_bool_option("GALLIUM_THREAD_STATS", false);
 
    for (unsigned i = 0; i < TC_MAX_BATCHES; i++) {
 #if !defined(NDEBUG) && TC_DEBUG >= 1
@@ -4524,7 +4661,19 @@ threaded_context_create(struct pipe_context *pipe,
 #endif
       tc->batch_slots[i].tc = tc;
       util_queue_fence_init(&tc->batch_slots[i].fence);
+      util_queue_fence_init(&tc->batch_slots[i].ready);
+      util_queue_fence_reset(&tc->batch_slots[i].ready);
+   }
+
+   if (u_thread_create(&tc->queue_thread, tc_queue_thread_func, tc) != thrd_success) {
+      for (unsigned i = 0; i < TC_MAX_BATCHES; i++) {
+         util_queue_fence_signal(&tc->batch_slots[i].ready);
+         util_queue_fence_destroy(&tc->batch_slots[i].ready);
+         util_queue_fence_destroy(&tc->batch_slots[i].fence);
+      }
+      goto fail;
    }
+   tc->queue_thread_created = true;
    for (unsigned i = 0; i < TC_MAX_BUFFER_LISTS; i++)
       util_queue_fence_init(&tc->buffer_lists[i].driver_flushed_fence);
 
@@ -186,9 +186,19 @@
  * 8-byte slots. Calls can occupy 1 or more slots.
  *
  * Once a batch is full and there is no space for the next call, it's flushed,
- * meaning that it's added to the queue for execution in the other thread.
+ * meaning that it's handed to the driver thread for execution.
  * The batches are ordered in a ring and reused once they are idle again.
- * The batching is necessary for low queue/mutex overhead.
+ * The batching is necessary for low synchronization overhead.
+ *
+ * The ring has a single producer (the application thread) and a single
+ * consumer (the driver thread), so no lock is taken: the driver thread
+ * executes the batches in ring order, and only sleeps on a batch's "ready"
+ * fence when it has caught up with the application thread.
+ *
+ * The number of slots after which a batch is flushed adapts to the driver:
+ * it shrinks while the driver thread keeps running out of work, so that it
+ * gets new calls sooner, and grows back when the application thread has to
+ * wait for a free batch.
  */
 
 #ifndef U_THREADED_CONTEXT_H
@@ -229,10 +239,10 @@ struct tc_unflushed_batch_token;
 /* fence is pre-populated with a fence created by the create_fence callback */
 #define TC_FLUSH_ASYNC        (1u << 31)
 
-/* Size of the queue = number of batch slots in memory.
+/* Number of batch slots in memory.
  * - 1 batch is always idle and records new commands
  * - 1 batch is being executed
- * so the queue size is TC_MAX_BATCHES - 2 = number of waiting batches.
+ * so TC_MAX_BATCHES - 2 batches can be waiting.
  *
  * Use a size as small as possible for low CPU L2 cache usage but large enough
  * so that the queue isn't stalled too often for not having enough idle batch
@@ -248,6 +258,9 @@ struct tc_unflushed_batch_token;
  */
 #define TC_SLOTS_PER_BATCH    1536
 
+/* The smallest number of slots after which a batch is flushed. */
+#define TC_MIN_SLOTS_PER_BATCH 192
+
 /* The buffer list queue is much deeper than the batch queue because buffer
  * lists need to stay around until the driver internally flushes its command
  * buffer.
@@ -437,7 +450,10 @@ struct tc_batch {
     */
    struct tc_call_base *last_mergeable_call;
 
+   /* Signalled by the driver thread when the batch has been executed. */
    struct util_queue_fence fence;
+   /* Signalled by the application thread when the batch is flushed. */
+   struct util_queue_fence ready;
    struct tc_unflushed_batch_token *token;
    uint64_t slots[TC_SLOTS_PER_BATCH];
 };
@@ -483,6 +499,18 @@ struct threaded_context {
    unsigned num_direct_slots;
    unsigned num_syncs;
 
+   /* Time the application thread spent waiting for the driver thread. */
+   unsigned num_stalls;
+   uint64_t stall_time_ns;
+
+   /* Single draws executed, and how many of them were merged into the
+    * draw_vbo call of a previous one. Updated by the driver thread.
+    */
+   unsigned num_single_draws;
+   unsigned num_merged_draws;
+   /* CSO binds that were skipped because the CSO was already bound. */
+   unsigned num_redundant_binds;
+
    bool use_forced_staging_uploads;
    bool add_all_gfx_bindings_to_buffer_list;
    bool add_all_compute_bindings_to_buffer_list;
@@ -493,7 +521,38 @@ struct threaded_context {
    uint64_t bytes_mapped_estimate;
    uint64_t bytes_mapped_limit;
 
-   struct util_queue queue;
+   /* The driver thread, which executes flushed batches. */
+   thrd_t queue_thread;
+   bool queue_thread_created;
+   bool queue_thread_exit;
+
+   /* Number of batches flushed to the driver thread. It's incremented before
+    * the batch's "ready" fence is signalled and read back by the driver
+    * thread, which orders the batch contents between the two threads.
+    */
+   unsigned num_flushed_batches;
+
+   /* Current number of slots after which a batch is flushed. */
+   unsigned batch_slot_limit;
+
+   /* GALLIUM_THREAD_STATS */
+   bool print_stats;
+
+   /* The last CSOs bound through the threaded context. Binding the same CSO
+    * again isn't recorded, so that the draws around it stay next to each
+    * other in the batch and can be merged. Deleting a CSO forgets it.
+    */
+   void *bound_blend;
+   void *bound_rasterizer;
+   void *bound_depth_stencil_alpha;
+   void *bound_compute;
+   void *bound_fs;
+   void *bound_vs;
+   void *bound_gs;
+   void *bound_tcs;
+   void *bound_tes;
+   void *bound_vertex_elements;
+
    struct util_queue_fence *fence;
 
 #ifndef NDEBUG
@@ -546,6 +605,7 @@ struct threaded_context {
 };
 
 void threaded_resource_init(struct pipe_resource *res, bool allow_cpu_storage);
+int64_t threaded_context_get_thread_time_nano(struct threaded_context *tc);
 void threaded_resource_deinit(struct pipe_resource *res);
 struct pipe_context *threaded_context_unwrap_sync(struct pipe_context *pipe);
 void tc_driver_internal_flush_notify(struct threaded_context *tc);
@@ -32,11 +32,22 @@
 #include "pipe/p_defines.h"
 #include "util/u_inlines.h"
 #include "pipe/p_context.h"
+#include "pipe/p_screen.h"
 #include "util/u_memory.h"
 #include "util/u_math.h"
 
 #include "u_upload_mgr.h"
 
+/* Maximum number of full buffers kept for reuse in ring mode. */
+#define U_UPLOAD_RING_MAX_BUFFERS 8
+
+struct u_upload_ring_buffer {
+   struct pipe_resource *buffer;
+   struct pipe_transfer *transfer; /* Only kept with persistent mappings. */
+   uint8_t *map;
+   int idle_refcount;
+   struct pipe_fence_handle *fence;
+};
 
 struct u_upload_mgr {
    struct pipe_context *pipe;
@@ -55,6 +66,13 @@ struct u_upload_mgr {
    unsigned offset; /* Aligned offset to the upload buffer, pointing
                      * at the first unused byte. */
    int buffer_private_refcount;
+   int buffer_idle_refcount; /* Own references, including the mapping's. */
+
+   /* Ring mode, see u_upload_enable_ring. Full buffers, oldest first. */
+   boolean ring;
+   boolean ring_fenced;
+   unsigned num_retired;
+   struct u_upload_ring_buffer retired[U_UPLOAD_RING_MAX_BUFFERS];
 };
 
 
@@ -109,6 +127,8 @@ u_upload_clone(struct pipe_context *pipe, struct u_upload_mgr *upload)
                                                  upload->flags);
    if (!upload->map_persistent && result->map_persistent)
       u_upload_disable_persistent(result);
+   if (upload->ring)
+      u_upload_enable_ring(result, upload->ring_fenced);
 
    return result;
 }
@@ -121,6 +141,13 @@ u_upload_disable_persistent(struct u_upload_mgr *upload)
    upload->map_flags |= PIPE_MAP_FLUSH_EXPLICIT;
 }
 
+void
+u_upload_enable_ring(struct u_upload_mgr *upload, boolean fenced)
+{
+   upload->ring = TRUE;
+   upload->ring_fenced = fenced;
+}
+
 static void
 upload_unmap_internal(struct u_upload_mgr *upload, boolean destroying)
 {
@@ -148,10 +175,8 @@ u_upload_unmap(struct u_upload_mgr *upload)
 
 
 static void
-u_upload_release_buffer(struct u_upload_mgr *upload)
+u_upload_drop_private_refs(struct u_upload_mgr *upload)
 {
-   /* Unmap and unreference the upload buffer. */
-   upload_unmap_internal(upload, TRUE);
    if (upload->buffer_private_refcount) {
       /* Subtract the remaining private references before unreferencing
        * the buffer. The mega comment below explains it.
@@ -161,15 +186,136 @@ u_upload_release_buffer(struct u_upload_mgr *upload)
                    -upload->buffer_private_refcount);
       upload->buffer_private_refcount = 0;
    }
+}
+
+static void
+u_upload_release_buffer(struct u_upload_mgr *upload)
+{
+   /* Unmap and unreference the upload buffer. */
+   upload_unmap_internal(upload, TRUE);
+   u_upload_drop_private_refs(upload);
    pipe_resource_reference(&upload->buffer, NULL);
    upload->buffer_size = 0;
 }
 
+static void
+u_upload_release_retired(struct u_upload_mgr *upload, unsigned index)
+{
+   struct pipe_screen *screen = upload->pipe->screen;
+   struct u_upload_ring_buffer *retired = &upload->retired[index];
+
+   if (retired->transfer)
+      pipe_buffer_unmap(upload->pipe, retired->transfer);
+   if (retired->fence)
+      screen->fence_reference(screen, &retired->fence, NULL);
+   pipe_resource_reference(&retired->buffer, NULL);
+
+   upload->num_retired--;
+   memmove(retired, retired + 1,
+           (upload->num_retired - index) * sizeof(*retired));
+}
+
+/* Move the full upload buffer to the end of the ring. The oldest buffer is
+ * released if there are too many.
+ */
+static void
+u_upload_retire_buffer(struct u_upload_mgr *upload)
+{
+   if (!upload->buffer)
+      return;
+
+   if (upload->num_retired == U_UPLOAD_RING_MAX_BUFFERS)
+      u_upload_release_retired(upload, 0);
+
+   /* Persistent mappings are kept, the others are mapped again on reuse. */
+   if (!upload->map_persistent)
+      upload_unmap_internal(upload, TRUE);
+   u_upload_drop_private_refs(upload);
+
+   struct u_upload_ring_buffer *retired = &upload->retired[upload->num_retired++];
+   retired->buffer = upload->buffer;
+   retired->transfer = upload->transfer;
+   retired->map = upload->map;
+   retired->idle_refcount = upload->transfer ? upload->buffer_idle_refcount : 1;
+   retired->fence = NULL;
+
+   /* The fence signals once the commands recorded so far, which are the
+    * only ones that can read this buffer, have finished.
+    */
+   if (upload->ring_fenced)
+      upload->pipe->flush(upload->pipe, &retired->fence, PIPE_FLUSH_DEFERRED);
+
+   upload->buffer = NULL;
+   upload->transfer = NULL;
+   upload->map = NULL;
+   upload->buffer_size = 0;
+}
+
+/* Make the oldest idle buffer of the ring that is large enough the upload
+ * buffer. Return its size or 0 if there is none.
+ */
+static unsigned
+u_upload_reuse_buffer(struct u_upload_mgr *upload, unsigned min_size)
+{
+   struct pipe_screen *screen = upload->pipe->screen;
+
+   for (unsigned i = 0; i < upload->num_retired; i++) {
+      struct u_upload_ring_buffer *retired = &upload->retired[i];
+      unsigned size = retired->buffer->width0;
+
+      /* Anything still bound or used by the driver holds a reference. */
+      if (size < min_size ||
+          p_atomic_read(&retired->buffer->reference.count) !=
+          retired->idle_refcount)
+         continue;
+
+      if (retired->fence) {
+         if (!screen->fence_finish(screen, NULL, retired->fence, 0))
+            continue;
+         screen->fence_reference(screen, &retired->fence, NULL);
+      }
+
+      upload->buffer = retired->buffer;
+      upload->transfer = retired->transfer;
+      upload->map = retired->map;
+      upload->buffer_idle_refcount = retired->idle_refcount;
+      retired->buffer = NULL;
+      retired->transfer = NULL;
+      u_upload_release_retired(upload, i);
+
+      /* See u_upload_alloc_buffer. */
+      upload->buffer_private_refcount = 1 + (size - min_size);
+      p_atomic_add(&upload->buffer->reference.count,
+                   upload->buffer_private_refcount);
+
+      if (!upload->map) {
+         upload->map = pipe_buffer_map_range(upload->pipe, upload->buffer,
+                                             0, size, upload->map_flags,
+                                             &upload->transfer);
+         if (upload->map == NULL) {
+            u_upload_release_buffer(upload);
+            return 0;
+         }
+         upload->buffer_idle_refcount =
+            p_atomic_read(&upload->buffer->reference.count) -
+            upload->buffer_private_refcount;
+      }
+
+      upload->buffer_size = size;
+      upload->offset = 0;
+      return size;
+   }
+
+   return 0;
+}
+
 
 void
 u_upload_destroy(struct u_upload_mgr *upload)
 {
    u_upload_release_buffer(upload);
+   while (upload->num_retired)
+      u_upload_release_retired(upload, upload->num_retired - 1);
    FREE(upload);
 }
 
@@ -181,9 +327,16 @@ u_upload_alloc_buffer(struct u_upload_mgr *upload, unsigned min_size)
    struct pipe_resource buffer;
    unsigned size;
 
-   /* Release the old buffer, if present:
+   /* Release the old buffer, if present, or reuse an idle one in ring mode:
     */
-   u_upload_release_buffer(upload);
+   if (upload->ring) {
+      u_upload_retire_buffer(upload);
+      size = u_upload_reuse_buffer(upload, min_size);
+      if (size)
+         return size;
+   } else {
+      u_upload_release_buffer(upload);
+   }
 
    /* Allocate a new one:
     */
@@ -245,6 +398,11 @@ u_upload_alloc_buffer(struct u_upload_mgr *upload, unsigned min_size)
       return 0;
    }
 
+   /* The mapping may hold a reference too. */
+   upload->buffer_idle_refcount =
+      p_atomic_read(&upload->buffer->reference.count) -
+      upload->buffer_private_refcount;
+
    upload->buffer_size = size;
    upload->offset = 0;
    return size;
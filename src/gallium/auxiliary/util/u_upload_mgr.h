@@ -73,6 +73,22 @@ u_upload_clone(struct pipe_context *pipe, struct u_upload_mgr *upload);
 void
 u_upload_disable_persistent(struct u_upload_mgr *upload);
 
+/**
+ * Reuse full upload buffers instead of allocating a new one every time.
+ *
+ * Up to 8 full buffers are kept, and the oldest idle one that is large
+ * enough becomes the next upload buffer, so new buffers are only allocated
+ * while all of them are still in use. A buffer is idle when the upload
+ * manager holds the only reference to it and, if \p fenced is set, the
+ * fence of a deferred flush done when it filled up has signalled.
+ *
+ * Drivers whose unfinished work references every buffer it reads can pass
+ * FALSE. With TRUE, the pipe_context is flushed from u_upload_alloc, so the
+ * upload manager must not be used while the driver is recording a command.
+ */
+void
+u_upload_enable_ring(struct u_upload_mgr *upload, boolean fenced);
+
 /**
  * Destroy the upload manager.
  */
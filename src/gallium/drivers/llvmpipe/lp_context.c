@@ -282,6 +282,10 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    llvmpipe->pipe.stream_uploader = u_upload_create_default(&llvmpipe->pipe);
    if (!llvmpipe->pipe.stream_uploader)
       goto fail;
+   /* Scenes reference the buffers they read and vertices are fetched at draw
+    * time, so full upload buffers can be reused without fences.
+    */
+   u_upload_enable_ring(llvmpipe->pipe.stream_uploader, FALSE);
    llvmpipe->pipe.const_uploader = llvmpipe->pipe.stream_uploader;
 
    llvmpipe->blitter = util_blitter_create(&llvmpipe->pipe);
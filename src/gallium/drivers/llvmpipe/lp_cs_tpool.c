@@ -28,14 +28,77 @@
  * based on threadpool.c but modified heavily to be compute shader tuned.
  */
 
+#include "util/u_atomic.h"
 #include "util/u_thread.h"
+#include "util/u_math.h"
 #include "util/u_memory.h"
 #include "lp_cs_tpool.h"
 
+/* Number of chunks each range is cut into.  More chunks balance better,
+ * fewer keep neighbouring workgroups on the same thread.
+ */
+#define LP_CS_TPOOL_CHUNKS_PER_RANGE 8
+
+/* How long an idle worker polls for new work before sleeping. */
+#define LP_CS_TPOOL_SPIN_COUNT 4096
+
+/**
+ * Grab the next chunk of iterations, from range \p home if possible,
+ * otherwise from any other range.
+ * \return FALSE when no iterations are left to start.
+ */
+static bool
+lp_cs_tpool_grab_chunk(struct lp_cs_tpool_task *task, unsigned home,
+                       unsigned *start, unsigned *count)
+{
+   for (unsigned i = 0; i < task->num_ranges; i++) {
+      struct lp_cs_tpool_range *range =
+         &task->ranges[(home + i) % task->num_ranges];
+
+      if (p_atomic_read_relaxed(&range->next) >= range->end)
+         continue;
+
+      unsigned first = p_atomic_fetch_add(&range->next, task->chunk_size);
+      if (first >= range->end)
+         continue;
+
+      *start = first;
+      *count = MIN2(task->chunk_size, range->end - first);
+      return true;
+   }
+   return false;
+}
+
+/**
+ * Run chunks of the task until no iterations are left to start.
+ */
+static void
+lp_cs_tpool_run_task(struct lp_cs_tpool_task *task, unsigned home,
+                     struct lp_cs_local_mem *lmem)
+{
+   unsigned start, count;
+
+   while (lp_cs_tpool_grab_chunk(task, home, &start, &count)) {
+      for (unsigned i = 0; i < count; i++)
+         task->work(task->data, start + i, lmem);
+      p_atomic_add(&task->iter_finished, count);
+   }
+}
+
+static void
+lp_cs_tpool_dequeue(struct lp_cs_tpool_task *task)
+{
+   if (task->queued) {
+      list_del(&task->list);
+      task->queued = false;
+   }
+}
+
 static int
 lp_cs_tpool_worker(void *data)
 {
-   struct lp_cs_tpool *pool = data;
+   struct lp_cs_tpool_thread *thread = data;
+   struct lp_cs_tpool *pool = thread->pool;
    struct lp_cs_local_mem lmem;
 
    memset(&lmem, 0, sizeof(lmem));
@@ -43,7 +106,17 @@ lp_cs_tpool_worker(void *data)
 
    while (!pool->shutdown) {
       struct lp_cs_tpool_task *task;
-      unsigned iter_per_thread;
+
+      if (list_is_empty(&pool->workqueue) && !pool->shutdown) {
+         unsigned seqno = pool->work_seqno;
+
+         mtx_unlock(&pool->m);
+         for (unsigned i = 0; i < LP_CS_TPOOL_SPIN_COUNT; i++) {
+            if (p_atomic_read(&pool->work_seqno) != seqno)
+               break;
+         }
+         mtx_lock(&pool->m);
+      }
 
       while (list_is_empty(&pool->workqueue) && !pool->shutdown)
          cnd_wait(&pool->new_work, &pool->m);
@@ -53,29 +126,15 @@ lp_cs_tpool_worker(void *data)
 
       task = list_first_entry(&pool->workqueue, struct lp_cs_tpool_task,
                               list);
-
-      unsigned this_iter = task->iter_start;
-
-      iter_per_thread = task->iter_per_thread;
-
-      if (task->iter_remainder &&
-          task->iter_start + task->iter_remainder == task->iter_total) {
-         task->iter_remainder--;
-         iter_per_thread = 1;
-      }
-
-      task->iter_start += iter_per_thread;
-
-      if (task->iter_start == task->iter_total)
-         list_del(&task->list);
-
+      task->active_workers++;
       mtx_unlock(&pool->m);
-      for (unsigned i = 0; i < iter_per_thread; i++)
-         task->work(task->data, this_iter + i, &lmem);
+
+      lp_cs_tpool_run_task(task, (thread->idx + 1) % task->num_ranges, &lmem);
 
       mtx_lock(&pool->m);
-      task->iter_finished += iter_per_thread;
-      if (task->iter_finished == task->iter_total)
+      /* Nothing left to start, don't let other workers pick it up. */
+      lp_cs_tpool_dequeue(task);
+      if (--task->active_workers == 0)
          cnd_broadcast(&task->finish);
    }
    mtx_unlock(&pool->m);
@@ -97,7 +156,10 @@ lp_cs_tpool_create(unsigned num_threads)
    list_inithead(&pool->workqueue);
    assert (num_threads <= LP_MAX_THREADS);
    for (unsigned i = 0; i < num_threads; i++) {
-      if (thrd_success != u_thread_create(pool->threads + i, lp_cs_tpool_worker, pool)) {
+      pool->thread_data[i].pool = pool;
+      pool->thread_data[i].idx = i;
+      if (thrd_success != u_thread_create(pool->threads + i, lp_cs_tpool_worker,
+                                          &pool->thread_data[i])) {
          num_threads = i;  /* previous thread is max */
          break;
       }
@@ -132,7 +194,8 @@ lp_cs_tpool_queue_task(struct lp_cs_tpool *pool,
 {
    struct lp_cs_tpool_task *task;
 
-   if (pool->num_threads == 0) {
+   /* A single iteration isn't worth waking anybody up for. */
+   if (pool->num_threads == 0 || num_iters == 1) {
       struct lp_cs_local_mem lmem;
 
       memset(&lmem, 0, sizeof(lmem));
@@ -142,7 +205,7 @@ lp_cs_tpool_queue_task(struct lp_cs_tpool *pool,
       FREE(lmem.local_mem_ptr);
       return NULL;
    }
-   task = CALLOC_STRUCT(lp_cs_tpool_task);
+   task = MALLOC_STRUCT(lp_cs_tpool_task);
    if (!task) {
       return NULL;
    }
@@ -150,17 +213,33 @@ lp_cs_tpool_queue_task(struct lp_cs_tpool *pool,
    task->work = work;
    task->data = data;
    task->iter_total = num_iters;
-
-   task->iter_per_thread = num_iters / pool->num_threads;
-   task->iter_remainder = num_iters % pool->num_threads;
+   task->iter_finished = 0;
+   task->active_workers = 0;
+
+   /* The waiting thread takes part too, see lp_cs_tpool_wait_for_task(). */
+   task->num_ranges = MIN2(pool->num_threads + 1, num_iters);
+   for (unsigned i = 0; i < task->num_ranges; i++) {
+      task->ranges[i].next = (uint64_t)num_iters * i / task->num_ranges;
+      task->ranges[i].end = (uint64_t)num_iters * (i + 1) / task->num_ranges;
+   }
+   task->chunk_size = MAX2(num_iters / (task->num_ranges *
+                                        LP_CS_TPOOL_CHUNKS_PER_RANGE), 1);
 
    cnd_init(&task->finish);
 
    mtx_lock(&pool->m);
 
    list_addtail(&task->list, &pool->workqueue);
-
-   cnd_broadcast(&pool->new_work);
+   task->queued = true;
+   p_atomic_inc(&pool->work_seqno);
+
+   /* Only wake up as many workers as there are ranges for them. */
+   if (task->num_ranges > pool->num_threads)
+      cnd_broadcast(&pool->new_work);
+   else {
+      for (unsigned i = 1; i < task->num_ranges; i++)
+         cnd_signal(&pool->new_work);
+   }
    mtx_unlock(&pool->m);
    return task;
 }
@@ -170,13 +249,21 @@ lp_cs_tpool_wait_for_task(struct lp_cs_tpool *pool,
                           struct lp_cs_tpool_task **task_handle)
 {
    struct lp_cs_tpool_task *task = *task_handle;
+   struct lp_cs_local_mem lmem;
 
    if (!pool || !task)
       return;
 
+   /* Help out rather than just sleeping. */
+   memset(&lmem, 0, sizeof(lmem));
+   lp_cs_tpool_run_task(task, 0, &lmem);
+   FREE(lmem.local_mem_ptr);
+
    mtx_lock(&pool->m);
-   while (task->iter_finished < task->iter_total)
+   while (p_atomic_read(&task->iter_finished) < task->iter_total ||
+          task->active_workers)
       cnd_wait(&task->finish, &pool->m);
+   lp_cs_tpool_dequeue(task);
    mtx_unlock(&pool->m);
 
    cnd_destroy(&task->finish);
@@ -30,6 +30,11 @@
  * structs with just unique indexes in them.
  * It also supports a local memory support struct to be passed from
  * outside the thread exec function.
+ *
+ * The iterations of a task are split into one contiguous range per
+ * thread (the thread waiting for the task included), and every thread
+ * takes chunks from its own range first and then steals chunks from the
+ * other ranges, so uneven iteration costs don't leave threads idle.
  */
 #ifndef LP_CS_QUEUE
 #define LP_CS_QUEUE
@@ -41,14 +46,27 @@
 
 #include "lp_limits.h"
 
+struct lp_cs_tpool;
+
+struct lp_cs_tpool_thread {
+   struct lp_cs_tpool *pool;
+   unsigned idx;
+};
+
 struct lp_cs_tpool {
    mtx_t m;
    cnd_t new_work;
 
    thrd_t threads[LP_MAX_THREADS];
+   struct lp_cs_tpool_thread thread_data[LP_MAX_THREADS];
    unsigned num_threads;
    struct list_head workqueue;
    bool shutdown;
+
+   /* Bumped whenever a task gets queued, so idle workers can spin on it
+    * for a little while before going to sleep.
+    */
+   unsigned work_seqno;
 };
 
 struct lp_cs_local_mem {
@@ -58,16 +76,27 @@ struct lp_cs_local_mem {
 
 typedef void (*lp_cs_tpool_task_func)(void *data, int iter_idx, struct lp_cs_local_mem *lmem);
 
+/* One range per participating thread, on separate cache lines as they
+ * are hammered by atomics.
+ */
+struct lp_cs_tpool_range {
+   unsigned next;
+   unsigned end;
+   char pad[64 - 2 * sizeof(unsigned)];
+};
+
 struct lp_cs_tpool_task {
    lp_cs_tpool_task_func work;
    void *data;
    struct list_head list;
    cnd_t finish;
    unsigned iter_total;
-   unsigned iter_start;
    unsigned iter_finished;
-   unsigned iter_per_thread;
-   unsigned iter_remainder;
+   unsigned chunk_size;
+   unsigned num_ranges;
+   unsigned active_workers;
+   bool queued;
+   struct lp_cs_tpool_range ranges[LP_MAX_THREADS + 1];
 };
 
 struct lp_cs_tpool *lp_cs_tpool_create(unsigned num_threads);
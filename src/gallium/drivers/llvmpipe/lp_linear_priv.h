@@ -29,6 +29,11 @@ struct lp_linear_sampler {
    int width;
    boolean axis_aligned;
 
+   /**
+    * BGRA/BGRX fetch function wrapped by the RGBA/RGBX channel swap.
+    */
+   lp_linear_func swizzled_fetch;
+
    alignas(16) uint32_t row[64];
    alignas(16) uint32_t stretched_row[2][64];
 
@@ -709,6 +709,43 @@ sampler_is_nearest(const struct lp_linear_sampler *samp,
    return TRUE;
 }
 
+/*
+ * Swap the red and blue channels of the texels returned by the wrapped
+ * BGRA/BGRX fetch function, for sampling RGBA/RGBX textures.
+ */
+static const uint32_t *
+fetch_swap_rb(struct lp_linear_elem *elem)
+{
+   struct lp_linear_sampler *samp = (struct lp_linear_sampler *)elem;
+   const uint32_t *src_row = samp->swizzled_fetch(elem);
+   const __m128i ag_mask = _mm_set1_epi32(0xff00ff00);
+   const __m128i b_mask = _mm_set1_epi32(0x000000ff);
+   const int width = samp->width;
+   uint32_t *row = samp->row;
+   int i;
+
+   for (i = 0; i + 4 <= width; i += 4) {
+      __m128i texels = _mm_loadu_si128((const __m128i *)&src_row[i]);
+      __m128i ag = _mm_and_si128(texels, ag_mask);
+      __m128i r = _mm_and_si128(_mm_srli_epi32(texels, 16), b_mask);
+      __m128i b = _mm_slli_epi32(_mm_and_si128(texels, b_mask), 16);
+
+      texels = _mm_or_si128(ag, _mm_or_si128(r, b));
+      _mm_store_si128((__m128i *)&row[i], texels);
+   }
+
+   for (; i < width; i++) {
+      uint32_t texel = src_row[i];
+
+      row[i] = (texel & 0xff00ff00) |
+               ((texel >> 16) & 0xff) |
+               ((texel & 0xff) << 16);
+   }
+
+   return row;
+}
+
+
 /* XXX: Lots of static-state parameters being passed in here but very
  * little info is extracted from each one.  Consolidate it all down to
  * something succinct in the prepare phase?
@@ -867,8 +904,27 @@ lp_linear_init_sampler(struct lp_linear_sampler *samp,
        return FALSE;
    }
 
+   /* RGBA/RGBX textures are fetched with the BGRA/BGRX routines and have
+    * their red and blue channels swapped afterwards.
+    */
+   enum pipe_format format = sampler_state->texture_state.format;
+   boolean swap_rb = FALSE;
+
+   switch (format) {
+   case PIPE_FORMAT_R8G8B8A8_UNORM:
+      format = PIPE_FORMAT_B8G8R8A8_UNORM;
+      swap_rb = TRUE;
+      break;
+   case PIPE_FORMAT_R8G8B8X8_UNORM:
+      format = PIPE_FORMAT_B8G8R8X8_UNORM;
+      swap_rb = TRUE;
+      break;
+   default:
+      break;
+   }
+
    if (is_nearest) {
-      switch (sampler_state->texture_state.format) {
+      switch (format) {
       case PIPE_FORMAT_B8G8R8A8_UNORM:
          if (need_wrap)
             samp->base.fetch = fetch_bgra_clamp;
@@ -878,7 +934,7 @@ lp_linear_init_sampler(struct lp_linear_sampler *samp,
             samp->base.fetch = fetch_bgra_axis_aligned;
          else
             samp->base.fetch = fetch_bgra_memcpy;
-         return TRUE;
+         break;
       case PIPE_FORMAT_B8G8R8X8_UNORM:
          if (need_wrap)
             samp->base.fetch = fetch_bgrx_clamp;
@@ -888,19 +944,17 @@ lp_linear_init_sampler(struct lp_linear_sampler *samp,
             samp->base.fetch = fetch_bgrx_axis_aligned;
          else
             samp->base.fetch = fetch_bgrx_memcpy;
-         return TRUE;
-      default:
          break;
+      default:
+         FAIL("unknown format for nearest");
       }
-
-      FAIL("unknown format for nearest");
    }
    else {
       samp->stretched_row_y[0] = -1;
       samp->stretched_row_y[1] = -1;
       samp->stretched_row_index = 0;
 
-      switch (sampler_state->texture_state.format) {
+      switch (format) {
       case PIPE_FORMAT_B8G8R8A8_UNORM:
          if (need_wrap)
             samp->base.fetch = fetch_bgra_clamp_linear;
@@ -908,7 +962,7 @@ lp_linear_init_sampler(struct lp_linear_sampler *samp,
             samp->base.fetch = fetch_bgra_linear;
          else
             samp->base.fetch = fetch_bgra_axis_aligned_linear;
-         return TRUE;
+         break;
       case PIPE_FORMAT_B8G8R8X8_UNORM:
          if (need_wrap)
             samp->base.fetch = fetch_bgrx_clamp_linear;
@@ -916,13 +970,18 @@ lp_linear_init_sampler(struct lp_linear_sampler *samp,
             samp->base.fetch = fetch_bgrx_linear;
          else
             samp->base.fetch = fetch_bgrx_axis_aligned_linear;
-         return TRUE;
-      default:
          break;
+      default:
+         FAIL("unknown format");
       }
+   }
 
-      FAIL("unknown format");
+   if (swap_rb) {
+      samp->swizzled_fetch = samp->base.fetch;
+      samp->base.fetch = fetch_swap_rb;
    }
+
+   return TRUE;
 }
 
 
@@ -968,11 +1027,19 @@ lp_linear_check_sampler(const struct lp_sampler_static_state *sampler,
        !is_linear_sampler(sampler))
       return FALSE;
 
-   /* These are the only texture formats we support at the moment
+   /* These are the only texture formats we support at the moment.
+    * sRGB formats are left on the SoA path, as decoding them to 8 bit
+    * linear intermediates loses too much precision.
     */
-   if (sampler->texture_state.format != PIPE_FORMAT_B8G8R8A8_UNORM &&
-       sampler->texture_state.format != PIPE_FORMAT_B8G8R8X8_UNORM)
+   switch (sampler->texture_state.format) {
+   case PIPE_FORMAT_B8G8R8A8_UNORM:
+   case PIPE_FORMAT_B8G8R8X8_UNORM:
+   case PIPE_FORMAT_R8G8B8A8_UNORM:
+   case PIPE_FORMAT_R8G8B8X8_UNORM:
+      break;
+   default:
       return FALSE;
+   }
 
    /* We don't support sampler view swizzling on the linear path */
    if (sampler->texture_state.swizzle_r != PIPE_SWIZZLE_X ||
@@ -121,6 +121,10 @@ lp_print_counters(void)
       debug_printf("llvmpipe: nr_llvm_compiles:             %u\n", lp_count.nr_llvm_compiles);
       debug_printf("llvmpipe: total LLVM compile time:      %.2f sec\n", lp_count.llvm_compile_time / 1000000.0);
       debug_printf("llvmpipe: average LLVM compile time:    %.2f sec\n", lp_count.llvm_compile_time / 1000000.0 / lp_count.nr_llvm_compiles);
+      debug_printf("llvmpipe: nr_llvm_modules:              %u\n", lp_count.nr_llvm_modules);
+      debug_printf("llvmpipe: nr_llvm_batched:              %u\n", lp_count.nr_llvm_batched);
+      if (lp_count.llvm_compile_time)
+         debug_printf("llvmpipe: LLVM compile throughput:      %.1f shaders/sec\n", lp_count.nr_llvm_compiles * 1000000.0 / lp_count.llvm_compile_time);
 
    }
 }
@@ -63,6 +63,8 @@ struct lp_counters
    unsigned nr_rect_partially_covered_4;
    unsigned nr_non_empty_4;
    unsigned nr_llvm_compiles;
+   unsigned nr_llvm_modules;   /**< MCJIT modules the compiles went into */
+   unsigned nr_llvm_batched;   /**< setup variants sharing an fs module */
    int64_t llvm_compile_time;  /**< total, in microseconds */
 
    unsigned nr_color_tile_clear;
@@ -96,6 +96,7 @@ static const struct debug_named_value lp_perf_flags[] = {
    { "no_alphatest",   PERF_NO_ALPHATEST, NULL },
    { "no_rast_linear", PERF_NO_RAST_LINEAR, NULL },
    { "no_shade",       PERF_NO_SHADE, NULL },
+   { "no_batch",       PERF_NO_BATCH, NULL },
    DEBUG_NAMED_VALUE_END
 };
 
@@ -339,6 +340,10 @@ llvmpipe_get_param(struct pipe_screen *screen, enum pipe_cap param)
        */
       return 0;
 
+   case PIPE_CAP_SHAREABLE_STATES:
+      /* The other CSOs are plain copies of their templates. */
+      return 1;
+
    case PIPE_CAP_MAX_GS_INVOCATIONS:
       return 32;
    case PIPE_CAP_MAX_SHADER_BUFFER_SIZE_UINT:
@@ -47,9 +47,11 @@
 
 
 /* It should be a multiple of both 6 and 4 (in other words, a multiple of 12)
- * to ensure draw splits between a whole number of rectangles.
+ * to ensure draw splits between a whole number of rectangles.  It also
+ * bounds the segments the draw module's vsplit front end cuts indexed list
+ * primitives into, which reuse vertices better the longer they are.
  */
-#define LP_MAX_VBUF_INDEXES 1020
+#define LP_MAX_VBUF_INDEXES 4092
 
 #define LP_MAX_VBUF_SIZE    4096
 
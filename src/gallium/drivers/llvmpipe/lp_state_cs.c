@@ -905,6 +905,7 @@ llvmpipe_update_cs(struct llvmpipe_context *lp)
       dt = t1 - t0;
       LP_COUNT_ADD(llvm_compile_time, dt);
       LP_COUNT_ADD(nr_llvm_compiles, 2);  /* emit vs. omit in/out test */
+      LP_COUNT_ADD(nr_llvm_modules, 1);
 
       /* Put the new variant into the list */
       if (variant) {
@@ -1320,6 +1321,46 @@ llvmpipe_cs_update_derived(struct llvmpipe_context *llvmpipe, const void *input)
    llvmpipe->cs_dirty = 0;
 }
 
+/* Workgroups are handed out to threads in runs of consecutive iterations,
+ * so walk 2D grids in tiles of this size to keep the workgroups a thread
+ * runs close together in memory.
+ */
+#define LP_CS_TILE_SIZE 4
+
+/**
+ * Map an iteration index to a workgroup id, walking each slice of the grid
+ * as rows of LP_CS_TILE_SIZE x LP_CS_TILE_SIZE tiles.  Tiles on the right
+ * and bottom edges may be smaller.
+ */
+static void
+cs_iter_to_grid(const struct lp_cs_job_info *job_info, unsigned iter_idx,
+                unsigned grid[3])
+{
+   const unsigned width = job_info->grid_size[0];
+   const unsigned height = job_info->grid_size[1];
+   const unsigned slice = width * height;
+
+   grid[2] = iter_idx / slice;
+   iter_idx -= grid[2] * slice;
+
+   if (width <= LP_CS_TILE_SIZE || height <= 1) {
+      grid[1] = iter_idx / width;
+      grid[0] = iter_idx - grid[1] * width;
+      return;
+   }
+
+   const unsigned band = iter_idx / (width * LP_CS_TILE_SIZE);
+   iter_idx -= band * width * LP_CS_TILE_SIZE;
+   const unsigned tile_h = MIN2(LP_CS_TILE_SIZE, height - band * LP_CS_TILE_SIZE);
+
+   const unsigned tile = iter_idx / (LP_CS_TILE_SIZE * tile_h);
+   iter_idx -= tile * LP_CS_TILE_SIZE * tile_h;
+   const unsigned tile_w = MIN2(LP_CS_TILE_SIZE, width - tile * LP_CS_TILE_SIZE);
+
+   grid[1] = band * LP_CS_TILE_SIZE + iter_idx / tile_w;
+   grid[0] = tile * LP_CS_TILE_SIZE + iter_idx % tile_w;
+}
+
 static void
 cs_exec_fn(void *init_data, int iter_idx, struct lp_cs_local_mem *lmem)
 {
@@ -1337,13 +1378,12 @@ cs_exec_fn(void *init_data, int iter_idx, struct lp_cs_local_mem *lmem)
       memset(lmem->local_mem_ptr, 0, job_info->req_local_mem);
    thread_data.shared = lmem->local_mem_ptr;
 
-   unsigned grid_z = iter_idx / (job_info->grid_size[0] * job_info->grid_size[1]);
-   unsigned grid_y = (iter_idx - (grid_z * (job_info->grid_size[0] * job_info->grid_size[1]))) / job_info->grid_size[0];
-   unsigned grid_x = (iter_idx - (grid_z * (job_info->grid_size[0] * job_info->grid_size[1])) - (grid_y * job_info->grid_size[0]));
+   unsigned grid[3];
+   cs_iter_to_grid(job_info, iter_idx, grid);
 
-   grid_z += job_info->grid_base[2];
-   grid_y += job_info->grid_base[1];
-   grid_x += job_info->grid_base[0];
+   unsigned grid_z = grid[2] + job_info->grid_base[2];
+   unsigned grid_y = grid[1] + job_info->grid_base[1];
+   unsigned grid_x = grid[0] + job_info->grid_base[0];
    struct lp_compute_shader_variant *variant = job_info->current->variant;
    variant->jit_function(&job_info->current->jit_context,
                          job_info->block_size[0], job_info->block_size[1], job_info->block_size[2],
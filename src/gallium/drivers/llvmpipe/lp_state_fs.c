@@ -3825,6 +3825,15 @@ generate_variant(struct llvmpipe_context *lp,
       }
    }
 
+   /*
+    * The setup variant for the new state usually misses too; compile it as
+    * part of this module.  Not when the code comes from the disk cache, as
+    * the cached object would lack the setup function.
+    */
+   struct lp_setup_variant *setup_variant = NULL;
+   if (!cached.data_size)
+      setup_variant = lp_setup_batch_variant(lp, variant->gallivm);
+
    /*
     * Compile everything
     */
@@ -3833,6 +3842,9 @@ generate_variant(struct llvmpipe_context *lp,
 
    variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
 
+   if (setup_variant)
+      lp_setup_finish_batched_variant(lp, setup_variant);
+
    if (variant->function[RAST_EDGE_TEST]) {
       variant->jit_function[RAST_EDGE_TEST] = (lp_jit_frag_func)
             gallivm_jit_function(variant->gallivm,
@@ -4029,7 +4041,7 @@ void
 llvmpipe_destroy_shader_variant(struct llvmpipe_context *lp,
                                 struct lp_fragment_shader_variant *variant)
 {
-   gallivm_destroy(variant->gallivm);
+   gallivm_reference(&variant->gallivm, NULL);
    lp_fs_reference(lp, &variant->shader, NULL);
    FREE(variant);
 }
@@ -4588,6 +4600,7 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
       int64_t dt = t1 - t0;
       LP_COUNT_ADD(llvm_compile_time, dt);
       LP_COUNT_ADD(nr_llvm_compiles, 2);  /* emit vs. omit in/out test */
+      LP_COUNT_ADD(nr_llvm_modules, 1);
 
       /* Put the new variant into the list */
       if (variant) {
@@ -28,6 +28,7 @@
 
 #include "util/u_memory.h"
 #include "util/u_math.h"
+#include "util/set.h"
 #include "tgsi/tgsi_parse.h"
 #include "tgsi/tgsi_text.h"
 #include "tgsi/tgsi_util.h"
@@ -253,21 +254,30 @@ get_texcoord_provenance(const nir_tex_src *texcoord,
 {
    assert(texcoord->src_type == nir_tex_src_coord);
 
-   // The parent instr of the coord should be an nir_op_vec2 alu op
+   // The parent instr of the coord should be an nir_op_vec2 alu op, or a
+   // swizzling nir_op_mov (as produced by tgsi_to_nir).
    const nir_instr *parent = texcoord->src.ssa->parent_instr;
    if (!parent || parent->type != nir_instr_type_alu) {
       return false;
    }
    const nir_alu_instr *alu = nir_instr_as_alu(parent);
-   if (!alu || alu->op != nir_op_vec2) {
+   if (!alu || (alu->op != nir_op_vec2 && alu->op != nir_op_mov)) {
       return false;
    }
 
-   // Loop over nir_op_vec2 instruction arguments to find the
-   // input register index and component.
+   // Loop over nir_op_vec2 instruction arguments (or nir_op_mov components)
+   // to find the input register index and component.
    unsigned input_reg_indexes[2];
    for (unsigned comp = 0; comp < 2; comp++) {
-      if (!get_nir_input_info(&alu->src[comp],
+      nir_alu_src src;
+      if (alu->op == nir_op_mov) {
+         src = alu->src[0];
+         src.swizzle[0] = alu->src[0].swizzle[comp];
+      } else {
+         src = alu->src[comp];
+      }
+
+      if (!get_nir_input_info(&src,
                               &input_reg_indexes[comp], &swizzle[comp])) {
          return false;
       }
@@ -284,12 +294,187 @@ get_texcoord_provenance(const nir_tex_src *texcoord,
 }
 
 
+/*
+ * Immediate operands of arithmetic instructions must be 32-bit floats in
+ * the range [0,1], as the linear path works on unorm8 values.  The AoS
+ * code splats scalars and converts vec4s, but has no channel layout for
+ * vec2/vec3 immediates.
+ */
+static bool
+linear_alu_immediates_ok(const nir_alu_instr *alu,
+                         struct lp_tgsi_info *info)
+{
+   unsigned num_src = nir_op_infos[alu->op].num_inputs;
+   for (unsigned s = 0; s < num_src; s++) {
+      if (nir_src_is_const(alu->src[s].src)) {
+         nir_load_const_instr *load =
+            nir_instr_as_load_const(alu->src[s].src.ssa->parent_instr);
+
+         if (load->def.bit_size != 32 ||
+             (load->def.num_components != 1 && load->def.num_components != 4))
+            return false;
+         for (unsigned c = 0; c < load->def.num_components; c++) {
+            if (load->value[c].f32 < 0.0 || load->value[c].f32 > 1.0) {
+               info->unclamped_immediates = true;
+               return false;
+            }
+         }
+      }
+   }
+   return true;
+}
+
+
+/*
+ * The AoS code generator ignores ALU source swizzles, so only accept
+ * identity swizzles, or scalar constants which get splatted anyway.
+ */
+static bool
+linear_alu_swizzles_ok(const nir_alu_instr *alu)
+{
+   unsigned num_src = nir_op_infos[alu->op].num_inputs;
+   for (unsigned s = 0; s < num_src; s++) {
+      if (!alu->src[s].src.is_ssa)
+         return false;
+
+      const nir_ssa_def *def = alu->src[s].src.ssa;
+      const nir_instr *parent = def->parent_instr;
+      if (def->num_components == 1 &&
+          (parent->type == nir_instr_type_load_const ||
+           (parent->type == nir_instr_type_intrinsic &&
+            nir_instr_as_intrinsic(parent)->intrinsic ==
+               nir_intrinsic_load_ubo)))
+         continue;
+
+      for (unsigned c = 0; c < nir_ssa_alu_instr_src_components(alu, s); c++) {
+         if (alu->src[s].swizzle[c] != c)
+            return false;
+      }
+   }
+   return true;
+}
+
+
+static bool
+linear_alu_src_is_clamped(const nir_alu_instr *alu, unsigned s,
+                          struct set *clamped)
+{
+   return alu->src[s].src.is_ssa &&
+          _mesa_set_search(clamped, alu->src[s].src.ssa) != NULL;
+}
+
+
+/*
+ * Whether the value is a constant 1.0 in all the components read.
+ */
+static bool
+linear_alu_src_is_one(const nir_alu_instr *alu, unsigned s)
+{
+   if (!nir_src_is_const(alu->src[s].src))
+      return false;
+
+   for (unsigned c = 0; c < nir_ssa_alu_instr_src_components(alu, s); c++) {
+      if (nir_src_comp_as_float(alu->src[s].src, alu->src[s].swizzle[c]) != 1.0)
+         return false;
+   }
+   return true;
+}
+
+
+/*
+ * Examine an ALU instruction to determine if it's "linear".
+ *
+ * The AoS code works on unorm8 values, so results are implicitly clamped
+ * to [0,1].  Values whose float result may fall outside that range
+ * (additions and subtractions, except 1 - x) are recorded in the clamped
+ * set, and may only reach the output through min/max and moves, which
+ * commute with clamping.
+ */
+static bool
+llvmpipe_nir_alu_is_linear_compat(const nir_alu_instr *alu,
+                                  struct set *clamped,
+                                  struct lp_tgsi_info *info)
+{
+   unsigned num_src = nir_op_infos[alu->op].num_inputs;
+   bool any_clamped = false;
+
+   for (unsigned s = 0; s < num_src; s++)
+      any_clamped |= linear_alu_src_is_clamped(alu, s, clamped);
+
+   switch (alu->op) {
+   case nir_op_mov:
+   case nir_op_vec2:
+   case nir_op_vec4:
+      // these instructions are OK
+      break;
+   case nir_op_fmin:
+   case nir_op_fmax:
+      if (!linear_alu_immediates_ok(alu, info) ||
+          !linear_alu_swizzles_ok(alu))
+         return false;
+      break;
+   case nir_op_fmul:
+      if (any_clamped ||
+          !linear_alu_immediates_ok(alu, info) ||
+          !linear_alu_swizzles_ok(alu))
+         return false;
+      break;
+   case nir_op_fneg:
+      /* Only as the subtrahend of a subtraction. */
+      if (any_clamped || !linear_alu_swizzles_ok(alu) ||
+          !alu->dest.dest.is_ssa ||
+          !list_is_empty(&alu->dest.dest.ssa.if_uses))
+         return false;
+      nir_foreach_use(use, &alu->dest.dest.ssa) {
+         if (use->parent_instr->type != nir_instr_type_alu ||
+             nir_instr_as_alu(use->parent_instr)->op != nir_op_fadd)
+            return false;
+      }
+      return true;
+   case nir_op_fadd: {
+      if (any_clamped ||
+          !linear_alu_immediates_ok(alu, info) ||
+          !linear_alu_swizzles_ok(alu))
+         return false;
+
+      bool exact = false;
+      for (unsigned s = 0; s < 2; s++) {
+         nir_alu_instr *neg = nir_src_as_alu_instr(alu->src[s].src);
+         if (neg && neg->op == nir_op_fneg) {
+            nir_alu_instr *other = nir_src_as_alu_instr(alu->src[1 - s].src);
+            if (other && other->op == nir_op_fneg)
+               return false;
+            /* 1 - x stays in [0,1] */
+            exact = linear_alu_src_is_one(alu, 1 - s);
+         }
+      }
+
+      if (!exact)
+         any_clamped = true;
+      break;
+   }
+   default:
+      // disallowed instruction
+      return false;
+   }
+
+   if (any_clamped) {
+      if (!alu->dest.dest.is_ssa)
+         return false;
+      _mesa_set_add(clamped, &alu->dest.dest.ssa);
+   }
+
+   return true;
+}
+
+
 /*
  * Examine the NIR shader to determine if it's "linear".
  */
 static bool
 llvmpipe_nir_fn_is_linear_compat(const struct nir_shader *shader,
                                  nir_function_impl *impl,
+                                 struct set *clamped,
                                  struct lp_tgsi_info *info)
 {
    nir_foreach_block(block, impl) {
@@ -367,42 +552,11 @@ llvmpipe_nir_fn_is_linear_compat(const struct nir_shader *shader,
             info->num_texs++;
             break;
          }
-         case nir_instr_type_alu: {
-            const nir_alu_instr *alu = nir_instr_as_alu(instr);
-            switch (alu->op) {
-            case nir_op_mov:
-            case nir_op_vec2:
-            case nir_op_vec4:
-               // these instructions are OK
-               break;
-            case nir_op_fmul: {
-               unsigned num_src = nir_op_infos[alu->op].num_inputs;;
-               for (unsigned s = 0; s < num_src; s++) {
-                  /* If the MUL uses immediate values, the values must
-                   * be 32-bit floats in the range [0,1].
-                   */
-                  if (nir_src_is_const(alu->src[s].src)) {
-                     nir_load_const_instr *load =
-                        nir_instr_as_load_const(alu->src[s].src.ssa->parent_instr);
-
-                     if (load->def.bit_size != 32)
-                        return false;
-                     for (unsigned c = 0; c < load->def.num_components; c++) {
-                        if (load->value[c].f32 < 0.0 || load->value[c].f32 > 1.0) {
-                           info->unclamped_immediates = true;
-                           return false;
-                        }
-                     }
-                  }
-               }
-               break;
-            }
-            default:
-               // disallowed instruction
+         case nir_instr_type_alu:
+            if (!llvmpipe_nir_alu_is_linear_compat(nir_instr_as_alu(instr),
+                                                   clamped, info))
                return false;
-            }
             break;
-         }
          default:
             return false;
          }
@@ -416,13 +570,21 @@ static bool
 llvmpipe_nir_is_linear_compat(struct nir_shader *shader,
                               struct lp_tgsi_info *info)
 {
+   struct set *clamped = _mesa_pointer_set_create(NULL);
+   bool linear = true;
+
    nir_foreach_function(function, shader) {
       if (function->impl) {
-         if (!llvmpipe_nir_fn_is_linear_compat(shader, function->impl, info))
-            return false;
+         if (!llvmpipe_nir_fn_is_linear_compat(shader, function->impl,
+                                               clamped, info)) {
+            linear = false;
+            break;
+         }
       }
    }
-   return true;
+
+   _mesa_set_destroy(clamped, NULL);
+   return linear;
 }
 
 
@@ -465,6 +627,8 @@ llvmpipe_fs_analyse(struct lp_fragment_shader *shader,
         shader->info.base.opcode_count[TGSI_OPCODE_SAMPLE] +
         shader->info.base.opcode_count[TGSI_OPCODE_MOV] +
         shader->info.base.opcode_count[TGSI_OPCODE_MUL] +
+        shader->info.base.opcode_count[TGSI_OPCODE_MIN] +
+        shader->info.base.opcode_count[TGSI_OPCODE_MAX] +
         shader->info.base.opcode_count[TGSI_OPCODE_RET] +
         shader->info.base.opcode_count[TGSI_OPCODE_END] ==
         shader->info.base.num_instructions)) {
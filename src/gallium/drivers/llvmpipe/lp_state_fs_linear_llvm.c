@@ -68,6 +68,57 @@
 #include "lp_state_fs.h"
 
 
+/**
+ * Turn fadd(a, fneg(b)) into fsub(a, b).
+ *
+ * Negative values can't be represented in the unorm8 AoS registers, but a
+ * saturating subtraction can.  The analysis in lp_state_fs_analysis.c only
+ * accepts fneg when all its uses are fadd sources.
+ */
+static void
+linear_fuse_fsub(nir_shader *nir)
+{
+   nir_foreach_function(function, nir) {
+      if (!function->impl)
+         continue;
+
+      nir_foreach_block(block, function->impl) {
+         nir_foreach_instr(instr, block) {
+            if (instr->type != nir_instr_type_alu)
+               continue;
+
+            nir_alu_instr *alu = nir_instr_as_alu(instr);
+            if (alu->op != nir_op_fadd)
+               continue;
+
+            for (unsigned i = 0; i < 2; i++) {
+               nir_alu_instr *neg = nir_src_as_alu_instr(alu->src[i].src);
+               if (!neg || neg->op != nir_op_fneg)
+                  continue;
+
+               nir_alu_src a = alu->src[1 - i];
+               nir_alu_src b = neg->src[0];
+               for (unsigned c = 0; c < NIR_MAX_VEC_COMPONENTS; c++)
+                  b.swizzle[c] = neg->src[0].swizzle[alu->src[i].swizzle[c]];
+
+               nir_instr_rewrite_src(instr, &alu->src[0].src, a.src);
+               nir_instr_rewrite_src(instr, &alu->src[1].src, b.src);
+               memcpy(alu->src[0].swizzle, a.swizzle, sizeof a.swizzle);
+               memcpy(alu->src[1].swizzle, b.swizzle, sizeof b.swizzle);
+               alu->op = nir_op_fsub;
+               break;
+            }
+         }
+      }
+
+      nir_metadata_preserve(function->impl, nir_metadata_block_index |
+                                            nir_metadata_dominance);
+   }
+
+   nir_opt_dce(nir);
+}
+
+
 /**
  * Sampler.
  */
@@ -171,6 +222,7 @@ llvm_fragment_body(struct lp_build_context *bld,
                         &shader->info.base);
    } else {
       nir_shader *clone = nir_shader_clone(NULL, shader->base.ir.nir);
+      linear_fuse_fsub(clone);
       lp_build_nir_aos(gallivm, clone, fs_type,
                        bgra_swizzles,
                        consts_ptr, inputs, outputs,
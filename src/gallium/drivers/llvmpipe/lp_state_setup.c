@@ -621,43 +621,19 @@ init_args(struct gallivm_state *gallivm,
 
 
 /**
- * Generate the runtime callable function for the coefficient calculation.
- *
+ * Emit the IR for the coefficient calculation function of a setup variant
+ * into the given gallivm module.
  */
-static struct lp_setup_variant *
-generate_setup_variant(struct lp_setup_variant_key *key,
-                       struct llvmpipe_context *lp)
+static boolean
+emit_setup_variant(struct gallivm_state *gallivm,
+                   struct lp_setup_variant *variant)
 {
-   int64_t t0 = 0, t1;
-
-   if (0)
-      goto fail;
-
-   struct lp_setup_variant *variant = CALLOC_STRUCT(lp_setup_variant);
-   if (!variant)
-      goto fail;
-
-   variant->no = setup_no++;
+   LLVMBuilderRef builder = gallivm->builder;
 
    char func_name[64];
    snprintf(func_name, sizeof(func_name), "setup_variant_%u",
             variant->no);
 
-   struct gallivm_state *gallivm;
-   variant->gallivm = gallivm = gallivm_create(func_name, lp->context, NULL);
-   if (!variant->gallivm) {
-      goto fail;
-   }
-
-   LLVMBuilderRef builder = gallivm->builder;
-
-   if (LP_DEBUG & DEBUG_COUNTERS) {
-      t0 = os_time_get();
-   }
-
-   memcpy(&variant->key, key, key->size);
-   variant->list_item_global.base = variant;
-
    /* Currently always deal with full 4-wide vertex attributes from
     * the vertices.
     */
@@ -681,7 +657,7 @@ generate_setup_variant(struct lp_setup_variant_key *key,
 
    variant->function = LLVMAddFunction(gallivm->module, func_name, func_type);
    if (!variant->function)
-      goto fail;
+      return FALSE;
 
    LLVMSetFunctionCallConv(variant->function, LLVMCCallConv);
 
@@ -720,6 +696,49 @@ generate_setup_variant(struct lp_setup_variant_key *key,
 
    gallivm_verify_function(gallivm, variant->function);
 
+   return TRUE;
+}
+
+
+/**
+ * Generate the runtime callable function for the coefficient calculation.
+ *
+ */
+static struct lp_setup_variant *
+generate_setup_variant(struct lp_setup_variant_key *key,
+                       struct llvmpipe_context *lp)
+{
+   int64_t t0 = 0, t1;
+
+   if (0)
+      goto fail;
+
+   struct lp_setup_variant *variant = CALLOC_STRUCT(lp_setup_variant);
+   if (!variant)
+      goto fail;
+
+   variant->no = setup_no++;
+
+   char module_name[64];
+   snprintf(module_name, sizeof(module_name), "setup_variant_%u",
+            variant->no);
+
+   struct gallivm_state *gallivm;
+   variant->gallivm = gallivm = gallivm_create(module_name, lp->context, NULL);
+   if (!variant->gallivm) {
+      goto fail;
+   }
+
+   if (LP_DEBUG & DEBUG_COUNTERS) {
+      t0 = os_time_get();
+   }
+
+   memcpy(&variant->key, key, key->size);
+   variant->list_item_global.base = variant;
+
+   if (!emit_setup_variant(gallivm, variant))
+      goto fail;
+
    gallivm_compile_module(gallivm);
 
    variant->jit_function = (lp_jit_setup_triangle)
@@ -736,15 +755,14 @@ generate_setup_variant(struct lp_setup_variant_key *key,
       t1 = os_time_get();
       LP_COUNT_ADD(llvm_compile_time, t1 - t0);
       LP_COUNT_ADD(nr_llvm_compiles, 1);
+      LP_COUNT_ADD(nr_llvm_modules, 1);
    }
 
    return variant;
 
 fail:
    if (variant) {
-      if (variant->gallivm) {
-         gallivm_destroy(variant->gallivm);
-      }
+      gallivm_reference(&variant->gallivm, NULL);
       FREE(variant);
    }
 
@@ -816,9 +834,7 @@ remove_setup_variant(struct llvmpipe_context *lp,
                    variant->no, lp->nr_setup_variants);
    }
 
-   if (variant->gallivm) {
-      gallivm_destroy(variant->gallivm);
-   }
+   gallivm_reference(&variant->gallivm, NULL);
 
    list_del(&variant->list_item_global.list);
    lp->nr_setup_variants--;
@@ -855,6 +871,101 @@ cull_setup_variants(struct llvmpipe_context *lp)
 }
 
 
+static struct lp_setup_variant *
+lookup_setup_variant(struct llvmpipe_context *lp,
+                     const struct lp_setup_variant_key *key)
+{
+   struct lp_setup_variant_list_item *li;
+
+   LIST_FOR_EACH_ENTRY(li, &lp->setup_variants_list.list, list) {
+      if (li->base->key.size == key->size &&
+         memcmp(&li->base->key, key, key->size) == 0) {
+         return li->base;
+      }
+   }
+
+   return NULL;
+}
+
+
+/**
+ * Emit the setup variant the next llvmpipe_update_setup() call is going to
+ * need into a module which is about to be compiled anyway (i.e. the one of
+ * a new fragment shader variant), so that both are compiled together
+ * instead of paying the fixed per-module cost of MCJIT twice for what is
+ * usually a tiny function.
+ *
+ * Returns NULL if there's nothing to batch.  Otherwise the variant must be
+ * completed with lp_setup_finish_batched_variant() once the module has
+ * been compiled.
+ */
+struct lp_setup_variant *
+lp_setup_batch_variant(struct llvmpipe_context *lp,
+                       struct gallivm_state *gallivm)
+{
+   struct lp_setup_variant_key key;
+
+   if (LP_PERF & PERF_NO_BATCH)
+      return NULL;
+
+   /* Only if llvmpipe_update_derived() will look for a setup variant. */
+   if (!(lp->dirty & (LP_NEW_FS |
+                      LP_NEW_FRAMEBUFFER |
+                      LP_NEW_RASTERIZER)) ||
+       !lp->fs || !lp->rasterizer)
+      return NULL;
+
+   /* Culling must be left to llvmpipe_update_setup(). */
+   if (lp->nr_setup_variants >= LP_MAX_SETUP_VARIANTS)
+      return NULL;
+
+   lp_make_setup_variant_key(lp, &key);
+   if (lookup_setup_variant(lp, &key))
+      return NULL;
+
+   struct lp_setup_variant *variant = CALLOC_STRUCT(lp_setup_variant);
+   if (!variant)
+      return NULL;
+
+   variant->no = setup_no++;
+   memcpy(&variant->key, &key, key.size);
+   variant->list_item_global.base = variant;
+
+   if (!emit_setup_variant(gallivm, variant)) {
+      FREE(variant);
+      return NULL;
+   }
+
+   gallivm_reference(&variant->gallivm, gallivm);
+
+   return variant;
+}
+
+
+/**
+ * Resolve the code of a setup variant created by lp_setup_batch_variant()
+ * after its module got compiled, and make it available for lookup.
+ */
+void
+lp_setup_finish_batched_variant(struct llvmpipe_context *lp,
+                                struct lp_setup_variant *variant)
+{
+   variant->jit_function = (lp_jit_setup_triangle)
+      gallivm_jit_function(variant->gallivm, variant->function);
+   if (!variant->jit_function) {
+      gallivm_reference(&variant->gallivm, NULL);
+      FREE(variant);
+      return;
+   }
+
+   list_add(&variant->list_item_global.list, &lp->setup_variants_list.list);
+   lp->nr_setup_variants++;
+
+   LP_COUNT_ADD(nr_llvm_compiles, 1);
+   LP_COUNT_ADD(nr_llvm_batched, 1);
+}
+
+
 /**
  * Update fragment/vertex shader linkage state.  This is called just
  * prior to drawing something when some fragment-related state has
@@ -864,18 +975,11 @@ void
 llvmpipe_update_setup(struct llvmpipe_context *lp)
 {
    struct lp_setup_variant_key *key = &lp->setup_variant.key;
-   struct lp_setup_variant *variant = NULL;
-   struct lp_setup_variant_list_item *li;
+   struct lp_setup_variant *variant;
 
    lp_make_setup_variant_key(lp, key);
 
-   LIST_FOR_EACH_ENTRY(li, &lp->setup_variants_list.list, list) {
-      if (li->base->key.size == key->size &&
-         memcmp(&li->base->key, key, key->size) == 0) {
-         variant = li->base;
-         break;
-      }
-   }
+   variant = lookup_setup_variant(lp, key);
 
    if (variant) {
       list_move_to(&variant->list_item_global.list, &lp->setup_variants_list.list);
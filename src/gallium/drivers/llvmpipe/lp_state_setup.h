@@ -6,6 +6,7 @@
 
 struct llvmpipe_context;
 struct lp_setup_variant;
+struct gallivm_state;
 
 struct lp_setup_variant_list_item
 {
@@ -78,6 +79,14 @@ struct lp_setup_variant {
 void
 lp_delete_setup_variants(struct llvmpipe_context *lp);
 
+struct lp_setup_variant *
+lp_setup_batch_variant(struct llvmpipe_context *lp,
+                       struct gallivm_state *gallivm);
+
+void
+lp_setup_finish_batched_variant(struct llvmpipe_context *lp,
+                                struct lp_setup_variant *variant);
+
 void
 lp_dump_setup_coef(const struct lp_setup_variant_key *key,
                    const float (*sa0)[4],
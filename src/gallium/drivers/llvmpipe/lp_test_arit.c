@@ -251,6 +251,64 @@ const float round_values[] = {
       -FLT_MAX
 };
 
+/*
+ * Round to the nearest integer (as an integer), converted back to float so
+ * it can share the unary test harness.
+ */
+static LLVMValueRef
+lp_build_iround_float(struct lp_build_context *bld, LLVMValueRef a)
+{
+   LLVMValueRef res = lp_build_iround(bld, a);
+   return LLVMBuildSIToFP(bld->gallivm->builder, res, bld->vec_type, "");
+}
+
+
+const float iround_values[] = {
+      -10.0, -1, 0.0, 12.0,
+      -1.49, -0.25, 1.25, 2.51,
+      -0.99, -0.01, 0.01, 0.99,
+      -1.5, -0.5, 0.5, 1.5,
+      1.401298464324817e-45f, // smallest denormal
+      -1.401298464324817e-45f,
+      1.62981451e-08f,
+      -1.62981451e-08f,
+      16777215.0f,
+      -16777215.0f,
+      FLT_EPSILON,
+      -FLT_EPSILON,
+      1.0f - 0.5f*FLT_EPSILON,
+      -1.0f + FLT_EPSILON,
+};
+
+
+static float clamp01f(float x)
+{
+   if (isnan(x)) {
+      return 0.0f;
+   }
+   return fminf(fmaxf(x, 0.0f), 1.0f);
+}
+
+
+const float clamp01_values[] = {
+   -INFINITY,
+   -FLT_MAX,
+   -1.5,
+   -1e-007,
+   -0.0f,
+   0.0f,
+   1e-007,
+   0.25,
+   0.5,
+   1.0f - 0.5f*FLT_EPSILON,
+   1.0,
+   1.5,
+   FLT_MAX,
+   INFINITY,
+   NAN,
+};
+
+
 static float fractf(float x)
 {
    x -= floorf(x);
@@ -328,6 +386,8 @@ unary_tests[] = {
    {"trunc", &lp_build_trunc, &truncf, round_values, ARRAY_SIZE(round_values), 24.0 },
    {"floor", &lp_build_floor, &floorf, round_values, ARRAY_SIZE(round_values), 24.0 },
    {"ceil", &lp_build_ceil, &ceilf, round_values, ARRAY_SIZE(round_values), 24.0 },
+   {"iround", &lp_build_iround_float, &nearbyintf, iround_values, ARRAY_SIZE(iround_values), 24.0 },
+   {"clamp01", &lp_build_clamp_zero_one_nanzero, &clamp01f, clamp01_values, ARRAY_SIZE(clamp01_values), 24.0 },
    {"fract", &lp_build_fract_safe, &fractf, fract_values, ARRAY_SIZE(fract_values), 24.0 },
 };
 
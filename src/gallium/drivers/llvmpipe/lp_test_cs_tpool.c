@@ -0,0 +1,196 @@
+/**************************************************************************
+ *
+ * Copyright 2022 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Compute thread pool test and benchmark.
+ *
+ * Checks every iteration of a task runs exactly once, for uniform and
+ * skewed per-iteration costs, and reports iterations/sec with -o.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "util/os_time.h"
+#include "util/u_atomic.h"
+#include "util/u_memory.h"
+
+#include "lp_cs_tpool.h"
+#include "lp_test.h"
+
+
+enum workload {
+   WORKLOAD_UNIFORM,   /* every iteration costs the same */
+   WORKLOAD_RAMP,      /* cost grows with the iteration index */
+   WORKLOAD_HOTSPOT,   /* a few iterations are very expensive */
+};
+
+static const char *workload_names[] = {
+   "uniform",
+   "ramp",
+   "hotspot",
+};
+
+struct test_job {
+   enum workload workload;
+   unsigned num_iters;
+   unsigned *counts;
+   unsigned sink;
+};
+
+
+static unsigned
+iteration_cost(const struct test_job *job, unsigned iter_idx)
+{
+   switch (job->workload) {
+   case WORKLOAD_RAMP:
+      return 64 + (iter_idx * 1024) / job->num_iters;
+   case WORKLOAD_HOTSPOT:
+      return iter_idx % 61 == 0 ? 16384 : 64;
+   case WORKLOAD_UNIFORM:
+   default:
+      return 256;
+   }
+}
+
+
+static void
+test_work(void *data, int iter_idx, struct lp_cs_local_mem *lmem)
+{
+   struct test_job *job = data;
+   unsigned cost = iteration_cost(job, iter_idx);
+   unsigned x = iter_idx;
+
+   for (unsigned i = 0; i < cost; i++)
+      x = x * 1664525 + 1013904223;
+
+   p_atomic_add(&job->sink, x);
+   p_atomic_inc(&job->counts[iter_idx]);
+}
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "threads\t"
+           "workload\t"
+           "iterations\t"
+           "iters/sec\n");
+
+   fflush(fp);
+}
+
+
+static boolean
+test_one(unsigned verbose, FILE *fp, struct lp_cs_tpool *pool,
+         enum workload workload, unsigned num_iters)
+{
+   struct test_job job;
+   boolean success = TRUE;
+
+   memset(&job, 0, sizeof job);
+   job.workload = workload;
+   job.num_iters = num_iters;
+   job.counts = CALLOC(num_iters, sizeof *job.counts);
+   if (!job.counts)
+      return FALSE;
+
+   int64_t t0 = os_time_get_nano();
+   struct lp_cs_tpool_task *task =
+      lp_cs_tpool_queue_task(pool, test_work, &job, num_iters);
+   lp_cs_tpool_wait_for_task(pool, &task);
+   int64_t t1 = os_time_get_nano();
+
+   for (unsigned i = 0; i < num_iters; i++) {
+      if (job.counts[i] != 1) {
+         success = FALSE;
+         break;
+      }
+   }
+
+   double iters_per_sec = num_iters * 1e9 / MAX2(t1 - t0, 1);
+
+   if (verbose || !success) {
+      printf("%s: %u threads, %s, %u iterations, %.0f iters/sec\n",
+             success ? "PASS" : "FAIL", pool->num_threads,
+             workload_names[workload], num_iters, iters_per_sec);
+   }
+
+   if (fp) {
+      fprintf(fp, "%s\t%u\t%s\t%u\t%.0f\n",
+              success ? "pass" : "fail", pool->num_threads,
+              workload_names[workload], num_iters, iters_per_sec);
+      fflush(fp);
+   }
+
+   FREE(job.counts);
+   return success;
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   static const unsigned thread_counts[] = { 0, 1, 2, 3, 8 };
+   static const unsigned iter_counts[] = { 1, 2, 3, 5, 17, 100, 1000, 10000 };
+   boolean success = TRUE;
+
+   for (unsigned t = 0; t < ARRAY_SIZE(thread_counts); t++) {
+      struct lp_cs_tpool *pool = lp_cs_tpool_create(thread_counts[t]);
+      if (!pool)
+         return FALSE;
+
+      for (unsigned w = 0; w < ARRAY_SIZE(workload_names); w++) {
+         for (unsigned i = 0; i < ARRAY_SIZE(iter_counts); i++) {
+            if (!test_one(verbose, fp, pool, w, iter_counts[i]))
+               success = FALSE;
+         }
+      }
+
+      lp_cs_tpool_destroy(pool);
+   }
+
+   return success;
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_all(verbose, fp);
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   printf("no test_single()");
+   return TRUE;
+}
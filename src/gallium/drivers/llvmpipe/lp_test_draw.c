@@ -0,0 +1,639 @@
+/**************************************************************************
+ *
+ * Copyright 2022 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Indexed draw test and benchmark.
+ *
+ * Draws grid meshes with different triangle orders and index sizes through
+ * the draw module, checks the result matches the same triangles drawn
+ * without indices, and reports the vertex reuse of the vsplit front end
+ * (ACMR and vertices shaded per unique vertex) and draws/sec with -o.
+ */
+
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_defines.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_state.h"
+#include "draw/draw_context.h"
+#include "util/os_time.h"
+#include "util/u_box.h"
+#include "util/u_draw.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "util/u_prim.h"
+#include "util/u_simple_shaders.h"
+#include "sw/null/null_sw_winsys.h"
+
+#include "lp_context.h"
+#include "lp_public.h"
+#include "lp_setup_context.h"
+#include "lp_test.h"
+
+
+#define FB_SIZE      256
+#define GRID_SIZE    96     /* quads per side */
+#define GRID_VERTS   ((GRID_SIZE + 1) * (GRID_SIZE + 1))
+#define GRID_INDICES (GRID_SIZE * GRID_SIZE * 6)
+
+#define TILE_SIZE_QUADS 8
+
+
+enum mesh_order {
+   ORDER_ROWS,       /* row by row, as generated by most tools */
+   ORDER_TILES,      /* small tiles of quads, as a cache optimizer would */
+   ORDER_SHUFFLED,   /* triangles in random order */
+};
+
+static const char *order_names[] = {
+   "rows",
+   "tiles",
+   "shuffled",
+};
+
+
+struct draw_test {
+   struct pipe_screen *screen;
+   struct pipe_context *pipe;
+   struct pipe_resource *cbuf;
+   struct pipe_surface *surf;
+   void *vs;
+   void *fs;
+   void *velems;
+   void *rast;
+   void *dsa;
+   void *blend;
+
+   float vertices[GRID_VERTS][8];
+   unsigned indices[GRID_INDICES];
+   float expanded[GRID_INDICES][8];
+};
+
+
+/*
+ * Write the two triangles of the quad at (x, y).
+ */
+static unsigned *
+write_quad(unsigned *idx, unsigned x, unsigned y)
+{
+   const unsigned v0 = y * (GRID_SIZE + 1) + x;
+   const unsigned v1 = v0 + 1;
+   const unsigned v2 = v0 + GRID_SIZE + 1;
+   const unsigned v3 = v2 + 1;
+
+   idx[0] = v0; idx[1] = v1; idx[2] = v2;
+   idx[3] = v2; idx[4] = v1; idx[5] = v3;
+   return idx + 6;
+}
+
+
+static void
+build_mesh(struct draw_test *t, enum mesh_order order)
+{
+   for (unsigned y = 0; y <= GRID_SIZE; y++) {
+      for (unsigned x = 0; x <= GRID_SIZE; x++) {
+         float *v = t->vertices[y * (GRID_SIZE + 1) + x];
+         unsigned hash = (x * 73856093u) ^ (y * 19349663u);
+
+         v[0] = x * (2.0f / GRID_SIZE) - 1.0f;
+         v[1] = y * (2.0f / GRID_SIZE) - 1.0f;
+         v[2] = 0.0f;
+         v[3] = 1.0f;
+         v[4] = (hash & 0xff) / 255.0f;
+         v[5] = ((hash >> 8) & 0xff) / 255.0f;
+         v[6] = ((hash >> 16) & 0xff) / 255.0f;
+         v[7] = 1.0f;
+      }
+   }
+
+   unsigned *idx = t->indices;
+
+   switch (order) {
+   case ORDER_ROWS:
+      for (unsigned y = 0; y < GRID_SIZE; y++)
+         for (unsigned x = 0; x < GRID_SIZE; x++)
+            idx = write_quad(idx, x, y);
+      break;
+   case ORDER_TILES:
+      for (unsigned ty = 0; ty < GRID_SIZE; ty += TILE_SIZE_QUADS)
+         for (unsigned tx = 0; tx < GRID_SIZE; tx += TILE_SIZE_QUADS)
+            for (unsigned y = ty; y < MIN2(ty + TILE_SIZE_QUADS, GRID_SIZE); y++)
+               for (unsigned x = tx; x < MIN2(tx + TILE_SIZE_QUADS, GRID_SIZE); x++)
+                  idx = write_quad(idx, x, y);
+      break;
+   case ORDER_SHUFFLED: {
+      for (unsigned y = 0; y < GRID_SIZE; y++)
+         for (unsigned x = 0; x < GRID_SIZE; x++)
+            idx = write_quad(idx, x, y);
+
+      /* Fisher-Yates shuffle of the triangles, with a fixed seed */
+      unsigned seed = 1;
+      for (unsigned i = GRID_INDICES / 3 - 1; i > 0; i--) {
+         seed = seed * 1103515245 + 12345;
+         unsigned j = (seed >> 8) % (i + 1);
+         for (unsigned k = 0; k < 3; k++) {
+            unsigned tmp = t->indices[i * 3 + k];
+            t->indices[i * 3 + k] = t->indices[j * 3 + k];
+            t->indices[j * 3 + k] = tmp;
+         }
+      }
+      break;
+   }
+   }
+
+   for (unsigned i = 0; i < GRID_INDICES; i++)
+      memcpy(t->expanded[i], t->vertices[t->indices[i]], sizeof t->expanded[i]);
+}
+
+
+static boolean
+init_test(struct draw_test *t)
+{
+   t->screen = llvmpipe_create_screen(null_sw_create());
+   if (!t->screen)
+      return FALSE;
+
+   t->pipe = t->screen->context_create(t->screen, NULL, 0);
+   if (!t->pipe)
+      return FALSE;
+
+   struct pipe_resource templ;
+   memset(&templ, 0, sizeof templ);
+   templ.target = PIPE_TEXTURE_2D;
+   templ.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+   templ.width0 = FB_SIZE;
+   templ.height0 = FB_SIZE;
+   templ.depth0 = 1;
+   templ.array_size = 1;
+   templ.bind = PIPE_BIND_RENDER_TARGET;
+   t->cbuf = t->screen->resource_create(t->screen, &templ);
+   if (!t->cbuf)
+      return FALSE;
+
+   struct pipe_surface surf_templ;
+   memset(&surf_templ, 0, sizeof surf_templ);
+   surf_templ.format = templ.format;
+   t->surf = t->pipe->create_surface(t->pipe, t->cbuf, &surf_templ);
+
+   struct pipe_framebuffer_state fb;
+   memset(&fb, 0, sizeof fb);
+   fb.width = FB_SIZE;
+   fb.height = FB_SIZE;
+   fb.nr_cbufs = 1;
+   fb.cbufs[0] = t->surf;
+   t->pipe->set_framebuffer_state(t->pipe, &fb);
+
+   struct pipe_viewport_state vp;
+   memset(&vp, 0, sizeof vp);
+   vp.scale[0] = vp.scale[1] = FB_SIZE / 2.0f;
+   vp.scale[2] = 1.0f;
+   vp.translate[0] = vp.translate[1] = FB_SIZE / 2.0f;
+   vp.swizzle_x = PIPE_VIEWPORT_SWIZZLE_POSITIVE_X;
+   vp.swizzle_y = PIPE_VIEWPORT_SWIZZLE_POSITIVE_Y;
+   vp.swizzle_z = PIPE_VIEWPORT_SWIZZLE_POSITIVE_Z;
+   vp.swizzle_w = PIPE_VIEWPORT_SWIZZLE_POSITIVE_W;
+   t->pipe->set_viewport_states(t->pipe, 0, 1, &vp);
+
+   static const enum tgsi_semantic names[] = {
+      TGSI_SEMANTIC_POSITION, TGSI_SEMANTIC_COLOR
+   };
+   static const unsigned indices[] = { 0, 0 };
+   t->vs = util_make_vertex_passthrough_shader(t->pipe, 2, names, indices,
+                                               false);
+   t->pipe->bind_vs_state(t->pipe, t->vs);
+
+   t->fs = util_make_fragment_passthrough_shader(t->pipe,
+                                                 TGSI_SEMANTIC_COLOR,
+                                                 TGSI_INTERPOLATE_PERSPECTIVE,
+                                                 false);
+   t->pipe->bind_fs_state(t->pipe, t->fs);
+
+   struct pipe_vertex_element ve[2];
+   memset(ve, 0, sizeof ve);
+   for (unsigned i = 0; i < 2; i++) {
+      ve[i].src_offset = i * 4 * sizeof(float);
+      ve[i].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   }
+   t->velems = t->pipe->create_vertex_elements_state(t->pipe, 2, ve);
+   t->pipe->bind_vertex_elements_state(t->pipe, t->velems);
+
+   struct pipe_rasterizer_state rast;
+   memset(&rast, 0, sizeof rast);
+   rast.half_pixel_center = 1;
+   rast.bottom_edge_rule = 1;
+   rast.depth_clip_near = 1;
+   rast.depth_clip_far = 1;
+   t->rast = t->pipe->create_rasterizer_state(t->pipe, &rast);
+   t->pipe->bind_rasterizer_state(t->pipe, t->rast);
+
+   struct pipe_depth_stencil_alpha_state dsa;
+   memset(&dsa, 0, sizeof dsa);
+   t->dsa = t->pipe->create_depth_stencil_alpha_state(t->pipe, &dsa);
+   t->pipe->bind_depth_stencil_alpha_state(t->pipe, t->dsa);
+
+   struct pipe_blend_state blend;
+   memset(&blend, 0, sizeof blend);
+   blend.rt[0].colormask = PIPE_MASK_RGBA;
+   t->blend = t->pipe->create_blend_state(t->pipe, &blend);
+   t->pipe->bind_blend_state(t->pipe, t->blend);
+
+   return TRUE;
+}
+
+
+static void
+fini_test(struct draw_test *t)
+{
+   if (t->pipe) {
+      t->pipe->bind_vs_state(t->pipe, NULL);
+      t->pipe->bind_fs_state(t->pipe, NULL);
+      t->pipe->bind_blend_state(t->pipe, NULL);
+      if (t->blend)
+         t->pipe->delete_blend_state(t->pipe, t->blend);
+      if (t->dsa)
+         t->pipe->delete_depth_stencil_alpha_state(t->pipe, t->dsa);
+      if (t->rast)
+         t->pipe->delete_rasterizer_state(t->pipe, t->rast);
+      if (t->velems)
+         t->pipe->delete_vertex_elements_state(t->pipe, t->velems);
+      if (t->fs)
+         t->pipe->delete_fs_state(t->pipe, t->fs);
+      if (t->vs)
+         t->pipe->delete_vs_state(t->pipe, t->vs);
+      pipe_surface_reference(&t->surf, NULL);
+      t->pipe->destroy(t->pipe);
+   }
+   pipe_resource_reference(&t->cbuf, NULL);
+   if (t->screen)
+      t->screen->destroy(t->screen);
+}
+
+
+static void
+set_vertices(struct draw_test *t, const void *data, unsigned size)
+{
+   struct pipe_vertex_buffer vb;
+   memset(&vb, 0, sizeof vb);
+   vb.stride = 8 * sizeof(float);
+   vb.buffer.resource =
+      pipe_buffer_create_with_data(t->pipe, PIPE_BIND_VERTEX_BUFFER,
+                                   PIPE_USAGE_DEFAULT, size, data);
+   t->pipe->set_vertex_buffers(t->pipe, 0, 1, 0, true, &vb);
+}
+
+
+/*
+ * Draw iterations times, read back the result and return the time spent
+ * in nanoseconds.
+ */
+static int64_t
+run_draw(struct draw_test *t, const struct pipe_draw_info *info,
+         unsigned count, unsigned iterations, uint8_t *result)
+{
+   const struct pipe_draw_start_count_bias draw = { 0, count, 0 };
+   union pipe_color_union clear_color = { .f = { 0.0f, 0.0f, 0.0f, 1.0f } };
+   struct pipe_fence_handle *fence = NULL;
+   struct pipe_transfer *transfer;
+   struct pipe_box box;
+
+   int64_t t0 = os_time_get_nano();
+
+   for (unsigned i = 0; i < iterations; i++) {
+      t->pipe->clear(t->pipe, PIPE_CLEAR_COLOR0, NULL, &clear_color, 0.0, 0);
+      t->pipe->draw_vbo(t->pipe, info, 0, NULL, &draw, 1);
+      t->pipe->flush(t->pipe, &fence, 0);
+      t->screen->fence_finish(t->screen, NULL, fence, PIPE_TIMEOUT_INFINITE);
+      t->screen->fence_reference(t->screen, &fence, NULL);
+   }
+
+   int64_t t1 = os_time_get_nano();
+
+   u_box_2d(0, 0, FB_SIZE, FB_SIZE, &box);
+   const uint8_t *map = t->pipe->texture_map(t->pipe, t->cbuf, 0,
+                                             PIPE_MAP_READ, &box, &transfer);
+   for (unsigned y = 0; y < FB_SIZE; y++)
+      memcpy(result + y * FB_SIZE * 4, map + y * transfer->stride,
+             FB_SIZE * 4);
+   t->pipe->texture_unmap(t->pipe, transfer);
+
+   return t1 - t0;
+}
+
+
+static boolean
+test_one(unsigned verbose, FILE *fp, struct draw_test *t,
+         enum mesh_order order, unsigned index_size, unsigned iterations)
+{
+   struct draw_context *draw = llvmpipe_context(t->pipe)->draw;
+   struct draw_vertex_cache_stats stats;
+   struct pipe_draw_info info;
+   boolean success = TRUE;
+   void *indices = NULL;
+   uint8_t *results[2];
+
+   build_mesh(t, order);
+
+   if (index_size == 2) {
+      ushort *idx16 = MALLOC(GRID_INDICES * sizeof *idx16);
+      for (unsigned i = 0; i < GRID_INDICES; i++)
+         idx16[i] = t->indices[i];
+      indices = idx16;
+   } else {
+      indices = t->indices;
+   }
+
+   results[0] = MALLOC(FB_SIZE * FB_SIZE * 4);
+   results[1] = MALLOC(FB_SIZE * FB_SIZE * 4);
+
+   /* Reference: the same triangles without indices */
+   memset(&info, 0, sizeof info);
+   info.mode = PIPE_PRIM_TRIANGLES;
+   info.instance_count = 1;
+   set_vertices(t, t->expanded, sizeof t->expanded);
+   run_draw(t, &info, GRID_INDICES, 1, results[1]);
+
+   info.index_size = index_size;
+   info.has_user_indices = true;
+   info.index.user = indices;
+   info.index_bounds_valid = true;
+   info.min_index = 0;
+   info.max_index = GRID_VERTS - 1;
+   set_vertices(t, t->vertices, sizeof t->vertices);
+
+   draw_reset_vertex_cache_stats(draw);
+   int64_t ns = run_draw(t, &info, GRID_INDICES, iterations, results[0]);
+   draw_get_vertex_cache_stats(draw, &stats);
+
+   if (memcmp(results[0], results[1], FB_SIZE * FB_SIZE * 4) != 0)
+      success = FALSE;
+
+   /* Every vertex must be shaded at least once per draw. */
+   if (stats.fetches < (uint64_t)GRID_VERTS * iterations ||
+       stats.indices != (uint64_t)GRID_INDICES * iterations ||
+       stats.primitives != (uint64_t)GRID_INDICES / 3 * iterations)
+      success = FALSE;
+
+   double acmr = (double)stats.fetches / MAX2(stats.primitives, 1);
+   double shaded = (double)stats.fetches / ((double)GRID_VERTS * iterations);
+   double draws_per_sec = iterations * 1e9 / MAX2(ns, 1);
+
+   /* A locality friendly order should shade each vertex about once. */
+   if (order != ORDER_SHUFFLED && shaded > 1.25)
+      success = FALSE;
+
+   if (verbose || !success) {
+      printf("%s: %s, %u byte indices, ACMR %.3f, %.3f shades/vertex, "
+             "%.1f draws/sec\n",
+             success ? "PASS" : "FAIL", order_names[order], index_size,
+             acmr, shaded, draws_per_sec);
+   }
+
+   if (fp) {
+      fprintf(fp, "%s\t%s\t%u\t%.3f\t%.3f\t%.1f\n",
+              success ? "pass" : "fail", order_names[order], index_size,
+              acmr, shaded, draws_per_sec);
+      fflush(fp);
+   }
+
+   if (indices != t->indices)
+      FREE(indices);
+   FREE(results[0]);
+   FREE(results[1]);
+
+   return success;
+}
+
+
+/*
+ * Strips, fans and loops longer than a segment are split into segments
+ * that share vertices, which must not make them count more primitives.
+ */
+static boolean
+test_split_primitives(unsigned verbose, struct draw_test *t)
+{
+   static const struct {
+      enum pipe_prim_type mode;
+      unsigned extra_verts;   /* vertices in excess of the primitives */
+   } prims[] = {
+      { PIPE_PRIM_TRIANGLE_STRIP, 2 },
+      { PIPE_PRIM_TRIANGLE_FAN,   2 },
+      { PIPE_PRIM_LINE_STRIP,     1 },
+      { PIPE_PRIM_LINE_LOOP,      0 },
+   };
+   struct draw_context *draw = llvmpipe_context(t->pipe)->draw;
+   struct draw_vertex_cache_stats stats;
+   struct pipe_draw_info info;
+   const unsigned count = 4000;
+   uint8_t *result = MALLOC(FB_SIZE * FB_SIZE * 4);
+   unsigned *indices = MALLOC(count * sizeof *indices);
+   boolean success = TRUE;
+
+   build_mesh(t, ORDER_ROWS);
+   for (unsigned i = 0; i < count; i++)
+      indices[i] = i;
+
+   memset(&info, 0, sizeof info);
+   info.instance_count = 1;
+   info.index_size = 4;
+   info.has_user_indices = true;
+   info.index.user = indices;
+   info.index_bounds_valid = true;
+   info.min_index = 0;
+   info.max_index = count - 1;
+   set_vertices(t, t->vertices, sizeof t->vertices);
+
+   for (unsigned p = 0; p < ARRAY_SIZE(prims); p++) {
+      info.mode = prims[p].mode;
+
+      draw_reset_vertex_cache_stats(draw);
+      run_draw(t, &info, count, 1, result);
+      draw_get_vertex_cache_stats(draw, &stats);
+
+      boolean ok = stats.primitives == count - prims[p].extra_verts;
+      if (verbose || !ok) {
+         printf("%s: %s of %u indices, %" PRIu64 " primitives\n",
+                ok ? "PASS" : "FAIL", u_prim_name(prims[p].mode), count,
+                stats.primitives);
+      }
+      success = success && ok;
+   }
+
+   FREE(indices);
+   FREE(result);
+   return success;
+}
+
+
+static void (*real_draw_elements)(struct vbuf_render *, const ushort *, uint);
+static unsigned max_elements_drawn;
+
+static void
+count_draw_elements(struct vbuf_render *render, const ushort *indices,
+                    uint nr)
+{
+   max_elements_drawn = MAX2(max_elements_drawn, nr);
+   real_draw_elements(render, indices, nr);
+}
+
+
+/*
+ * The indices of a segment are handed to the render in one go, so segments
+ * must not be longer than the render's max_indices, whether they are below
+ * (cut by vertices) or above (cut by indices) the fetch segment size.
+ */
+static boolean
+test_max_indices(unsigned verbose, struct draw_test *t)
+{
+   static const unsigned max_indices[] = { 600, 1500 };
+   struct vbuf_render *render = &llvmpipe_context(t->pipe)->setup->base;
+   const unsigned saved_max_indices = render->max_indices;
+   struct pipe_draw_info info;
+   uint8_t *results[2];
+   boolean success = TRUE;
+
+   results[0] = MALLOC(FB_SIZE * FB_SIZE * 4);
+   results[1] = MALLOC(FB_SIZE * FB_SIZE * 4);
+   build_mesh(t, ORDER_ROWS);
+
+   real_draw_elements = render->draw_elements;
+   render->draw_elements = count_draw_elements;
+
+   for (unsigned m = 0; m < ARRAY_SIZE(max_indices); m++) {
+      render->max_indices = max_indices[m];
+
+      /* Switching between non-indexed and indexed draws prepares the front
+       * end again, which picks up the new limit.
+       */
+      memset(&info, 0, sizeof info);
+      info.mode = PIPE_PRIM_TRIANGLES;
+      info.instance_count = 1;
+      set_vertices(t, t->expanded, sizeof t->expanded);
+      run_draw(t, &info, GRID_INDICES, 1, results[1]);
+
+      info.index_size = 4;
+      info.has_user_indices = true;
+      info.index.user = t->indices;
+      info.index_bounds_valid = true;
+      info.min_index = 0;
+      info.max_index = GRID_VERTS - 1;
+      set_vertices(t, t->vertices, sizeof t->vertices);
+
+      max_elements_drawn = 0;
+      run_draw(t, &info, GRID_INDICES, 1, results[0]);
+
+      boolean ok = max_elements_drawn <= max_indices[m] &&
+                   !memcmp(results[0], results[1], FB_SIZE * FB_SIZE * 4);
+      if (verbose || !ok) {
+         printf("%s: max_indices %u, up to %u indices per draw_elements\n",
+                ok ? "PASS" : "FAIL", max_indices[m], max_elements_drawn);
+      }
+      success = success && ok;
+   }
+
+   render->draw_elements = real_draw_elements;
+   render->max_indices = saved_max_indices;
+
+   FREE(results[0]);
+   FREE(results[1]);
+   return success;
+}
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "order\t"
+           "index size\t"
+           "acmr\t"
+           "shades/vertex\t"
+           "draws/sec\n");
+
+   fflush(fp);
+}
+
+
+static boolean
+test_iterations(unsigned verbose, FILE *fp, unsigned iterations)
+{
+   static const unsigned index_sizes[] = { 2, 4 };
+   struct draw_test *t = CALLOC_STRUCT(draw_test);
+   boolean success = TRUE;
+
+   if (!t)
+      return FALSE;
+
+   if (!init_test(t)) {
+      fini_test(t);
+      FREE(t);
+      return FALSE;
+   }
+
+   for (unsigned o = 0; o < ARRAY_SIZE(order_names); o++) {
+      for (unsigned i = 0; i < ARRAY_SIZE(index_sizes); i++) {
+         if (!test_one(verbose, fp, t, o, index_sizes[i], iterations))
+            success = FALSE;
+      }
+   }
+
+   if (!test_split_primitives(verbose, t))
+      success = FALSE;
+
+   if (!test_max_indices(verbose, t))
+      success = FALSE;
+
+   fini_test(t);
+   FREE(t);
+   return success;
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   return test_iterations(verbose, fp, 20);
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_iterations(verbose, fp, fp ? 20 : 2);
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   printf("no test_single()");
+   return TRUE;
+}
@@ -0,0 +1,638 @@
+/**************************************************************************
+ *
+ * Copyright 2022 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Linear rasterizer test and benchmark.
+ *
+ * Draws 2D compositor style workloads (blits, premultiplied blending,
+ * opacity, tinting, simple color transforms and 9-patch stretching) with
+ * and without the linear rasterizer, checks both paths produce the same
+ * image and reports pixels/sec for each with -o.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_defines.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_state.h"
+#include "tgsi/tgsi_text.h"
+#include "nir/tgsi_to_nir.h"
+#include "util/os_time.h"
+#include "util/u_box.h"
+#include "util/u_draw.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "util/u_sampler.h"
+#include "util/u_simple_shaders.h"
+#include "sw/null/null_sw_winsys.h"
+
+#include "lp_context.h"
+#include "lp_debug.h"
+#include "lp_public.h"
+#include "lp_setup_context.h"
+#include "lp_state_fs.h"
+#include "lp_test.h"
+
+
+#define FB_SIZE      256
+#define TEX_SIZE     256
+#define PATCH_SIZE   64
+#define PATCH_BORDER 16
+
+
+struct linear_case {
+   const char *name;
+   const char *fs;
+   enum pipe_format tex_format;
+   boolean premul_blend;
+   boolean nine_patch;
+   enum lp_fs_kind kind;   /**< expected shader kind after binding */
+};
+
+
+#define FS_HEADER \
+   "FRAG\n" \
+   "DCL IN[0], GENERIC[0], PERSPECTIVE\n" \
+   "DCL IN[1], GENERIC[1], PERSPECTIVE\n" \
+   "DCL OUT[0], COLOR\n" \
+   "DCL SAMP[0]\n" \
+   "DCL SVIEW[0], 2D, FLOAT\n" \
+   "DCL CONST[0][0]\n" \
+   "DCL TEMP[0]\n" \
+   "IMM[0] FLT32 { 1.0, 1.0, 1.0, 1.0 }\n"
+
+static const char fs_blit[] =
+   FS_HEADER
+   "TEX OUT[0], IN[0], SAMP[0], 2D\n"
+   "END\n";
+
+static const char fs_opacity[] =
+   FS_HEADER
+   "TEX TEMP[0], IN[0], SAMP[0], 2D\n"
+   "MUL OUT[0], TEMP[0], CONST[0][0]\n"
+   "END\n";
+
+static const char fs_tint[] =
+   FS_HEADER
+   "TEX TEMP[0], IN[0], SAMP[0], 2D\n"
+   "MUL OUT[0], TEMP[0], IN[1]\n"
+   "END\n";
+
+static const char fs_invert[] =
+   FS_HEADER
+   "TEX TEMP[0], IN[0], SAMP[0], 2D\n"
+   "ADD OUT[0], IMM[0], -TEMP[0]\n"
+   "END\n";
+
+static const char fs_add_clamp[] =
+   FS_HEADER
+   "TEX TEMP[0], IN[0], SAMP[0], 2D\n"
+   "ADD TEMP[0], TEMP[0], IN[1]\n"
+   "MIN OUT[0], TEMP[0], IMM[0]\n"
+   "END\n";
+
+static const char fs_darken[] =
+   FS_HEADER
+   "TEX TEMP[0], IN[0], SAMP[0], 2D\n"
+   "ADD TEMP[0], TEMP[0], -IN[1]\n"
+   "MAX OUT[0], TEMP[0], CONST[0][0]\n"
+   "END\n";
+
+/* Must stay on the general path, as the sum isn't clamped before the MUL. */
+static const char fs_add_mul[] =
+   FS_HEADER
+   "TEX TEMP[0], IN[0], SAMP[0], 2D\n"
+   "ADD TEMP[0], TEMP[0], IN[1]\n"
+   "MUL OUT[0], TEMP[0], CONST[0][0]\n"
+   "END\n";
+
+static const struct linear_case cases[] = {
+   { "blit",           fs_blit,      PIPE_FORMAT_B8G8R8A8_UNORM, FALSE, FALSE,
+     LP_FS_KIND_LLVM_LINEAR },
+   { "blit_rgba",      fs_blit,      PIPE_FORMAT_R8G8B8A8_UNORM, FALSE, FALSE,
+     LP_FS_KIND_LLVM_LINEAR },
+   { "blit_rgbx",      fs_blit,      PIPE_FORMAT_R8G8B8X8_UNORM, FALSE, FALSE,
+     LP_FS_KIND_LLVM_LINEAR },
+   { "premul_over",    fs_blit,      PIPE_FORMAT_B8G8R8A8_UNORM, TRUE,  FALSE,
+     LP_FS_KIND_LLVM_LINEAR },
+   { "opacity_over",   fs_opacity,   PIPE_FORMAT_B8G8R8A8_UNORM, TRUE,  FALSE,
+     LP_FS_KIND_LLVM_LINEAR },
+   { "tint",           fs_tint,      PIPE_FORMAT_B8G8R8A8_UNORM, FALSE, FALSE,
+     LP_FS_KIND_LLVM_LINEAR },
+   { "invert",         fs_invert,    PIPE_FORMAT_B8G8R8A8_UNORM, FALSE, FALSE,
+     LP_FS_KIND_LLVM_LINEAR },
+   { "add_clamp",      fs_add_clamp, PIPE_FORMAT_B8G8R8A8_UNORM, FALSE, FALSE,
+     LP_FS_KIND_LLVM_LINEAR },
+   { "darken",         fs_darken,    PIPE_FORMAT_R8G8B8A8_UNORM, FALSE, FALSE,
+     LP_FS_KIND_LLVM_LINEAR },
+   { "add_mul",        fs_add_mul,   PIPE_FORMAT_B8G8R8A8_UNORM, FALSE, FALSE,
+     LP_FS_KIND_GENERAL },
+   { "nine_patch",     fs_blit,      PIPE_FORMAT_B8G8R8A8_UNORM, FALSE, TRUE,
+     LP_FS_KIND_LLVM_LINEAR },
+   { "nine_patch_over", fs_blit,     PIPE_FORMAT_R8G8B8A8_UNORM, TRUE,  TRUE,
+     LP_FS_KIND_LLVM_LINEAR },
+};
+
+
+struct linear_test {
+   struct pipe_screen *screen;
+   struct pipe_context *pipe;
+   struct pipe_resource *cbuf;
+   struct pipe_surface *surf;
+   void *vs;
+   void *velems;
+   void *rast;
+   void *dsa;
+   void *sampler;
+   uint8_t texels[TEX_SIZE * TEX_SIZE * 4];
+};
+
+
+static void
+write_quad(float *v, float x0, float y0, float x1, float y1,
+           float s0, float t0, float s1, float t1)
+{
+   /* position, texcoord and color for two triangles */
+   const float corners[6][4] = {
+      { x0, y0, s0, t0 }, { x1, y0, s1, t0 }, { x0, y1, s0, t1 },
+      { x0, y1, s0, t1 }, { x1, y0, s1, t0 }, { x1, y1, s1, t1 },
+   };
+
+   for (unsigned i = 0; i < 6; i++) {
+      v[0] = corners[i][0] * (2.0f / FB_SIZE) - 1.0f;
+      v[1] = corners[i][1] * (2.0f / FB_SIZE) - 1.0f;
+      v[2] = 0.0f;
+      v[3] = 1.0f;
+      v[4] = corners[i][2];
+      v[5] = corners[i][3];
+      v[6] = 0.0f;
+      v[7] = 1.0f;
+      v[8] = 0.75f;
+      v[9] = 0.5f;
+      v[10] = 0.25f;
+      v[11] = 0.5f;
+      v += 12;
+   }
+}
+
+
+/*
+ * Fill the vertex buffer, returning the number of vertices.
+ */
+static unsigned
+write_vertices(const struct linear_case *tc, float *v)
+{
+   if (!tc->nine_patch) {
+      write_quad(v, 0, 0, FB_SIZE, FB_SIZE, 0.0f, 0.0f, 1.0f, 1.0f);
+      return 6;
+   }
+
+   /* Corners of the patch are copied, edges stretched in one direction and
+    * the center in both.
+    */
+   const float src[4] = { 0, PATCH_BORDER, PATCH_SIZE - PATCH_BORDER,
+                          PATCH_SIZE };
+   const float dst[4] = { 0, PATCH_BORDER, FB_SIZE - PATCH_BORDER, FB_SIZE };
+   unsigned n = 0;
+
+   for (unsigned j = 0; j < 3; j++) {
+      for (unsigned i = 0; i < 3; i++) {
+         write_quad(v + n * 12, dst[i], dst[j], dst[i + 1], dst[j + 1],
+                    src[i] / TEX_SIZE, src[j] / TEX_SIZE,
+                    src[i + 1] / TEX_SIZE, src[j + 1] / TEX_SIZE);
+         n += 6;
+      }
+   }
+   return n;
+}
+
+
+static boolean
+init_test(struct linear_test *t)
+{
+   memset(t, 0, sizeof *t);
+
+   t->screen = llvmpipe_create_screen(null_sw_create());
+   if (!t->screen)
+      return FALSE;
+
+   t->pipe = t->screen->context_create(t->screen, NULL, 0);
+   if (!t->pipe)
+      return FALSE;
+
+   struct pipe_resource templ;
+   memset(&templ, 0, sizeof templ);
+   templ.target = PIPE_TEXTURE_2D;
+   templ.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+   templ.width0 = FB_SIZE;
+   templ.height0 = FB_SIZE;
+   templ.depth0 = 1;
+   templ.array_size = 1;
+   templ.bind = PIPE_BIND_RENDER_TARGET;
+   t->cbuf = t->screen->resource_create(t->screen, &templ);
+   if (!t->cbuf)
+      return FALSE;
+
+   struct pipe_surface surf_templ;
+   memset(&surf_templ, 0, sizeof surf_templ);
+   surf_templ.format = templ.format;
+   t->surf = t->pipe->create_surface(t->pipe, t->cbuf, &surf_templ);
+
+   struct pipe_framebuffer_state fb;
+   memset(&fb, 0, sizeof fb);
+   fb.width = FB_SIZE;
+   fb.height = FB_SIZE;
+   fb.nr_cbufs = 1;
+   fb.cbufs[0] = t->surf;
+   t->pipe->set_framebuffer_state(t->pipe, &fb);
+
+   struct pipe_viewport_state vp;
+   memset(&vp, 0, sizeof vp);
+   vp.scale[0] = vp.scale[1] = FB_SIZE / 2.0f;
+   vp.scale[2] = 1.0f;
+   vp.translate[0] = vp.translate[1] = FB_SIZE / 2.0f;
+   vp.swizzle_x = PIPE_VIEWPORT_SWIZZLE_POSITIVE_X;
+   vp.swizzle_y = PIPE_VIEWPORT_SWIZZLE_POSITIVE_Y;
+   vp.swizzle_z = PIPE_VIEWPORT_SWIZZLE_POSITIVE_Z;
+   vp.swizzle_w = PIPE_VIEWPORT_SWIZZLE_POSITIVE_W;
+   t->pipe->set_viewport_states(t->pipe, 0, 1, &vp);
+
+   static const enum tgsi_semantic names[] = {
+      TGSI_SEMANTIC_POSITION, TGSI_SEMANTIC_GENERIC, TGSI_SEMANTIC_GENERIC
+   };
+   static const unsigned indices[] = { 0, 0, 1 };
+   t->vs = util_make_vertex_passthrough_shader(t->pipe, 3, names, indices,
+                                               false);
+   t->pipe->bind_vs_state(t->pipe, t->vs);
+
+   struct pipe_vertex_element ve[3];
+   memset(ve, 0, sizeof ve);
+   for (unsigned i = 0; i < 3; i++) {
+      ve[i].src_offset = i * 4 * sizeof(float);
+      ve[i].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   }
+   t->velems = t->pipe->create_vertex_elements_state(t->pipe, 3, ve);
+   t->pipe->bind_vertex_elements_state(t->pipe, t->velems);
+
+   struct pipe_rasterizer_state rast;
+   memset(&rast, 0, sizeof rast);
+   rast.half_pixel_center = 1;
+   rast.bottom_edge_rule = 1;
+   rast.depth_clip_near = 1;
+   rast.depth_clip_far = 1;
+   t->rast = t->pipe->create_rasterizer_state(t->pipe, &rast);
+   t->pipe->bind_rasterizer_state(t->pipe, t->rast);
+
+   struct pipe_depth_stencil_alpha_state dsa;
+   memset(&dsa, 0, sizeof dsa);
+   t->dsa = t->pipe->create_depth_stencil_alpha_state(t->pipe, &dsa);
+   t->pipe->bind_depth_stencil_alpha_state(t->pipe, t->dsa);
+
+   struct pipe_sampler_state samp;
+   memset(&samp, 0, sizeof samp);
+   samp.wrap_s = PIPE_TEX_WRAP_CLAMP_TO_EDGE;
+   samp.wrap_t = PIPE_TEX_WRAP_CLAMP_TO_EDGE;
+   samp.wrap_r = PIPE_TEX_WRAP_CLAMP_TO_EDGE;
+   samp.min_img_filter = PIPE_TEX_FILTER_LINEAR;
+   samp.mag_img_filter = PIPE_TEX_FILTER_LINEAR;
+   samp.min_mip_filter = PIPE_TEX_MIPFILTER_NONE;
+   samp.normalized_coords = 1;
+   t->sampler = t->pipe->create_sampler_state(t->pipe, &samp);
+   t->pipe->bind_sampler_states(t->pipe, PIPE_SHADER_FRAGMENT, 0, 1,
+                                &t->sampler);
+
+   /* Premultiplied texels, with a mix of opaque, translucent and fully
+    * transparent areas.
+    */
+   for (unsigned y = 0; y < TEX_SIZE; y++) {
+      for (unsigned x = 0; x < TEX_SIZE; x++) {
+         uint8_t *texel = &t->texels[(y * TEX_SIZE + x) * 4];
+         unsigned a = (x / 8 + y / 8) % 3 == 0 ? 255 : (x * 3 + y) & 0xff;
+         texel[0] = ((x * 4) & 0xff) * a / 255;
+         texel[1] = ((y * 4) & 0xff) * a / 255;
+         texel[2] = (((x ^ y) * 4) & 0xff) * a / 255;
+         texel[3] = a;
+      }
+   }
+
+   float cval[4] = { 0.5f, 0.5f, 0.5f, 0.5f };
+   struct pipe_constant_buffer cb;
+   memset(&cb, 0, sizeof cb);
+   cb.user_buffer = cval;
+   cb.buffer_size = sizeof cval;
+   t->pipe->set_constant_buffer(t->pipe, PIPE_SHADER_FRAGMENT, 0, false, &cb);
+
+   return TRUE;
+}
+
+
+static void
+fini_test(struct linear_test *t)
+{
+   if (t->pipe) {
+      t->pipe->bind_fs_state(t->pipe, NULL);
+      t->pipe->set_sampler_views(t->pipe, PIPE_SHADER_FRAGMENT, 0, 0, 1,
+                                 false, NULL);
+      if (t->sampler)
+         t->pipe->delete_sampler_state(t->pipe, t->sampler);
+      if (t->dsa)
+         t->pipe->delete_depth_stencil_alpha_state(t->pipe, t->dsa);
+      if (t->rast)
+         t->pipe->delete_rasterizer_state(t->pipe, t->rast);
+      if (t->velems)
+         t->pipe->delete_vertex_elements_state(t->pipe, t->velems);
+      if (t->vs)
+         t->pipe->delete_vs_state(t->pipe, t->vs);
+      pipe_surface_reference(&t->surf, NULL);
+      t->pipe->destroy(t->pipe);
+   }
+   pipe_resource_reference(&t->cbuf, NULL);
+   if (t->screen)
+      t->screen->destroy(t->screen);
+}
+
+
+static void *
+create_fs(struct linear_test *t, const char *text)
+{
+   struct tgsi_token tokens[1024];
+   struct pipe_shader_state state;
+
+   if (!tgsi_text_translate(text, tokens, ARRAY_SIZE(tokens)))
+      return NULL;
+
+   memset(&state, 0, sizeof state);
+   state.type = PIPE_SHADER_IR_NIR;
+   state.ir.nir = tgsi_to_nir(tokens, t->screen, false);
+   return t->pipe->create_fs_state(t->pipe, &state);
+}
+
+
+static struct pipe_sampler_view *
+create_texture(struct linear_test *t, enum pipe_format format)
+{
+   struct pipe_resource templ;
+   struct pipe_resource *tex;
+   struct pipe_sampler_view view_templ;
+   struct pipe_sampler_view *view;
+   struct pipe_box box;
+
+   memset(&templ, 0, sizeof templ);
+   templ.target = PIPE_TEXTURE_2D;
+   templ.format = format;
+   templ.width0 = TEX_SIZE;
+   templ.height0 = TEX_SIZE;
+   templ.depth0 = 1;
+   templ.array_size = 1;
+   templ.bind = PIPE_BIND_SAMPLER_VIEW;
+   tex = t->screen->resource_create(t->screen, &templ);
+   if (!tex)
+      return NULL;
+
+   u_box_2d(0, 0, TEX_SIZE, TEX_SIZE, &box);
+   t->pipe->texture_subdata(t->pipe, tex, 0, PIPE_MAP_WRITE, &box,
+                            t->texels, TEX_SIZE * 4, 0);
+
+   u_sampler_view_default_template(&view_templ, tex, format);
+   view = t->pipe->create_sampler_view(t->pipe, tex, &view_templ);
+   pipe_resource_reference(&tex, NULL);
+   return view;
+}
+
+
+/*
+ * Draw the case repeatedly and read back the result, returning the time
+ * spent in nanoseconds.
+ */
+static int64_t
+run_case(struct linear_test *t, const struct linear_case *tc,
+         struct pipe_resource *vbuf, unsigned num_verts,
+         unsigned iterations, uint8_t *result)
+{
+   struct pipe_fence_handle *fence = NULL;
+   union pipe_color_union clear_color = { .f = { 0.2f, 0.3f, 0.4f, 1.0f } };
+   struct pipe_box box;
+   struct pipe_transfer *transfer;
+
+   int64_t t0 = 0;
+
+   /* The first iteration compiles the shader variants and isn't timed. */
+   for (unsigned i = 0; i <= iterations; i++) {
+      if (i == 1)
+         t0 = os_time_get_nano();
+
+      t->pipe->clear(t->pipe, PIPE_CLEAR_COLOR0, NULL, &clear_color, 0.0, 0);
+      util_draw_arrays(t->pipe, PIPE_PRIM_TRIANGLES, 0, num_verts);
+      t->pipe->flush(t->pipe, &fence, 0);
+      t->screen->fence_finish(t->screen, NULL, fence, PIPE_TIMEOUT_INFINITE);
+      t->screen->fence_reference(t->screen, &fence, NULL);
+   }
+
+   int64_t t1 = os_time_get_nano();
+
+   u_box_2d(0, 0, FB_SIZE, FB_SIZE, &box);
+   const uint8_t *map = t->pipe->texture_map(t->pipe, t->cbuf, 0,
+                                             PIPE_MAP_READ, &box, &transfer);
+   for (unsigned y = 0; y < FB_SIZE; y++)
+      memcpy(result + y * FB_SIZE * 4, map + y * transfer->stride,
+             FB_SIZE * 4);
+   t->pipe->texture_unmap(t->pipe, transfer);
+
+   return t1 - t0;
+}
+
+
+static boolean
+test_one(unsigned verbose, FILE *fp, struct linear_test *t,
+         const struct linear_case *tc, unsigned iterations)
+{
+   /* The linear path filters with 8 bit weights, so allow a bit more
+    * error when stretching.
+    */
+   const int tolerance = tc->nine_patch ? 4 : 1;
+   boolean success = TRUE;
+   float vertices[9 * 6 * 12];
+   uint8_t *results[2];
+   double pixels_per_sec[2];
+
+   void *fs = create_fs(t, tc->fs);
+   struct pipe_sampler_view *view = create_texture(t, tc->tex_format);
+   if (!fs || !view)
+      return FALSE;
+
+   unsigned num_verts = write_vertices(tc, vertices);
+   struct pipe_resource *vbuf =
+      pipe_buffer_create_with_data(t->pipe, PIPE_BIND_VERTEX_BUFFER,
+                                   PIPE_USAGE_DEFAULT,
+                                   num_verts * 12 * sizeof(float), vertices);
+   struct pipe_vertex_buffer vb;
+   memset(&vb, 0, sizeof vb);
+   vb.stride = 12 * sizeof(float);
+   vb.buffer.resource = vbuf;
+   t->pipe->set_vertex_buffers(t->pipe, 0, 1, 0, false, &vb);
+
+   struct pipe_blend_state blend;
+   memset(&blend, 0, sizeof blend);
+   blend.rt[0].colormask = PIPE_MASK_RGBA;
+   if (tc->premul_blend) {
+      blend.rt[0].blend_enable = 1;
+      blend.rt[0].rgb_func = PIPE_BLEND_ADD;
+      blend.rt[0].rgb_src_factor = PIPE_BLENDFACTOR_ONE;
+      blend.rt[0].rgb_dst_factor = PIPE_BLENDFACTOR_INV_SRC_ALPHA;
+      blend.rt[0].alpha_func = PIPE_BLEND_ADD;
+      blend.rt[0].alpha_src_factor = PIPE_BLENDFACTOR_ONE;
+      blend.rt[0].alpha_dst_factor = PIPE_BLENDFACTOR_INV_SRC_ALPHA;
+   }
+   void *blend_cso = t->pipe->create_blend_state(t->pipe, &blend);
+   t->pipe->bind_blend_state(t->pipe, blend_cso);
+   t->pipe->bind_fs_state(t->pipe, fs);
+   t->pipe->set_sampler_views(t->pipe, PIPE_SHADER_FRAGMENT, 0, 1, 0,
+                              false, &view);
+
+   /* Linear path first, then the general one. */
+   const int saved_perf = LP_PERF;
+   for (unsigned p = 0; p < 2; p++) {
+      results[p] = MALLOC(FB_SIZE * FB_SIZE * 4);
+      if (p)
+         LP_PERF |= PERF_NO_RAST_LINEAR;
+      int64_t ns = run_case(t, tc, vbuf, num_verts, iterations, results[p]);
+      pixels_per_sec[p] = (double)FB_SIZE * FB_SIZE * iterations * 1e9 /
+                          MAX2(ns, 1);
+   }
+   LP_PERF = saved_perf;
+
+   /* Comparing against the general path proves nothing if the linear
+    * path was never taken, so check the variant that was actually bound.
+    */
+   struct llvmpipe_context *lp = llvmpipe_context(t->pipe);
+   const struct lp_fragment_shader_variant *variant =
+      lp->setup->fs.current.variant;
+   enum lp_fs_kind kind = lp->fs->kind;
+   boolean has_linear = variant && variant->jit_linear != NULL;
+   if (kind != tc->kind ||
+       has_linear != (tc->kind != LP_FS_KIND_GENERAL)) {
+      printf("%s: expected kind %s, got %s%s\n", tc->name,
+             lp_debug_fs_kind(tc->kind), lp_debug_fs_kind(kind),
+             has_linear ? " with linear path" : " without linear path");
+      success = FALSE;
+   }
+
+   int max_diff = 0;
+   for (unsigned i = 0; i < FB_SIZE * FB_SIZE * 4; i++)
+      max_diff = MAX2(max_diff, abs(results[0][i] - results[1][i]));
+   if (max_diff > tolerance)
+      success = FALSE;
+
+   if (verbose || !success) {
+      printf("%s: %s, linear %.0f pixels/sec, general %.0f pixels/sec, "
+             "max diff %d\n",
+             success ? "PASS" : "FAIL", tc->name,
+             pixels_per_sec[0], pixels_per_sec[1], max_diff);
+   }
+
+   if (fp) {
+      fprintf(fp, "%s\t%s\t%.0f\t%.0f\t%d\n",
+              success ? "pass" : "fail", tc->name,
+              pixels_per_sec[0], pixels_per_sec[1], max_diff);
+      fflush(fp);
+   }
+
+   FREE(results[0]);
+   FREE(results[1]);
+
+   t->pipe->bind_fs_state(t->pipe, NULL);
+   t->pipe->delete_fs_state(t->pipe, fs);
+   t->pipe->bind_blend_state(t->pipe, NULL);
+   t->pipe->delete_blend_state(t->pipe, blend_cso);
+   t->pipe->set_sampler_views(t->pipe, PIPE_SHADER_FRAGMENT, 0, 0, 1,
+                              false, NULL);
+   pipe_sampler_view_reference(&view, NULL);
+   t->pipe->set_vertex_buffers(t->pipe, 0, 0, 1, false, NULL);
+   pipe_resource_reference(&vbuf, NULL);
+
+   return success;
+}
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "case\t"
+           "linear pixels/sec\t"
+           "general pixels/sec\t"
+           "max diff\n");
+
+   fflush(fp);
+}
+
+
+static boolean
+test_iterations(unsigned verbose, FILE *fp, unsigned iterations)
+{
+   struct linear_test t;
+   boolean success = TRUE;
+
+   if (!init_test(&t)) {
+      fini_test(&t);
+      return FALSE;
+   }
+
+   for (unsigned i = 0; i < ARRAY_SIZE(cases); i++) {
+      if (!test_one(verbose, fp, &t, &cases[i], iterations))
+         success = FALSE;
+   }
+
+   fini_test(&t);
+   return success;
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   return test_iterations(verbose, fp, 100);
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_iterations(verbose, fp, fp ? 100 : 4);
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   printf("no test_single()");
+   return TRUE;
+}
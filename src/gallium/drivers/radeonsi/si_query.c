@@ -210,7 +210,7 @@ static bool si_query_sw_begin(struct si_context *sctx, struct si_query *squery)
       query->begin_time = os_time_get_nano();
       break;
    case SI_QUERY_GALLIUM_THREAD_BUSY:
-      query->begin_result = sctx->tc ? util_queue_get_thread_time_nano(&sctx->tc->queue, 0) : 0;
+      query->begin_result = sctx->tc ? threaded_context_get_thread_time_nano(sctx->tc) : 0;
       query->begin_time = os_time_get_nano();
       break;
    case SI_QUERY_GPU_LOAD:
@@ -366,7 +366,7 @@ static bool si_query_sw_end(struct si_context *sctx, struct si_query *squery)
       query->end_time = os_time_get_nano();
       break;
    case SI_QUERY_GALLIUM_THREAD_BUSY:
-      query->end_result = sctx->tc ? util_queue_get_thread_time_nano(&sctx->tc->queue, 0) : 0;
+      query->end_result = sctx->tc ? threaded_context_get_thread_time_nano(sctx->tc) : 0;
       query->end_time = os_time_get_nano();
       break;
    case SI_QUERY_GPU_LOAD:
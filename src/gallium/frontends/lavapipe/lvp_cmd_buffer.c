@@ -88,6 +88,7 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_BeginCommandBuffer(
    if (cmd_buffer->status != LVP_CMD_BUFFER_STATUS_INITIAL)
       lvp_reset_cmd_buffer(&cmd_buffer->vk, 0);
    cmd_buffer->status = LVP_CMD_BUFFER_STATUS_RECORDING;
+   cmd_buffer->usage_flags = pBeginInfo->flags;
    return VK_SUCCESS;
 }
 
@@ -97,6 +98,13 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_EndCommandBuffer(
    LVP_FROM_HANDLE(lvp_cmd_buffer, cmd_buffer, commandBuffer);
    VkResult result = vk_command_buffer_get_record_result(&cmd_buffer->vk);
 
+   /* Command buffers which may be submitted more than once get their
+    * state-independent translation done up front instead of per submit.
+    */
+   if (result == VK_SUCCESS &&
+       !(cmd_buffer->usage_flags & VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT))
+      lvp_prepare_cmds(cmd_buffer);
+
    cmd_buffer->status = result == VK_SUCCESS ?
       LVP_CMD_BUFFER_STATUS_EXECUTABLE :
       LVP_CMD_BUFFER_STATUS_INVALID;
@@ -107,9 +115,11 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_EndCommandBuffer(
 static void
 lvp_free_CmdPushDescriptorSetWithTemplateKHR(struct vk_cmd_queue *queue, struct vk_cmd_queue_entry *cmd)
 {
-   struct lvp_device *device = cmd->driver_data;
+   struct lvp_cmd_buffer *cmd_buffer =
+      container_of(queue, struct lvp_cmd_buffer, vk.cmd_queue);
    LVP_FROM_HANDLE(lvp_descriptor_update_template, templ, cmd->u.push_descriptor_set_with_template_khr.descriptor_update_template);
-   lvp_descriptor_template_templ_unref(device, templ);
+   lvp_descriptor_template_templ_unref(cmd_buffer->device, templ);
+   vk_free(queue->alloc, cmd->driver_data);
 }
 
 VKAPI_ATTR void VKAPI_CALL lvp_CmdPushDescriptorSetWithTemplateKHR(
@@ -122,9 +132,8 @@ VKAPI_ATTR void VKAPI_CALL lvp_CmdPushDescriptorSetWithTemplateKHR(
    LVP_FROM_HANDLE(lvp_cmd_buffer, cmd_buffer, commandBuffer);
    LVP_FROM_HANDLE(lvp_descriptor_update_template, templ, descriptorUpdateTemplate);
    size_t info_size = 0;
-   struct vk_cmd_queue_entry *cmd = vk_zalloc(cmd_buffer->vk.cmd_queue.alloc,
-                                              sizeof(*cmd), 8,
-                                              VK_SYSTEM_ALLOCATION_SCOPE_COMMAND);
+   struct vk_cmd_queue_entry *cmd = vk_cmd_queue_zalloc(&cmd_buffer->vk.cmd_queue,
+                                                        sizeof(*cmd));
    if (!cmd)
       return;
 
@@ -132,7 +141,6 @@ VKAPI_ATTR void VKAPI_CALL lvp_CmdPushDescriptorSetWithTemplateKHR(
 
    list_addtail(&cmd->cmd_link, &cmd_buffer->vk.cmd_queue.cmds);
    cmd->driver_free_cb = lvp_free_CmdPushDescriptorSetWithTemplateKHR;
-   cmd->driver_data = cmd_buffer->device;
 
    cmd->u.push_descriptor_set_with_template_khr.descriptor_update_template = descriptorUpdateTemplate;
    lvp_descriptor_template_templ_ref(templ);
@@ -164,7 +172,7 @@ VKAPI_ATTR void VKAPI_CALL lvp_CmdPushDescriptorSetWithTemplateKHR(
       }
    }
 
-   cmd->u.push_descriptor_set_with_template_khr.data = vk_zalloc(cmd_buffer->vk.cmd_queue.alloc, info_size, 8, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND);
+   cmd->u.push_descriptor_set_with_template_khr.data = vk_cmd_queue_zalloc(&cmd_buffer->vk.cmd_queue, info_size);
 
    uint64_t offset = 0;
    for (unsigned i = 0; i < templ->entry_count; i++) {
@@ -304,6 +304,92 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreatePipelineLayout(
    return VK_SUCCESS;
 }
 
+static size_t
+stage_tables_size(const struct lvp_descriptor_set_layout *layout, gl_shader_stage stage)
+{
+   return layout->stage[stage].const_buffer_count * sizeof(struct pipe_constant_buffer) +
+          layout->stage[stage].shader_buffer_count * sizeof(struct pipe_shader_buffer) +
+          layout->stage[stage].sampler_count * sizeof(struct pipe_sampler_state *) +
+          layout->stage[stage].sampler_view_count * sizeof(struct pipe_sampler_view *) +
+          layout->stage[stage].image_count * sizeof(struct pipe_image_view) +
+          layout->stage[stage].uniform_block_count * sizeof(uint8_t *);
+}
+
+static void
+update_binding_tables(struct lvp_descriptor_set *set,
+                      const struct lvp_descriptor_set_binding_layout *bind_layout,
+                      uint32_t first, uint32_t count)
+{
+   const struct lvp_descriptor *desc =
+      &set->descriptors[bind_layout->descriptor_index];
+
+   for (gl_shader_stage s = MESA_SHADER_VERTEX; s < MESA_SHADER_STAGES; s++) {
+      struct lvp_descriptor_set_stage *tables = &set->stage[s];
+
+      for (uint32_t i = first; i < first + count; i++) {
+         switch (bind_layout->type) {
+         case VK_DESCRIPTOR_TYPE_SAMPLER:
+         case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+            if (bind_layout->stage[s].sampler_index >= 0) {
+               tables->samplers[bind_layout->stage[s].sampler_index + i] =
+                  bind_layout->immutable_samplers ? bind_layout->immutable_samplers[i] : desc[i].info.sampler;
+            }
+            if (bind_layout->type == VK_DESCRIPTOR_TYPE_SAMPLER)
+               break;
+            FALLTHROUGH;
+         case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+         case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+            if (bind_layout->stage[s].sampler_view_index >= 0)
+               tables->sampler_views[bind_layout->stage[s].sampler_view_index + i] = desc[i].info.sampler_view;
+            break;
+         case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+         case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+         case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+            if (bind_layout->stage[s].image_index >= 0)
+               tables->images[bind_layout->stage[s].image_index + i] = desc[i].info.image_view;
+            break;
+         case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+         case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+            if (bind_layout->stage[s].const_buffer_index >= 0)
+               tables->const_buffers[bind_layout->stage[s].const_buffer_index + i] = desc[i].info.ubo;
+            break;
+         case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+         case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+            if (bind_layout->stage[s].shader_buffer_index >= 0)
+               tables->shader_buffers[bind_layout->stage[s].shader_buffer_index + i] = desc[i].info.ssbo;
+            break;
+         default:
+            break;
+         }
+      }
+   }
+}
+
+/* Mirror count descriptors starting at array element first of a binding
+ * into the per-stage tables.  Like the writes themselves, this carries on
+ * into the following bindings when count runs past the end of this one.
+ */
+static void
+update_stage_tables(struct lvp_descriptor_set *set, uint32_t binding,
+                    uint32_t first, uint32_t count)
+{
+   const struct lvp_descriptor_set_layout *layout = set->layout;
+
+   while (count && binding < layout->binding_count) {
+      const struct lvp_descriptor_set_binding_layout *bind_layout =
+         &layout->binding[binding++];
+      if (!bind_layout->valid || first >= bind_layout->array_size) {
+         first -= MIN2(first, bind_layout->array_size);
+         continue;
+      }
+
+      uint32_t n = MIN2(count, bind_layout->array_size - first);
+      update_binding_tables(set, bind_layout, first, n);
+      count -= n;
+      first = 0;
+   }
+}
+
 VkResult
 lvp_descriptor_set_create(struct lvp_device *device,
                           struct lvp_descriptor_set_layout *layout,
@@ -311,6 +397,8 @@ lvp_descriptor_set_create(struct lvp_device *device,
 {
    struct lvp_descriptor_set *set;
    size_t base_size = sizeof(*set) + layout->size * sizeof(set->descriptors[0]);
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++)
+      base_size += stage_tables_size(layout, i);
    size_t size = base_size;
    for (unsigned i = 0; i < MESA_SHADER_STAGES; i++)
       size += layout->stage[i].uniform_block_size;
@@ -329,18 +417,41 @@ lvp_descriptor_set_create(struct lvp_device *device,
    set->layout = layout;
    vk_descriptor_set_layout_ref(&layout->vk);
 
+   uint8_t *table_mem = (uint8_t *)&set->descriptors[layout->size];
+   for (gl_shader_stage s = MESA_SHADER_VERTEX; s < MESA_SHADER_STAGES; s++) {
+      struct lvp_descriptor_set_stage *tables = &set->stage[s];
+      tables->const_buffers = (struct pipe_constant_buffer *)table_mem;
+      table_mem += layout->stage[s].const_buffer_count * sizeof(struct pipe_constant_buffer);
+      tables->shader_buffers = (struct pipe_shader_buffer *)table_mem;
+      table_mem += layout->stage[s].shader_buffer_count * sizeof(struct pipe_shader_buffer);
+      tables->samplers = (const struct pipe_sampler_state **)table_mem;
+      table_mem += layout->stage[s].sampler_count * sizeof(struct pipe_sampler_state *);
+      tables->sampler_views = (struct pipe_sampler_view **)table_mem;
+      table_mem += layout->stage[s].sampler_view_count * sizeof(struct pipe_sampler_view *);
+      tables->images = (struct pipe_image_view *)table_mem;
+      table_mem += layout->stage[s].image_count * sizeof(struct pipe_image_view);
+      tables->uniform_blocks = (uint8_t **)table_mem;
+      table_mem += layout->stage[s].uniform_block_count * sizeof(uint8_t *);
+   }
+
    /* Go through and fill out immutable samplers if we have any */
    struct lvp_descriptor *desc = set->descriptors;
    uint8_t *uniform_mem = (uint8_t*)(set) + base_size;
    for (uint32_t b = 0; b < layout->binding_count; b++) {
       if (layout->binding[b].type == VK_DESCRIPTOR_TYPE_INLINE_UNIFORM_BLOCK) {
          desc->info.uniform = uniform_mem;
+         lvp_foreach_stage(s, layout->shader_stages) {
+            int idx = layout->binding[b].stage[s].uniform_block_index;
+            if (idx >= 0)
+               set->stage[s].uniform_blocks[idx] = uniform_mem;
+         }
          uniform_mem += layout->binding[b].array_size;
          desc++;
       } else {
          if (layout->binding[b].immutable_samplers) {
             for (uint32_t i = 0; i < layout->binding[b].array_size; i++)
                desc[i].info.sampler = layout->binding[b].immutable_samplers[i];
+            update_binding_tables(set, &layout->binding[b], 0, layout->binding[b].array_size);
          }
          desc += layout->binding[b].array_size;
       }
@@ -548,6 +659,9 @@ VKAPI_ATTR void VKAPI_CALL lvp_UpdateDescriptorSets(
       default:
          break;
       }
+
+      update_stage_tables(set, write->dstBinding, write->dstArrayElement,
+                          write->descriptorCount);
    }
 
    for (uint32_t i = 0; i < descriptorCopyCount; i++) {
@@ -576,6 +690,9 @@ VKAPI_ATTR void VKAPI_CALL lvp_UpdateDescriptorSets(
 
          for (uint32_t j = 0; j < copy->descriptorCount; j++)
             dst_desc[j] = src_desc[j];
+
+         update_stage_tables(dst, copy->dstBinding, copy->dstArrayElement,
+                             copy->descriptorCount);
       }
    }
 }
@@ -821,5 +938,8 @@ VKAPI_ATTR void VKAPI_CALL lvp_UpdateDescriptorSetWithTemplate(VkDevice _device,
          }
          pSrc += entry->stride;
       }
+
+      update_stage_tables(set, entry->dstBinding, entry->dstArrayElement,
+                          entry->descriptorCount);
    }
 }
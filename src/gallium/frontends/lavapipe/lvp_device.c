@@ -35,6 +35,7 @@
 #include "pipe/p_context.h"
 #include "frontend/drisw_api.h"
 
+#include "util/disk_cache.h"
 #include "util/u_inlines.h"
 #include "util/os_memory.h"
 #include "util/u_thread.h"
@@ -43,12 +44,6 @@
 #include "util/ptralloc.h"
 #include "os_time.h"
 
-#if defined(VK_USE_PLATFORM_WAYLAND_KHR) || \
-    defined(VK_USE_PLATFORM_WIN32_KHR) || \
-    defined(VK_USE_PLATFORM_XCB_KHR) || \
-    defined(VK_USE_PLATFORM_XLIB_KHR)
-#define LVP_USE_WSI_PLATFORM
-#endif
 #define LVP_API_VERSION VK_MAKE_VERSION(1, 3, VK_HEADER_VERSION)
 
 VKAPI_ATTR VkResult VKAPI_CALL lvp_EnumerateInstanceVersion(uint32_t* pApiVersion)
@@ -65,11 +60,10 @@ static const struct vk_instance_extension_table lvp_instance_extensions_supporte
    .KHR_get_physical_device_properties2      = true,
    .EXT_debug_report                         = true,
    .EXT_debug_utils                          = true,
-#ifdef LVP_USE_WSI_PLATFORM
    .KHR_get_surface_capabilities2            = true,
    .KHR_surface                              = true,
    .KHR_surface_protected_capabilities       = true,
-#endif
+   .EXT_headless_surface                     = true,
 #ifdef VK_USE_PLATFORM_WAYLAND_KHR
    .KHR_wayland_surface                      = true,
 #endif
@@ -107,9 +101,7 @@ static const struct vk_device_extension_table lvp_device_extensions_supported =
    .KHR_external_semaphore                = true,
    .KHR_shader_float_controls             = true,
    .KHR_get_memory_requirements2          = true,
-#ifdef LVP_USE_WSI_PLATFORM
    .KHR_incremental_present               = true,
-#endif
    .KHR_image_format_list                 = true,
    .KHR_imageless_framebuffer             = true,
    .KHR_maintenance1                      = true,
@@ -131,10 +123,8 @@ static const struct vk_device_extension_table lvp_device_extensions_supported =
    .KHR_shader_terminate_invocation       = true,
    .KHR_spirv_1_4                         = true,
    .KHR_storage_buffer_storage_class      = true,
-#ifdef LVP_USE_WSI_PLATFORM
    .KHR_swapchain                         = true,
    .KHR_swapchain_mutable_format          = true,
-#endif
    .KHR_synchronization2                  = true,
    .KHR_timeline_semaphore                = true,
    .KHR_uniform_buffer_standard_layout    = true,
@@ -241,6 +231,14 @@ lvp_physical_device_init(struct lvp_physical_device *device,
    device->sync_types[2] = NULL;
    device->vk.supported_sync_types = device->sync_types;
 
+#ifdef ENABLE_SHADER_CACHE
+   uint8_t cache_uuid[VK_UUID_SIZE];
+   char cache_id[VK_UUID_SIZE * 2 + 1];
+   lvp_device_get_cache_uuid(cache_uuid);
+   disk_cache_format_hex_id(cache_id, cache_uuid, VK_UUID_SIZE * 2);
+   device->vk.disk_cache = disk_cache_create("lavapipe", cache_id, 0);
+#endif
+
    device->max_images = device->pscreen->get_shader_param(device->pscreen, PIPE_SHADER_FRAGMENT, PIPE_SHADER_CAP_MAX_SHADER_IMAGES);
    device->vk.supported_extensions = lvp_device_extensions_supported;
 
@@ -389,6 +387,9 @@ static void VKAPI_CALL
 lvp_physical_device_finish(struct lvp_physical_device *device)
 {
    lvp_finish_wsi(device);
+#ifdef ENABLE_SHADER_CACHE
+   disk_cache_destroy(device->vk.disk_cache);
+#endif
    device->pscreen->destroy(device->pscreen);
    vk_physical_device_finish(&device->vk);
 }
@@ -971,8 +972,20 @@ VKAPI_ATTR void VKAPI_CALL lvp_GetPhysicalDeviceFeatures2(
 void
 lvp_device_get_cache_uuid(void *uuid)
 {
-   memset(uuid, 0, VK_UUID_SIZE);
-   snprintf(uuid, VK_UUID_SIZE, "val-%s", &MESA_GIT_SHA1[4]);
+   struct mesa_sha1 ctx;
+   unsigned char sha1[SHA1_DIGEST_LENGTH];
+
+   /* Pipeline caches hold serialized NIR, which is only valid for the build
+    * that wrote it, so prefer the build-id over the git sha.
+    */
+   _mesa_sha1_init(&ctx);
+   if (!disk_cache_get_function_identifier(lvp_device_get_cache_uuid, &ctx)) {
+      memset(uuid, 0, VK_UUID_SIZE);
+      snprintf(uuid, VK_UUID_SIZE, "val-%s", &MESA_GIT_SHA1[4]);
+      return;
+   }
+   _mesa_sha1_final(&ctx, sha1);
+   memcpy(uuid, sha1, VK_UUID_SIZE);
 }
 
 VKAPI_ATTR void VKAPI_CALL lvp_GetPhysicalDeviceProperties(VkPhysicalDevice physicalDevice,
@@ -1298,7 +1311,7 @@ VKAPI_ATTR void VKAPI_CALL lvp_GetPhysicalDeviceQueueFamilyProperties2(
          .queueFlags = VK_QUEUE_GRAPHICS_BIT |
          VK_QUEUE_COMPUTE_BIT |
          VK_QUEUE_TRANSFER_BIT,
-         .queueCount = 1,
+         .queueCount = LVP_MAX_QUEUES,
          .timestampValidBits = 64,
          .minImageTransferGranularity = (VkExtent3D) { 1, 1, 1 },
       };
@@ -1401,7 +1414,10 @@ destroy_pipelines(struct lvp_queue *queue)
 {
    simple_mtx_lock(&queue->pipeline_lock);
    while (util_dynarray_contains(&queue->pipeline_destroys, struct lvp_pipeline*)) {
-      lvp_pipeline_destroy(queue->device, util_dynarray_pop(&queue->pipeline_destroys, struct lvp_pipeline*));
+      struct lvp_pipeline *pipeline =
+         util_dynarray_pop(&queue->pipeline_destroys, struct lvp_pipeline*);
+      if (lvp_pipeline_destroy_queue_shaders(queue, pipeline))
+         lvp_pipeline_destroy(queue->device, pipeline);
    }
    simple_mtx_unlock(&queue->pipeline_lock);
 }
@@ -1455,6 +1471,12 @@ lvp_queue_init(struct lvp_device *device, struct lvp_queue *queue,
    }
 
    queue->device = device;
+   queue->state = vk_zalloc(&device->vk.alloc, lvp_get_rendering_state_size(), 8,
+                            VK_SYSTEM_ALLOCATION_SCOPE_DEVICE);
+   if (!queue->state) {
+      vk_queue_finish(&queue->vk);
+      return vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
+   }
 
    queue->ctx = device->pscreen->context_create(device->pscreen, NULL, PIPE_CONTEXT_ROBUST_BUFFER_ACCESS);
    queue->cso = cso_create_context(queue->ctx, CSO_NO_VBUF);
@@ -1477,9 +1499,12 @@ lvp_queue_finish(struct lvp_queue *queue)
    simple_mtx_destroy(&queue->pipeline_lock);
    util_dynarray_fini(&queue->pipeline_destroys);
 
+   if (queue->last_fence)
+      queue->device->pscreen->fence_reference(queue->device->pscreen, &queue->last_fence, NULL);
    u_upload_destroy(queue->uploader);
    cso_destroy_context(queue->cso);
    queue->ctx->destroy(queue->ctx);
+   vk_free(&queue->device->vk.alloc, queue->state);
 }
 
 VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateDevice(
@@ -1494,14 +1519,12 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateDevice(
 
    assert(pCreateInfo->sType == VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO);
 
-   size_t state_size = lvp_get_rendering_state_size();
    device = vk_zalloc2(&physical_device->vk.instance->alloc, pAllocator,
-                       sizeof(*device) + state_size, 8,
+                       sizeof(*device), 8,
                        VK_SYSTEM_ALLOCATION_SCOPE_DEVICE);
    if (!device)
       return vk_error(instance, VK_ERROR_OUT_OF_HOST_MEMORY);
 
-   device->queue.state = device + 1;
    device->poison_mem = debug_get_bool_option("LVP_POISON_MEMORY", false);
 
    struct vk_device_dispatch_table dispatch_table;
@@ -1527,15 +1550,34 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateDevice(
 
    device->pscreen = physical_device->pscreen;
 
+   device->inline_stats = debug_get_bool_option("LVP_INLINE_STATS", false);
+   if (!util_queue_init(&device->inline_queue, "lvp_inline", 32, 1,
+                        UTIL_QUEUE_INIT_RESIZE_IF_FULL |
+                        UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY, NULL)) {
+      vk_device_finish(&device->vk);
+      vk_free(&device->vk.alloc, device);
+      return vk_error(instance, VK_ERROR_OUT_OF_HOST_MEMORY);
+   }
+
    assert(pCreateInfo->queueCreateInfoCount == 1);
    assert(pCreateInfo->pQueueCreateInfos[0].queueFamilyIndex == 0);
-   assert(pCreateInfo->pQueueCreateInfos[0].queueCount == 1);
-   result = lvp_queue_init(device, &device->queue, pCreateInfo->pQueueCreateInfos, 0);
-   if (result != VK_SUCCESS) {
-      vk_free(&device->vk.alloc, device);
-      return result;
+   assert(pCreateInfo->pQueueCreateInfos[0].queueCount <= LVP_MAX_QUEUES);
+   for (uint32_t i = 0; i < pCreateInfo->pQueueCreateInfos[0].queueCount; i++) {
+      result = lvp_queue_init(device, &device->queues[i], pCreateInfo->pQueueCreateInfos, i);
+      if (result != VK_SUCCESS) {
+         for (uint32_t j = 0; j < device->queue_count; j++)
+            lvp_queue_finish(&device->queues[j]);
+         util_queue_destroy(&device->inline_queue);
+         vk_free(&device->vk.alloc, device);
+         return result;
+      }
+      device->queue_count++;
    }
 
+   /* used when pipelines are created without a VkPipelineCache */
+   device->pipeline_cache = vk_pipeline_cache_create(&device->vk,
+      &(struct vk_pipeline_cache_create_info) { 0 }, NULL);
+
    *pDevice = lvp_device_to_handle(device);
 
    return VK_SUCCESS;
@@ -1548,9 +1590,19 @@ VKAPI_ATTR void VKAPI_CALL lvp_DestroyDevice(
 {
    LVP_FROM_HANDLE(lvp_device, device, _device);
 
-   if (device->queue.last_fence)
-      device->pscreen->fence_reference(device->pscreen, &device->queue.last_fence, NULL);
-   lvp_queue_finish(&device->queue);
+   if (device->pipeline_cache)
+      vk_pipeline_cache_destroy(device->pipeline_cache, NULL);
+   for (uint32_t i = 0; i < device->queue_count; i++)
+      lvp_queue_finish(&device->queues[i]);
+   util_queue_destroy(&device->inline_queue);
+
+   if (device->inline_stats) {
+      fprintf(stderr, "lavapipe: inlined uniforms: %u generic binds, %u variant binds, "
+              "%u variants compiled, %u rejected\n",
+              device->inline_counts.generic, device->inline_counts.hits,
+              device->inline_counts.specialized, device->inline_counts.rejected);
+   }
+
    vk_device_finish(&device->vk);
    vk_free(&device->vk.alloc, device);
 }
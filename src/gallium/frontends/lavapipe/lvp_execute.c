@@ -43,7 +43,6 @@
 #include "util/u_prim.h"
 #include "util/u_prim_restart.h"
 #include "util/format/u_format_zs.h"
-#include "util/ptralloc.h"
 #include "tgsi/tgsi_from_mesa.h"
 
 #include "vk_cmd_enqueue_entrypoints.h"
@@ -72,6 +71,8 @@ struct rendering_state {
    struct pipe_context *pctx;
    struct u_upload_mgr *uploader;
    struct cso_context *cso;
+   /* row of lvp_pipeline::shader_cso belonging to pctx */
+   unsigned queue_index;
 
    bool blend_dirty;
    bool rs_dirty;
@@ -261,71 +262,73 @@ update_pcbuf(struct rendering_state *state, enum pipe_shader_type pstage)
    state->pcbuf_dirty[pstage] = false;
 }
 
+/* Returns the pipeline's shader state for this queue's context, compiling
+ * it on first use.
+ */
+static void *
+get_shader_cso(struct rendering_state *state, struct lvp_pipeline *pipeline, enum pipe_shader_type sh)
+{
+   void **cso = &pipeline->shader_cso[state->queue_index][sh];
+   if (!*cso) {
+      gl_shader_stage stage = tgsi_processor_to_shader_stage(sh);
+      *cso = lvp_pipeline_compile(pipeline, state->pctx, nir_shader_clone(NULL, pipeline->pipeline_nir[stage]));
+   }
+   return *cso;
+}
+
 static void
-update_inline_shader_state(struct rendering_state *state, enum pipe_shader_type sh, bool pcbuf_dirty, bool constbuf_dirty)
+update_inline_shader_state(struct rendering_state *state, enum pipe_shader_type sh)
 {
    bool is_compute = sh == PIPE_SHADER_COMPUTE;
-   uint32_t inline_uniforms[MAX_INLINABLE_UNIFORMS];
+   uint32_t inline_uniforms[MAX_INLINABLE_UNIFORMS] = {0};
    unsigned stage = tgsi_processor_to_shader_stage(sh);
    state->inlines_dirty[sh] = false;
    if (!state->pipeline[is_compute]->inlines[stage].can_inline)
       return;
    struct lvp_pipeline *pipeline = state->pipeline[is_compute];
+   /* only a single buffer is ever inlined from */
+   unsigned slot = ffs(pipeline->inlines[stage].can_inline) - 1;
+   unsigned count = pipeline->inlines[stage].count[slot];
    /* these buffers have already been flushed in llvmpipe, so they're safe to read */
-   nir_shader *nir = nir_shader_clone(pipeline->pipeline_nir[stage], pipeline->pipeline_nir[stage]);
-   nir_function_impl *impl = nir_shader_get_entrypoint(nir);
-   unsigned ssa_alloc = impl->ssa_alloc;
-   unsigned count = pipeline->inlines[stage].count[0];
-   if (count && pcbuf_dirty) {
+   if (slot == 0) {
       unsigned push_size = get_pcbuf_size(state, sh);
       for (unsigned i = 0; i < count; i++) {
          unsigned offset = pipeline->inlines[stage].uniform_offsets[0][i];
          if (offset < push_size) {
             memcpy(&inline_uniforms[i], &state->push_constants[offset], sizeof(uint32_t));
          } else {
-            for (unsigned i = 0; i < state->uniform_blocks[sh].count; i++) {
-               if (offset < push_size + state->uniform_blocks[sh].size[i]) {
-                  unsigned ubo_offset = offset - push_size;
-                  uint8_t *block = state->uniform_blocks[sh].block[i];
+            unsigned block_start = push_size;
+            for (unsigned j = 0; j < state->uniform_blocks[sh].count; j++) {
+               if (offset < block_start + state->uniform_blocks[sh].size[j]) {
+                  unsigned ubo_offset = offset - block_start;
+                  uint8_t *block = state->uniform_blocks[sh].block[j];
                   memcpy(&inline_uniforms[i], &block[ubo_offset], sizeof(uint32_t));
                   break;
                }
-               push_size += state->uniform_blocks[sh].size[i];
+               block_start += state->uniform_blocks[sh].size[j];
             }
          }
       }
-      NIR_PASS_V(nir, lvp_inline_uniforms, pipeline, inline_uniforms, 0);
-   }
-   if (constbuf_dirty) {
-      struct pipe_box box = {0};
-      u_foreach_bit(slot, pipeline->inlines[stage].can_inline) {
-         unsigned count = pipeline->inlines[stage].count[slot];
-         struct pipe_constant_buffer *cbuf = &state->const_buffer[sh][slot - 1];
-         struct pipe_resource *pres = cbuf->buffer;
-         box.x = cbuf->buffer_offset;
-         box.width = cbuf->buffer_size - cbuf->buffer_offset;
-         struct pipe_transfer *xfer;
-         uint8_t *map = state->pctx->buffer_map(state->pctx, pres, 0, PIPE_MAP_READ, &box, &xfer);
-         for (unsigned i = 0; i < count; i++) {
-            unsigned offset = pipeline->inlines[stage].uniform_offsets[slot][i];
-            memcpy(&inline_uniforms[i], map + offset, sizeof(uint32_t));
-         }
-         state->pctx->buffer_unmap(state->pctx, xfer);
-         NIR_PASS_V(nir, lvp_inline_uniforms, pipeline, inline_uniforms, slot);
-      }
-   }
-   lvp_shader_optimize(nir);
-   impl = nir_shader_get_entrypoint(nir);
-   void *shader_state;
-   if (ssa_alloc - impl->ssa_alloc < ssa_alloc / 2 &&
-       !pipeline->inlines[stage].must_inline) {
-      /* not enough change; don't inline further */
-      pipeline->inlines[stage].can_inline = 0;
-      ralloc_free(nir);
-      pipeline->shader_cso[sh] = lvp_pipeline_compile(pipeline, nir_shader_clone(NULL, pipeline->pipeline_nir[stage]));
-      shader_state = pipeline->shader_cso[sh];
    } else {
-      shader_state = lvp_pipeline_compile(pipeline, nir);
+      struct pipe_box box = {0};
+      struct pipe_constant_buffer *cbuf = &state->const_buffer[sh][slot - 1];
+      struct pipe_resource *pres = cbuf->buffer;
+      box.x = cbuf->buffer_offset;
+      box.width = cbuf->buffer_size - cbuf->buffer_offset;
+      struct pipe_transfer *xfer;
+      uint8_t *map = state->pctx->buffer_map(state->pctx, pres, 0, PIPE_MAP_READ, &box, &xfer);
+      for (unsigned i = 0; i < count; i++) {
+         unsigned offset = pipeline->inlines[stage].uniform_offsets[slot][i];
+         memcpy(&inline_uniforms[i], map + offset, sizeof(uint32_t));
+      }
+      state->pctx->buffer_unmap(state->pctx, xfer);
+   }
+
+   void *shader_state = lvp_inline_cache_get_cso(pipeline, state->pctx, state->queue_index,
+                                                 stage, slot, inline_uniforms);
+   if (!shader_state) {
+      p_atomic_inc(&pipeline->device->inline_counts.generic);
+      shader_state = get_shader_cso(state, pipeline, sh);
    }
    switch (sh) {
    case PIPE_SHADER_VERTEX:
@@ -359,11 +362,9 @@ static void emit_compute_state(struct rendering_state *state)
       state->iv_dirty[PIPE_SHADER_COMPUTE] = false;
    }
 
-   bool pcbuf_dirty = state->pcbuf_dirty[PIPE_SHADER_COMPUTE];
    if (state->pcbuf_dirty[PIPE_SHADER_COMPUTE])
       update_pcbuf(state, PIPE_SHADER_COMPUTE);
 
-   bool constbuf_dirty = state->constbuf_dirty[PIPE_SHADER_COMPUTE];
    if (state->constbuf_dirty[PIPE_SHADER_COMPUTE]) {
       for (unsigned i = 0; i < state->num_const_bufs[PIPE_SHADER_COMPUTE]; i++)
          state->pctx->set_constant_buffer(state->pctx, PIPE_SHADER_COMPUTE,
@@ -372,7 +373,7 @@ static void emit_compute_state(struct rendering_state *state)
    }
 
    if (state->inlines_dirty[PIPE_SHADER_COMPUTE])
-      update_inline_shader_state(state, PIPE_SHADER_COMPUTE, pcbuf_dirty, constbuf_dirty);
+      update_inline_shader_state(state, PIPE_SHADER_COMPUTE);
 
    if (state->sb_dirty[PIPE_SHADER_COMPUTE]) {
       state->pctx->set_shader_buffers(state->pctx, PIPE_SHADER_COMPUTE,
@@ -474,10 +475,7 @@ static void emit_state(struct rendering_state *state)
       state->ve_dirty = false;
    }
 
-   bool constbuf_dirty[PIPE_SHADER_TYPES] = {false};
-   bool pcbuf_dirty[PIPE_SHADER_TYPES] = {false};
    for (sh = 0; sh < PIPE_SHADER_COMPUTE; sh++) {
-      constbuf_dirty[sh] = state->constbuf_dirty[sh];
       if (state->constbuf_dirty[sh]) {
          for (unsigned idx = 0; idx < state->num_const_bufs[sh]; idx++)
             state->pctx->set_constant_buffer(state->pctx, sh,
@@ -487,14 +485,13 @@ static void emit_state(struct rendering_state *state)
    }
 
    for (sh = 0; sh < PIPE_SHADER_COMPUTE; sh++) {
-      pcbuf_dirty[sh] = state->pcbuf_dirty[sh];
       if (state->pcbuf_dirty[sh])
          update_pcbuf(state, sh);
    }
 
    for (sh = 0; sh < PIPE_SHADER_COMPUTE; sh++) {
       if (state->inlines_dirty[sh])
-         update_inline_shader_state(state, sh, pcbuf_dirty[sh], constbuf_dirty[sh]);
+         update_inline_shader_state(state, sh);
    }
 
    for (sh = 0; sh < PIPE_SHADER_COMPUTE; sh++) {
@@ -567,7 +564,7 @@ static void handle_compute_pipeline(struct vk_cmd_queue_entry *cmd,
    state->dispatch_info.block[2] = pipeline->pipeline_nir[MESA_SHADER_COMPUTE]->info.workgroup_size[2];
    state->inlines_dirty[PIPE_SHADER_COMPUTE] = pipeline->inlines[MESA_SHADER_COMPUTE].can_inline;
    if (!pipeline->inlines[MESA_SHADER_COMPUTE].can_inline)
-      state->pctx->bind_compute_state(state->pctx, pipeline->shader_cso[PIPE_SHADER_COMPUTE]);
+      state->pctx->bind_compute_state(state->pctx, get_shader_cso(state, pipeline, PIPE_SHADER_COMPUTE));
 }
 
 static void
@@ -649,32 +646,32 @@ static void handle_graphics_pipeline(struct vk_cmd_queue_entry *cmd,
          case VK_SHADER_STAGE_FRAGMENT_BIT:
             state->inlines_dirty[PIPE_SHADER_FRAGMENT] = pipeline->inlines[MESA_SHADER_FRAGMENT].can_inline;
             if (!pipeline->inlines[MESA_SHADER_FRAGMENT].can_inline)
-               state->pctx->bind_fs_state(state->pctx, pipeline->shader_cso[PIPE_SHADER_FRAGMENT]);
+               state->pctx->bind_fs_state(state->pctx, get_shader_cso(state, pipeline, PIPE_SHADER_FRAGMENT));
             has_stage[PIPE_SHADER_FRAGMENT] = true;
             break;
          case VK_SHADER_STAGE_VERTEX_BIT:
             state->inlines_dirty[PIPE_SHADER_VERTEX] = pipeline->inlines[MESA_SHADER_VERTEX].can_inline;
             if (!pipeline->inlines[MESA_SHADER_VERTEX].can_inline)
-               state->pctx->bind_vs_state(state->pctx, pipeline->shader_cso[PIPE_SHADER_VERTEX]);
+               state->pctx->bind_vs_state(state->pctx, get_shader_cso(state, pipeline, PIPE_SHADER_VERTEX));
             has_stage[PIPE_SHADER_VERTEX] = true;
             break;
          case VK_SHADER_STAGE_GEOMETRY_BIT:
             state->inlines_dirty[PIPE_SHADER_GEOMETRY] = pipeline->inlines[MESA_SHADER_GEOMETRY].can_inline;
             if (!pipeline->inlines[MESA_SHADER_GEOMETRY].can_inline)
-               state->pctx->bind_gs_state(state->pctx, pipeline->shader_cso[PIPE_SHADER_GEOMETRY]);
+               state->pctx->bind_gs_state(state->pctx, get_shader_cso(state, pipeline, PIPE_SHADER_GEOMETRY));
             state->gs_output_lines = pipeline->gs_output_lines ? GS_OUTPUT_LINES : GS_OUTPUT_NOT_LINES;
             has_stage[PIPE_SHADER_GEOMETRY] = true;
             break;
          case VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT:
             state->inlines_dirty[PIPE_SHADER_TESS_CTRL] = pipeline->inlines[MESA_SHADER_TESS_CTRL].can_inline;
             if (!pipeline->inlines[MESA_SHADER_TESS_CTRL].can_inline)
-               state->pctx->bind_tcs_state(state->pctx, pipeline->shader_cso[PIPE_SHADER_TESS_CTRL]);
+               state->pctx->bind_tcs_state(state->pctx, get_shader_cso(state, pipeline, PIPE_SHADER_TESS_CTRL));
             has_stage[PIPE_SHADER_TESS_CTRL] = true;
             break;
          case VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT:
             state->inlines_dirty[PIPE_SHADER_TESS_EVAL] = pipeline->inlines[MESA_SHADER_TESS_EVAL].can_inline;
             if (!pipeline->inlines[MESA_SHADER_TESS_EVAL].can_inline)
-               state->pctx->bind_tes_state(state->pctx, pipeline->shader_cso[PIPE_SHADER_TESS_EVAL]);
+               state->pctx->bind_tes_state(state->pctx, get_shader_cso(state, pipeline, PIPE_SHADER_TESS_EVAL));
             has_stage[PIPE_SHADER_TESS_EVAL] = true;
             break;
          default:
@@ -686,7 +683,7 @@ static void handle_graphics_pipeline(struct vk_cmd_queue_entry *cmd,
 
    /* there should always be a dummy fs. */
    if (!has_stage[PIPE_SHADER_FRAGMENT])
-      state->pctx->bind_fs_state(state->pctx, pipeline->shader_cso[PIPE_SHADER_FRAGMENT]);
+      state->pctx->bind_fs_state(state->pctx, get_shader_cso(state, pipeline, PIPE_SHADER_FRAGMENT));
    if (state->pctx->bind_gs_state && !has_stage[PIPE_SHADER_GEOMETRY])
       state->pctx->bind_gs_state(state->pctx, NULL);
    if (state->pctx->bind_tcs_state && !has_stage[PIPE_SHADER_TESS_CTRL])
@@ -1199,18 +1196,103 @@ static void handle_set_stage(struct rendering_state *state,
                              gl_shader_stage stage,
                              enum pipe_shader_type p_stage)
 {
-   int j;
-   for (j = 0; j < set->layout->binding_count; j++) {
-      const struct lvp_descriptor_set_binding_layout *binding;
-      const struct lvp_descriptor *descriptor;
-      binding = &set->layout->binding[j];
-
-      if (binding->valid) {
-         unsigned array_size = binding->type == VK_DESCRIPTOR_TYPE_INLINE_UNIFORM_BLOCK ? 1 : binding->array_size;
-         for (int i = 0; i < array_size; i++) {
-            descriptor = &set->descriptors[binding->descriptor_index + i];
-            handle_descriptor(state, dyn_info, binding, stage, p_stage, i, descriptor->type, &descriptor->info);
-         }
+   const struct lvp_descriptor_set_layout *layout = set->layout;
+   const struct lvp_descriptor_set_stage *tables = &set->stage[stage];
+   unsigned base, count;
+
+   count = layout->stage[stage].const_buffer_count;
+   if (count) {
+      base = dyn_info->stage[stage].const_buffer_count;
+      memcpy(&state->const_buffer[p_stage][base], tables->const_buffers,
+             count * sizeof(*tables->const_buffers));
+      state->num_const_bufs[p_stage] = MAX2(state->num_const_bufs[p_stage], base + count);
+      state->constbuf_dirty[p_stage] = true;
+      state->inlines_dirty[p_stage] = true;
+   }
+
+   count = layout->stage[stage].shader_buffer_count;
+   if (count) {
+      base = dyn_info->stage[stage].shader_buffer_count;
+      memcpy(&state->sb[p_stage][base], tables->shader_buffers,
+             count * sizeof(*tables->shader_buffers));
+      state->num_shader_buffers[p_stage] = MAX2(state->num_shader_buffers[p_stage], base + count);
+      state->sb_dirty[p_stage] = true;
+   }
+
+   count = layout->stage[stage].sampler_count;
+   if (count) {
+      base = dyn_info->stage[stage].sampler_count;
+      for (unsigned i = 0; i < count; i++) {
+         if (tables->samplers[i])
+            state->ss[p_stage][base + i] = *tables->samplers[i];
+      }
+      state->num_sampler_states[p_stage] = MAX2(state->num_sampler_states[p_stage], base + count);
+      state->ss_dirty[p_stage] = true;
+   }
+
+   count = layout->stage[stage].sampler_view_count;
+   if (count) {
+      base = dyn_info->stage[stage].sampler_view_count;
+      assert(base + count <= ARRAY_SIZE(state->sv[p_stage]));
+      memcpy(&state->sv[p_stage][base], tables->sampler_views,
+             count * sizeof(*tables->sampler_views));
+      state->num_sampler_views[p_stage] = MAX2(state->num_sampler_views[p_stage], base + count);
+      state->sv_dirty[p_stage] = true;
+   }
+
+   count = layout->stage[stage].image_count;
+   if (count) {
+      base = dyn_info->stage[stage].image_count;
+      for (unsigned i = 0; i < count; i++) {
+         /* the access flags come from the pipeline */
+         struct pipe_image_view *iv = &state->iv[p_stage][base + i];
+         uint16_t access = iv->access;
+         uint16_t shader_access = iv->shader_access;
+         *iv = tables->images[i];
+         iv->access = access;
+         iv->shader_access = shader_access;
+      }
+      state->num_shader_images[p_stage] = MAX2(state->num_shader_images[p_stage], base + count);
+      state->iv_dirty[p_stage] = true;
+   }
+
+   count = layout->stage[stage].uniform_block_count;
+   if (count) {
+      base = dyn_info->stage[stage].uniform_block_count;
+      memcpy(&state->uniform_blocks[p_stage].block[base], tables->uniform_blocks,
+             count * sizeof(*tables->uniform_blocks));
+      state->pcbuf_dirty[p_stage] = true;
+      state->inlines_dirty[p_stage] = true;
+   }
+
+   if (!layout->dynamic_offset_count)
+      return;
+
+   for (unsigned j = 0; j < layout->binding_count; j++) {
+      const struct lvp_descriptor_set_binding_layout *binding = &layout->binding[j];
+      const uint32_t *offsets =
+         &dyn_info->dynamic_offsets[dyn_info->dyn_index + binding->dynamic_index];
+      int idx;
+
+      switch (binding->type) {
+      case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+         idx = binding->stage[stage].const_buffer_index;
+         if (idx == -1)
+            break;
+         idx += dyn_info->stage[stage].const_buffer_count;
+         for (unsigned i = 0; i < binding->array_size; i++)
+            state->const_buffer[p_stage][idx + i].buffer_offset += offsets[i];
+         break;
+      case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+         idx = binding->stage[stage].shader_buffer_index;
+         if (idx == -1)
+            break;
+         idx += dyn_info->stage[stage].shader_buffer_count;
+         for (unsigned i = 0; i < binding->array_size; i++)
+            state->sb[p_stage][idx + i].buffer_offset += offsets[i];
+         break;
+      default:
+         break;
       }
    }
 }
@@ -1740,6 +1822,46 @@ static void render_att_init(struct lvp_render_attachment* att,
    }
 }
 
+/* The parts of a VkRenderingInfo which can be resolved without looking at
+ * the rendering state.
+ */
+struct lvp_render_setup {
+   uint32_t forced_sample_count;
+   VkResolveModeFlagBits forced_depth_resolve_mode;
+   VkResolveModeFlagBits forced_stencil_resolve_mode;
+   struct lvp_render_attachment depth_att;
+   struct lvp_render_attachment stencil_att;
+   uint32_t color_att_count;
+   struct lvp_render_attachment color_att[];
+};
+
+static struct lvp_render_setup *
+create_render_setup(const VkAllocationCallbacks *alloc,
+                    const VkRenderingInfo *info)
+{
+   struct lvp_render_setup *setup =
+      vk_zalloc(alloc, sizeof(*setup) +
+                info->colorAttachmentCount * sizeof(setup->color_att[0]), 8,
+                VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+   if (!setup)
+      return NULL;
+
+   const VkMultisampledRenderToSingleSampledInfoEXT *ssi =
+         vk_find_struct_const(info->pNext, MULTISAMPLED_RENDER_TO_SINGLE_SAMPLED_INFO_EXT);
+   if (ssi && ssi->multisampledRenderToSingleSampledEnable) {
+      setup->forced_sample_count = ssi->rasterizationSamples;
+      setup->forced_depth_resolve_mode = info->pDepthAttachment ? info->pDepthAttachment->resolveMode : 0;
+      setup->forced_stencil_resolve_mode = info->pStencilAttachment ? info->pStencilAttachment->resolveMode : 0;
+   }
+
+   setup->color_att_count = info->colorAttachmentCount;
+   for (unsigned i = 0; i < info->colorAttachmentCount; i++)
+      render_att_init(&setup->color_att[i], &info->pColorAttachments[i]);
+   render_att_init(&setup->depth_att, info->pDepthAttachment);
+   render_att_init(&setup->stencil_att, info->pStencilAttachment);
+   return setup;
+}
+
 static void handle_begin_rendering(struct vk_cmd_queue_entry *cmd,
                                    struct rendering_state *state)
 {
@@ -1747,18 +1869,17 @@ static void handle_begin_rendering(struct vk_cmd_queue_entry *cmd,
    bool resuming = (info->flags & VK_RENDERING_RESUMING_BIT) == VK_RENDERING_RESUMING_BIT;
    bool suspending = (info->flags & VK_RENDERING_SUSPENDING_BIT) == VK_RENDERING_SUSPENDING_BIT;
 
-   const VkMultisampledRenderToSingleSampledInfoEXT *ssi =
-         vk_find_struct_const(info->pNext, MULTISAMPLED_RENDER_TO_SINGLE_SAMPLED_INFO_EXT);
-   if (ssi && ssi->multisampledRenderToSingleSampledEnable) {
-      state->forced_sample_count = ssi->rasterizationSamples;
-      state->forced_depth_resolve_mode = info->pDepthAttachment ? info->pDepthAttachment->resolveMode : 0;
-      state->forced_stencil_resolve_mode = info->pStencilAttachment ? info->pStencilAttachment->resolveMode : 0;
-   } else {
-      state->forced_sample_count = 0;
-      state->forced_depth_resolve_mode = 0;
-      state->forced_stencil_resolve_mode = 0;
+   struct lvp_render_setup *setup = cmd->driver_data;
+   if (!setup) {
+      setup = create_render_setup(vk_default_allocator(), info);
+      if (!setup)
+         return;
    }
 
+   state->forced_sample_count = setup->forced_sample_count;
+   state->forced_depth_resolve_mode = setup->forced_depth_resolve_mode;
+   state->forced_stencil_resolve_mode = setup->forced_stencil_resolve_mode;
+
    state->info.view_mask = info->viewMask;
    state->render_area = info->renderArea;
    state->suspending = suspending;
@@ -1771,8 +1892,9 @@ static void handle_begin_rendering(struct vk_cmd_queue_entry *cmd,
 
    state->color_att_count = info->colorAttachmentCount;
    state->color_att = realloc(state->color_att, sizeof(*state->color_att) * state->color_att_count);
+   memcpy(state->color_att, setup->color_att,
+          sizeof(*state->color_att) * state->color_att_count);
    for (unsigned i = 0; i < info->colorAttachmentCount; i++) {
-      render_att_init(&state->color_att[i], &info->pColorAttachments[i]);
       if (state->color_att[i].imgv) {
          struct lvp_image_view *imgv = state->color_att[i].imgv;
          add_img_view_surface(state, imgv,
@@ -1786,8 +1908,11 @@ static void handle_begin_rendering(struct vk_cmd_queue_entry *cmd,
       }
    }
 
-   render_att_init(&state->depth_att, info->pDepthAttachment);
-   render_att_init(&state->stencil_att, info->pStencilAttachment);
+   state->depth_att = setup->depth_att;
+   state->stencil_att = setup->stencil_att;
+   if (setup != cmd->driver_data)
+      vk_free(vk_default_allocator(), setup);
+
    if (state->depth_att.imgv || state->stencil_att.imgv) {
       assert(state->depth_att.imgv == NULL ||
              state->stencil_att.imgv == NULL ||
@@ -1848,11 +1973,33 @@ static void handle_draw(struct vk_cmd_queue_entry *cmd,
    state->pctx->draw_vbo(state->pctx, &state->info, 0, NULL, &draw, 1);
 }
 
+static struct pipe_draw_start_count_bias *
+create_multi_draws(const VkAllocationCallbacks *alloc,
+                   const struct vk_cmd_draw_multi_ext *cmd)
+{
+   struct pipe_draw_start_count_bias *draws =
+      vk_zalloc(alloc, cmd->draw_count * sizeof(*draws), 8,
+                VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+   if (!draws)
+      return NULL;
+
+   for(unsigned i = 0; i < cmd->draw_count; i++) {
+      draws[i].start = cmd->vertex_info[i].firstVertex;
+      draws[i].count = cmd->vertex_info[i].vertexCount;
+      draws[i].index_bias = 0;
+   }
+   return draws;
+}
+
 static void handle_draw_multi(struct vk_cmd_queue_entry *cmd,
                               struct rendering_state *state)
 {
-   struct pipe_draw_start_count_bias *draws = calloc(cmd->u.draw_multi_ext.draw_count,
-                                                     sizeof(*draws));
+   struct pipe_draw_start_count_bias *draws = cmd->driver_data;
+   if (!draws && cmd->u.draw_multi_ext.draw_count) {
+      draws = create_multi_draws(vk_default_allocator(), &cmd->u.draw_multi_ext);
+      if (!draws)
+         return;
+   }
 
    state->info.index_size = 0;
    state->info.index.resource = NULL;
@@ -1861,18 +2008,13 @@ static void handle_draw_multi(struct vk_cmd_queue_entry *cmd,
    if (cmd->u.draw_multi_ext.draw_count > 1)
       state->info.increment_draw_id = true;
 
-   for(unsigned i = 0; i < cmd->u.draw_multi_ext.draw_count; i++) {
-      draws[i].start = cmd->u.draw_multi_ext.vertex_info[i].firstVertex;
-      draws[i].count = cmd->u.draw_multi_ext.vertex_info[i].vertexCount;
-      draws[i].index_bias = 0;
-   }
-
    state->pctx->set_patch_vertices(state->pctx, state->patch_vertices);
 
-   if (cmd->u.draw_multi_indexed_ext.draw_count)
+   if (cmd->u.draw_multi_ext.draw_count)
       state->pctx->draw_vbo(state->pctx, &state->info, 0, NULL, draws, cmd->u.draw_multi_ext.draw_count);
 
-   free(draws);
+   if (draws != cmd->driver_data)
+      vk_free(vk_default_allocator(), draws);
 }
 
 static void set_viewport(unsigned first_viewport, unsigned viewport_count,
@@ -3077,7 +3219,7 @@ static void handle_compute_push_descriptor_set(struct lvp_cmd_push_descriptor_se
 }
 
 static struct lvp_cmd_push_descriptor_set *
-create_push_descriptor_set(struct rendering_state *state, struct vk_cmd_push_descriptor_set_khr *in_cmd)
+create_push_descriptor_set(const VkAllocationCallbacks *alloc, struct vk_cmd_push_descriptor_set_khr *in_cmd)
 {
    LVP_FROM_HANDLE(lvp_pipeline_layout, layout, in_cmd->layout);
    struct lvp_cmd_push_descriptor_set *out_cmd;
@@ -3087,17 +3229,16 @@ create_push_descriptor_set(struct rendering_state *state, struct vk_cmd_push_des
       count_descriptors += in_cmd->descriptor_writes[i].descriptorCount;
    }
 
-   void *descriptors;
-   void *infos;
-   void **ptrs[] = {&descriptors, &infos};
-   size_t sizes[] = {
-      in_cmd->descriptor_write_count * sizeof(struct lvp_write_descriptor),
-      count_descriptors * sizeof(union lvp_descriptor_info),
-   };
-   out_cmd = ptrzalloc(sizeof(struct lvp_cmd_push_descriptor_set), 2, sizes, ptrs);
+   size_t descriptors_size = in_cmd->descriptor_write_count * sizeof(struct lvp_write_descriptor);
+   size_t infos_size = count_descriptors * sizeof(union lvp_descriptor_info);
+   out_cmd = vk_zalloc(alloc, sizeof(*out_cmd) + descriptors_size + infos_size, 8,
+                       VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
    if (!out_cmd)
       return NULL;
 
+   void *descriptors = out_cmd + 1;
+   void *infos = (uint8_t *)descriptors + descriptors_size;
+
    out_cmd->bind_point = in_cmd->pipeline_bind_point;
    out_cmd->layout = layout;
    out_cmd->set = in_cmd->set;
@@ -3188,10 +3329,9 @@ create_push_descriptor_set(struct rendering_state *state, struct vk_cmd_push_des
    return out_cmd;
 }
 
-static void handle_push_descriptor_set_generic(struct vk_cmd_push_descriptor_set_khr *_pds,
+static void handle_push_descriptor_set_generic(struct lvp_cmd_push_descriptor_set *pds,
                                                struct rendering_state *state)
 {
-   struct lvp_cmd_push_descriptor_set *pds = create_push_descriptor_set(state, _pds);
    const struct lvp_descriptor_set_layout *layout =
       vk_to_lvp_descriptor_set_layout(pds->layout->vk.set_layouts[pds->set]);
 
@@ -3246,19 +3386,29 @@ static void handle_push_descriptor_set_generic(struct vk_cmd_push_descriptor_set
       }
       info_idx += desc->descriptor_count;
    }
-   free(pds);
 }
 
 static void handle_push_descriptor_set(struct vk_cmd_queue_entry *cmd,
                                        struct rendering_state *state)
 {
-   handle_push_descriptor_set_generic(&cmd->u.push_descriptor_set_khr, state);
+   if (cmd->driver_data) {
+      handle_push_descriptor_set_generic(cmd->driver_data, state);
+      return;
+   }
+
+   struct lvp_cmd_push_descriptor_set *pds =
+      create_push_descriptor_set(vk_default_allocator(), &cmd->u.push_descriptor_set_khr);
+   if (!pds)
+      return;
+   handle_push_descriptor_set_generic(pds, state);
+   vk_free(vk_default_allocator(), pds);
 }
 
-static void handle_push_descriptor_set_with_template(struct vk_cmd_queue_entry *cmd,
-                                                     struct rendering_state *state)
+static struct lvp_cmd_push_descriptor_set *
+create_push_descriptor_set_with_template(const VkAllocationCallbacks *alloc,
+                                         struct vk_cmd_push_descriptor_set_with_template_khr *in_cmd)
 {
-   LVP_FROM_HANDLE(lvp_descriptor_update_template, templ, cmd->u.push_descriptor_set_with_template_khr.descriptor_update_template);
+   LVP_FROM_HANDLE(lvp_descriptor_update_template, templ, in_cmd->descriptor_update_template);
    struct vk_cmd_push_descriptor_set_khr *pds;
    int pds_size = sizeof(*pds);
 
@@ -3290,7 +3440,7 @@ static void handle_push_descriptor_set_with_template(struct vk_cmd_queue_entry *
 
    pds = calloc(1, pds_size);
    if (!pds)
-      return;
+      return NULL;
 
    pds->pipeline_bind_point = templ->bind_point;
    pds->layout = lvp_pipeline_layout_to_handle(templ->pipeline_layout);
@@ -3299,7 +3449,7 @@ static void handle_push_descriptor_set_with_template(struct vk_cmd_queue_entry *
    pds->descriptor_writes = (struct VkWriteDescriptorSet *)(pds + 1);
    const uint8_t *next_info = (const uint8_t *) (pds->descriptor_writes + templ->entry_count);
 
-   const uint8_t *pSrc = cmd->u.push_descriptor_set_with_template_khr.data;
+   const uint8_t *pSrc = in_cmd->data;
    for (unsigned i = 0; i < templ->entry_count; i++) {
       struct VkWriteDescriptorSet *desc = &pds->descriptor_writes[i];
       struct VkDescriptorUpdateTemplateEntry *entry = &templ->entry[i];
@@ -3342,8 +3492,113 @@ static void handle_push_descriptor_set_with_template(struct vk_cmd_queue_entry *
          }
       }
    }
-   handle_push_descriptor_set_generic(pds, state);
+   struct lvp_cmd_push_descriptor_set *out_cmd = create_push_descriptor_set(alloc, pds);
    free(pds);
+   return out_cmd;
+}
+
+static void handle_push_descriptor_set_with_template(struct vk_cmd_queue_entry *cmd,
+                                                     struct rendering_state *state)
+{
+   if (cmd->driver_data) {
+      handle_push_descriptor_set_generic(cmd->driver_data, state);
+      return;
+   }
+
+   struct lvp_cmd_push_descriptor_set *pds =
+      create_push_descriptor_set_with_template(vk_default_allocator(),
+                                               &cmd->u.push_descriptor_set_with_template_khr);
+   if (!pds)
+      return;
+   handle_push_descriptor_set_generic(pds, state);
+   vk_free(vk_default_allocator(), pds);
+}
+
+/* Dynamic state commands which replace everything they set, so that of a
+ * run of them with nothing else in between only the last of each type has
+ * any effect.
+ */
+static bool
+is_overriding_dynamic_state(enum vk_cmd_type type)
+{
+   switch (type) {
+   case VK_CMD_SET_LINE_WIDTH:
+   case VK_CMD_SET_DEPTH_BIAS:
+   case VK_CMD_SET_BLEND_CONSTANTS:
+   case VK_CMD_SET_DEPTH_BOUNDS:
+   case VK_CMD_SET_CULL_MODE:
+   case VK_CMD_SET_FRONT_FACE:
+   case VK_CMD_SET_PRIMITIVE_TOPOLOGY:
+   case VK_CMD_SET_DEPTH_TEST_ENABLE:
+   case VK_CMD_SET_DEPTH_WRITE_ENABLE:
+   case VK_CMD_SET_DEPTH_COMPARE_OP:
+   case VK_CMD_SET_DEPTH_BOUNDS_TEST_ENABLE:
+   case VK_CMD_SET_STENCIL_TEST_ENABLE:
+   case VK_CMD_SET_LINE_STIPPLE_EXT:
+   case VK_CMD_SET_DEPTH_BIAS_ENABLE:
+   case VK_CMD_SET_LOGIC_OP_EXT:
+   case VK_CMD_SET_PATCH_CONTROL_POINTS_EXT:
+   case VK_CMD_SET_PRIMITIVE_RESTART_ENABLE:
+   case VK_CMD_SET_RASTERIZER_DISCARD_ENABLE:
+      return true;
+   default:
+      return false;
+   }
+}
+
+/* Resolve the parts of a command buffer which don't depend on the state it
+ * executes with, so that command buffers which get submitted many times
+ * only pay for that once.  The results hang off the commands' driver_data
+ * and are freed along with the commands when the command buffer is reset.
+ *
+ * Dynamic state commands that are overridden by a later one of the same
+ * type before anything else is recorded are dropped from the list.  They
+ * own no driver_data and their storage goes away with the queue's blocks.
+ */
+void
+lvp_prepare_cmds(struct lvp_cmd_buffer *cmd_buffer)
+{
+   const VkAllocationCallbacks *alloc = cmd_buffer->vk.cmd_queue.alloc;
+   /* at most one of each overriding type is pending at a time */
+   struct vk_cmd_queue_entry *pending[32];
+   unsigned num_pending = 0;
+
+   list_for_each_entry_safe(struct vk_cmd_queue_entry, cmd, &cmd_buffer->vk.cmd_queue.cmds, cmd_link) {
+      if (is_overriding_dynamic_state(cmd->type)) {
+         unsigned i;
+         for (i = 0; i < num_pending; i++) {
+            if (pending[i]->type == cmd->type) {
+               list_del(&pending[i]->cmd_link);
+               break;
+            }
+         }
+         if (i == num_pending) {
+            assert(num_pending < ARRAY_SIZE(pending));
+            num_pending++;
+         }
+         pending[i] = cmd;
+         continue;
+      }
+      num_pending = 0;
+
+      switch (cmd->type) {
+      case VK_CMD_BEGIN_RENDERING:
+         cmd->driver_data = create_render_setup(alloc, cmd->u.begin_rendering.rendering_info);
+         break;
+      case VK_CMD_PUSH_DESCRIPTOR_SET_KHR:
+         cmd->driver_data = create_push_descriptor_set(alloc, &cmd->u.push_descriptor_set_khr);
+         break;
+      case VK_CMD_PUSH_DESCRIPTOR_SET_WITH_TEMPLATE_KHR:
+         cmd->driver_data = create_push_descriptor_set_with_template(alloc, &cmd->u.push_descriptor_set_with_template_khr);
+         break;
+      case VK_CMD_DRAW_MULTI_EXT:
+         if (cmd->u.draw_multi_ext.draw_count)
+            cmd->driver_data = create_multi_draws(alloc, &cmd->u.draw_multi_ext);
+         break;
+      default:
+         break;
+      }
+   }
 }
 
 static void handle_bind_transform_feedback_buffers(struct vk_cmd_queue_entry *cmd,
@@ -4004,6 +4259,7 @@ VkResult lvp_execute_cmds(struct lvp_device *device,
    state->pctx = queue->ctx;
    state->uploader = queue->uploader;
    state->cso = queue->cso;
+   state->queue_index = queue->vk.index_in_family;
    state->blend_dirty = true;
    state->dsa_dirty = true;
    state->rs_dirty = true;
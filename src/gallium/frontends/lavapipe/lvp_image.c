@@ -277,7 +277,7 @@ lvp_CreateImageView(VkDevice _device,
    view->image = image;
    view->surface = NULL;
    view->iv = lvp_create_imageview(view);
-   view->sv = lvp_create_samplerview(device->queue.ctx, view);
+   view->sv = lvp_create_samplerview(device->queues[0].ctx, view);
    *pView = lvp_image_view_to_handle(view);
 
    return VK_SUCCESS;
@@ -515,7 +515,7 @@ lvp_CreateBufferView(VkDevice _device,
       view->range = view->buffer->size - view->offset;
    else
       view->range = pCreateInfo->range;
-   view->sv = lvp_create_samplerview_buffer(device->queue.ctx, view);
+   view->sv = lvp_create_samplerview_buffer(device->queues[0].ctx, view);
    view->iv = lvp_create_imageview_buffer(view);
    *pView = lvp_buffer_view_to_handle(view);
 
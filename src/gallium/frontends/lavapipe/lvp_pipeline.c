@@ -26,6 +26,7 @@
 #include "vk_render_pass.h"
 #include "vk_util.h"
 #include "glsl_types.h"
+#include "util/mesa-sha1.h"
 #include "util/os_time.h"
 #include "spirv/nir_spirv.h"
 #include "nir/nir_builder.h"
@@ -44,21 +45,108 @@
       dst = temp;                                                \
    } while(0)
 
+static void
+destroy_shader_csos(struct pipe_context *ctx, void **shader_cso)
+{
+   if (shader_cso[PIPE_SHADER_VERTEX])
+      ctx->delete_vs_state(ctx, shader_cso[PIPE_SHADER_VERTEX]);
+   if (shader_cso[PIPE_SHADER_FRAGMENT])
+      ctx->delete_fs_state(ctx, shader_cso[PIPE_SHADER_FRAGMENT]);
+   if (shader_cso[PIPE_SHADER_GEOMETRY])
+      ctx->delete_gs_state(ctx, shader_cso[PIPE_SHADER_GEOMETRY]);
+   if (shader_cso[PIPE_SHADER_TESS_CTRL])
+      ctx->delete_tcs_state(ctx, shader_cso[PIPE_SHADER_TESS_CTRL]);
+   if (shader_cso[PIPE_SHADER_TESS_EVAL])
+      ctx->delete_tes_state(ctx, shader_cso[PIPE_SHADER_TESS_EVAL]);
+   if (shader_cso[PIPE_SHADER_COMPUTE])
+      ctx->delete_compute_state(ctx, shader_cso[PIPE_SHADER_COMPUTE]);
+   memset(shader_cso, 0, sizeof(void *) * PIPE_SHADER_TYPES);
+}
+
+static void
+delete_shader_cso(struct pipe_context *ctx, gl_shader_stage stage, void *cso)
+{
+   switch (stage) {
+   case MESA_SHADER_VERTEX:
+      ctx->delete_vs_state(ctx, cso);
+      break;
+   case MESA_SHADER_FRAGMENT:
+      ctx->delete_fs_state(ctx, cso);
+      break;
+   case MESA_SHADER_GEOMETRY:
+      ctx->delete_gs_state(ctx, cso);
+      break;
+   case MESA_SHADER_TESS_CTRL:
+      ctx->delete_tcs_state(ctx, cso);
+      break;
+   case MESA_SHADER_TESS_EVAL:
+      ctx->delete_tes_state(ctx, cso);
+      break;
+   case MESA_SHADER_COMPUTE:
+      ctx->delete_compute_state(ctx, cso);
+      break;
+   default:
+      unreachable("invalid shader stage");
+   }
+}
+
+static void
+inline_variant_finish(struct pipe_context *ctx, struct lvp_inline_variant *variant)
+{
+   /* the background job may still be using the pipeline NIR */
+   util_queue_fence_wait(&variant->fence);
+   util_queue_fence_destroy(&variant->fence);
+   ralloc_free(variant->nir);
+   if (variant->cso)
+      delete_shader_cso(ctx, variant->stage, variant->cso);
+}
+
+static void
+destroy_inline_caches(struct pipe_context *ctx, struct lvp_inline_cache **caches)
+{
+   for (unsigned stage = 0; stage < MESA_SHADER_STAGES; stage++) {
+      struct lvp_inline_cache *cache = caches[stage];
+      if (!cache)
+         continue;
+      for (unsigned i = 0; i < cache->num_sets; i++)
+         inline_variant_finish(ctx, &cache->sets[i]);
+      free(cache);
+      caches[stage] = NULL;
+   }
+}
+
+static bool
+has_queue_shaders(const struct lvp_pipeline *pipeline, unsigned queue)
+{
+   for (unsigned i = 0; i < PIPE_SHADER_TYPES; i++) {
+      if (pipeline->shader_cso[queue][i])
+         return true;
+   }
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      if (pipeline->inline_cache[queue][i])
+         return true;
+   }
+   return false;
+}
+
+/* Called on the queue's submit thread.  Returns true when this was the last
+ * queue holding on to the pipeline and it can be freed.
+ */
+bool
+lvp_pipeline_destroy_queue_shaders(struct lvp_queue *queue, struct lvp_pipeline *pipeline)
+{
+   destroy_shader_csos(queue->ctx, pipeline->shader_cso[queue->vk.index_in_family]);
+   destroy_inline_caches(queue->ctx, pipeline->inline_cache[queue->vk.index_in_family]);
+   return p_atomic_dec_zero(&pipeline->destroy_refs);
+}
+
 void
 lvp_pipeline_destroy(struct lvp_device *device, struct lvp_pipeline *pipeline)
 {
-   if (pipeline->shader_cso[PIPE_SHADER_VERTEX])
-      device->queue.ctx->delete_vs_state(device->queue.ctx, pipeline->shader_cso[PIPE_SHADER_VERTEX]);
-   if (pipeline->shader_cso[PIPE_SHADER_FRAGMENT])
-      device->queue.ctx->delete_fs_state(device->queue.ctx, pipeline->shader_cso[PIPE_SHADER_FRAGMENT]);
-   if (pipeline->shader_cso[PIPE_SHADER_GEOMETRY])
-      device->queue.ctx->delete_gs_state(device->queue.ctx, pipeline->shader_cso[PIPE_SHADER_GEOMETRY]);
-   if (pipeline->shader_cso[PIPE_SHADER_TESS_CTRL])
-      device->queue.ctx->delete_tcs_state(device->queue.ctx, pipeline->shader_cso[PIPE_SHADER_TESS_CTRL]);
-   if (pipeline->shader_cso[PIPE_SHADER_TESS_EVAL])
-      device->queue.ctx->delete_tes_state(device->queue.ctx, pipeline->shader_cso[PIPE_SHADER_TESS_EVAL]);
-   if (pipeline->shader_cso[PIPE_SHADER_COMPUTE])
-      device->queue.ctx->delete_compute_state(device->queue.ctx, pipeline->shader_cso[PIPE_SHADER_COMPUTE]);
+   for (unsigned q = 0; q < device->queue_count; q++) {
+      destroy_shader_csos(device->queues[q].ctx, pipeline->shader_cso[q]);
+      destroy_inline_caches(device->queues[q].ctx, pipeline->inline_cache[q]);
+   }
 
    for (unsigned i = 0; i < MESA_SHADER_STAGES; i++)
       ralloc_free(pipeline->pipeline_nir[i]);
@@ -83,9 +171,23 @@ VKAPI_ATTR void VKAPI_CALL lvp_DestroyPipeline(
    if (!_pipeline)
       return;
 
-   simple_mtx_lock(&device->queue.pipeline_lock);
-   util_dynarray_append(&device->queue.pipeline_destroys, struct lvp_pipeline*, pipeline);
-   simple_mtx_unlock(&device->queue.pipeline_lock);
+   /* Each queue deletes its own shader states on its submit thread and the
+    * last one frees the pipeline.  Queue 0 always takes part so there is
+    * somebody to do that even if no queue ever used the pipeline.
+    */
+   uint32_t queues = BITFIELD_BIT(0);
+   for (unsigned q = 1; q < device->queue_count; q++) {
+      if (has_queue_shaders(pipeline, q))
+         queues |= BITFIELD_BIT(q);
+   }
+   p_atomic_set(&pipeline->destroy_refs, util_bitcount(queues));
+
+   u_foreach_bit(q, queues) {
+      struct lvp_queue *queue = &device->queues[q];
+      simple_mtx_lock(&queue->pipeline_lock);
+      util_dynarray_append(&queue->pipeline_destroys, struct lvp_pipeline*, pipeline);
+      simple_mtx_unlock(&queue->pipeline_lock);
+   }
 }
 
 static void
@@ -355,13 +457,106 @@ lvp_shader_optimize(nir_shader *nir)
    nir_sweep(nir);
 }
 
+#define SHA1_UPDATE_VALUE(ctx, x) _mesa_sha1_update(ctx, &(x), sizeof(x))
+
+/* Hashed one field at a time, so that padding doesn't end up in the key. */
+static void
+hash_set_layout(struct mesa_sha1 *ctx,
+                const struct lvp_descriptor_set_layout *set_layout)
+{
+   SHA1_UPDATE_VALUE(ctx, set_layout->immutable_sampler_count);
+   SHA1_UPDATE_VALUE(ctx, set_layout->binding_count);
+   SHA1_UPDATE_VALUE(ctx, set_layout->size);
+   SHA1_UPDATE_VALUE(ctx, set_layout->shader_stages);
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      SHA1_UPDATE_VALUE(ctx, set_layout->stage[i].const_buffer_count);
+      SHA1_UPDATE_VALUE(ctx, set_layout->stage[i].shader_buffer_count);
+      SHA1_UPDATE_VALUE(ctx, set_layout->stage[i].sampler_count);
+      SHA1_UPDATE_VALUE(ctx, set_layout->stage[i].sampler_view_count);
+      SHA1_UPDATE_VALUE(ctx, set_layout->stage[i].image_count);
+      SHA1_UPDATE_VALUE(ctx, set_layout->stage[i].uniform_block_count);
+      SHA1_UPDATE_VALUE(ctx, set_layout->stage[i].uniform_block_size);
+      SHA1_UPDATE_VALUE(ctx, set_layout->stage[i].uniform_block_sizes);
+   }
+   SHA1_UPDATE_VALUE(ctx, set_layout->dynamic_offset_count);
+
+   for (unsigned b = 0; b < set_layout->binding_count; b++) {
+      const struct lvp_descriptor_set_binding_layout *binding =
+         &set_layout->binding[b];
+
+      SHA1_UPDATE_VALUE(ctx, binding->descriptor_index);
+      SHA1_UPDATE_VALUE(ctx, binding->type);
+      SHA1_UPDATE_VALUE(ctx, binding->array_size);
+      SHA1_UPDATE_VALUE(ctx, binding->valid);
+      SHA1_UPDATE_VALUE(ctx, binding->dynamic_index);
+      for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+         SHA1_UPDATE_VALUE(ctx, binding->stage[i].const_buffer_index);
+         SHA1_UPDATE_VALUE(ctx, binding->stage[i].shader_buffer_index);
+         SHA1_UPDATE_VALUE(ctx, binding->stage[i].sampler_index);
+         SHA1_UPDATE_VALUE(ctx, binding->stage[i].sampler_view_index);
+         SHA1_UPDATE_VALUE(ctx, binding->stage[i].image_index);
+         SHA1_UPDATE_VALUE(ctx, binding->stage[i].uniform_block_index);
+         SHA1_UPDATE_VALUE(ctx, binding->stage[i].uniform_block_offset);
+      }
+   }
+}
+
+static void
+hash_pipeline_layout(struct mesa_sha1 *ctx,
+                     const struct lvp_pipeline_layout *layout)
+{
+   if (!layout)
+      return;
+
+   /* everything lvp_lower_pipeline_layout() looks at */
+   for (unsigned s = 0; s < layout->vk.set_count; s++) {
+      bool has_set = layout->vk.set_layouts[s] != NULL;
+      SHA1_UPDATE_VALUE(ctx, has_set);
+      if (has_set)
+         hash_set_layout(ctx, get_set_layout(layout, s));
+   }
+   SHA1_UPDATE_VALUE(ctx, layout->push_constant_size);
+   SHA1_UPDATE_VALUE(ctx, layout->push_constant_stages);
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      SHA1_UPDATE_VALUE(ctx, layout->stage[i].uniform_block_size);
+      SHA1_UPDATE_VALUE(ctx, layout->stage[i].uniform_block_count);
+      SHA1_UPDATE_VALUE(ctx, layout->stage[i].uniform_block_sizes);
+   }
+}
+
+#undef SHA1_UPDATE_VALUE
+
+static void
+lvp_hash_shader(const struct lvp_pipeline *pipeline,
+                const VkPipelineShaderStageCreateInfo *sinfo,
+                unsigned char *sha1)
+{
+   unsigned char stage_sha1[SHA1_DIGEST_LENGTH];
+   struct mesa_sha1 ctx;
+
+   vk_pipeline_hash_shader_stage(sinfo, stage_sha1);
+
+   _mesa_sha1_init(&ctx);
+   _mesa_sha1_update(&ctx, stage_sha1, sizeof(stage_sha1));
+   hash_pipeline_layout(&ctx, pipeline->layout);
+   _mesa_sha1_final(&ctx, sha1);
+}
+
 static VkResult
 lvp_shader_compile_to_ir(struct lvp_pipeline *pipeline,
-                         const VkPipelineShaderStageCreateInfo *sinfo)
+                         struct vk_pipeline_cache *cache,
+                         const VkPipelineShaderStageCreateInfo *sinfo,
+                         bool *cache_hit)
 {
    struct lvp_device *pdevice = pipeline->device;
    gl_shader_stage stage = vk_to_mesa_shader_stage(sinfo->stage);
    assert(stage <= MESA_SHADER_COMPUTE && stage != MESA_SHADER_NONE);
+   unsigned char sha1[SHA1_DIGEST_LENGTH];
+
+   lvp_hash_shader(pipeline, sinfo, sha1);
+   if (lvp_pipeline_cache_load_shader(cache, sha1, pipeline, stage, cache_hit))
+      return VK_SUCCESS;
+
    const nir_shader_compiler_options *drv_options = pdevice->pscreen->get_compiler_options(pipeline->device->pscreen, PIPE_SHADER_IR_NIR, (enum pipe_shader_type)stage);
    VkResult result;
    nir_shader *nir;
@@ -506,6 +701,8 @@ lvp_shader_compile_to_ir(struct lvp_pipeline *pipeline,
       pipeline->inlines[stage].must_inline = lvp_find_inlinable_uniforms(pipeline, nir);
    pipeline->pipeline_nir[stage] = nir;
 
+   lvp_pipeline_cache_store_shader(cache, sha1, pipeline, nir);
+
    return VK_SUCCESS;
 }
 
@@ -589,15 +786,14 @@ lvp_pipeline_xfb_init(struct lvp_pipeline *pipeline)
 }
 
 void *
-lvp_pipeline_compile_stage(struct lvp_pipeline *pipeline, nir_shader *nir)
+lvp_pipeline_compile_stage(struct lvp_pipeline *pipeline, struct pipe_context *pctx, nir_shader *nir)
 {
-   struct lvp_device *device = pipeline->device;
    if (nir->info.stage == MESA_SHADER_COMPUTE) {
       struct pipe_compute_state shstate = {0};
       shstate.prog = nir;
       shstate.ir_type = PIPE_SHADER_IR_NIR;
       shstate.req_local_mem = nir->info.shared_size;
-      return device->queue.ctx->create_compute_state(device->queue.ctx, &shstate);
+      return pctx->create_compute_state(pctx, &shstate);
    } else {
       struct pipe_shader_state shstate = {0};
       shstate.type = PIPE_SHADER_IR_NIR;
@@ -607,15 +803,15 @@ lvp_pipeline_compile_stage(struct lvp_pipeline *pipeline, nir_shader *nir)
 
       switch (nir->info.stage) {
       case MESA_SHADER_FRAGMENT:
-         return device->queue.ctx->create_fs_state(device->queue.ctx, &shstate);
+         return pctx->create_fs_state(pctx, &shstate);
       case MESA_SHADER_VERTEX:
-         return device->queue.ctx->create_vs_state(device->queue.ctx, &shstate);
+         return pctx->create_vs_state(pctx, &shstate);
       case MESA_SHADER_GEOMETRY:
-         return device->queue.ctx->create_gs_state(device->queue.ctx, &shstate);
+         return pctx->create_gs_state(pctx, &shstate);
       case MESA_SHADER_TESS_CTRL:
-         return device->queue.ctx->create_tcs_state(device->queue.ctx, &shstate);
+         return pctx->create_tcs_state(pctx, &shstate);
       case MESA_SHADER_TESS_EVAL:
-         return device->queue.ctx->create_tes_state(device->queue.ctx, &shstate);
+         return pctx->create_tes_state(pctx, &shstate);
       default:
          unreachable("illegal shader");
          break;
@@ -625,11 +821,128 @@ lvp_pipeline_compile_stage(struct lvp_pipeline *pipeline, nir_shader *nir)
 }
 
 void *
-lvp_pipeline_compile(struct lvp_pipeline *pipeline, nir_shader *nir)
+lvp_pipeline_compile(struct lvp_pipeline *pipeline, struct pipe_context *pctx, nir_shader *nir)
 {
    struct lvp_device *device = pipeline->device;
    device->physical_device->pscreen->finalize_nir(device->physical_device->pscreen, nir);
-   return lvp_pipeline_compile_stage(pipeline, nir);
+   return lvp_pipeline_compile_stage(pipeline, pctx, nir);
+}
+
+static void
+inline_specialize_job(void *data, void *gdata, int thread_index)
+{
+   struct lvp_inline_variant *variant = data;
+   struct lvp_pipeline *pipeline = variant->pipeline;
+   struct pipe_screen *pscreen = pipeline->device->physical_device->pscreen;
+
+   nir_shader *nir = nir_shader_clone(NULL, pipeline->pipeline_nir[variant->stage]);
+   unsigned ssa_alloc = nir_shader_get_entrypoint(nir)->ssa_alloc;
+   NIR_PASS_V(nir, lvp_inline_uniforms, pipeline, variant->values, variant->slot);
+   lvp_shader_optimize(nir);
+   nir_function_impl *impl = nir_shader_get_entrypoint(nir);
+   if (ssa_alloc - impl->ssa_alloc < ssa_alloc / 2 &&
+       !pipeline->inlines[variant->stage].must_inline) {
+      /* not enough change; keep using the generic shader for these values */
+      ralloc_free(nir);
+      return;
+   }
+   pscreen->finalize_nir(pscreen, nir);
+   variant->nir = nir;
+}
+
+static struct lvp_inline_variant *
+inline_cache_lookup(struct lvp_inline_cache *cache, uint32_t slot,
+                    const uint32_t *values, unsigned count)
+{
+   for (unsigned i = 0; i < cache->num_sets; i++) {
+      struct lvp_inline_variant *variant = &cache->sets[i];
+      if (variant->slot == slot &&
+          !memcmp(variant->values, values, count * sizeof(uint32_t)))
+         return variant;
+   }
+
+   /* Track the new value set, replacing the least used one which has no
+    * shader yet when the table is full.
+    */
+   struct lvp_inline_variant *variant = NULL;
+   if (cache->num_sets < LVP_INLINE_TRACKED_SETS) {
+      variant = &cache->sets[cache->num_sets++];
+   } else {
+      for (unsigned i = 0; i < cache->num_sets; i++) {
+         struct lvp_inline_variant *v = &cache->sets[i];
+         if (v->specializing || v->cso)
+            continue;
+         if (!variant || v->hits < variant->hits)
+            variant = v;
+      }
+      if (!variant)
+         return NULL;
+      util_queue_fence_destroy(&variant->fence);
+   }
+
+   memset(variant, 0, sizeof(*variant));
+   variant->slot = slot;
+   memcpy(variant->values, values, count * sizeof(uint32_t));
+   util_queue_fence_init(&variant->fence);
+   return variant;
+}
+
+/* Called on the queue's submit thread.  Returns the shader state specialized
+ * for the given inlinable uniform values, or NULL if the generic one has to
+ * be used for now.  Value sets are specialized in the background once they
+ * are used often enough.
+ */
+void *
+lvp_inline_cache_get_cso(struct lvp_pipeline *pipeline, struct pipe_context *pctx, unsigned queue,
+                         gl_shader_stage stage, uint32_t slot, const uint32_t *values)
+{
+   struct lvp_device *device = pipeline->device;
+   const struct lvp_inline_info *inlines = &pipeline->inlines[stage];
+   struct lvp_inline_cache *cache = pipeline->inline_cache[queue][stage];
+
+   if (!cache) {
+      cache = calloc(1, sizeof(*cache));
+      if (!cache)
+         return NULL;
+      pipeline->inline_cache[queue][stage] = cache;
+   }
+
+   struct lvp_inline_variant *variant =
+      inline_cache_lookup(cache, slot, values, inlines->count[slot]);
+   if (!variant)
+      return NULL;
+   variant->hits++;
+
+   if (variant->specializing) {
+      if (!util_queue_fence_is_signalled(&variant->fence))
+         return NULL;
+      variant->specializing = false;
+      variant->done = true;
+      if (variant->nir) {
+         variant->cso = lvp_pipeline_compile_stage(pipeline, pctx, variant->nir);
+         variant->nir = NULL;
+         p_atomic_inc(&device->inline_counts.specialized);
+      } else {
+         cache->num_variants--;
+         p_atomic_inc(&device->inline_counts.rejected);
+      }
+   }
+
+   if (variant->cso) {
+      p_atomic_inc(&device->inline_counts.hits);
+      return variant->cso;
+   }
+
+   if (!variant->done && cache->num_variants < LVP_MAX_INLINE_VARIANTS &&
+       (variant->hits >= LVP_INLINE_HOT_THRESHOLD || inlines->must_inline)) {
+      variant->pipeline = pipeline;
+      variant->stage = stage;
+      variant->specializing = true;
+      cache->num_variants++;
+      util_queue_add_job(&device->inline_queue, variant, &variant->fence,
+                         inline_specialize_job, NULL, 0);
+   }
+   return NULL;
 }
 
 #ifndef NDEBUG
@@ -717,8 +1030,9 @@ merge_layouts(struct lvp_pipeline *dst, struct lvp_pipeline_layout *src)
 static VkResult
 lvp_graphics_pipeline_init(struct lvp_pipeline *pipeline,
                            struct lvp_device *device,
-                           struct lvp_pipeline_cache *cache,
-                           const VkGraphicsPipelineCreateInfo *pCreateInfo)
+                           struct vk_pipeline_cache *cache,
+                           const VkGraphicsPipelineCreateInfo *pCreateInfo,
+                           bool *cache_hit)
 {
    VkResult result;
 
@@ -794,6 +1108,7 @@ lvp_graphics_pipeline_init(struct lvp_pipeline *pipeline,
 
    pipeline->device = device;
 
+   *cache_hit = pCreateInfo->stageCount > 0;
    for (uint32_t i = 0; i < pCreateInfo->stageCount; i++) {
       const VkPipelineShaderStageCreateInfo *sinfo = &pCreateInfo->pStages[i];
       gl_shader_stage stage = vk_to_mesa_shader_stage(sinfo->stage);
@@ -804,9 +1119,11 @@ lvp_graphics_pipeline_init(struct lvp_pipeline *pipeline,
          if (!(pipeline->stages & VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT))
             continue;
       }
-      result = lvp_shader_compile_to_ir(pipeline, sinfo);
+      bool stage_hit;
+      result = lvp_shader_compile_to_ir(pipeline, cache, sinfo, &stage_hit);
       if (result != VK_SUCCESS)
          goto fail;
+      *cache_hit &= stage_hit;
 
       switch (stage) {
       case MESA_SHADER_GEOMETRY:
@@ -863,8 +1180,8 @@ lvp_graphics_pipeline_init(struct lvp_pipeline *pipeline,
          assert(stage == pipeline->pipeline_nir[i]->info.stage);
          enum pipe_shader_type pstage = pipe_shader_type_from_mesa(stage);
          if (!pipeline->inlines[stage].can_inline)
-            pipeline->shader_cso[pstage] = lvp_pipeline_compile(pipeline,
-                                                                nir_shader_clone(NULL, pipeline->pipeline_nir[stage]));
+            pipeline->shader_cso[0][pstage] = lvp_pipeline_compile(pipeline, device->queues[0].ctx,
+                                                                   nir_shader_clone(NULL, pipeline->pipeline_nir[stage]));
          if (stage == MESA_SHADER_FRAGMENT)
             has_fragment_shader = true;
       }
@@ -878,7 +1195,7 @@ lvp_graphics_pipeline_init(struct lvp_pipeline *pipeline,
          struct pipe_shader_state shstate = {0};
          shstate.type = PIPE_SHADER_IR_NIR;
          shstate.ir.nir = nir_shader_clone(NULL, pipeline->pipeline_nir[MESA_SHADER_FRAGMENT]);
-         pipeline->shader_cso[PIPE_SHADER_FRAGMENT] = device->queue.ctx->create_fs_state(device->queue.ctx, &shstate);
+         pipeline->shader_cso[0][PIPE_SHADER_FRAGMENT] = device->queues[0].ctx->create_fs_state(device->queues[0].ctx, &shstate);
       }
    }
    return VK_SUCCESS;
@@ -901,8 +1218,9 @@ lvp_graphics_pipeline_create(
    VkPipeline *pPipeline)
 {
    LVP_FROM_HANDLE(lvp_device, device, _device);
-   LVP_FROM_HANDLE(lvp_pipeline_cache, cache, _cache);
+   VK_FROM_HANDLE(vk_pipeline_cache, cache, _cache);
    struct lvp_pipeline *pipeline;
+   bool cache_hit = false;
    VkResult result;
 
    assert(pCreateInfo->sType == VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO);
@@ -915,7 +1233,9 @@ lvp_graphics_pipeline_create(
    vk_object_base_init(&device->vk, &pipeline->base,
                        VK_OBJECT_TYPE_PIPELINE);
    uint64_t t0 = os_time_get_nano();
-   result = lvp_graphics_pipeline_init(pipeline, device, cache, pCreateInfo);
+   result = lvp_graphics_pipeline_init(pipeline, device,
+                                       cache ? cache : device->pipeline_cache,
+                                       pCreateInfo, &cache_hit);
    if (result != VK_SUCCESS) {
       vk_free(&device->vk.alloc, pipeline);
       return result;
@@ -925,6 +1245,8 @@ lvp_graphics_pipeline_create(
    if (feedback) {
       feedback->pPipelineCreationFeedback->duration = os_time_get_nano() - t0;
       feedback->pPipelineCreationFeedback->flags = VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT;
+      if (cache_hit)
+         feedback->pPipelineCreationFeedback->flags |= VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT;
       memset(feedback->pPipelineStageCreationFeedbacks, 0, sizeof(VkPipelineCreationFeedback) * feedback->pipelineStageCreationFeedbackCount);
    }
 
@@ -933,6 +1255,26 @@ lvp_graphics_pipeline_create(
    return VK_SUCCESS;
 }
 
+struct lvp_create_pipelines_data {
+   VkPipelineCache cache;
+   const void *create_infos;
+};
+
+static VkResult
+lvp_create_graphics_pipeline_cb(struct vk_device *vk_device, void *_data,
+                                uint32_t index, VkPipeline *pipeline_out)
+{
+   struct lvp_create_pipelines_data *data = _data;
+   const VkGraphicsPipelineCreateInfo *info =
+      (const VkGraphicsPipelineCreateInfo *)data->create_infos + index;
+
+   if (info->flags & VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT)
+      return VK_PIPELINE_COMPILE_REQUIRED;
+
+   return lvp_graphics_pipeline_create(vk_device_to_handle(vk_device),
+                                       data->cache, info, pipeline_out);
+}
+
 VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateGraphicsPipelines(
    VkDevice                                    _device,
    VkPipelineCache                             pipelineCache,
@@ -941,36 +1283,24 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateGraphicsPipelines(
    const VkAllocationCallbacks*                pAllocator,
    VkPipeline*                                 pPipelines)
 {
-   VkResult result = VK_SUCCESS;
-   unsigned i = 0;
-
-   for (; i < count; i++) {
-      VkResult r = VK_PIPELINE_COMPILE_REQUIRED;
-      if (!(pCreateInfos[i].flags & VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT))
-         r = lvp_graphics_pipeline_create(_device,
-                                          pipelineCache,
-                                          &pCreateInfos[i],
-                                          &pPipelines[i]);
-      if (r != VK_SUCCESS) {
-         result = r;
-         pPipelines[i] = VK_NULL_HANDLE;
-         if (pCreateInfos[i].flags & VK_PIPELINE_CREATE_EARLY_RETURN_ON_FAILURE_BIT)
-            break;
-      }
-   }
-   if (result != VK_SUCCESS) {
-      for (; i < count; i++)
-         pPipelines[i] = VK_NULL_HANDLE;
-   }
+   LVP_FROM_HANDLE(lvp_device, device, _device);
+   struct lvp_create_pipelines_data data = {
+      .cache = pipelineCache,
+      .create_infos = pCreateInfos,
+   };
 
-   return result;
+   return vk_create_pipelines(&device->vk, count, pCreateInfos,
+                              sizeof(*pCreateInfos), pAllocator,
+                              lvp_create_graphics_pipeline_cb, &data,
+                              pPipelines);
 }
 
 static VkResult
 lvp_compute_pipeline_init(struct lvp_pipeline *pipeline,
                           struct lvp_device *device,
-                          struct lvp_pipeline_cache *cache,
-                          const VkComputePipelineCreateInfo *pCreateInfo)
+                          struct vk_pipeline_cache *cache,
+                          const VkComputePipelineCreateInfo *pCreateInfo,
+                          bool *cache_hit)
 {
    pipeline->device = device;
    pipeline->layout = lvp_pipeline_layout_from_handle(pCreateInfo->layout);
@@ -980,12 +1310,13 @@ lvp_compute_pipeline_init(struct lvp_pipeline *pipeline,
    pipeline->mem_ctx = ralloc_context(NULL);
    pipeline->is_compute_pipeline = true;
 
-   VkResult result = lvp_shader_compile_to_ir(pipeline, &pCreateInfo->stage);
+   VkResult result = lvp_shader_compile_to_ir(pipeline, cache, &pCreateInfo->stage,
+                                              cache_hit);
    if (result != VK_SUCCESS)
       return result;
 
    if (!pipeline->inlines[MESA_SHADER_COMPUTE].can_inline)
-      pipeline->shader_cso[PIPE_SHADER_COMPUTE] = lvp_pipeline_compile(pipeline, nir_shader_clone(NULL, pipeline->pipeline_nir[MESA_SHADER_COMPUTE]));
+      pipeline->shader_cso[0][PIPE_SHADER_COMPUTE] = lvp_pipeline_compile(pipeline, device->queues[0].ctx, nir_shader_clone(NULL, pipeline->pipeline_nir[MESA_SHADER_COMPUTE]));
    return VK_SUCCESS;
 }
 
@@ -997,8 +1328,9 @@ lvp_compute_pipeline_create(
    VkPipeline *pPipeline)
 {
    LVP_FROM_HANDLE(lvp_device, device, _device);
-   LVP_FROM_HANDLE(lvp_pipeline_cache, cache, _cache);
+   VK_FROM_HANDLE(vk_pipeline_cache, cache, _cache);
    struct lvp_pipeline *pipeline;
+   bool cache_hit = false;
    VkResult result;
 
    assert(pCreateInfo->sType == VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO);
@@ -1011,7 +1343,9 @@ lvp_compute_pipeline_create(
    vk_object_base_init(&device->vk, &pipeline->base,
                        VK_OBJECT_TYPE_PIPELINE);
    uint64_t t0 = os_time_get_nano();
-   result = lvp_compute_pipeline_init(pipeline, device, cache, pCreateInfo);
+   result = lvp_compute_pipeline_init(pipeline, device,
+                                      cache ? cache : device->pipeline_cache,
+                                      pCreateInfo, &cache_hit);
    if (result != VK_SUCCESS) {
       vk_free(&device->vk.alloc, pipeline);
       return result;
@@ -1021,6 +1355,8 @@ lvp_compute_pipeline_create(
    if (feedback) {
       feedback->pPipelineCreationFeedback->duration = os_time_get_nano() - t0;
       feedback->pPipelineCreationFeedback->flags = VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT;
+      if (cache_hit)
+         feedback->pPipelineCreationFeedback->flags |= VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT;
       memset(feedback->pPipelineStageCreationFeedbacks, 0, sizeof(VkPipelineCreationFeedback) * feedback->pipelineStageCreationFeedbackCount);
    }
 
@@ -1029,6 +1365,21 @@ lvp_compute_pipeline_create(
    return VK_SUCCESS;
 }
 
+static VkResult
+lvp_create_compute_pipeline_cb(struct vk_device *vk_device, void *_data,
+                               uint32_t index, VkPipeline *pipeline_out)
+{
+   struct lvp_create_pipelines_data *data = _data;
+   const VkComputePipelineCreateInfo *info =
+      (const VkComputePipelineCreateInfo *)data->create_infos + index;
+
+   if (info->flags & VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT)
+      return VK_PIPELINE_COMPILE_REQUIRED;
+
+   return lvp_compute_pipeline_create(vk_device_to_handle(vk_device),
+                                      data->cache, info, pipeline_out);
+}
+
 VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateComputePipelines(
    VkDevice                                    _device,
    VkPipelineCache                             pipelineCache,
@@ -1037,28 +1388,14 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateComputePipelines(
    const VkAllocationCallbacks*                pAllocator,
    VkPipeline*                                 pPipelines)
 {
-   VkResult result = VK_SUCCESS;
-   unsigned i = 0;
-
-   for (; i < count; i++) {
-      VkResult r = VK_PIPELINE_COMPILE_REQUIRED;
-      if (!(pCreateInfos[i].flags & VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT))
-         r = lvp_compute_pipeline_create(_device,
-                                         pipelineCache,
-                                         &pCreateInfos[i],
-                                         &pPipelines[i]);
-      if (r != VK_SUCCESS) {
-         result = r;
-         pPipelines[i] = VK_NULL_HANDLE;
-         if (pCreateInfos[i].flags & VK_PIPELINE_CREATE_EARLY_RETURN_ON_FAILURE_BIT)
-            break;
-      }
-   }
-   if (result != VK_SUCCESS) {
-      for (; i < count; i++)
-         pPipelines[i] = VK_NULL_HANDLE;
-   }
-
+   LVP_FROM_HANDLE(lvp_device, device, _device);
+   struct lvp_create_pipelines_data data = {
+      .cache = pipelineCache,
+      .create_infos = pCreateInfos,
+   };
 
-   return result;
+   return vk_create_pipelines(&device->vk, count, pCreateInfos,
+                              sizeof(*pCreateInfos), pAllocator,
+                              lvp_create_compute_pipeline_cb, &data,
+                              pPipelines);
 }
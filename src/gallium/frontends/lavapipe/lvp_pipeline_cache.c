@@ -23,80 +23,219 @@
 
 #include "lvp_private.h"
 
-VKAPI_ATTR VkResult VKAPI_CALL lvp_CreatePipelineCache(
-    VkDevice                                    _device,
-    const VkPipelineCacheCreateInfo*            pCreateInfo,
-    const VkAllocationCallbacks*                pAllocator,
-    VkPipelineCache*                            pPipelineCache)
+#include "util/blob.h"
+#include "util/u_atomic.h"
+#include "nir_serialize.h"
+
+/* Shaders are cached as the NIR lvp_shader_compile_to_ir() produces, after
+ * lowering to the pipeline layout, together with what the pipeline gathers
+ * while lowering it.  The llvmpipe variants compiled from that NIR are
+ * already cached by llvmpipe in its disk cache, keyed on the NIR.
+ */
+struct lvp_shader_cache_object {
+   struct vk_pipeline_cache_object base;
+   unsigned char sha1[SHA1_DIGEST_LENGTH];
+
+   struct lvp_access_info access;
+   struct lvp_inline_info inlines;
+
+   uint32_t nir_size;
+   uint8_t nir_data[0];
+};
+
+static const struct vk_pipeline_cache_object_ops lvp_shader_cache_object_ops;
+
+/* The device-internal cache backs pipelines created without a
+ * VkPipelineCache and lives as long as the device, so stop adding to it
+ * once it holds this much serialized NIR.
+ */
+#define LVP_DEVICE_CACHE_MAX_SIZE (64 * 1024 * 1024)
+
+static struct lvp_shader_cache_object *
+lvp_shader_cache_object_create(struct vk_device *device,
+                               const void *key_data, size_t key_size,
+                               const struct lvp_access_info *access,
+                               const struct lvp_inline_info *inlines,
+                               const void *nir_data, size_t nir_size)
 {
-   LVP_FROM_HANDLE(lvp_device, device, _device);
-   struct lvp_pipeline_cache *cache;
+   struct lvp_shader_cache_object *shader;
 
-   assert(pCreateInfo->sType == VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO);
+   assert(key_size == SHA1_DIGEST_LENGTH);
 
-   cache = vk_alloc2(&device->vk.alloc, pAllocator,
-                       sizeof(*cache), 8,
-                       VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
-   if (cache == NULL)
-      return vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
+   shader = vk_zalloc(&device->alloc, sizeof(*shader) + nir_size, 8,
+                      VK_SYSTEM_ALLOCATION_SCOPE_DEVICE);
+   if (shader == NULL)
+      return NULL;
 
-   vk_object_base_init(&device->vk, &cache->base,
-                       VK_OBJECT_TYPE_PIPELINE_CACHE);
-   if (pAllocator)
-     cache->alloc = *pAllocator;
-   else
-     cache->alloc = device->vk.alloc;
+   memcpy(shader->sha1, key_data, SHA1_DIGEST_LENGTH);
+   vk_pipeline_cache_object_init(device, &shader->base,
+                                 &lvp_shader_cache_object_ops,
+                                 shader->sha1, SHA1_DIGEST_LENGTH);
+   shader->access = *access;
+   shader->inlines = *inlines;
+   shader->nir_size = nir_size;
+   memcpy(shader->nir_data, nir_data, nir_size);
 
-   cache->device = device;
-   *pPipelineCache = lvp_pipeline_cache_to_handle(cache);
+   return shader;
+}
 
-   return VK_SUCCESS;
+static bool
+lvp_shader_cache_object_serialize(struct vk_pipeline_cache_object *object,
+                                  struct blob *blob)
+{
+   struct lvp_shader_cache_object *shader =
+      container_of(object, struct lvp_shader_cache_object, base);
+
+   /* one field at a time, so that no padding is written */
+   blob_write_uint64(blob, shader->access.images_read);
+   blob_write_uint64(blob, shader->access.images_written);
+   blob_write_uint64(blob, shader->access.buffers_written);
+   blob_write_bytes(blob, shader->inlines.uniform_offsets,
+                    sizeof(shader->inlines.uniform_offsets));
+   blob_write_bytes(blob, shader->inlines.count,
+                    sizeof(shader->inlines.count));
+   blob_write_uint8(blob, shader->inlines.must_inline);
+   blob_write_uint32(blob, shader->inlines.can_inline);
+   blob_write_uint32(blob, shader->nir_size);
+   blob_write_bytes(blob, shader->nir_data, shader->nir_size);
+
+   return !blob->out_of_memory;
 }
 
-VKAPI_ATTR void VKAPI_CALL lvp_DestroyPipelineCache(
-    VkDevice                                    _device,
-    VkPipelineCache                             _cache,
-    const VkAllocationCallbacks*                pAllocator)
+static struct vk_pipeline_cache_object *
+lvp_shader_cache_object_deserialize(struct vk_device *device,
+                                    const void *key_data, size_t key_size,
+                                    struct blob_reader *blob)
 {
-   LVP_FROM_HANDLE(lvp_device, device, _device);
-   LVP_FROM_HANDLE(lvp_pipeline_cache, cache, _cache);
+   struct lvp_access_info access;
+   struct lvp_inline_info inlines = {0};
 
-   if (!_cache)
-      return;
-//   lvp_pipeline_cache_finish(cache);
-   vk_object_base_finish(&cache->base);
-   vk_free2(&device->vk.alloc, pAllocator, cache);
+   access.images_read = blob_read_uint64(blob);
+   access.images_written = blob_read_uint64(blob);
+   access.buffers_written = blob_read_uint64(blob);
+   blob_copy_bytes(blob, inlines.uniform_offsets,
+                   sizeof(inlines.uniform_offsets));
+   blob_copy_bytes(blob, inlines.count, sizeof(inlines.count));
+   inlines.must_inline = blob_read_uint8(blob);
+   inlines.can_inline = blob_read_uint32(blob);
+   uint32_t nir_size = blob_read_uint32(blob);
+   const void *nir_data = blob_read_bytes(blob, nir_size);
+
+   if (blob->overrun || key_size != SHA1_DIGEST_LENGTH)
+      return NULL;
+
+   struct lvp_shader_cache_object *shader =
+      lvp_shader_cache_object_create(device, key_data, key_size,
+                                     &access, &inlines, nir_data, nir_size);
+
+   return shader ? &shader->base : NULL;
 }
 
-VKAPI_ATTR VkResult VKAPI_CALL lvp_GetPipelineCacheData(
-        VkDevice                                    _device,
-        VkPipelineCache                             _cache,
-        size_t*                                     pDataSize,
-        void*                                       pData)
+static void
+lvp_shader_cache_object_destroy(struct vk_pipeline_cache_object *object)
 {
-   VkResult result = VK_SUCCESS;
-   if (pData) {
-      if (*pDataSize < 32) {
-         *pDataSize = 0;
-         result = VK_INCOMPLETE;
-      } else {
-         uint32_t *hdr = (uint32_t *)pData;
-         hdr[0] = 32;
-         hdr[1] = 1;
-         hdr[2] = VK_VENDOR_ID_MESA;
-         hdr[3] = 0;
-         lvp_device_get_cache_uuid(&hdr[4]);
-      }
-   } else
-      *pDataSize = 32;
-   return result;
+   struct lvp_shader_cache_object *shader =
+      container_of(object, struct lvp_shader_cache_object, base);
+
+   vk_pipeline_cache_object_finish(&shader->base);
+   vk_free(&object->device->alloc, shader);
 }
 
-VKAPI_ATTR VkResult VKAPI_CALL lvp_MergePipelineCaches(
-        VkDevice                                    _device,
-        VkPipelineCache                             destCache,
-        uint32_t                                    srcCacheCount,
-        const VkPipelineCache*                      pSrcCaches)
+static const struct vk_pipeline_cache_object_ops lvp_shader_cache_object_ops = {
+   .serialize = lvp_shader_cache_object_serialize,
+   .deserialize = lvp_shader_cache_object_deserialize,
+   .destroy = lvp_shader_cache_object_destroy,
+};
+
+/**
+ * Look up the shader for one stage of a pipeline by the hash of everything
+ * that went into it.  On success, the stage's NIR, access and inlining
+ * information are filled in as lvp_shader_compile_to_ir() would.
+ */
+bool
+lvp_pipeline_cache_load_shader(struct vk_pipeline_cache *cache,
+                               const unsigned char *sha1,
+                               struct lvp_pipeline *pipeline,
+                               gl_shader_stage stage, bool *cache_hit)
 {
-   return VK_SUCCESS;
+   struct lvp_device *device = pipeline->device;
+   struct vk_pipeline_cache_object *object;
+   struct blob_reader blob;
+
+   *cache_hit = false;
+   if (!cache)
+      return false;
+
+   object = vk_pipeline_cache_lookup_object(cache, sha1, SHA1_DIGEST_LENGTH,
+                                            &lvp_shader_cache_object_ops,
+                                            cache_hit);
+   if (!object)
+      return false;
+
+   struct lvp_shader_cache_object *shader =
+      container_of(object, struct lvp_shader_cache_object, base);
+   const nir_shader_compiler_options *options =
+      device->pscreen->get_compiler_options(device->pscreen, PIPE_SHADER_IR_NIR,
+                                            (enum pipe_shader_type)stage);
+
+   blob_reader_init(&blob, shader->nir_data, shader->nir_size);
+   nir_shader *nir = nir_deserialize(NULL, options, &blob);
+   if (blob.overrun || nir->info.stage != stage) {
+      ralloc_free(nir);
+      vk_pipeline_cache_object_unref(object);
+      *cache_hit = false;
+      return false;
+   }
+
+   pipeline->access[stage] = shader->access;
+   pipeline->inlines[stage] = shader->inlines;
+   pipeline->pipeline_nir[stage] = nir;
+
+   vk_pipeline_cache_object_unref(object);
+   return true;
+}
+
+void
+lvp_pipeline_cache_store_shader(struct vk_pipeline_cache *cache,
+                                const unsigned char *sha1,
+                                const struct lvp_pipeline *pipeline,
+                                const nir_shader *nir)
+{
+   struct lvp_device *device = pipeline->device;
+   gl_shader_stage stage = nir->info.stage;
+   struct blob blob;
+
+   if (!cache)
+      return;
+
+   blob_init(&blob);
+   nir_serialize(&blob, nir, false);
+   if (blob.out_of_memory) {
+      blob_finish(&blob);
+      return;
+   }
+
+   bool device_cache = cache == device->pipeline_cache;
+   if (device_cache &&
+       p_atomic_read(&device->pipeline_cache_size) + blob.size >
+       LVP_DEVICE_CACHE_MAX_SIZE) {
+      blob_finish(&blob);
+      return;
+   }
+   size_t nir_size = blob.size;
+
+   struct lvp_shader_cache_object *shader =
+      lvp_shader_cache_object_create(&device->vk, sha1, SHA1_DIGEST_LENGTH,
+                                     &pipeline->access[stage],
+                                     &pipeline->inlines[stage],
+                                     blob.data, blob.size);
+   blob_finish(&blob);
+   if (!shader)
+      return;
+
+   struct vk_pipeline_cache_object *cached =
+      vk_pipeline_cache_add_object(cache, &shader->base);
+   if (device_cache && cached == &shader->base)
+      p_atomic_add(&device->pipeline_cache_size, nir_size);
+   vk_pipeline_cache_object_unref(cached);
 }
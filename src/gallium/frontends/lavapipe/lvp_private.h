@@ -69,6 +69,7 @@ typedef uint32_t xcb_window_t;
 #include "vk_command_pool.h"
 #include "vk_descriptor_set_layout.h"
 #include "vk_graphics_state.h"
+#include "vk_pipeline_cache.h"
 #include "vk_pipeline_layout.h"
 #include "vk_queue.h"
 #include "vk_sync.h"
@@ -86,6 +87,8 @@ extern "C" {
 #define MAX_PUSH_DESCRIPTORS 32
 #define MAX_DESCRIPTOR_UNIFORM_BLOCK_SIZE 4096
 #define MAX_PER_STAGE_DESCRIPTOR_UNIFORM_BLOCKS 8
+/* Each queue gets its own gallium context and submit thread */
+#define LVP_MAX_QUEUES 4
 
 #ifdef _WIN32
 #define lvp_printflike(a, b)
@@ -165,20 +168,31 @@ struct lvp_queue {
    simple_mtx_t pipeline_lock;
 };
 
-struct lvp_pipeline_cache {
-   struct vk_object_base                        base;
-   struct lvp_device *                          device;
-   VkAllocationCallbacks                        alloc;
-};
-
 struct lvp_device {
    struct vk_device vk;
 
-   struct lvp_queue queue;
+   /* queues[0] always exists and its context is the one API objects such
+    * as shader states, sampler views and queries are created with.
+    */
+   struct lvp_queue queues[LVP_MAX_QUEUES];
+   uint32_t queue_count;
    struct lvp_instance *                       instance;
    struct lvp_physical_device *physical_device;
    struct pipe_screen *pscreen;
+   struct vk_pipeline_cache *pipeline_cache;
+   /* bytes of serialized NIR held by pipeline_cache */
+   uint64_t pipeline_cache_size;
    bool poison_mem;
+
+   /* specializes shaders for hot inlinable uniform values */
+   struct util_queue inline_queue;
+   bool inline_stats;
+   struct {
+      uint32_t generic;
+      uint32_t hits;
+      uint32_t specialized;
+      uint32_t rejected;
+   } inline_counts;
 };
 
 void lvp_device_get_cache_uuid(void *uuid);
@@ -328,10 +342,24 @@ struct lvp_descriptor {
    union lvp_descriptor_info info;
 };
 
+/* A set's descriptors as seen by one shader stage, laid out in the order
+ * gallium binds them (see lvp_descriptor_set_binding_layout::stage), so
+ * binding the set is a copy per table rather than a walk over the bindings.
+ */
+struct lvp_descriptor_set_stage {
+   struct pipe_constant_buffer *const_buffers;
+   struct pipe_shader_buffer *shader_buffers;
+   const struct pipe_sampler_state **samplers;
+   struct pipe_sampler_view **sampler_views;
+   struct pipe_image_view *images;
+   uint8_t **uniform_blocks;
+};
+
 struct lvp_descriptor_set {
    struct vk_object_base base;
    struct lvp_descriptor_set_layout *layout;
    struct list_head link;
+   struct lvp_descriptor_set_stage stage[MESA_SHADER_STAGES];
    struct lvp_descriptor descriptors[0];
 };
 
@@ -402,6 +430,47 @@ struct lvp_access_info {
    uint64_t buffers_written;
 };
 
+struct lvp_inline_info {
+   uint32_t uniform_offsets[PIPE_MAX_CONSTANT_BUFFERS][MAX_INLINABLE_UNIFORMS];
+   uint8_t count[PIPE_MAX_CONSTANT_BUFFERS];
+   bool must_inline;
+   uint32_t can_inline; //bitmask
+};
+
+/* Uniform values have to be seen this many times before a specialized
+ * shader is built for them; until then the generic shader is used.
+ */
+#define LVP_INLINE_HOT_THRESHOLD 4
+/* specialized shaders kept per pipeline stage and queue */
+#define LVP_MAX_INLINE_VARIANTS 8
+/* distinct value sets whose use is counted per pipeline stage and queue */
+#define LVP_INLINE_TRACKED_SETS 16
+
+struct lvp_inline_variant {
+   uint32_t slot;
+   uint32_t values[MAX_INLINABLE_UNIFORMS];
+   uint32_t hits;
+
+   /* set while the background job specializing the NIR is queued */
+   bool specializing;
+   /* the background job has finished and its result was picked up */
+   bool done;
+   struct util_queue_fence fence;
+   /* output of the background job, NULL if inlining didn't pay off */
+   nir_shader *nir;
+   /* shader state compiled from nir on the queue's context */
+   void *cso;
+
+   struct lvp_pipeline *pipeline;
+   gl_shader_stage stage;
+};
+
+struct lvp_inline_cache {
+   unsigned num_sets;
+   unsigned num_variants;
+   struct lvp_inline_variant sets[LVP_INLINE_TRACKED_SETS];
+};
+
 struct lvp_pipeline {
    struct vk_object_base base;
    struct lvp_device *                          device;
@@ -414,13 +483,16 @@ struct lvp_pipeline {
    bool is_compute_pipeline;
    bool force_min_sample;
    nir_shader *pipeline_nir[MESA_SHADER_STAGES];
-   void *shader_cso[PIPE_SHADER_TYPES];
-   struct {
-      uint32_t uniform_offsets[PIPE_MAX_CONSTANT_BUFFERS][MAX_INLINABLE_UNIFORMS];
-      uint8_t count[PIPE_MAX_CONSTANT_BUFFERS];
-      bool must_inline;
-      uint32_t can_inline; //bitmask
-   } inlines[MESA_SHADER_STAGES];
+   /* Gallium shader states can only be used with the context that created
+    * them, so each queue compiles its own from pipeline_nir when it first
+    * binds the pipeline.  Row 0 is filled in at pipeline creation.
+    */
+   void *shader_cso[LVP_MAX_QUEUES][PIPE_SHADER_TYPES];
+   /* number of queues which still have to drop their shader states */
+   uint32_t destroy_refs;
+   struct lvp_inline_info inlines[MESA_SHADER_STAGES];
+   /* per queue, allocated on first use by that queue's submit thread */
+   struct lvp_inline_cache *inline_cache[LVP_MAX_QUEUES][MESA_SHADER_STAGES];
    gl_shader_stage last_vertex;
    struct pipe_stream_output_info stream_output;
    struct vk_graphics_pipeline_state graphics_state;
@@ -483,6 +555,7 @@ struct lvp_cmd_buffer {
    struct lvp_device *                          device;
 
    enum lvp_cmd_buffer_status status;
+   VkCommandBufferUsageFlags usage_flags;
 
    uint8_t push_constants[MAX_PUSH_CONSTANTS_SIZE];
 };
@@ -532,8 +605,6 @@ VK_DEFINE_NONDISP_HANDLE_CASTS(lvp_event, base, VkEvent, VK_OBJECT_TYPE_EVENT)
 VK_DEFINE_NONDISP_HANDLE_CASTS(lvp_image, vk.base, VkImage, VK_OBJECT_TYPE_IMAGE)
 VK_DEFINE_NONDISP_HANDLE_CASTS(lvp_image_view, vk.base, VkImageView,
                                VK_OBJECT_TYPE_IMAGE_VIEW);
-VK_DEFINE_NONDISP_HANDLE_CASTS(lvp_pipeline_cache, base, VkPipelineCache,
-                               VK_OBJECT_TYPE_PIPELINE_CACHE)
 VK_DEFINE_NONDISP_HANDLE_CASTS(lvp_pipeline, base, VkPipeline,
                                VK_OBJECT_TYPE_PIPELINE)
 VK_DEFINE_NONDISP_HANDLE_CASTS(lvp_pipeline_layout, vk.base, VkPipelineLayout,
@@ -564,6 +635,7 @@ void lvp_add_enqueue_cmd_entrypoints(struct vk_device_dispatch_table *disp);
 VkResult lvp_execute_cmds(struct lvp_device *device,
                           struct lvp_queue *queue,
                           struct lvp_cmd_buffer *cmd_buffer);
+void lvp_prepare_cmds(struct lvp_cmd_buffer *cmd_buffer);
 size_t
 lvp_get_rendering_state_size(void);
 struct lvp_image *lvp_swapchain_get_image(VkSwapchainKHR swapchain,
@@ -602,6 +674,8 @@ lvp_vk_format_to_pipe_format(VkFormat format)
 
 void
 lvp_pipeline_destroy(struct lvp_device *device, struct lvp_pipeline *pipeline);
+bool
+lvp_pipeline_destroy_queue_shaders(struct lvp_queue *queue, struct lvp_pipeline *pipeline);
 
 void
 queue_thread_noop(void *data, void *gdata, int thread_index);
@@ -609,13 +683,26 @@ queue_thread_noop(void *data, void *gdata, int thread_index);
 void
 lvp_shader_optimize(nir_shader *nir);
 void *
-lvp_pipeline_compile_stage(struct lvp_pipeline *pipeline, nir_shader *nir);
+lvp_pipeline_compile_stage(struct lvp_pipeline *pipeline, struct pipe_context *pctx, nir_shader *nir);
 bool
 lvp_find_inlinable_uniforms(struct lvp_pipeline *pipeline, nir_shader *shader);
 void
 lvp_inline_uniforms(nir_shader *shader, const struct lvp_pipeline *pipeline, const uint32_t *uniform_values, uint32_t ubo);
 void *
-lvp_pipeline_compile(struct lvp_pipeline *pipeline, nir_shader *base_nir);
+lvp_pipeline_compile(struct lvp_pipeline *pipeline, struct pipe_context *pctx, nir_shader *base_nir);
+void *
+lvp_inline_cache_get_cso(struct lvp_pipeline *pipeline, struct pipe_context *pctx, unsigned queue,
+                         gl_shader_stage stage, uint32_t slot, const uint32_t *values);
+bool
+lvp_pipeline_cache_load_shader(struct vk_pipeline_cache *cache,
+                               const unsigned char *sha1,
+                               struct lvp_pipeline *pipeline,
+                               gl_shader_stage stage, bool *cache_hit);
+void
+lvp_pipeline_cache_store_shader(struct vk_pipeline_cache *cache,
+                                const unsigned char *sha1,
+                                const struct lvp_pipeline *pipeline,
+                                const nir_shader *nir);
 #ifdef __cplusplus
 }
 #endif
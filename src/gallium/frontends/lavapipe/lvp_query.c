@@ -85,7 +85,7 @@ VKAPI_ATTR void VKAPI_CALL lvp_DestroyQueryPool(
 
    for (unsigned i = 0; i < pool->count; i++)
       if (pool->queries[i])
-         device->queue.ctx->destroy_query(device->queue.ctx, pool->queries[i]);
+         device->queues[0].ctx->destroy_query(device->queues[0].ctx, pool->queries[i]);
    vk_object_base_finish(&pool->base);
    vk_free2(&device->vk.alloc, pAllocator, pool);
 }
@@ -111,7 +111,7 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_GetQueryPoolResults(
       union pipe_query_result result;
       bool ready = false;
       if (pool->queries[i]) {
-        ready = device->queue.ctx->get_query_result(device->queue.ctx,
+        ready = device->queues[0].ctx->get_query_result(device->queues[0].ctx,
                                                     pool->queries[i],
                                                     (flags & VK_QUERY_RESULT_WAIT_BIT),
                                                     &result);
@@ -210,7 +210,7 @@ VKAPI_ATTR void VKAPI_CALL lvp_ResetQueryPool(
       uint32_t idx = i + firstQuery;
 
       if (pool->queries[idx]) {
-         device->queue.ctx->destroy_query(device->queue.ctx, pool->queries[idx]);
+         device->queues[0].ctx->destroy_query(device->queues[0].ctx, pool->queries[idx]);
          pool->queries[idx] = NULL;
       }
    }
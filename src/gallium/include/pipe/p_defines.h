@@ -1002,6 +1002,7 @@ enum pipe_cap
    PIPE_CAP_FBFETCH_ZS,
    PIPE_CAP_TIMELINE_SEMAPHORE_IMPORT,
    PIPE_CAP_QUERY_TIMESTAMP_BITS,
+   PIPE_CAP_SHAREABLE_STATES,
 
    PIPE_CAP_LAST,
    /* XXX do not add caps after PIPE_CAP_LAST! */
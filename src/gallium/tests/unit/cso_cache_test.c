@@ -0,0 +1,467 @@
+/*
+ * Copyright © 2022 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Checks that cso_contexts on a screen with PIPE_CAP_SHAREABLE_STATES create
+ * each state once for all of them, also when they set states concurrently
+ * from several threads, that the driver always gets the state of the
+ * template, and that every state is deleted in the end.
+ *
+ * With --bench, prints the time per draw of a loop that changes states
+ * before every draw, with and without the shared cache.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c11/threads.h"
+#include "cso_cache/cso_context.h"
+#include "pipe/p_context.h"
+#include "pipe/p_screen.h"
+#include "util/os_time.h"
+#include "util/u_atomic.h"
+#include "util/u_memory.h"
+
+#define NUM_TEMPLATES 300
+#define NUM_THREADS   4
+
+struct test_screen {
+   struct pipe_screen base;
+   bool shareable;
+   unsigned num_created;
+   unsigned num_deleted;
+};
+
+struct test_context {
+   struct pipe_context base;
+   void *blend, *dsa, *rasterizer, *velems;
+   void *samplers[PIPE_MAX_SAMPLERS];
+   unsigned num_draws;
+};
+
+struct test_velems {
+   unsigned count;
+   struct pipe_vertex_element velems[PIPE_MAX_ATTRIBS];
+};
+
+static struct pipe_blend_state blend_templates[NUM_TEMPLATES];
+static struct pipe_depth_stencil_alpha_state dsa_templates[NUM_TEMPLATES];
+static struct pipe_rasterizer_state rasterizer_templates[NUM_TEMPLATES];
+static struct pipe_sampler_state sampler_templates[NUM_TEMPLATES];
+static struct cso_velems_state velems_templates[NUM_TEMPLATES];
+
+static int
+test_get_param(struct pipe_screen *pscreen, enum pipe_cap param)
+{
+   struct test_screen *screen = (struct test_screen *)pscreen;
+   return param == PIPE_CAP_SHAREABLE_STATES ? screen->shareable : 0;
+}
+
+static int
+test_get_shader_param(struct pipe_screen *screen, enum pipe_shader_type shader,
+                      enum pipe_shader_cap param)
+{
+   return 0;
+}
+
+static void *
+test_create(struct pipe_context *pipe, const void *templ, size_t size)
+{
+   struct test_screen *screen = (struct test_screen *)pipe->screen;
+   p_atomic_inc(&screen->num_created);
+   return mem_dup(templ, size);
+}
+
+static void
+test_delete(struct pipe_context *pipe, void *state)
+{
+   struct test_screen *screen = (struct test_screen *)pipe->screen;
+   p_atomic_inc(&screen->num_deleted);
+   FREE(state);
+}
+
+static void *
+test_create_blend_state(struct pipe_context *pipe,
+                        const struct pipe_blend_state *state)
+{
+   return test_create(pipe, state, sizeof(*state));
+}
+
+static void *
+test_create_dsa_state(struct pipe_context *pipe,
+                      const struct pipe_depth_stencil_alpha_state *state)
+{
+   return test_create(pipe, state, sizeof(*state));
+}
+
+static void *
+test_create_rasterizer_state(struct pipe_context *pipe,
+                             const struct pipe_rasterizer_state *state)
+{
+   return test_create(pipe, state, sizeof(*state));
+}
+
+static void *
+test_create_sampler_state(struct pipe_context *pipe,
+                          const struct pipe_sampler_state *state)
+{
+   return test_create(pipe, state, sizeof(*state));
+}
+
+static void *
+test_create_velems_state(struct pipe_context *pipe, unsigned count,
+                         const struct pipe_vertex_element *velems)
+{
+   struct test_velems state = { count };
+   memcpy(state.velems, velems, count * sizeof(velems[0]));
+   return test_create(pipe, &state, sizeof(state));
+}
+
+static void
+test_bind_blend_state(struct pipe_context *pipe, void *state)
+{
+   ((struct test_context *)pipe)->blend = state;
+}
+
+static void
+test_bind_dsa_state(struct pipe_context *pipe, void *state)
+{
+   ((struct test_context *)pipe)->dsa = state;
+}
+
+static void
+test_bind_rasterizer_state(struct pipe_context *pipe, void *state)
+{
+   ((struct test_context *)pipe)->rasterizer = state;
+}
+
+static void
+test_bind_velems_state(struct pipe_context *pipe, void *state)
+{
+   ((struct test_context *)pipe)->velems = state;
+}
+
+static void
+test_bind_sampler_states(struct pipe_context *pipe, enum pipe_shader_type shader,
+                         unsigned start, unsigned count, void **states)
+{
+   struct test_context *ctx = (struct test_context *)pipe;
+   memcpy(&ctx->samplers[start], states, count * sizeof(states[0]));
+}
+
+static void
+test_bind_shader_state(struct pipe_context *pipe, void *state)
+{
+}
+
+static void
+test_set_constant_buffer(struct pipe_context *pipe, enum pipe_shader_type shader,
+                         uint index, bool take_ownership,
+                         const struct pipe_constant_buffer *buf)
+{
+}
+
+static void
+test_set_stencil_ref(struct pipe_context *pipe, const struct pipe_stencil_ref ref)
+{
+}
+
+static void
+test_set_sample_mask(struct pipe_context *pipe, unsigned sample_mask)
+{
+}
+
+static void
+test_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info,
+              unsigned drawid_offset,
+              const struct pipe_draw_indirect_info *indirect,
+              const struct pipe_draw_start_count_bias *draws,
+              unsigned num_draws)
+{
+   ((struct test_context *)pipe)->num_draws += num_draws;
+}
+
+static void
+test_screen_init(struct test_screen *screen, bool shareable)
+{
+   memset(screen, 0, sizeof(*screen));
+   screen->base.get_param = test_get_param;
+   screen->base.get_shader_param = test_get_shader_param;
+   screen->shareable = shareable;
+}
+
+static struct test_context *
+create_context(struct test_screen *screen)
+{
+   struct test_context *ctx = CALLOC_STRUCT(test_context);
+
+   ctx->base.screen = &screen->base;
+   ctx->base.create_blend_state = test_create_blend_state;
+   ctx->base.bind_blend_state = test_bind_blend_state;
+   ctx->base.delete_blend_state = test_delete;
+   ctx->base.create_depth_stencil_alpha_state = test_create_dsa_state;
+   ctx->base.bind_depth_stencil_alpha_state = test_bind_dsa_state;
+   ctx->base.delete_depth_stencil_alpha_state = test_delete;
+   ctx->base.create_rasterizer_state = test_create_rasterizer_state;
+   ctx->base.bind_rasterizer_state = test_bind_rasterizer_state;
+   ctx->base.delete_rasterizer_state = test_delete;
+   ctx->base.create_sampler_state = test_create_sampler_state;
+   ctx->base.bind_sampler_states = test_bind_sampler_states;
+   ctx->base.delete_sampler_state = test_delete;
+   ctx->base.create_vertex_elements_state = test_create_velems_state;
+   ctx->base.bind_vertex_elements_state = test_bind_velems_state;
+   ctx->base.delete_vertex_elements_state = test_delete;
+   ctx->base.bind_fs_state = test_bind_shader_state;
+   ctx->base.bind_vs_state = test_bind_shader_state;
+   ctx->base.set_constant_buffer = test_set_constant_buffer;
+   ctx->base.set_stencil_ref = test_set_stencil_ref;
+   ctx->base.set_sample_mask = test_set_sample_mask;
+   ctx->base.draw_vbo = test_draw_vbo;
+   return ctx;
+}
+
+static void
+init_templates(void)
+{
+   /* the templates differ in a single field */
+   for (unsigned i = 0; i < NUM_TEMPLATES; i++) {
+      blend_templates[i].rt[0].colormask = i & 0xf;
+      blend_templates[i].rt[0].rgb_src_factor = i >> 4;
+      dsa_templates[i].stencil[0].valuemask = i;
+      dsa_templates[i].stencil[0].writemask = i >> 8;
+      rasterizer_templates[i].line_width = i;
+      sampler_templates[i].lod_bias = i;
+      velems_templates[i].count = 1 + i % 4;
+      velems_templates[i].velems[0].src_offset = i;
+   }
+}
+
+/* Set the states of template i and check that the driver got them. */
+static bool
+set_states(struct cso_context *cso, struct test_context *ctx, unsigned i)
+{
+   cso_set_blend(cso, &blend_templates[i]);
+   cso_set_depth_stencil_alpha(cso, &dsa_templates[i]);
+   cso_set_rasterizer(cso, &rasterizer_templates[i]);
+   cso_single_sampler(cso, PIPE_SHADER_FRAGMENT, 0, &sampler_templates[i]);
+   cso_single_sampler(cso, PIPE_SHADER_FRAGMENT, 1,
+                      &sampler_templates[(i + 1) % NUM_TEMPLATES]);
+   cso_single_sampler_done(cso, PIPE_SHADER_FRAGMENT);
+   cso_set_vertex_elements(cso, &velems_templates[i]);
+
+   const struct test_velems *velems = ctx->velems;
+   return !memcmp(ctx->blend, &blend_templates[i], sizeof(blend_templates[i])) &&
+          !memcmp(ctx->dsa, &dsa_templates[i], sizeof(dsa_templates[i])) &&
+          !memcmp(ctx->rasterizer, &rasterizer_templates[i],
+                  sizeof(rasterizer_templates[i])) &&
+          !memcmp(ctx->samplers[0], &sampler_templates[i],
+                  sizeof(sampler_templates[i])) &&
+          !memcmp(ctx->samplers[1], &sampler_templates[(i + 1) % NUM_TEMPLATES],
+                  sizeof(sampler_templates[i])) &&
+          velems->count == velems_templates[i].count &&
+          !memcmp(velems->velems, velems_templates[i].velems,
+                  velems->count * sizeof(velems->velems[0]));
+}
+
+/* a blend, depth/stencil/alpha, rasterizer, sampler and vertex elements
+ * state per template
+ */
+#define NUM_STATES (NUM_TEMPLATES * 5)
+
+static bool
+test_two_contexts(bool shareable)
+{
+   struct test_screen screen;
+   test_screen_init(&screen, shareable);
+   struct test_context *ctx[2] = { create_context(&screen), create_context(&screen) };
+   struct cso_context *cso[2];
+   struct cso_cache_stats stats;
+   bool success = true;
+
+   for (unsigned c = 0; c < 2; c++) {
+      cso[c] = cso_create_context(&ctx[c]->base, CSO_NO_VBUF | CSO_SHARED_CACHE);
+      for (unsigned i = 0; i < NUM_TEMPLATES; i++)
+         success &= set_states(cso[c], ctx[c], i);
+   }
+
+   cso_get_cache_stats(cso[1], &stats);
+   unsigned expected_created = shareable ? NUM_STATES : 2 * NUM_STATES;
+   if (screen.num_created != expected_created ||
+       (shareable && stats.misses) ||
+       (!shareable && stats.shared_hits)) {
+      printf("FAILED: %s cache, %u states created, %u misses, "
+             "%u shared hits in the second context\n",
+             shareable ? "shared" : "private", screen.num_created,
+             stats.misses, stats.shared_hits);
+      success = false;
+   }
+
+   /* the states of the first context stay usable after it's gone */
+   cso_destroy_context(cso[0]);
+   for (unsigned i = 0; i < NUM_TEMPLATES; i++)
+      success &= set_states(cso[1], ctx[1], NUM_TEMPLATES - 1 - i);
+   cso_destroy_context(cso[1]);
+
+   if (screen.num_deleted != screen.num_created) {
+      printf("FAILED: %s cache, %u of %u states deleted\n",
+             shareable ? "shared" : "private", screen.num_deleted,
+             screen.num_created);
+      success = false;
+   }
+   if (!success)
+      printf("FAILED: two contexts, %s cache\n", shareable ? "shared" : "private");
+
+   FREE(ctx[0]);
+   FREE(ctx[1]);
+   return success;
+}
+
+struct thread_data {
+   struct test_screen *screen;
+   struct test_context *ctx;
+   struct cso_context *cso;
+   unsigned seed;
+   unsigned iterations;
+   bool draw;
+   bool success;
+};
+
+static int
+thread_func(void *data)
+{
+   struct thread_data *t = data;
+
+   t->success = true;
+   for (unsigned i = 0; i < t->iterations; i++) {
+      t->seed = t->seed * 1103515245 + 12345;
+      unsigned templ = (t->seed >> 8) % NUM_TEMPLATES;
+
+      if (t->draw) {
+         set_states(t->cso, t->ctx, templ);
+         cso_draw_arrays(t->cso, PIPE_PRIM_TRIANGLES, 0, 3);
+      } else {
+         t->success &= set_states(t->cso, t->ctx, templ);
+      }
+   }
+   return 0;
+}
+
+/* Returns the time taken in nanoseconds, or -1 on failure. */
+static int64_t
+run_threads(bool shareable, unsigned num_threads, unsigned iterations,
+            bool draw, struct cso_cache_stats *total)
+{
+   struct test_screen screen;
+   struct thread_data data[NUM_THREADS];
+   thrd_t threads[NUM_THREADS];
+   bool success = true;
+
+   test_screen_init(&screen, shareable);
+   for (unsigned t = 0; t < num_threads; t++) {
+      data[t].screen = &screen;
+      data[t].ctx = create_context(&screen);
+      data[t].cso = cso_create_context(&data[t].ctx->base,
+                                       CSO_NO_VBUF | CSO_SHARED_CACHE);
+      data[t].seed = t + 1;
+      data[t].iterations = iterations;
+      data[t].draw = draw;
+   }
+
+   int64_t start = os_time_get_nano();
+   for (unsigned t = 0; t < num_threads; t++)
+      thrd_create(&threads[t], thread_func, &data[t]);
+   for (unsigned t = 0; t < num_threads; t++) {
+      thrd_join(threads[t], NULL);
+      success &= data[t].success;
+   }
+   int64_t time = os_time_get_nano() - start;
+
+   memset(total, 0, sizeof(*total));
+   for (unsigned t = 0; t < num_threads; t++) {
+      struct cso_cache_stats stats;
+      cso_get_cache_stats(data[t].cso, &stats);
+      total->hits += stats.hits;
+      total->shared_hits += stats.shared_hits;
+      total->misses += stats.misses;
+   }
+
+   /* states that lost a race with another thread are deleted right away */
+   unsigned live = screen.num_created - screen.num_deleted;
+   if (shareable && live != NUM_STATES) {
+      printf("FAILED: %u live states instead of %u\n", live, NUM_STATES);
+      success = false;
+   }
+
+   for (unsigned t = 0; t < num_threads; t++) {
+      cso_destroy_context(data[t].cso);
+      FREE(data[t].ctx);
+   }
+
+   if (screen.num_deleted != screen.num_created) {
+      printf("FAILED: %u of %u states deleted\n", screen.num_deleted,
+             screen.num_created);
+      success = false;
+   }
+
+   return success ? time : -1;
+}
+
+static void
+bench(bool shareable, unsigned num_threads)
+{
+   const unsigned iterations = 1000000;
+   struct cso_cache_stats stats;
+   int64_t time = run_threads(shareable, num_threads, iterations, true, &stats);
+
+   printf("%-7s cache, %u thread(s): %6.1f ns per draw, "
+          "%u hits, %u shared hits, %u misses\n",
+          shareable ? "shared" : "private", num_threads,
+          (double)time / iterations, stats.hits, stats.shared_hits,
+          stats.misses);
+}
+
+int main(int argc, char **argv)
+{
+   struct cso_cache_stats stats;
+   bool success = true;
+
+   init_templates();
+
+   success &= test_two_contexts(false);
+   success &= test_two_contexts(true);
+
+   if (run_threads(true, NUM_THREADS, 100000, false, &stats) < 0) {
+      printf("FAILED: concurrent contexts\n");
+      success = false;
+   }
+
+   if (argc > 1 && !strcmp(argv[1], "--bench")) {
+      bench(false, 1);
+      bench(true, 1);
+      bench(false, NUM_THREADS);
+      bench(true, NUM_THREADS);
+   }
+
+   return success ? 0 : 1;
+}
@@ -0,0 +1,341 @@
+/*
+ * Copyright © 2022 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Replays a synthetic allocation trace through pb_cache and checks that
+ * every reclaimed buffer fits the request and is idle, that the size limits
+ * are respected and that the statistics add up.  Also checks that the
+ * closest size is reclaimed and that unused buffers expire.
+ *
+ * With --bench, prints the time per allocation of the trace replay.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pipebuffer/pb_cache.h"
+#include "util/os_time.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+
+#define NUM_BUCKETS  4
+#define NUM_SLOTS    2048
+#define NUM_OPS      200000
+/* a released buffer stays busy for this many trace steps */
+#define BUSY_STEPS   64
+#define SIZE_FACTOR  2.0f
+
+struct test_buffer {
+   struct pb_buffer base;
+   struct pb_cache_entry cache_entry;
+   unsigned bucket;
+   unsigned released_step;
+};
+
+struct test_winsys {
+   struct pb_cache cache;
+   unsigned step;
+   unsigned num_created;
+   unsigned num_destroyed;
+};
+
+struct trace_op {
+   unsigned slot;
+   unsigned size;
+   unsigned alignment;
+   unsigned bucket;
+   unsigned usage;
+};
+
+static struct trace_op trace[NUM_OPS];
+static uint32_t rand_state = 1;
+
+static uint32_t
+next_rand(void)
+{
+   rand_state = rand_state * 1103515245 + 12345;
+   return rand_state >> 8;
+}
+
+static void
+test_destroy_buffer(void *winsys, struct pb_buffer *buf)
+{
+   struct test_winsys *ws = winsys;
+   ws->num_destroyed++;
+   FREE(buf);
+}
+
+static bool
+test_can_reclaim(void *winsys, struct pb_buffer *buf)
+{
+   struct test_winsys *ws = winsys;
+   return ((struct test_buffer *)buf)->released_step + BUSY_STEPS <= ws->step;
+}
+
+static void
+test_winsys_init(struct test_winsys *ws, unsigned usecs,
+                 uint64_t max_cache_size)
+{
+   memset(ws, 0, sizeof(*ws));
+   pb_cache_init(&ws->cache, NUM_BUCKETS, usecs, SIZE_FACTOR, 0,
+                 max_cache_size, ws, test_destroy_buffer, test_can_reclaim);
+}
+
+static struct test_buffer *
+create_buffer(struct test_winsys *ws, unsigned size, unsigned alignment,
+              unsigned usage, unsigned bucket)
+{
+   struct test_buffer *buf = CALLOC_STRUCT(test_buffer);
+
+   pipe_reference_init(&buf->base.reference, 1);
+   buf->base.size = size;
+   buf->base.alignment_log2 = util_logbase2(alignment);
+   buf->base.usage = usage;
+   buf->bucket = bucket;
+   pb_cache_init_entry(&ws->cache, &buf->cache_entry, &buf->base, bucket);
+   ws->num_created++;
+   return buf;
+}
+
+static void
+release_buffer(struct test_winsys *ws, struct test_buffer *buf)
+{
+   buf->released_step = ws->step;
+   pipe_reference_init(&buf->base.reference, 0);
+   pb_cache_add_buffer(&buf->cache_entry);
+}
+
+static void
+generate_trace(void)
+{
+   for (unsigned i = 0; i < NUM_OPS; i++) {
+      unsigned r = next_rand() % 100;
+
+      /* mostly small buffers, as for constants, uploads and vertices */
+      if (r < 70)
+         trace[i].size = 256 + next_rand() % (64 * 1024);
+      else if (r < 95)
+         trace[i].size = 64 * 1024 + next_rand() % (4 * 1024 * 1024);
+      else
+         trace[i].size = 4 * 1024 * 1024 + next_rand() % (32 * 1024 * 1024);
+
+      trace[i].slot = next_rand() % NUM_SLOTS;
+      trace[i].alignment = next_rand() % 4 ? 256 : 4096;
+      trace[i].bucket = next_rand() % NUM_BUCKETS;
+      trace[i].usage = next_rand() % 3;
+   }
+}
+
+static bool
+replay_trace(struct test_winsys *ws, unsigned *num_allocs)
+{
+   struct test_buffer *slots[NUM_SLOTS] = {0};
+   bool success = true;
+
+   for (unsigned i = 0; i < NUM_OPS; i++) {
+      const struct trace_op *op = &trace[i];
+
+      ws->step = i;
+      if (slots[op->slot])
+         release_buffer(ws, slots[op->slot]);
+
+      struct test_buffer *buf = (struct test_buffer *)
+         pb_cache_reclaim_buffer(&ws->cache, op->size, op->alignment,
+                                 op->usage, op->bucket);
+      if (buf) {
+         if (buf->base.size < op->size ||
+             buf->base.size > SIZE_FACTOR * op->size ||
+             (1u << buf->base.alignment_log2) < op->alignment ||
+             (buf->base.usage & op->usage) != op->usage ||
+             buf->bucket != op->bucket ||
+             buf->released_step + BUSY_STEPS > i) {
+            printf("FAILED: step %u reclaimed an incompatible buffer\n", i);
+            success = false;
+         }
+      } else {
+         buf = create_buffer(ws, op->size, 4096, op->usage, op->bucket);
+      }
+      slots[op->slot] = buf;
+
+      if (ws->cache.cache_size > ws->cache.max_cache_size) {
+         printf("FAILED: step %u exceeds the cache size limit\n", i);
+         success = false;
+      }
+   }
+
+   for (unsigned i = 0; i < NUM_SLOTS; i++) {
+      if (slots[i])
+         release_buffer(ws, slots[i]);
+   }
+
+   *num_allocs = NUM_OPS;
+   return success;
+}
+
+static bool
+check_stats(struct test_winsys *ws, unsigned num_allocs,
+            uint64_t bucket_max_size)
+{
+   uint64_t hits = 0, misses = 0, size = 0;
+   unsigned num_buffers = 0;
+
+   for (unsigned i = 0; i < NUM_BUCKETS; i++) {
+      struct pb_cache_stats stats;
+
+      pb_cache_get_stats(&ws->cache, i, &stats);
+      hits += stats.hits;
+      misses += stats.misses;
+      size += stats.size;
+      num_buffers += stats.num_buffers;
+
+      if (i == 0 && stats.size > bucket_max_size) {
+         printf("FAILED: bucket 0 exceeds its size limit\n");
+         return false;
+      }
+   }
+
+   if (hits + misses != num_allocs ||
+       misses != ws->num_created ||
+       size != ws->cache.cache_size ||
+       num_buffers != ws->cache.num_buffers) {
+      printf("FAILED: the statistics don't add up\n");
+      return false;
+   }
+   return true;
+}
+
+static bool
+test_trace(uint64_t max_cache_size, uint64_t bucket_max_size)
+{
+   struct test_winsys ws;
+   unsigned num_allocs;
+   bool success;
+
+   test_winsys_init(&ws, 10 * 1000 * 1000, max_cache_size);
+   pb_cache_set_bucket_max_size(&ws.cache, 0, bucket_max_size);
+
+   success = replay_trace(&ws, &num_allocs);
+   success &= check_stats(&ws, num_allocs, bucket_max_size);
+
+   pb_cache_deinit(&ws.cache);
+   if (ws.num_created != ws.num_destroyed) {
+      printf("FAILED: %u buffers leaked\n", ws.num_created - ws.num_destroyed);
+      success = false;
+   }
+   return success;
+}
+
+static bool
+test_closest_size(void)
+{
+   static const unsigned sizes[] = { 4096, 9000, 12000, 6000 };
+   struct test_winsys ws;
+   bool success = true;
+
+   test_winsys_init(&ws, 10 * 1000 * 1000, UINT64_MAX);
+   ws.step = BUSY_STEPS;
+
+   for (unsigned i = 0; i < ARRAY_SIZE(sizes); i++)
+      release_buffer(&ws, create_buffer(&ws, sizes[i], 4096, 0, 0));
+   ws.step += BUSY_STEPS;
+
+   /* 6000 is the smallest that fits, although 9000 was added before it */
+   struct pb_buffer *buf = pb_cache_reclaim_buffer(&ws.cache, 5000, 0, 0, 0);
+   if (!buf || buf->size != 6000) {
+      printf("FAILED: reclaimed %u bytes instead of 6000\n",
+             buf ? (unsigned)buf->size : 0);
+      success = false;
+   }
+   if (buf)
+      release_buffer(&ws, (struct test_buffer *)buf);
+
+   /* nothing fits in [10000, 20000] in another bucket */
+   if (pb_cache_reclaim_buffer(&ws.cache, 10000, 0, 0, 1)) {
+      printf("FAILED: reclaimed a buffer of another bucket\n");
+      success = false;
+   }
+
+   pb_cache_deinit(&ws.cache);
+   return success;
+}
+
+static bool
+test_expiry(void)
+{
+   struct test_winsys ws;
+   struct pb_cache_stats stats;
+
+   test_winsys_init(&ws, 1000, UINT64_MAX);
+
+   release_buffer(&ws, create_buffer(&ws, 4096, 4096, 0, 0));
+   os_time_sleep(10000);
+   release_buffer(&ws, create_buffer(&ws, 4096, 4096, 0, 1));
+
+   pb_cache_get_stats(&ws.cache, 0, &stats);
+   bool success = stats.expired == 1 && stats.num_buffers == 0 &&
+                  ws.cache.num_buffers == 1;
+   if (!success)
+      printf("FAILED: unused buffer didn't expire\n");
+
+   pb_cache_deinit(&ws.cache);
+   return success;
+}
+
+static void
+bench(void)
+{
+   struct test_winsys ws;
+   unsigned num_allocs;
+
+   test_winsys_init(&ws, 10 * 1000 * 1000, UINT64_MAX);
+
+   int64_t start = os_time_get_nano();
+   replay_trace(&ws, &num_allocs);
+   int64_t time = os_time_get_nano() - start;
+
+   printf("%u allocations: %.1f ns per allocation, %.1f%% reclaimed, "
+          "%u buffers cached at the end\n",
+          num_allocs, (double)time / num_allocs,
+          100.0 * (num_allocs - ws.num_created) / num_allocs,
+          ws.cache.num_buffers);
+
+   pb_cache_deinit(&ws.cache);
+}
+
+int main(int argc, char **argv)
+{
+   bool success = true;
+
+   generate_trace();
+
+   success &= test_trace(UINT64_MAX, UINT64_MAX);
+   success &= test_trace(64 * 1024 * 1024, 4 * 1024 * 1024);
+   success &= test_closest_size();
+   success &= test_expiry();
+
+   if (argc > 1 && !strcmp(argv[1], "--bench"))
+      bench();
+
+   return success ? 0 : 1;
+}
@@ -25,6 +25,7 @@
 
 #include <stdio.h>
 #include "translate/translate.h"
+#include "util/os_time.h"
 #include "util/u_memory.h"
 #include "util/format/u_format.h"
 #include "util/half_float.h"
@@ -47,6 +48,138 @@ static double rand_double()
 
 char cpu_caps_override_env[128];
 
+/* Interleaved vertex layouts, as fed to the draw module or u_vbuf */
+static const struct {
+   const char *name;
+   unsigned nr_elements;
+   enum pipe_format input[4];
+   enum pipe_format output[4];
+} bench_layouts[] = {
+   { "pos3f norm4b uv2us color4ub -> 4f", 4,
+     { PIPE_FORMAT_R32G32B32_FLOAT, PIPE_FORMAT_R8G8B8A8_SNORM,
+       PIPE_FORMAT_R16G16_UNORM, PIPE_FORMAT_R8G8B8A8_UNORM },
+     { PIPE_FORMAT_R32G32B32A32_FLOAT, PIPE_FORMAT_R32G32B32A32_FLOAT,
+       PIPE_FORMAT_R32G32B32A32_FLOAT, PIPE_FORMAT_R32G32B32A32_FLOAT } },
+   { "pos4h uv2h -> 4f", 2,
+     { PIPE_FORMAT_R16G16B16A16_FLOAT, PIPE_FORMAT_R16G16_FLOAT },
+     { PIPE_FORMAT_R32G32B32A32_FLOAT, PIPE_FORMAT_R32G32B32A32_FLOAT } },
+   { "pos3f norm10 -> 3f 4f", 2,
+     { PIPE_FORMAT_R32G32B32_FLOAT, PIPE_FORMAT_R10G10B10A2_SNORM },
+     { PIPE_FORMAT_R32G32B32_FLOAT, PIPE_FORMAT_R32G32B32A32_FLOAT } },
+   { "pos3d color4ub -> 3f 4ub", 2,
+     { PIPE_FORMAT_R64G64B64_FLOAT, PIPE_FORMAT_B8G8R8A8_UNORM },
+     { PIPE_FORMAT_R32G32B32_FLOAT, PIPE_FORMAT_R8G8B8A8_UNORM } },
+};
+
+/*
+ * Times the common vertex layouts above, and checks that run, run_elts,
+ * run_elts16 and run_elts8 agree with each other for draws longer than the
+ * batches the implementations work in.
+ */
+static int
+bench(void)
+{
+   const unsigned count = 1 << 16;
+   const unsigned iterations = 16;
+   struct translate *(*create_fns[])(const struct translate_key *key) = {
+      translate_generic_create, translate_create,
+   };
+   const char *create_names[] = { "generic", "default" };
+   unsigned *elts = align_malloc(count * sizeof(unsigned), 64);
+   uint16_t *elts16 = align_malloc(count * sizeof(uint16_t), 64);
+   uint8_t *elts8 = align_malloc(count, 64);
+   int ret = 0;
+   unsigned i, l, f;
+
+   for (i = 0; i < count; i++) {
+      elts[i] = elts16[i] = (i * 7) & 0xffff;
+      elts8[i] = i & 0xff;
+   }
+
+   for (l = 0; l < ARRAY_SIZE(bench_layouts); l++) {
+      struct translate_key key;
+      unsigned input_stride = 0;
+      uint8_t *input, *output[4];
+
+      memset(&key, 0, sizeof(key));
+      key.nr_elements = bench_layouts[l].nr_elements;
+      for (i = 0; i < key.nr_elements; i++) {
+         key.element[i].type = TRANSLATE_ELEMENT_NORMAL;
+         key.element[i].input_format = bench_layouts[l].input[i];
+         key.element[i].output_format = bench_layouts[l].output[i];
+         key.element[i].input_offset = input_stride;
+         key.element[i].output_offset = key.output_stride;
+         input_stride += util_format_get_blocksize(bench_layouts[l].input[i]);
+         key.output_stride += util_format_get_blocksize(bench_layouts[l].output[i]);
+      }
+
+      input = align_malloc((size_t)input_stride * count, 64);
+      for (i = 0; i < input_stride * count; i++)
+         input[i] = rand() & 0x3f;
+      for (i = 0; i < ARRAY_SIZE(output); i++)
+         output[i] = align_malloc((size_t)key.output_stride * count, 64);
+
+      for (f = 0; f < ARRAY_SIZE(create_fns); f++) {
+         struct translate *translate = create_fns[f](&key);
+         int64_t start, run_time, elts_time;
+         unsigned it;
+
+         if (!translate)
+            continue;
+
+         translate->set_buffer(translate, 0, input, input_stride, count - 1);
+
+         /* fault the outputs in before timing */
+         translate->run(translate, 0, count, 0, 0, output[0]);
+         translate->run_elts(translate, elts, count, 0, 0, output[1]);
+
+         start = os_time_get_nano();
+         for (it = 0; it < iterations; it++)
+            translate->run(translate, 0, count, 0, 0, output[0]);
+         run_time = os_time_get_nano() - start;
+
+         start = os_time_get_nano();
+         for (it = 0; it < iterations; it++)
+            translate->run_elts(translate, elts, count, 0, 0, output[1]);
+         elts_time = os_time_get_nano() - start;
+
+         translate->run_elts16(translate, elts16, count, 0, 0, output[2]);
+         translate->run_elts8(translate, elts8, count, 0, 0, output[3]);
+
+         for (i = 0; i < count; i++) {
+            const uint8_t *linear = output[0] + (size_t)key.output_stride * elts[i];
+            const uint8_t *linear8 = output[0] + (size_t)key.output_stride * elts8[i];
+            size_t offset = (size_t)key.output_stride * i;
+
+            if (memcmp(output[1] + offset, linear, key.output_stride) ||
+                memcmp(output[2] + offset, linear, key.output_stride) ||
+                memcmp(output[3] + offset, linear8, key.output_stride)) {
+               printf("FAIL: %s %s: indexed vertex %u differs from run()\n",
+                      create_names[f], bench_layouts[l].name, i);
+               ret = 1;
+               break;
+            }
+         }
+
+         printf("%-8s %-36s %8.1f Mvert/s run  %8.1f Mvert/s run_elts\n",
+                create_names[f], bench_layouts[l].name,
+                (double)count * iterations * 1000.0 / MAX2(run_time, 1),
+                (double)count * iterations * 1000.0 / MAX2(elts_time, 1));
+
+         translate->release(translate);
+      }
+
+      align_free(input);
+      for (i = 0; i < ARRAY_SIZE(output); i++)
+         align_free(output[i]);
+   }
+
+   align_free(elts);
+   align_free(elts16);
+   align_free(elts8);
+   return ret;
+}
+
 int main(int argc, char** argv)
 {
    struct translate *(*create_fn)(const struct translate_key *key) = 0;
@@ -69,6 +202,9 @@ int main(int argc, char** argv)
 
    create_fn = 0;
 
+   if (argc > 1 && !strcmp(argv[1], "bench"))
+      return bench();
+
    if (argc <= 1 ||
        !strcmp(argv[1], "default") )
       create_fn = translate_create;
@@ -99,7 +235,7 @@ int main(int argc, char** argv)
 
    if (!create_fn)
    {
-      printf("Usage: ./translate_test [default|generic|x86|nosse|sse|sse2|sse3|ssse3|sse4.1|avx]\n");
+      printf("Usage: ./translate_test [default|generic|x86|nosse|sse|sse2|sse3|ssse3|sse4.1|avx|bench]\n");
       return 2;
    }
 
@@ -0,0 +1,337 @@
+/*
+ * Copyright © 2022 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Checks that the functions returned by u_index_translator() and
+ * u_index_generator(), which may be SIMD variants, give the same result as
+ * the plain C functions for every primitive type, index size, provoking
+ * vertex convention and primitive restart setting.
+ *
+ * With --bench, prints the time taken by both for some common conversions.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "indices/u_indices.h"
+#include "indices/u_indices_priv.h"
+#include "util/os_time.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_prim.h"
+
+#define GUARD 64
+
+static uint32_t rand_state = 1;
+
+static uint32_t
+next_rand(void)
+{
+   rand_state = rand_state * 1103515245 + 12345;
+   return rand_state >> 8;
+}
+
+static void
+fill_indices(void *indices, unsigned index_size, unsigned count,
+             unsigned restart_index, unsigned restart_freq)
+{
+   for (unsigned i = 0; i < count; i++) {
+      uint32_t value = next_rand();
+      if (restart_freq && value % restart_freq == 0)
+         value = restart_index;
+
+      switch (index_size) {
+      case 1:
+         ((uint8_t *)indices)[i] = value;
+         break;
+      case 2:
+         ((uint16_t *)indices)[i] = value;
+         break;
+      default:
+         ((uint32_t *)indices)[i] = value;
+         break;
+      }
+   }
+}
+
+/* Whether u_index_init() installs SIMD functions for the primitive type.
+ * Line loops, triangle fans and polygons refer back to the first vertex and
+ * are always translated by the scalar functions.
+ */
+static bool
+simd_expected(enum pipe_prim_type prim)
+{
+#if defined(USE_SSE41)
+   util_cpu_detect();
+   return util_get_cpu_caps()->has_sse4_1 &&
+          prim != PIPE_PRIM_LINE_LOOP &&
+          prim != PIPE_PRIM_TRIANGLE_FAN &&
+          prim != PIPE_PRIM_POLYGON;
+#else
+   return false;
+#endif
+}
+
+static bool
+test_translate(enum pipe_prim_type prim, unsigned in_index_size,
+               unsigned in_pv, unsigned out_pv, unsigned prim_restart,
+               unsigned start, unsigned nr, unsigned restart_index,
+               unsigned restart_freq)
+{
+   enum pipe_prim_type out_prim;
+   unsigned out_index_size, out_nr;
+   u_translate_func translate;
+
+   /* like the callers, only pass whole primitives */
+   if (!u_trim_pipe_prim(prim, &nr))
+      return true;
+
+   u_index_translator(0, prim, in_index_size, nr, in_pv, out_pv, prim_restart,
+                      &out_prim, &out_index_size, &out_nr, &translate);
+   u_translate_func scalar =
+      u_index_translate_scalar(in_index_size, out_index_size, in_pv, out_pv,
+                               prim_restart, prim);
+   if (translate == scalar) {
+      if (!simd_expected(prim))
+         return true;
+      printf("FAILED: no SIMD translate for %s, %u -> %u bytes, pv %u -> %u, "
+             "restart %u\n", u_prim_name(prim), in_index_size, out_index_size,
+             in_pv, out_pv, prim_restart);
+      return false;
+   }
+
+   /* No padding after the input, reading past it would be a bug. The last
+    * odd triangle of a strip with adjacency reads one index past the strip.
+    */
+   unsigned in_count = start + nr + (prim == PIPE_PRIM_TRIANGLE_STRIP_ADJACENCY);
+   void *in = malloc(in_count * in_index_size);
+   size_t out_size = out_nr * out_index_size + GUARD;
+   uint8_t *out = malloc(out_size);
+   uint8_t *ref = malloc(out_size);
+
+   fill_indices(in, in_index_size, in_count, restart_index, restart_freq);
+   memset(out, 0xcd, out_size);
+   memset(ref, 0xcd, out_size);
+
+   translate(in, start, start + nr, out_nr, restart_index, out);
+   scalar(in, start, start + nr, out_nr, restart_index, ref);
+
+   bool success = !memcmp(out, ref, out_size);
+   if (!success) {
+      printf("FAILED: translate %s, %u -> %u bytes, pv %u -> %u, restart %u "
+             "(0x%x every %u), start %u, count %u\n",
+             u_prim_name(prim), in_index_size, out_index_size, in_pv, out_pv,
+             prim_restart, restart_index, restart_freq, start, nr);
+   }
+
+   free(in);
+   free(out);
+   free(ref);
+   return success;
+}
+
+static bool
+test_generate(enum pipe_prim_type prim, unsigned in_pv, unsigned out_pv,
+              unsigned start, unsigned nr)
+{
+   enum pipe_prim_type out_prim;
+   unsigned out_index_size, out_nr;
+   u_generate_func generate;
+
+   if (!u_trim_pipe_prim(prim, &nr))
+      return true;
+
+   u_index_generator(0, prim, start, nr, in_pv, out_pv,
+                     &out_prim, &out_index_size, &out_nr, &generate);
+   u_generate_func scalar =
+      u_index_generate_scalar(out_index_size, in_pv, out_pv, prim);
+   if (generate == scalar) {
+      if (!simd_expected(prim))
+         return true;
+      printf("FAILED: no SIMD generate for %s, %u bytes, pv %u -> %u\n",
+             u_prim_name(prim), out_index_size, in_pv, out_pv);
+      return false;
+   }
+
+   size_t out_size = out_nr * out_index_size + GUARD;
+   uint8_t *out = malloc(out_size);
+   uint8_t *ref = malloc(out_size);
+   memset(out, 0xcd, out_size);
+   memset(ref, 0xcd, out_size);
+
+   generate(start, out_nr, out);
+   scalar(start, out_nr, ref);
+
+   bool success = !memcmp(out, ref, out_size);
+   if (!success) {
+      printf("FAILED: generate %s, %u bytes, pv %u -> %u, start %u, count %u\n",
+             u_prim_name(prim), out_index_size, in_pv, out_pv, start, nr);
+   }
+
+   free(out);
+   free(ref);
+   return success;
+}
+
+static const unsigned counts[] = { 6, 7, 12, 31, 64, 100, 257, 1000, 4099 };
+static const unsigned starts[] = { 0, 1, 2, 3, 6, 13 };
+
+static bool
+test_all(void)
+{
+   bool success = true;
+
+   for (enum pipe_prim_type prim = PIPE_PRIM_POINTS; prim < PRIM_COUNT; prim++) {
+      for (unsigned in_pv = 0; in_pv < PV_COUNT; in_pv++) {
+         for (unsigned out_pv = 0; out_pv < PV_COUNT; out_pv++) {
+            for (unsigned c = 0; c < ARRAY_SIZE(counts); c++) {
+               for (unsigned s = 0; s < ARRAY_SIZE(starts); s++) {
+                  /* triangle strips with adjacency tell odd triangles by the
+                   * absolute index, other starts read outside of the strip
+                   */
+                  if (prim == PIPE_PRIM_TRIANGLE_STRIP_ADJACENCY && starts[s] % 4)
+                     continue;
+
+                  success &= test_generate(prim, in_pv, out_pv, starts[s], counts[c]);
+                  success &= test_generate(prim, in_pv, out_pv, 70000 + starts[s], counts[c]);
+
+                  for (unsigned in_index_size = 1; in_index_size <= 4; in_index_size *= 2) {
+                     unsigned max_index = in_index_size == 4 ? ~0u :
+                                          (1u << (in_index_size * 8)) - 1;
+
+                     for (unsigned pr = 0; pr < PR_COUNT; pr++) {
+                        /* no restart index in the data */
+                        success &= test_translate(prim, in_index_size, in_pv, out_pv, pr,
+                                                  starts[s], counts[c], max_index, 0);
+                        /* a restart index the indices can't hold */
+                        success &= test_translate(prim, in_index_size, in_pv, out_pv, pr,
+                                                  starts[s], counts[c], ~0u, 0);
+                        /* sparse and frequent restarts */
+                        success &= test_translate(prim, in_index_size, in_pv, out_pv, pr,
+                                                  starts[s], counts[c], max_index, 97);
+                        success &= test_translate(prim, in_index_size, in_pv, out_pv, pr,
+                                                  starts[s], counts[c], max_index, 5);
+                     }
+                  }
+               }
+            }
+         }
+      }
+   }
+
+   return success;
+}
+
+static void
+bench_translate(enum pipe_prim_type prim, unsigned in_index_size,
+                unsigned in_pv, unsigned out_pv, unsigned prim_restart)
+{
+   const unsigned iterations = 20;
+   enum pipe_prim_type out_prim;
+   unsigned nr = 1 << 20, out_index_size, out_nr;
+   u_translate_func funcs[2];
+
+   u_trim_pipe_prim(prim, &nr);
+
+   u_index_translator(0, prim, in_index_size, nr, in_pv, out_pv, prim_restart,
+                      &out_prim, &out_index_size, &out_nr, &funcs[0]);
+   funcs[1] = u_index_translate_scalar(in_index_size, out_index_size, in_pv, out_pv,
+                                       prim_restart, prim);
+
+   void *in = malloc(nr * in_index_size);
+   void *out = malloc(out_nr * out_index_size);
+   fill_indices(in, in_index_size, nr, 0, 0);
+
+   int64_t times[2];
+   for (unsigned f = 0; f < 2; f++) {
+      int64_t start = os_time_get_nano();
+      for (unsigned i = 0; i < iterations; i++)
+         funcs[f](in, 0, nr, out_nr, ~0u, out);
+      times[f] = os_time_get_nano() - start;
+   }
+
+   printf("translate %-36s %u -> %u bytes, pv %u -> %u, restart %u  "
+          "%8.3f ms  (%8.3f ms scalar)\n",
+          u_prim_name(prim), in_index_size, out_index_size, in_pv, out_pv,
+          prim_restart, times[0] / 1000000.0 / iterations,
+          times[1] / 1000000.0 / iterations);
+
+   free(in);
+   free(out);
+}
+
+static void
+bench_generate(enum pipe_prim_type prim, unsigned in_pv, unsigned out_pv)
+{
+   const unsigned iterations = 20;
+   enum pipe_prim_type out_prim;
+   unsigned nr = 1 << 20, out_index_size, out_nr;
+   u_generate_func funcs[2];
+
+   u_trim_pipe_prim(prim, &nr);
+
+   u_index_generator(0, prim, 0, nr, in_pv, out_pv,
+                     &out_prim, &out_index_size, &out_nr, &funcs[0]);
+   funcs[1] = u_index_generate_scalar(out_index_size, in_pv, out_pv, prim);
+
+   void *out = malloc(out_nr * out_index_size);
+
+   int64_t times[2];
+   for (unsigned f = 0; f < 2; f++) {
+      int64_t start = os_time_get_nano();
+      for (unsigned i = 0; i < iterations; i++)
+         funcs[f](0, out_nr, out);
+      times[f] = os_time_get_nano() - start;
+   }
+
+   printf("generate  %-36s %u bytes,      pv %u -> %u             "
+          "%8.3f ms  (%8.3f ms scalar)\n",
+          u_prim_name(prim), out_index_size, in_pv, out_pv,
+          times[0] / 1000000.0 / iterations, times[1] / 1000000.0 / iterations);
+
+   free(out);
+}
+
+static void
+bench_all(void)
+{
+   for (enum pipe_prim_type prim = PIPE_PRIM_POINTS; prim < PRIM_COUNT; prim++) {
+      for (unsigned in_index_size = 1; in_index_size <= 4; in_index_size *= 2) {
+         bench_translate(prim, in_index_size, PV_FIRST, PV_LAST, PR_DISABLE);
+         bench_translate(prim, in_index_size, PV_FIRST, PV_LAST, PR_ENABLE);
+      }
+   }
+
+   for (enum pipe_prim_type prim = PIPE_PRIM_POINTS; prim < PRIM_COUNT; prim++)
+      bench_generate(prim, PV_FIRST, PV_LAST);
+}
+
+int main(int argc, char **argv)
+{
+   bool success = test_all();
+
+   if (argc > 1 && !strcmp(argv[1], "--bench"))
+      bench_all();
+
+   return success ? 0 : 1;
+}
@@ -0,0 +1,337 @@
+/*
+ * Copyright © 2022 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Runs calls through a threaded_context wrapping a dummy driver context, and
+ * checks that the driver sees all of them, in order, whether the driver keeps
+ * up or not and with frequent asynchronous flushes. Also checks that
+ * consecutive draws are merged even with redundant CSO binds between them.
+ *
+ * With --bench, prints the number of calls per second the application thread
+ * can record.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_screen.h"
+#include "util/os_time.h"
+#include "util/u_memory.h"
+#include "util/u_threaded_context.h"
+#include "util/u_upload_mgr.h"
+
+struct test_context {
+   struct pipe_context base;
+   thrd_t app_thread;
+   unsigned num_calls;
+   unsigned num_offloaded_calls;
+   unsigned num_flushes;
+   unsigned next_value;
+   unsigned slow_every;
+   unsigned num_draw_calls;
+   unsigned num_draws;
+   unsigned num_binds;
+   bool failed;
+};
+
+static int
+test_get_param(struct pipe_screen *screen, enum pipe_cap param)
+{
+   return 0;
+}
+
+static int
+test_get_shader_param(struct pipe_screen *screen, enum pipe_shader_type shader,
+                      enum pipe_shader_cap param)
+{
+   return 0;
+}
+
+static void
+test_fence_reference(struct pipe_screen *screen,
+                     struct pipe_fence_handle **ptr,
+                     struct pipe_fence_handle *fence)
+{
+   *ptr = fence;
+}
+
+static struct pipe_fence_handle *
+test_create_fence(struct pipe_context *pipe, struct tc_unflushed_batch_token *token)
+{
+   return NULL;
+}
+
+static void
+test_set_sample_mask(struct pipe_context *pipe, unsigned sample_mask)
+{
+   struct test_context *ctx = (struct test_context *)pipe;
+
+   if (sample_mask != ctx->next_value)
+      ctx->failed = true;
+   ctx->next_value = sample_mask + 1;
+   ctx->num_calls++;
+
+   /* the calls still unflushed at the end are executed by the sync */
+   if (!thrd_equal(thrd_current(), ctx->app_thread))
+      ctx->num_offloaded_calls++;
+
+   /* pretend that some calls are expensive for the driver */
+   if (ctx->slow_every && sample_mask % ctx->slow_every == 0)
+      os_time_sleep(50);
+}
+
+static void
+test_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info,
+              unsigned drawid_offset,
+              const struct pipe_draw_indirect_info *indirect,
+              const struct pipe_draw_start_count_bias *draws,
+              unsigned num_draws)
+{
+   struct test_context *ctx = (struct test_context *)pipe;
+
+   /* draws are recorded with start = their index and count = 3 */
+   for (unsigned i = 0; i < num_draws; i++) {
+      if (draws[i].start != ctx->num_draws + i || draws[i].count != 3)
+         ctx->failed = true;
+   }
+   ctx->num_draws += num_draws;
+   ctx->num_draw_calls++;
+}
+
+static void *
+test_create_blend_state(struct pipe_context *pipe,
+                        const struct pipe_blend_state *state)
+{
+   return MALLOC_STRUCT(pipe_blend_state);
+}
+
+static void
+test_bind_blend_state(struct pipe_context *pipe, void *state)
+{
+   struct test_context *ctx = (struct test_context *)pipe;
+   ctx->num_binds++;
+}
+
+static void
+test_delete_blend_state(struct pipe_context *pipe, void *state)
+{
+   FREE(state);
+}
+
+static void
+test_flush(struct pipe_context *pipe, struct pipe_fence_handle **fence,
+           unsigned flags)
+{
+   struct test_context *ctx = (struct test_context *)pipe;
+   ctx->num_flushes++;
+}
+
+static void
+test_destroy(struct pipe_context *pipe)
+{
+   u_upload_destroy(pipe->stream_uploader);
+}
+
+static struct pipe_screen screen = {
+   .get_param = test_get_param,
+   .get_shader_param = test_get_shader_param,
+   .fence_reference = test_fence_reference,
+};
+
+static struct pipe_context *
+create_context(struct test_context *ctx, struct slab_parent_pool *transfer_pool,
+               struct threaded_context **tc)
+{
+   struct threaded_context_options options = {
+      .create_fence = test_create_fence,
+   };
+
+   ctx->base = (struct pipe_context) {
+      .screen = &screen,
+      .set_sample_mask = test_set_sample_mask,
+      .draw_vbo = test_draw_vbo,
+      .create_blend_state = test_create_blend_state,
+      .bind_blend_state = test_bind_blend_state,
+      .delete_blend_state = test_delete_blend_state,
+      .flush = test_flush,
+      .destroy = test_destroy,
+   };
+   ctx->app_thread = thrd_current();
+
+   ctx->base.stream_uploader = u_upload_create(&ctx->base, 1024, 0, PIPE_USAGE_STREAM, 0);
+   ctx->base.const_uploader = ctx->base.stream_uploader;
+
+   slab_create_parent(transfer_pool, 64, 16);
+   return threaded_context_create(&ctx->base, transfer_pool, NULL, &options, tc);
+}
+
+static bool
+run(const char *name, unsigned num_calls, unsigned flush_every,
+    unsigned slow_every, bool bench)
+{
+   struct test_context ctx = {
+      .slow_every = slow_every,
+   };
+   struct slab_parent_pool transfer_pool;
+   struct threaded_context *tc = NULL;
+
+   struct pipe_context *pipe = create_context(&ctx, &transfer_pool, &tc);
+   if (!pipe || !tc) {
+      printf("FAILED: %s: no threaded context\n", name);
+      return false;
+   }
+
+   int64_t start = os_time_get_nano();
+   for (unsigned i = 0; i < num_calls; i++) {
+      pipe->set_sample_mask(pipe, i);
+      if (flush_every && i % flush_every == flush_every - 1)
+         pipe->flush(pipe, NULL, PIPE_FLUSH_ASYNC);
+   }
+   int64_t record_time = os_time_get_nano() - start;
+
+   threaded_context_unwrap_sync(pipe);
+   int64_t total_time = os_time_get_nano() - start;
+
+   bool success = !ctx.failed && ctx.num_calls == num_calls &&
+                  ctx.num_offloaded_calls > 0 &&
+                  ctx.num_flushes == (flush_every ? num_calls / flush_every : 0);
+   if (!success) {
+      printf("FAILED: %s: %u of %u calls, %u on the driver thread, %u flushes%s\n",
+             name, ctx.num_calls, num_calls, ctx.num_offloaded_calls,
+             ctx.num_flushes, ctx.failed ? ", out of order" : "");
+   }
+
+   if (bench) {
+      printf("%-24s %8.2f Mcalls/s recorded  %8.2f Mcalls/s executed  "
+             "%u batches  %u stalls (%.3f ms)\n", name,
+             num_calls * 1000.0 / MAX2(record_time, 1),
+             num_calls * 1000.0 / MAX2(total_time, 1),
+             tc->num_flushed_batches, tc->num_stalls,
+             tc->stall_time_ns / 1000000.0);
+   }
+
+   pipe->destroy(pipe);
+   slab_destroy_parent(&transfer_pool);
+   return success;
+}
+
+/* Draws with the same blend state bound again before each one, which must
+ * still be merged, and with two states alternating, which must not.
+ */
+static bool
+run_draw_merging(bool alternate, bool bench)
+{
+   const unsigned num_draws = 100000;
+   struct test_context ctx = {0};
+   struct slab_parent_pool transfer_pool;
+   struct threaded_context *tc = NULL;
+   struct pipe_blend_state blend = {0};
+
+   struct pipe_context *pipe = create_context(&ctx, &transfer_pool, &tc);
+   if (!pipe || !tc) {
+      printf("FAILED: draw merging: no threaded context\n");
+      return false;
+   }
+
+   void *states[2] = {
+      pipe->create_blend_state(pipe, &blend),
+      pipe->create_blend_state(pipe, &blend),
+   };
+   struct pipe_draw_info info = {
+      .mode = PIPE_PRIM_TRIANGLES,
+      .instance_count = 1,
+   };
+
+   int64_t start = os_time_get_nano();
+   for (unsigned i = 0; i < num_draws; i++) {
+      struct pipe_draw_start_count_bias draw = { .start = i, .count = 3 };
+
+      pipe->bind_blend_state(pipe, states[alternate ? i % 2 : 0]);
+      pipe->draw_vbo(pipe, &info, 0, NULL, &draw, 1);
+   }
+   threaded_context_unwrap_sync(pipe);
+   int64_t time = os_time_get_nano() - start;
+
+   unsigned num_binds = ctx.num_binds;
+
+   /* a deleted CSO is forgotten, even if the next one has the same address */
+   unsigned last = alternate ? (num_draws - 1) % 2 : 0;
+   pipe->delete_blend_state(pipe, states[last]);
+   states[last] = pipe->create_blend_state(pipe, &blend);
+   pipe->bind_blend_state(pipe, states[last]);
+   threaded_context_unwrap_sync(pipe);
+
+   bool success = !ctx.failed && ctx.num_draws == num_draws &&
+                  tc->num_single_draws == num_draws &&
+                  tc->num_merged_draws == num_draws - ctx.num_draw_calls &&
+                  ctx.num_binds == num_binds + 1;
+   if (alternate) {
+      success &= num_binds == num_draws && ctx.num_draw_calls == num_draws;
+   } else {
+      /* only batch boundaries split the draws */
+      success &= num_binds == 1 && ctx.num_draw_calls < num_draws / 10;
+   }
+
+   if (!success) {
+      printf("FAILED: draw merging%s: %u of %u draws in %u calls, "
+             "%u binds%s\n", alternate ? " with state changes" : "",
+             ctx.num_draws, num_draws, ctx.num_draw_calls, ctx.num_binds,
+             ctx.failed ? ", out of order" : "");
+   }
+
+   if (bench) {
+      printf("draw merging%-11s  %8.2f Mdraws/s  %u draws in %u calls  "
+             "%u redundant binds\n", alternate ? ", changes" : "",
+             num_draws * 1000.0 / MAX2(time, 1), ctx.num_draws,
+             ctx.num_draw_calls, tc->num_redundant_binds);
+   }
+
+   pipe->bind_blend_state(pipe, NULL);
+   pipe->delete_blend_state(pipe, states[0]);
+   pipe->delete_blend_state(pipe, states[1]);
+   pipe->destroy(pipe);
+   slab_destroy_parent(&transfer_pool);
+   return success;
+}
+
+int
+main(int argc, char **argv)
+{
+   bool bench = argc > 1 && !strcmp(argv[1], "--bench");
+   unsigned scale = bench ? 16 : 1;
+   bool success = true;
+
+   /* create a threaded context even on a single CPU */
+   setenv("GALLIUM_THREAD", "1", 1);
+
+   success &= run("draw-heavy", 1000000 * scale, 0, 0, bench);
+   success &= run("flush-heavy", 200000 * scale, 10, 0, bench);
+   success &= run("slow driver", 20000 * scale, 0, 1000, bench);
+   success &= run("slow driver, flushes", 20000 * scale, 30, 1000, bench);
+   success &= run_draw_merging(false, bench);
+   success &= run_draw_merging(true, bench);
+
+   return success ? 0 : 1;
+}
@@ -0,0 +1,289 @@
+/*
+ * Copyright © 2022 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Checks that the ring mode of u_upload_mgr reuses full buffers only once
+ * nothing references them and their fence has signalled, and that data
+ * still in use is never overwritten.
+ *
+ * With --bench, prints the upload throughput with and without ring mode.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_screen.h"
+#include "util/os_time.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "util/u_upload_mgr.h"
+
+struct test_resource {
+   struct pipe_resource base;
+   uint8_t *data;
+   /* the fence of the flush after which the buffer was last used */
+   uintptr_t last_use;
+};
+
+struct test_screen {
+   struct pipe_screen base;
+   bool persistent;
+   unsigned num_buffers;
+   unsigned num_live_buffers;
+   /* fences are sequence numbers, signalled up to completed_fence */
+   uintptr_t last_fence;
+   uintptr_t completed_fence;
+};
+
+static int
+test_get_param(struct pipe_screen *_screen, enum pipe_cap param)
+{
+   struct test_screen *screen = (struct test_screen *)_screen;
+
+   return param == PIPE_CAP_BUFFER_MAP_PERSISTENT_COHERENT && screen->persistent;
+}
+
+static struct pipe_resource *
+test_resource_create(struct pipe_screen *_screen,
+                     const struct pipe_resource *templ)
+{
+   struct test_screen *screen = (struct test_screen *)_screen;
+   struct test_resource *res = CALLOC_STRUCT(test_resource);
+
+   res->base = *templ;
+   res->base.screen = _screen;
+   pipe_reference_init(&res->base.reference, 1);
+   res->data = MALLOC(templ->width0);
+   screen->num_buffers++;
+   screen->num_live_buffers++;
+   return &res->base;
+}
+
+static void
+test_resource_destroy(struct pipe_screen *_screen, struct pipe_resource *pres)
+{
+   struct test_screen *screen = (struct test_screen *)_screen;
+   struct test_resource *res = (struct test_resource *)pres;
+
+   screen->num_live_buffers--;
+   FREE(res->data);
+   FREE(res);
+}
+
+static void
+test_fence_reference(struct pipe_screen *screen,
+                     struct pipe_fence_handle **ptr,
+                     struct pipe_fence_handle *fence)
+{
+   *ptr = fence;
+}
+
+static bool
+test_fence_finish(struct pipe_screen *_screen, struct pipe_context *ctx,
+                  struct pipe_fence_handle *fence, uint64_t timeout)
+{
+   struct test_screen *screen = (struct test_screen *)_screen;
+
+   return (uintptr_t)fence <= screen->completed_fence;
+}
+
+static void *
+test_buffer_map(struct pipe_context *pipe, struct pipe_resource *pres,
+                unsigned level, unsigned usage, const struct pipe_box *box,
+                struct pipe_transfer **out_transfer)
+{
+   struct pipe_transfer *transfer = CALLOC_STRUCT(pipe_transfer);
+
+   pipe_resource_reference(&transfer->resource, pres);
+   transfer->usage = usage;
+   transfer->box = *box;
+   *out_transfer = transfer;
+   return ((struct test_resource *)pres)->data + box->x;
+}
+
+static void
+test_buffer_unmap(struct pipe_context *pipe, struct pipe_transfer *transfer)
+{
+   pipe_resource_reference(&transfer->resource, NULL);
+   FREE(transfer);
+}
+
+static void
+test_transfer_flush_region(struct pipe_context *pipe,
+                           struct pipe_transfer *transfer,
+                           const struct pipe_box *box)
+{
+}
+
+static void
+test_flush(struct pipe_context *pipe, struct pipe_fence_handle **fence,
+           unsigned flags)
+{
+   struct test_screen *screen = (struct test_screen *)pipe->screen;
+
+   if (fence)
+      *fence = (struct pipe_fence_handle *)++screen->last_fence;
+}
+
+#define UPLOAD_SIZE 256
+#define BUFFER_SIZE 4096
+#define NUM_HELD 4
+
+static uint8_t
+pattern(unsigned upload, unsigned i)
+{
+   return upload * 7 + i;
+}
+
+static bool
+run(const char *name, bool persistent, bool ring, bool fenced, bool bench)
+{
+   struct test_screen screen = {
+      .base = {
+         .get_param = test_get_param,
+         .resource_create = test_resource_create,
+         .resource_destroy = test_resource_destroy,
+         .fence_reference = test_fence_reference,
+         .fence_finish = test_fence_finish,
+      },
+      .persistent = persistent,
+   };
+   struct pipe_context pipe = {
+      .screen = &screen.base,
+      .buffer_map = test_buffer_map,
+      .buffer_unmap = test_buffer_unmap,
+      .transfer_flush_region = test_transfer_flush_region,
+      .flush = test_flush,
+   };
+   const unsigned num_uploads = bench ? 10000000 : 100000;
+   struct pipe_resource *held[NUM_HELD] = {0};
+   unsigned held_offset[NUM_HELD], held_upload[NUM_HELD];
+   struct test_resource *current = NULL;
+   bool success = true;
+
+   struct u_upload_mgr *upload =
+      u_upload_create(&pipe, BUFFER_SIZE, PIPE_BIND_VERTEX_BUFFER,
+                      PIPE_USAGE_STREAM, 0);
+   if (ring)
+      u_upload_enable_ring(upload, fenced);
+
+   int64_t start = os_time_get_nano();
+   for (unsigned i = 0; i < num_uploads; i++) {
+      struct pipe_resource *buffer = NULL;
+      unsigned offset;
+      uint8_t *ptr;
+
+      u_upload_alloc(upload, 0, UPLOAD_SIZE, 16, &offset, &buffer,
+                     (void **)&ptr);
+      if (!ptr) {
+         printf("FAILED: %s: allocation failed\n", name);
+         success = false;
+         break;
+      }
+
+      /* a reused buffer must not be in use by the "GPU" anymore */
+      struct test_resource *res = (struct test_resource *)buffer;
+      if (fenced && res != current && res->last_use > screen.completed_fence) {
+         printf("FAILED: %s: busy buffer reused\n", name);
+         pipe_resource_reference(&buffer, NULL);
+         success = false;
+         break;
+      }
+      res->last_use = screen.last_fence + 1;
+      current = res;
+
+      for (unsigned j = 0; j < UPLOAD_SIZE; j++)
+         ptr[j] = pattern(i, j);
+
+      /* keep some uploads referenced for a while, like bound buffers */
+      if (i % 101 == 0) {
+         unsigned h = (i / 101) % NUM_HELD;
+
+         if (held[h]) {
+            const uint8_t *data =
+               ((struct test_resource *)held[h])->data + held_offset[h];
+            for (unsigned j = 0; j < UPLOAD_SIZE; j++) {
+               if (data[j] != pattern(held_upload[h], j)) {
+                  printf("FAILED: %s: upload %u was overwritten\n", name,
+                         held_upload[h]);
+                  success = false;
+                  break;
+               }
+            }
+         }
+         pipe_resource_reference(&held[h], buffer);
+         held_offset[h] = offset;
+         held_upload[h] = i;
+      }
+      pipe_resource_reference(&buffer, NULL);
+
+      /* the "GPU" is always one flush behind */
+      if (screen.last_fence)
+         screen.completed_fence = screen.last_fence - 1;
+   }
+   int64_t time = os_time_get_nano() - start;
+
+   unsigned num_buffers = screen.num_buffers;
+   unsigned max_buffers = DIV_ROUND_UP(num_uploads * UPLOAD_SIZE, BUFFER_SIZE);
+
+   if (ring && num_buffers > max_buffers / 20) {
+      printf("FAILED: %s: %u buffers allocated\n", name, num_buffers);
+      success = false;
+   }
+   if (!ring && num_buffers < max_buffers) {
+      printf("FAILED: %s: only %u buffers allocated\n", name, num_buffers);
+      success = false;
+   }
+
+   for (unsigned h = 0; h < NUM_HELD; h++)
+      pipe_resource_reference(&held[h], NULL);
+   u_upload_destroy(upload);
+
+   if (screen.num_live_buffers) {
+      printf("FAILED: %s: %u buffers leaked\n", name, screen.num_live_buffers);
+      success = false;
+   }
+
+   if (bench) {
+      printf("%-28s %8.2f GB/s  %u buffers allocated\n", name,
+             (double)num_uploads * UPLOAD_SIZE / MAX2(time, 1), num_buffers);
+   }
+
+   return success;
+}
+
+int
+main(int argc, char **argv)
+{
+   bool bench = argc > 1 && !strcmp(argv[1], "--bench");
+   bool success = true;
+
+   success &= run("persistent", true, false, false, bench);
+   success &= run("persistent, ring", true, true, false, bench);
+   success &= run("persistent, fenced ring", true, true, true, bench);
+   success &= run("unsynchronized, fenced ring", false, true, true, bench);
+
+   return success ? 0 : 1;
+}
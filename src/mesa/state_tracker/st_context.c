@@ -516,7 +516,7 @@ st_create_context_priv(struct gl_context *ctx, struct pipe_context *pipe,
       break;
    }
 
-   st->cso_context = cso_create_context(pipe, cso_flags);
+   st->cso_context = cso_create_context(pipe, cso_flags | CSO_SHARED_CACHE);
    ctx->cso_context = st->cso_context;
 
    st_init_atoms(st);
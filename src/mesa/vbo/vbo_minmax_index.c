@@ -30,9 +30,8 @@
 #include "main/context.h"
 #include "main/varray.h"
 #include "main/macros.h"
-#include "main/sse_minmax.h"
-#include "x86/common_x86_asm.h"
 #include "util/hash_table.h"
+#include "util/indices/u_index_minmax.h"
 #include "util/u_memory.h"
 #include "pipe/p_state.h"
 
@@ -40,6 +39,9 @@ struct minmax_cache_key {
    GLintptr offset;
    GLuint count;
    unsigned index_size;
+   /* Restart indices are skipped, so they change the result. */
+   unsigned primitive_restart;
+   unsigned restart_index;
 };
 
 
@@ -62,7 +64,9 @@ vbo_minmax_cache_key_equal(const struct minmax_cache_key *a,
                            const struct minmax_cache_key *b)
 {
    return (a->offset == b->offset) && (a->count == b->count) &&
-          (a->index_size == b->index_size);
+          (a->index_size == b->index_size) &&
+          (a->primitive_restart == b->primitive_restart) &&
+          (a->restart_index == b->restart_index);
 }
 
 
@@ -104,6 +108,7 @@ vbo_delete_minmax_cache(struct gl_buffer_object *bufferObj)
 static GLboolean
 vbo_get_minmax_cached(struct gl_buffer_object *bufferObj,
                       unsigned index_size, GLintptr offset, GLuint count,
+                      bool primitive_restart, unsigned restart_index,
                       GLuint *min_index, GLuint *max_index)
 {
    GLboolean found = GL_FALSE;
@@ -142,6 +147,8 @@ vbo_get_minmax_cached(struct gl_buffer_object *bufferObj,
    key.index_size = index_size;
    key.offset = offset;
    key.count = count;
+   key.primitive_restart = primitive_restart;
+   key.restart_index = primitive_restart ? restart_index : 0;
    hash = vbo_minmax_cache_hash(&key);
    result = _mesa_hash_table_search_pre_hashed(bufferObj->MinMaxCache, hash, &key);
    if (result) {
@@ -176,6 +183,7 @@ static void
 vbo_minmax_cache_store(struct gl_context *ctx,
                        struct gl_buffer_object *bufferObj,
                        unsigned index_size, GLintptr offset, GLuint count,
+                       bool primitive_restart, unsigned restart_index,
                        GLuint min, GLuint max)
 {
    struct minmax_cache_entry *entry;
@@ -203,6 +211,8 @@ vbo_minmax_cache_store(struct gl_context *ctx,
    entry->key.offset = offset;
    entry->key.count = count;
    entry->key.index_size = index_size;
+   entry->key.primitive_restart = primitive_restart;
+   entry->key.restart_index = primitive_restart ? restart_index : 0;
    entry->min = min;
    entry->max = max;
    hash = vbo_minmax_cache_hash(&entry->key);
@@ -234,82 +244,8 @@ vbo_get_minmax_index_mapped(unsigned count, unsigned index_size,
                             const void *indices,
                             unsigned *min_index, unsigned *max_index)
 {
-   switch (index_size) {
-   case 4: {
-      const GLuint *ui_indices = (const GLuint *)indices;
-      GLuint max_ui = 0;
-      GLuint min_ui = ~0U;
-      if (restart) {
-         for (unsigned i = 0; i < count; i++) {
-            if (ui_indices[i] != restartIndex) {
-               if (ui_indices[i] > max_ui) max_ui = ui_indices[i];
-               if (ui_indices[i] < min_ui) min_ui = ui_indices[i];
-            }
-         }
-      }
-      else {
-#if defined(USE_SSE41)
-         if (cpu_has_sse4_1) {
-            _mesa_uint_array_min_max(ui_indices, &min_ui, &max_ui, count);
-         }
-         else
-#endif
-            for (unsigned i = 0; i < count; i++) {
-               if (ui_indices[i] > max_ui) max_ui = ui_indices[i];
-               if (ui_indices[i] < min_ui) min_ui = ui_indices[i];
-            }
-      }
-      *min_index = min_ui;
-      *max_index = max_ui;
-      break;
-   }
-   case 2: {
-      const GLushort *us_indices = (const GLushort *)indices;
-      GLuint max_us = 0;
-      GLuint min_us = ~0U;
-      if (restart) {
-         for (unsigned i = 0; i < count; i++) {
-            if (us_indices[i] != restartIndex) {
-               if (us_indices[i] > max_us) max_us = us_indices[i];
-               if (us_indices[i] < min_us) min_us = us_indices[i];
-            }
-         }
-      }
-      else {
-         for (unsigned i = 0; i < count; i++) {
-            if (us_indices[i] > max_us) max_us = us_indices[i];
-            if (us_indices[i] < min_us) min_us = us_indices[i];
-         }
-      }
-      *min_index = min_us;
-      *max_index = max_us;
-      break;
-   }
-   case 1: {
-      const GLubyte *ub_indices = (const GLubyte *)indices;
-      GLuint max_ub = 0;
-      GLuint min_ub = ~0U;
-      if (restart) {
-         for (unsigned i = 0; i < count; i++) {
-            if (ub_indices[i] != restartIndex) {
-               if (ub_indices[i] > max_ub) max_ub = ub_indices[i];
-               if (ub_indices[i] < min_ub) min_ub = ub_indices[i];
-            }
-         }
-      }
-      else {
-         for (unsigned i = 0; i < count; i++) {
-            if (ub_indices[i] > max_ub) max_ub = ub_indices[i];
-            if (ub_indices[i] < min_ub) min_ub = ub_indices[i];
-         }
-      }
-      *min_index = min_ub;
-      *max_index = max_ub;
-      break;
-   }
-   default:
-      unreachable("not reached");
-   }
+   util_index_minmax(indices, index_size, count, restart, restartIndex,
+                     min_index, max_index);
 }
 
 
@@ -333,8 +269,9 @@ vbo_get_minmax_index(struct gl_context *ctx, struct gl_buffer_object *obj,
    } else {
       GLsizeiptr size = MIN2((GLsizeiptr)count * index_size, obj->Size);
 
-      if (vbo_get_minmax_cached(obj, index_size, offset, count, min_index,
-                                max_index))
+      if (vbo_get_minmax_cached(obj, index_size, offset, count,
+                                primitive_restart, restart_index,
+                                min_index, max_index))
          return;
 
       indices = _mesa_bufferobj_map_range(ctx, offset, size, GL_MAP_READ_BIT,
@@ -346,8 +283,9 @@ vbo_get_minmax_index(struct gl_context *ctx, struct gl_buffer_object *obj,
                                min_index, max_index);
 
    if (obj) {
-      vbo_minmax_cache_store(ctx, obj, index_size, offset, count, *min_index,
-                             *max_index);
+      vbo_minmax_cache_store(ctx, obj, index_size, offset, count,
+                             primitive_restart, restart_index,
+                             *min_index, *max_index);
       _mesa_bufferobj_unmap(ctx, obj, MAP_INTERNAL);
    }
 }
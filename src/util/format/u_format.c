@@ -34,8 +34,11 @@
 
 #include "util/format/u_format.h"
 #include "util/format/u_format_s3tc.h"
+#include "util/debug.h"
+#include "util/u_atomic.h"
 #include "util/u_cpu_detect.h"
 #include "util/u_math.h"
+#include "util/u_queue.h"
 
 #include "pipe/p_defines.h"
 #include "pipe/p_screen.h"
@@ -637,14 +640,75 @@ util_format_fits_8unorm(const struct util_format_description *format_desc)
 }
 
 
-boolean
-util_format_translate(enum pipe_format dst_format,
-                      void *dst, unsigned dst_stride,
-                      unsigned dst_x, unsigned dst_y,
-                      enum pipe_format src_format,
-                      const void *src, unsigned src_stride,
-                      unsigned src_x, unsigned src_y,
-                      unsigned width, unsigned height)
+/**
+ * Converts between two linear util_format_is_rgba8_variant() formats in a
+ * single pass, moving bytes around instead of going through a temporary
+ * RGBA8 row.  The result is the same as unpacking to and packing from
+ * 8unorm: missing source components read as 0 or 255 as given by the
+ * swizzle and padding channels are written as 0.
+ */
+static void
+translate_rgba8_swizzle(const struct util_format_description *dst_desc,
+                        uint8_t *dst_row, unsigned dst_stride,
+                        const struct util_format_description *src_desc,
+                        const uint8_t *src_row, unsigned src_stride,
+                        unsigned width, unsigned height)
+{
+   uint32_t src_shift[4], src_mask[4], fill = 0;
+
+   for (unsigned chan = 0; chan < 4; chan++) {
+      unsigned dst_shift = dst_desc->channel[chan].shift;
+      src_shift[chan] = 0;
+      src_mask[chan] = 0;
+
+      if (dst_desc->channel[chan].type == UTIL_FORMAT_TYPE_VOID)
+         continue;
+
+      for (unsigned comp = 0; comp < 4; comp++) {
+         if (dst_desc->swizzle[comp] != chan)
+            continue;
+
+         unsigned swz = src_desc->swizzle[comp];
+         if (swz <= PIPE_SWIZZLE_W) {
+            /* rotate right by this much to move the byte into place */
+            src_shift[chan] = (src_desc->channel[swz].shift - dst_shift) & 31;
+            src_mask[chan] = 0xffu << dst_shift;
+         } else if (swz == PIPE_SWIZZLE_1) {
+            fill |= 0xffu << dst_shift;
+         }
+         break;
+      }
+   }
+
+   for (unsigned y = 0; y < height; y++) {
+      const uint8_t *src = src_row;
+      uint8_t *dst = dst_row;
+
+      for (unsigned x = 0; x < width; x++) {
+         uint32_t in, out = fill;
+         memcpy(&in, src, 4);
+         for (unsigned chan = 0; chan < 4; chan++) {
+            unsigned r = src_shift[chan];
+            out |= ((in >> r) | (in << ((32 - r) & 31))) & src_mask[chan];
+         }
+         memcpy(dst, &out, 4);
+         src += 4;
+         dst += 4;
+      }
+
+      src_row += src_stride;
+      dst_row += dst_stride;
+   }
+}
+
+static boolean
+translate_serial(enum pipe_format dst_format,
+                 void *dst, unsigned dst_stride,
+                 unsigned dst_x, unsigned dst_y,
+                 enum pipe_format src_format,
+                 const void *src, unsigned src_stride,
+                 unsigned src_x, unsigned src_y,
+                 unsigned width, unsigned height)
 {
    const struct util_format_description *dst_format_desc;
    const struct util_format_description *src_format_desc;
@@ -677,8 +741,12 @@ util_format_translate(enum pipe_format dst_format,
    assert(src_x % src_format_desc->block.width == 0);
    assert(src_y % src_format_desc->block.height == 0);
 
-   dst_row = (uint8_t *)dst + dst_y*dst_stride + dst_x*(dst_format_desc->block.bits/8);
-   src_row = (const uint8_t *)src + src_y*src_stride + src_x*(src_format_desc->block.bits/8);
+   dst_row = (uint8_t *)dst +
+             dst_y / dst_format_desc->block.height * dst_stride +
+             dst_x / dst_format_desc->block.width * (dst_format_desc->block.bits/8);
+   src_row = (const uint8_t *)src +
+             src_y / src_format_desc->block.height * src_stride +
+             src_x / src_format_desc->block.width * (src_format_desc->block.bits/8);
 
    /*
     * This works because all pixel formats have pixel blocks with power of two
@@ -736,6 +804,18 @@ util_format_translate(enum pipe_format dst_format,
       return TRUE;
    }
 
+#if UTIL_ARCH_LITTLE_ENDIAN
+   if (src_format_desc->colorspace == UTIL_FORMAT_COLORSPACE_RGB &&
+       dst_format_desc->colorspace == UTIL_FORMAT_COLORSPACE_RGB &&
+       util_format_is_rgba8_variant(src_format_desc) &&
+       util_format_is_rgba8_variant(dst_format_desc)) {
+      translate_rgba8_swizzle(dst_format_desc, dst_row, dst_stride,
+                              src_format_desc, src_row, src_stride,
+                              width, height);
+      return TRUE;
+   }
+#endif
+
    if (util_format_fits_8unorm(src_format_desc) ||
        util_format_fits_8unorm(dst_format_desc)) {
       unsigned tmp_stride;
@@ -862,6 +942,157 @@ util_format_translate(enum pipe_format dst_format,
    return TRUE;
 }
 
+/* Smaller rectangles are converted on the calling thread */
+#define TRANSLATE_MT_MIN_PIXELS (512 * 512)
+/* Roughly how many pixels each thread converts at a time */
+#define TRANSLATE_STRIP_PIXELS (64 * 1024)
+#define TRANSLATE_MAX_JOBS 16
+
+static struct util_queue translate_queue;
+static unsigned translate_threads;
+static once_flag translate_queue_once = ONCE_FLAG_INIT;
+
+static void
+translate_queue_init(void)
+{
+   /* The pool is process-wide and isn't recreated in forked children, so
+    * it is only started on request.
+    */
+   unsigned num_threads = env_var_as_unsigned("MESA_FORMAT_TRANSLATE_THREADS", 0);
+   if (num_threads == 0)
+      return;
+
+   util_cpu_detect();
+   unsigned num_cpus = util_get_cpu_caps()->nr_cpus;
+   if (num_cpus <= 1)
+      return;
+
+   num_threads = MIN3(num_threads, num_cpus - 1, TRANSLATE_MAX_JOBS);
+
+   if (util_queue_init(&translate_queue, "fmt_translate", 32, num_threads,
+                       UTIL_QUEUE_INIT_RESIZE_IF_FULL |
+                       UTIL_QUEUE_INIT_SET_FULL_THREAD_AFFINITY, NULL))
+      translate_threads = num_threads;
+}
+
+struct translate_batch {
+   enum pipe_format dst_format;
+   void *dst;
+   unsigned dst_stride, dst_x, dst_y;
+   enum pipe_format src_format;
+   const void *src;
+   unsigned src_stride, src_x, src_y;
+   unsigned width, height;
+
+   unsigned strip_height;
+   unsigned num_strips;
+
+   /* Next strip to pick up */
+   unsigned next;
+   unsigned failed;
+};
+
+static void
+translate_batch_run(struct translate_batch *batch)
+{
+   while (true) {
+      unsigned i = p_atomic_inc_return(&batch->next) - 1;
+      if (i >= batch->num_strips)
+         break;
+
+      unsigned y = i * batch->strip_height;
+      unsigned height = MIN2(batch->strip_height, batch->height - y);
+      if (!translate_serial(batch->dst_format, batch->dst, batch->dst_stride,
+                            batch->dst_x, batch->dst_y + y,
+                            batch->src_format, batch->src, batch->src_stride,
+                            batch->src_x, batch->src_y + y,
+                            batch->width, height))
+         p_atomic_set(&batch->failed, 1);
+   }
+}
+
+static void
+translate_batch_job(void *job, void *gdata, int thread_index)
+{
+   translate_batch_run(job);
+}
+
+/**
+ * Converts a rectangle of pixels from one format to another.
+ *
+ * Large rectangles are split into strips of rows which are converted in
+ * parallel by a process-wide pool of threads, with the calling thread
+ * working alongside them.  MESA_FORMAT_TRANSLATE_THREADS sets the size of
+ * the pool; by default there is none and everything is converted on the
+ * calling thread.
+ */
+boolean
+util_format_translate(enum pipe_format dst_format,
+                      void *dst, unsigned dst_stride,
+                      unsigned dst_x, unsigned dst_y,
+                      enum pipe_format src_format,
+                      const void *src, unsigned src_stride,
+                      unsigned src_x, unsigned src_y,
+                      unsigned width, unsigned height)
+{
+   const struct util_format_description *dst_desc =
+      util_format_description(dst_format);
+   const struct util_format_description *src_desc =
+      util_format_description(src_format);
+
+   unsigned num_strips = 0, strip_height = 0;
+   if ((uint64_t)width * height >= TRANSLATE_MT_MIN_PIXELS &&
+       !util_is_format_compatible(src_desc, dst_desc)) {
+      call_once(&translate_queue_once, translate_queue_init);
+
+      /* Strips have to start on block boundaries in both formats */
+      unsigned y_step = MAX2(dst_desc->block.height, src_desc->block.height);
+      strip_height = align(DIV_ROUND_UP(TRANSLATE_STRIP_PIXELS, width), y_step);
+      num_strips = DIV_ROUND_UP(height, strip_height);
+   }
+
+   if (num_strips < 2 || translate_threads == 0) {
+      return translate_serial(dst_format, dst, dst_stride, dst_x, dst_y,
+                              src_format, src, src_stride, src_x, src_y,
+                              width, height);
+   }
+
+   struct translate_batch batch = {
+      .dst_format = dst_format,
+      .dst = dst,
+      .dst_stride = dst_stride,
+      .dst_x = dst_x,
+      .dst_y = dst_y,
+      .src_format = src_format,
+      .src = src,
+      .src_stride = src_stride,
+      .src_x = src_x,
+      .src_y = src_y,
+      .width = width,
+      .height = height,
+      .strip_height = strip_height,
+      .num_strips = num_strips,
+   };
+
+   /* The calling thread is a worker too */
+   struct util_queue_fence fences[TRANSLATE_MAX_JOBS];
+   unsigned num_jobs = MIN2(translate_threads, num_strips - 1);
+   for (unsigned i = 0; i < num_jobs; i++) {
+      util_queue_fence_init(&fences[i]);
+      util_queue_add_job(&translate_queue, &batch, &fences[i],
+                         translate_batch_job, NULL, 0);
+   }
+
+   translate_batch_run(&batch);
+
+   for (unsigned i = 0; i < num_jobs; i++) {
+      util_queue_fence_wait(&fences[i]);
+      util_queue_fence_destroy(&fences[i]);
+   }
+
+   return !batch.failed;
+}
+
 boolean
 util_format_translate_3d(enum pipe_format dst_format,
                          void *dst, unsigned dst_stride,
@@ -1179,20 +1410,41 @@ util_format_rgb_to_bgr(enum pipe_format format)
 }
 
 static const struct util_format_unpack_description *util_format_unpack_table[PIPE_FORMAT_COUNT];
+static const struct util_format_pack_description *util_format_pack_table[PIPE_FORMAT_COUNT];
+
+/* Copies of the generic descriptions with vectorized functions swapped in */
+static struct util_format_unpack_description util_format_unpack_simd[PIPE_FORMAT_COUNT];
+static struct util_format_pack_description util_format_pack_simd[PIPE_FORMAT_COUNT];
 
 static void
 util_format_unpack_table_init(void)
 {
+   util_cpu_detect();
+
    for (enum pipe_format format = PIPE_FORMAT_NONE; format < PIPE_FORMAT_COUNT; format++) {
 #if (defined(PIPE_ARCH_AARCH64) || defined(PIPE_ARCH_ARM)) && !defined(NO_FORMAT_ASM) && !defined(__SOFTFP__)
-      const struct util_format_unpack_description *unpack = util_format_unpack_description_neon(format);
-      if (unpack) {
-         util_format_unpack_table[format] = unpack;
+      const struct util_format_unpack_description *neon = util_format_unpack_description_neon(format);
+      if (neon) {
+         util_format_unpack_table[format] = neon;
          continue;
       }
 #endif
 
-      util_format_unpack_table[format] = util_format_unpack_description_generic(format);
+      struct util_format_unpack_description unpack =
+         *util_format_unpack_description_generic(format);
+      bool simd = false;
+
+#if defined(USE_SSE41)
+      if (util_get_cpu_caps()->has_sse4_1)
+         simd = util_format_unpack_description_sse41(format, &unpack);
+#endif
+
+      if (simd) {
+         util_format_unpack_simd[format] = unpack;
+         util_format_unpack_table[format] = &util_format_unpack_simd[format];
+      } else {
+         util_format_unpack_table[format] = util_format_unpack_description_generic(format);
+      }
    }
 }
 
@@ -1205,6 +1457,39 @@ util_format_unpack_description(enum pipe_format format)
    return util_format_unpack_table[format];
 }
 
+static void
+util_format_pack_table_init(void)
+{
+   util_cpu_detect();
+
+   for (enum pipe_format format = PIPE_FORMAT_NONE; format < PIPE_FORMAT_COUNT; format++) {
+      struct util_format_pack_description pack =
+         *util_format_pack_description_generic(format);
+      bool simd = false;
+
+#if defined(USE_SSE41)
+      if (util_get_cpu_caps()->has_sse4_1)
+         simd = util_format_pack_description_sse41(format, &pack);
+#endif
+
+      if (simd) {
+         util_format_pack_simd[format] = pack;
+         util_format_pack_table[format] = &util_format_pack_simd[format];
+      } else {
+         util_format_pack_table[format] = util_format_pack_description_generic(format);
+      }
+   }
+}
+
+const struct util_format_pack_description *
+util_format_pack_description(enum pipe_format format)
+{
+   static once_flag flag = ONCE_FLAG_INIT;
+   call_once(&flag, util_format_pack_table_init);
+
+   return util_format_pack_table[format];
+}
+
 enum pipe_format
 util_format_snorm_to_unorm(enum pipe_format format)
 {
@@ -414,6 +414,7 @@ typedef void (*util_format_fetch_rgba_func_ptr)(void *restrict dst, const uint8_
 const struct util_format_description *
 util_format_description(enum pipe_format format) ATTRIBUTE_CONST;
 
+/* Lookup with CPU detection for choosing optimized paths. */
 const struct util_format_pack_description *
 util_format_pack_description(enum pipe_format format) ATTRIBUTE_CONST;
 
@@ -428,6 +429,20 @@ util_format_unpack_description_generic(enum pipe_format format) ATTRIBUTE_CONST;
 const struct util_format_unpack_description *
 util_format_unpack_description_neon(enum pipe_format format) ATTRIBUTE_CONST;
 
+/* Codegenned table of CPU-agnostic pack code. */
+const struct util_format_pack_description *
+util_format_pack_description_generic(enum pipe_format format) ATTRIBUTE_CONST;
+
+/* Replace the functions in desc which have a vectorized version for the
+ * format, and return whether there were any.  Generated by u_format_simd.py.
+ */
+bool
+util_format_unpack_description_sse41(enum pipe_format format,
+                                     struct util_format_unpack_description *desc);
+bool
+util_format_pack_description_sse41(enum pipe_format format,
+                                   struct util_format_pack_description *desc);
+
 #ifdef __GNUC__
 #pragma GCC diagnostic pop
 #endif
@@ -0,0 +1,582 @@
+CopyRight = '''
+/*
+ * Copyright © 2022 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+'''
+
+'''
+Generates vectorized pack/unpack kernels for the most common formats.
+
+The kernels are picked per format from a few families, based on the layout
+described in u_format.csv.  They process several pixels per iteration and
+leave the remainder of a row to the generic scalar code, whose results they
+reproduce bit for bit.
+'''
+
+import argparse
+import sys
+
+from u_format_parse import *
+import u_format_pack
+
+
+def is_rgba8_unorm(format):
+    '''Linear ?8?8?8?8_UNORM layouts, with optional padding channels.'''
+    if format.layout != PLAIN or format.colorspace != RGB:
+        return False
+    if format.block_size() != 32 or format.nr_channels() != 4:
+        return False
+    for channel in format.le_channels:
+        if channel.size != 8:
+            return False
+        if channel.type != VOID and (channel.type != UNSIGNED or not channel.norm):
+            return False
+    return True
+
+
+def is_unorm_bitmask32(format):
+    '''Other 32-bit formats made of unorm bitfields, like R10G10B10A2_UNORM.'''
+    if format.layout != PLAIN or format.colorspace != RGB:
+        return False
+    if format.block_size() != 32 or is_rgba8_unorm(format):
+        return False
+    for channel in format.le_channels:
+        if channel.type != VOID and (channel.type != UNSIGNED or not channel.norm):
+            return False
+        # converted through signed 32-bit integers
+        if channel.size > 24:
+            return False
+    return True
+
+
+def is_rgba16_float(format):
+    '''R16G16B16A16_FLOAT and its padded variant.'''
+    if format.layout != PLAIN or format.colorspace != RGB:
+        return False
+    if format.block_size() != 64 or format.nr_channels() != 4:
+        return False
+    for i, channel in enumerate(format.le_channels):
+        if channel.size != 16:
+            return False
+        if channel.type == VOID:
+            if format.le_swizzles[i] != SWIZZLE_1:
+                return False
+        elif channel.type != FLOAT or format.le_swizzles[i] != i:
+            return False
+    return True
+
+
+def is_r11g11b10_float(format):
+    return format.name == 'PIPE_FORMAT_R11G11B10_FLOAT'
+
+
+def is_z24_32(format):
+    '''Packed 24-bit unorm depth in a 32-bit word, with stencil or padding.'''
+    if format.layout != PLAIN or format.colorspace != ZS:
+        return False
+    if format.block_size() != 32:
+        return False
+    depth = format.le_swizzles[0]
+    return depth < 4 and format.le_channels[depth].size == 24
+
+
+def has_stencil8(format):
+    stencil = format.le_swizzles[1]
+    return stencil < 4 and format.le_channels[stencil].size == 8
+
+
+def rgba8_unpack_bytes(format):
+    '''For each RGBA component, the source byte holding it, or a constant.'''
+    bytes = []
+    for comp in range(4):
+        swizzle = format.le_swizzles[comp]
+        if swizzle < 4:
+            bytes.append((format.le_channels[swizzle].shift // 8, None))
+        elif swizzle == SWIZZLE_1:
+            bytes.append((None, 0xff))
+        else:
+            bytes.append((None, 0))
+    return bytes
+
+
+def rgba8_pack_bytes(format):
+    '''For each destination byte, the RGBA component to store in it, or None.'''
+    inv_swizzle = u_format_pack.inv_swizzles(format.le_swizzles)
+    bytes = [None] * 4
+    for i, channel in enumerate(format.le_channels):
+        if channel.type != VOID:
+            bytes[channel.shift // 8] = inv_swizzle[i]
+    return bytes
+
+
+def is_rgba8_identity(format):
+    '''The generic 8unorm pack/unpack is a plain copy, which is faster than
+    any shuffle.'''
+    return (rgba8_unpack_bytes(format) == [(i, None) for i in range(4)] and
+            rgba8_pack_bytes(format) == list(range(4)))
+
+
+def fill_constant(bytes):
+    '''32-bit value or-ed into each pixel for the constant components.'''
+    value = 0
+    for i, (src, const) in enumerate(bytes):
+        if src is None and const:
+            value |= const << (8 * i)
+    return value
+
+
+#
+# SSE4.1
+#
+
+def sse41_shuffle(indices):
+    '''A _mm_shuffle_epi8 mask applying the per-pixel byte indices to 4 pixels.'''
+    mask = []
+    for pixel in range(4):
+        for index in indices:
+            mask.append('-1' if index is None else str(pixel * 4 + index))
+    return '_mm_setr_epi8(%s)' % ', '.join(mask)
+
+
+def sse41_helpers():
+    print('''
+/* Same as ubyte_to_float() */
+static inline __m128
+ubyte_to_float_sse41(__m128i value)
+{
+   return _mm_mul_ps(_mm_cvtepi32_ps(value), _mm_set1_ps(1.0f / 255.0f));
+}
+
+/* Same as float_to_ubyte(), one result per 32-bit lane */
+static inline __m128i
+float_to_ubyte_sse41(__m128 f)
+{
+   __m128 tmp = _mm_add_ps(_mm_mul_ps(f, _mm_set1_ps(255.0f / 256.0f)),
+                           _mm_set1_ps(32768.0f));
+   __m128i value = _mm_and_si128(_mm_castps_si128(tmp), _mm_set1_epi32(0xff));
+
+   /* 0 for NaN and anything <= 0, 255 for anything >= 1 */
+   value = _mm_and_si128(value, _mm_castps_si128(_mm_cmpgt_ps(f, _mm_setzero_ps())));
+   value = _mm_or_si128(value, _mm_and_si128(_mm_castps_si128(_mm_cmpge_ps(f, _mm_set1_ps(1.0f))),
+                                             _mm_set1_epi32(0xff)));
+   return value;
+}
+
+/* Same as _mesa_half_to_float() for the four halves in the low 64 bits */
+static inline __m128
+half_to_float_sse41(__m128i h)
+{
+#if defined(USE_X86_64_ASM)
+   if (util_get_cpu_caps()->has_f16c) {
+      __m128 out;
+      __asm volatile("vcvtph2ps %1, %0" : "=v"(out) : "v"(h));
+      return out;
+   }
+#endif
+
+   /* _mesa_half_to_float_slow() */
+   h = _mm_cvtepu16_epi32(h);
+   __m128i bits = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x7fff)), 13);
+   __m128 f = _mm_mul_ps(_mm_castsi128_ps(bits), _mm_castsi128_ps(_mm_set1_epi32(0xef << 23)));
+   __m128 infnan = _mm_cmpge_ps(f, _mm_set1_ps(65536.0f));
+   f = _mm_or_ps(f, _mm_and_ps(infnan, _mm_castsi128_ps(_mm_set1_epi32(0xff << 23))));
+   __m128i sign = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16);
+   return _mm_or_ps(f, _mm_castsi128_ps(sign));
+}
+
+/* Same as uf11_to_f32() and uf10_to_f32() */
+static inline __m128
+small_float_to_float_sse41(__m128i value, unsigned mantissa_bits)
+{
+   const __m128i mantissa_mask = _mm_set1_epi32((1 << mantissa_bits) - 1);
+   __m128i mantissa = _mm_and_si128(value, mantissa_mask);
+   __m128i exponent = _mm_and_si128(_mm_srli_epi32(value, mantissa_bits), _mm_set1_epi32(0x1f));
+
+   __m128i normal = _mm_or_si128(_mm_slli_epi32(_mm_add_epi32(exponent, _mm_set1_epi32(127 - 15)), 23),
+                                 _mm_sll_epi32(mantissa, _mm_cvtsi32_si128(23 - mantissa_bits)));
+   __m128 denorm = _mm_mul_ps(_mm_cvtepi32_ps(mantissa),
+                              _mm_set1_ps(1.0f / (1 << (14 + mantissa_bits))));
+   __m128i infnan = _mm_or_si128(mantissa, _mm_set1_epi32(0x7f800000));
+
+   __m128i result = _mm_blendv_epi8(normal, infnan,
+                                    _mm_cmpeq_epi32(exponent, _mm_set1_epi32(31)));
+   return _mm_blendv_ps(_mm_castsi128_ps(result), denorm,
+                        _mm_castsi128_ps(_mm_cmpeq_epi32(exponent, _mm_setzero_si128())));
+}
+
+static inline void
+store_transposed_sse41(float *dst, __m128 r, __m128 g, __m128 b, __m128 a)
+{
+   _MM_TRANSPOSE4_PS(r, g, b, a);
+   _mm_storeu_ps(dst + 0, r);
+   _mm_storeu_ps(dst + 4, g);
+   _mm_storeu_ps(dst + 8, b);
+   _mm_storeu_ps(dst + 12, a);
+}''')
+
+
+def sse41_rgba8(format, unpack, pack):
+    sn = format.short_name()
+    unpack_bytes = rgba8_unpack_bytes(format)
+    shuffle = sse41_shuffle([src for src, const in unpack_bytes])
+    fill = fill_constant(unpack_bytes)
+
+    def unpack_to_rgba8(var):
+        print('      %s = _mm_shuffle_epi8(%s, shuffle);' % (var, var))
+        if fill:
+            print('      %s = _mm_or_si128(%s, _mm_set1_epi32(0x%08x));' % (var, var, fill))
+
+    identity = is_rgba8_identity(format)
+
+    if not identity:
+        name = 'util_format_%s_unpack_rgba_8unorm' % sn
+        print()
+        print('static void')
+        print('%s_sse41(uint8_t *restrict dst, const uint8_t *restrict src, unsigned width)' % name)
+        print('{')
+        print('   const __m128i shuffle = %s;' % shuffle)
+        print('   while (width >= 4) {')
+        print('      __m128i pixels = _mm_loadu_si128((const __m128i *)src);')
+        unpack_to_rgba8('pixels')
+        print('      _mm_storeu_si128((__m128i *)dst, pixels);')
+        print('      src += 16;')
+        print('      dst += 16;')
+        print('      width -= 4;')
+        print('   }')
+        print('   if (width)')
+        print('      %s(dst, src, width);' % name)
+        print('}')
+        unpack.append(('unpack_rgba_8unorm', name + '_sse41'))
+
+    name = 'util_format_%s_unpack_rgba_float' % sn
+    print()
+    print('static void')
+    print('%s_sse41(void *restrict dst_row, const uint8_t *restrict src, unsigned width)' % name)
+    print('{')
+    print('   const __m128i shuffle = %s;' % shuffle)
+    print('   float *dst = dst_row;')
+    print('   while (width >= 4) {')
+    print('      __m128i pixels = _mm_loadu_si128((const __m128i *)src);')
+    unpack_to_rgba8('pixels')
+    for i in range(4):
+        print('      _mm_storeu_ps(dst + %u, ubyte_to_float_sse41(_mm_cvtepu8_epi32(_mm_srli_si128(pixels, %u))));' % (4 * i, 4 * i))
+    print('      src += 16;')
+    print('      dst += 16;')
+    print('      width -= 4;')
+    print('   }')
+    print('   if (width)')
+    print('      %s(dst, src, width);' % name)
+    print('}')
+    unpack.append(('unpack_rgba', name + '_sse41'))
+
+    pack_shuffle = sse41_shuffle(rgba8_pack_bytes(format))
+
+    if not identity:
+        name = 'util_format_%s_pack_rgba_8unorm' % sn
+        print()
+        print('static void')
+        print('%s_sse41(uint8_t *restrict dst_row, unsigned dst_stride,' % name)
+        print('   const uint8_t *restrict src_row, unsigned src_stride,')
+        print('   unsigned width, unsigned height)')
+        print('{')
+        print('   const __m128i shuffle = %s;' % pack_shuffle)
+        print('   for (unsigned y = 0; y < height; y++) {')
+        print('      const uint8_t *src = src_row;')
+        print('      uint8_t *dst = dst_row;')
+        print('      unsigned x = width;')
+        print('      while (x >= 4) {')
+        print('         __m128i pixels = _mm_loadu_si128((const __m128i *)src);')
+        print('         _mm_storeu_si128((__m128i *)dst, _mm_shuffle_epi8(pixels, shuffle));')
+        print('         src += 16;')
+        print('         dst += 16;')
+        print('         x -= 4;')
+        print('      }')
+        print('      if (x)')
+        print('         %s(dst, 0, src, 0, x, 1);' % name)
+        print('      dst_row += dst_stride;')
+        print('      src_row += src_stride;')
+        print('   }')
+        print('}')
+        pack.append(('pack_rgba_8unorm', name + '_sse41'))
+
+    name = 'util_format_%s_pack_rgba_float' % sn
+    print()
+    print('static void')
+    print('%s_sse41(uint8_t *restrict dst_row, unsigned dst_stride,' % name)
+    print('   const float *restrict src_row, unsigned src_stride,')
+    print('   unsigned width, unsigned height)')
+    print('{')
+    print('   const __m128i shuffle = %s;' % pack_shuffle)
+    print('   for (unsigned y = 0; y < height; y++) {')
+    print('      const float *src = src_row;')
+    print('      uint8_t *dst = dst_row;')
+    print('      unsigned x = width;')
+    print('      while (x >= 4) {')
+    for i in range(4):
+        print('         __m128i p%u = float_to_ubyte_sse41(_mm_loadu_ps(src + %u));' % (i, 4 * i))
+    print('         __m128i pixels = _mm_packus_epi16(_mm_packus_epi32(p0, p1), _mm_packus_epi32(p2, p3));')
+    print('         _mm_storeu_si128((__m128i *)dst, _mm_shuffle_epi8(pixels, shuffle));')
+    print('         src += 16;')
+    print('         dst += 16;')
+    print('         x -= 4;')
+    print('      }')
+    print('      if (x)')
+    print('         %s(dst, 0, src, 0, x, 1);' % name)
+    print('      dst_row += dst_stride;')
+    print('      src_row += src_stride / sizeof(*src_row);')
+    print('   }')
+    print('}')
+    pack.append(('pack_rgba_float', name + '_sse41'))
+
+
+def sse41_unorm_bitmask32(format, unpack, pack):
+    sn = format.short_name()
+    name = 'util_format_%s_unpack_rgba_float' % sn
+    print()
+    print('static void')
+    print('%s_sse41(void *restrict dst_row, const uint8_t *restrict src, unsigned width)' % name)
+    print('{')
+    print('   float *dst = dst_row;')
+    print('   while (width >= 4) {')
+    print('      __m128i pixels = _mm_loadu_si128((const __m128i *)src);')
+    for comp in range(4):
+        var = 'rgba'[comp]
+        swizzle = format.le_swizzles[comp]
+        if swizzle < 4:
+            channel = format.le_channels[swizzle]
+            mask = (1 << channel.size) - 1
+            value = '_mm_srli_epi32(pixels, %u)' % channel.shift if channel.shift else 'pixels'
+            if channel.shift + channel.size < 32:
+                value = '_mm_and_si128(%s, _mm_set1_epi32(0x%x))' % (value, mask)
+            print('      __m128 %s = _mm_mul_ps(_mm_cvtepi32_ps(%s),' % (var, value))
+            print('                          _mm_set1_ps(1.0f/0x%x));' % mask)
+        else:
+            print('      __m128 %s = _mm_set1_ps(%s);' % (var, '1.0f' if swizzle == SWIZZLE_1 else '0.0f'))
+    print('      store_transposed_sse41(dst, r, g, b, a);')
+    print('      src += 16;')
+    print('      dst += 16;')
+    print('      width -= 4;')
+    print('   }')
+    print('   if (width)')
+    print('      %s(dst, src, width);' % name)
+    print('}')
+    unpack.append(('unpack_rgba', name + '_sse41'))
+
+
+def sse41_rgba16_float(format, unpack, pack):
+    sn = format.short_name()
+    padded = format.le_channels[3].type == VOID
+    name = 'util_format_%s_unpack_rgba_float' % sn
+    print()
+    print('static void')
+    print('%s_sse41(void *restrict dst_row, const uint8_t *restrict src, unsigned width)' % name)
+    print('{')
+    print('   float *dst = dst_row;')
+    print('   while (width >= 2) {')
+    print('      __m128i pixels = _mm_loadu_si128((const __m128i *)src);')
+    print('      __m128 p0 = half_to_float_sse41(pixels);')
+    print('      __m128 p1 = half_to_float_sse41(_mm_srli_si128(pixels, 8));')
+    if padded:
+        print('      p0 = _mm_blend_ps(p0, _mm_set1_ps(1.0f), 0x8);')
+        print('      p1 = _mm_blend_ps(p1, _mm_set1_ps(1.0f), 0x8);')
+    print('      _mm_storeu_ps(dst, p0);')
+    print('      _mm_storeu_ps(dst + 4, p1);')
+    print('      src += 16;')
+    print('      dst += 8;')
+    print('      width -= 2;')
+    print('   }')
+    print('   if (width)')
+    print('      %s(dst, src, width);' % name)
+    print('}')
+    unpack.append(('unpack_rgba', name + '_sse41'))
+
+
+def sse41_r11g11b10_float(format, unpack, pack):
+    sn = format.short_name()
+    name = 'util_format_%s_unpack_rgba_float' % sn
+    print()
+    print('static void')
+    print('%s_sse41(void *restrict dst_row, const uint8_t *restrict src, unsigned width)' % name)
+    print('{')
+    print('   float *dst = dst_row;')
+    print('   while (width >= 4) {')
+    print('      __m128i pixels = _mm_loadu_si128((const __m128i *)src);')
+    print('      __m128 r = small_float_to_float_sse41(_mm_and_si128(pixels, _mm_set1_epi32(0x7ff)), 6);')
+    print('      __m128 g = small_float_to_float_sse41(_mm_and_si128(_mm_srli_epi32(pixels, 11), _mm_set1_epi32(0x7ff)), 6);')
+    print('      __m128 b = small_float_to_float_sse41(_mm_srli_epi32(pixels, 22), 5);')
+    print('      store_transposed_sse41(dst, r, g, b, _mm_set1_ps(1.0f));')
+    print('      src += 16;')
+    print('      dst += 16;')
+    print('      width -= 4;')
+    print('   }')
+    print('   if (width)')
+    print('      %s(dst, src, width);' % name)
+    print('}')
+    unpack.append(('unpack_rgba', name + '_sse41'))
+
+
+def sse41_z24_32(format, unpack, pack):
+    sn = format.short_name()
+    depth = format.le_channels[format.le_swizzles[0]]
+
+    name = 'util_format_%s_unpack_z_float' % sn
+    value = '_mm_srli_epi32(pixels, %u)' % depth.shift if depth.shift else \
+            '_mm_and_si128(pixels, _mm_set1_epi32(0xffffff))'
+    print()
+    print('static void')
+    print('%s_sse41(float *restrict dst_row, unsigned dst_stride,' % name)
+    print('   const uint8_t *restrict src_row, unsigned src_stride,')
+    print('   unsigned width, unsigned height)')
+    print('{')
+    print('   /* z24_unorm_to_z32_float() scales in double precision */')
+    print('   const __m128d scale = _mm_set1_pd(1.0 / 0xffffff);')
+    print('   for (unsigned y = 0; y < height; y++) {')
+    print('      const uint8_t *src = src_row;')
+    print('      float *dst = dst_row;')
+    print('      unsigned x = width;')
+    print('      while (x >= 4) {')
+    print('         __m128i pixels = _mm_loadu_si128((const __m128i *)src);')
+    print('         __m128i z = %s;' % value)
+    print('         __m128 lo = _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtepi32_pd(z), scale));')
+    print('         __m128 hi = _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(z, 8)), scale));')
+    print('         _mm_storeu_ps(dst, _mm_movelh_ps(lo, hi));')
+    print('         src += 16;')
+    print('         dst += 4;')
+    print('         x -= 4;')
+    print('      }')
+    print('      if (x)')
+    print('         %s(dst, 0, src, 0, x, 1);' % name)
+    print('      dst_row += dst_stride / sizeof(*dst_row);')
+    print('      src_row += src_stride;')
+    print('   }')
+    print('}')
+    unpack.append(('unpack_z_float', name + '_sse41'))
+
+    if not has_stencil8(format):
+        return
+
+    stencil = format.le_channels[format.le_swizzles[1]]
+    name = 'util_format_%s_unpack_s_8uint' % sn
+    print()
+    print('static void')
+    print('%s_sse41(uint8_t *restrict dst_row, unsigned dst_stride,' % name)
+    print('   const uint8_t *restrict src_row, unsigned src_stride,')
+    print('   unsigned width, unsigned height)')
+    print('{')
+    print('   const __m128i shuffle = %s;' % sse41_shuffle([stencil.shift // 8, None, None, None]))
+    print('   for (unsigned y = 0; y < height; y++) {')
+    print('      const uint8_t *src = src_row;')
+    print('      uint8_t *dst = dst_row;')
+    print('      unsigned x = width;')
+    print('      while (x >= 16) {')
+    for i in range(4):
+        print('         __m128i s%u = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)src + %u), shuffle);' % (i, i))
+    print('         __m128i s = _mm_packus_epi16(_mm_packus_epi32(s0, s1), _mm_packus_epi32(s2, s3));')
+    print('         _mm_storeu_si128((__m128i *)dst, s);')
+    print('         src += 64;')
+    print('         dst += 16;')
+    print('         x -= 16;')
+    print('      }')
+    print('      if (x)')
+    print('         %s(dst, 0, src, 0, x, 1);' % name)
+    print('      dst_row += dst_stride;')
+    print('      src_row += src_stride;')
+    print('   }')
+    print('}')
+    unpack.append(('unpack_s_8uint', name + '_sse41'))
+
+
+sse41_families = [
+    (is_rgba8_unorm, sse41_rgba8),
+    (is_unorm_bitmask32, sse41_unorm_bitmask32),
+    (is_rgba16_float, sse41_rgba16_float),
+    (is_r11g11b10_float, sse41_r11g11b10_float),
+    (is_z24_32, sse41_z24_32),
+]
+
+
+def write_lookup(isa, type, formats):
+    print()
+    print('bool')
+    print('util_format_%s_description_%s(enum pipe_format format,' % (type, isa))
+    print('   struct util_format_%s_description *desc)' % type)
+    print('{')
+    print('   switch (format) {')
+    for format, funcs in formats:
+        if not funcs:
+            continue
+        print('   case %s:' % format.name)
+        for field, func in funcs:
+            print('      desc->%s = &%s;' % (field, func))
+        print('      return true;')
+    print('   default:')
+    print('      return false;')
+    print('   }')
+    print('}')
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('csv')
+    parser.add_argument('--isa', choices=['sse41'], required=True)
+    args = parser.parse_args()
+
+    formats = parse(args.csv)
+
+    print('/* This file is autogenerated by u_format_simd.py from u_format.csv. Do not edit directly. */')
+    print()
+    print(CopyRight.strip())
+    print()
+    print('#include "util/format/u_format.h"')
+    print('#include "u_format_other.h"')
+    print('#include "u_format_pack.h"')
+    print('#include "u_format_zs.h"')
+    print('#include "util/u_cpu_detect.h"')
+    print()
+
+    families = sse41_families
+    print('#if defined(USE_SSE41)')
+    print()
+    print('#include <smmintrin.h>')
+    sse41_helpers()
+
+    unpacks = []
+    packs = []
+    for format in formats:
+        unpack = []
+        pack = []
+        for match, generate in families:
+            if match(format):
+                generate(format, unpack, pack)
+                break
+        unpacks.append((format, unpack))
+        packs.append((format, pack))
+
+    write_lookup(args.isa, 'unpack', unpacks)
+    write_lookup(args.isa, 'pack', packs)
+
+    print()
+    print('#endif')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,81 @@
+/*
+ * Copyright © 2022 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "util/indices/u_index_minmax.h"
+#include "util/u_cpu_detect.h"
+#include "util/macros.h"
+
+#define MINMAX(type, indices, count, restart, restart_index, min, max) \
+   do { \
+      const type *idx = (const type *)(indices); \
+      if (restart) { \
+         for (unsigned i = 0; i < (count); i++) { \
+            if (idx[i] != (restart_index)) { \
+               if (idx[i] > max) max = idx[i]; \
+               if (idx[i] < min) min = idx[i]; \
+            } \
+         } \
+      } else { \
+         for (unsigned i = 0; i < (count); i++) { \
+            if (idx[i] > max) max = idx[i]; \
+            if (idx[i] < min) min = idx[i]; \
+         } \
+      } \
+   } while (0)
+
+void
+util_index_minmax(const void *indices, unsigned index_size, unsigned count,
+                  bool primitive_restart, unsigned restart_index,
+                  unsigned *out_min, unsigned *out_max)
+{
+   unsigned min = ~0u, max = 0;
+
+#if defined(USE_SSE41)
+   /* below that, the setup costs more than the loop */
+   if (count >= 32 && util_get_cpu_caps()->has_sse4_1) {
+      util_index_minmax_sse41(indices, index_size, count, primitive_restart,
+                              restart_index, out_min, out_max);
+      return;
+   }
+#endif
+
+   switch (index_size) {
+   case 4:
+      MINMAX(uint32_t, indices, count, primitive_restart, restart_index,
+             min, max);
+      break;
+   case 2:
+      MINMAX(uint16_t, indices, count, primitive_restart, restart_index,
+             min, max);
+      break;
+   case 1:
+      MINMAX(uint8_t, indices, count, primitive_restart, restart_index,
+             min, max);
+      break;
+   default:
+      unreachable("bad index size");
+   }
+
+   *out_min = min;
+   *out_max = max;
+}
@@ -1,5 +1,6 @@
 /*
  * Copyright © 2014 Timothy Arceri
+ * Copyright © 2022 The Mesa Authors
  *
  * Permission is hereby granted, free of charge, to any person obtaining a
  * copy of this software and associated documentation files (the "Software"),
@@ -25,11 +26,35 @@
  *
  */
 
-#ifndef SSE_MINMAX_H
-#define SSE_MINMAX_H
+#ifndef U_INDEX_MINMAX_H
+#define U_INDEX_MINMAX_H
 
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Find the smallest and the largest of \p count indices of \p index_size
+ * bytes (1, 2 or 4). If \p primitive_restart is set, indices equal to
+ * \p restart_index are skipped.
+ *
+ * If there are no indices left, *out_min is ~0 and *out_max is 0.
+ */
 void
-_mesa_uint_array_min_max(const unsigned *ui_indices, unsigned *min_index,
-                         unsigned *max_index, const unsigned count);
+util_index_minmax(const void *indices, unsigned index_size, unsigned count,
+                  bool primitive_restart, unsigned restart_index,
+                  unsigned *out_min, unsigned *out_max);
+
+void
+util_index_minmax_sse41(const void *indices, unsigned index_size,
+                        unsigned count, bool primitive_restart,
+                        unsigned restart_index,
+                        unsigned *out_min, unsigned *out_max);
+
+#ifdef __cplusplus
+}
+#endif
 
-#endif /* SSE_MINMAX_H */
+#endif /* U_INDEX_MINMAX_H */
@@ -0,0 +1,125 @@
+/*
+ * Copyright © 2014 Timothy Arceri
+ * Copyright © 2022 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ * Author:
+ *    Timothy Arceri <t_arceri@yahoo.com.au>
+ *
+ */
+
+/* SSE4.1 versions of util_index_minmax. Restart indices are replaced by
+ * 0 for the maximum and by all ones for the minimum, so they never win.
+ */
+
+#ifdef USE_SSE41
+
+#include <smmintrin.h>
+#include <stdint.h>
+
+#include "util/indices/u_index_minmax.h"
+#include "util/macros.h"
+
+#define MINMAX_SSE41(bits, type, min_op, max_op) \
+   static void \
+   minmax##bits(const type *idx, unsigned count, bool restart, \
+                type restart_index, unsigned *out_min, unsigned *out_max) \
+   { \
+      const unsigned lanes = 16 / sizeof(type); \
+      const __m128i r = _mm_set1_epi##bits(restart_index); \
+      __m128i vmin0 = _mm_set1_epi32(-1), vmin1 = vmin0; \
+      __m128i vmax0 = _mm_setzero_si128(), vmax1 = vmax0; \
+      unsigned i = 0; \
+      \
+      for (; i + 2 * lanes <= count; i += 2 * lanes) { \
+         __m128i v0 = _mm_loadu_si128((const __m128i *)(idx + i)); \
+         __m128i v1 = _mm_loadu_si128((const __m128i *)(idx + i + lanes)); \
+         \
+         if (restart) { \
+            __m128i m0 = _mm_cmpeq_epi##bits(v0, r); \
+            __m128i m1 = _mm_cmpeq_epi##bits(v1, r); \
+            vmin0 = min_op(vmin0, _mm_or_si128(v0, m0)); \
+            vmin1 = min_op(vmin1, _mm_or_si128(v1, m1)); \
+            vmax0 = max_op(vmax0, _mm_andnot_si128(m0, v0)); \
+            vmax1 = max_op(vmax1, _mm_andnot_si128(m1, v1)); \
+         } else { \
+            vmin0 = min_op(vmin0, v0); \
+            vmin1 = min_op(vmin1, v1); \
+            vmax0 = max_op(vmax0, v0); \
+            vmax1 = max_op(vmax1, v1); \
+         } \
+      } \
+      \
+      type mins[16 / sizeof(type)], maxs[16 / sizeof(type)]; \
+      _mm_storeu_si128((__m128i *)mins, min_op(vmin0, vmin1)); \
+      _mm_storeu_si128((__m128i *)maxs, max_op(vmax0, vmax1)); \
+      \
+      unsigned min = ~0u, max = 0; \
+      for (unsigned l = 0; l < lanes; l++) { \
+         min = MIN2(min, mins[l]); \
+         max = MAX2(max, maxs[l]); \
+      } \
+      /* Only the initial values are left if all indices were restart \
+       * indices; any real index moves one of them. \
+       */ \
+      if (min == (type)~0 && max == 0) \
+         min = ~0u; \
+      \
+      for (; i < count; i++) { \
+         if (restart && idx[i] == restart_index) \
+            continue; \
+         min = MIN2(min, idx[i]); \
+         max = MAX2(max, idx[i]); \
+      } \
+      *out_min = min; \
+      *out_max = max; \
+   }
+
+MINMAX_SSE41(32, uint32_t, _mm_min_epu32, _mm_max_epu32)
+MINMAX_SSE41(16, uint16_t, _mm_min_epu16, _mm_max_epu16)
+MINMAX_SSE41(8, uint8_t, _mm_min_epu8, _mm_max_epu8)
+
+void
+util_index_minmax_sse41(const void *indices, unsigned index_size,
+                        unsigned count, bool primitive_restart,
+                        unsigned restart_index,
+                        unsigned *out_min, unsigned *out_max)
+{
+   switch (index_size) {
+   case 4:
+      minmax32(indices, count, primitive_restart, restart_index,
+               out_min, out_max);
+      break;
+   case 2:
+      /* a restart index that doesn't fit never matches */
+      minmax16(indices, count, primitive_restart && restart_index <= UINT16_MAX,
+               restart_index, out_min, out_max);
+      break;
+   case 1:
+      minmax8(indices, count, primitive_restart && restart_index <= UINT8_MAX,
+              restart_index, out_min, out_max);
+      break;
+   default:
+      unreachable("bad index size");
+   }
+}
+
+#endif /* USE_SSE41 */
@@ -45,20 +45,6 @@ static void translate_memcpy_uint( const void *in,
    memcpy(out, &((int *)in)[start], out_nr*sizeof(int));
 }
 
-static void translate_byte_to_ushort( const void *in,
-                                      unsigned start,
-                                      UNUSED unsigned in_nr,
-                                      unsigned out_nr,
-                                      UNUSED unsigned restart_index,
-                                      void *out )
-{
-   uint8_t *src = (uint8_t *)in + start;
-   uint16_t *dst = out;
-   while (out_nr--) {
-      *dst++ = *src++;
-   }
-}
-
 enum pipe_prim_type
 u_index_prim_type_convert(unsigned hw_mask, enum pipe_prim_type prim, bool pv_matches)
 {
@@ -152,8 +138,8 @@ u_index_translator(unsigned hw_mask,
          *out_translate = translate_memcpy_uint;
       else if (in_index_size == 2)
          *out_translate = translate_memcpy_ushort;
-      else
-         *out_translate = translate_byte_to_ushort;
+      else /* the point list translation just widens the indices */
+         *out_translate = translate[IN_UBYTE][OUT_USHORT][PV_FIRST][PV_FIRST][PR_DISABLE][PIPE_PRIM_POINTS];
 
       *out_prim = prim;
       *out_nr = nr;
@@ -263,3 +249,21 @@ u_index_generator(unsigned hw_mask,
    *out_generate = generate[out_idx][in_pv][out_pv][prim];
    return prim == PIPE_PRIM_LINE_LOOP ? U_GENERATE_ONE_OFF : U_GENERATE_REUSABLE;
 }
+
+u_translate_func
+u_index_translate_scalar(unsigned in_index_size, unsigned out_index_size,
+                         unsigned in_pv, unsigned out_pv,
+                         unsigned prim_restart, enum pipe_prim_type prim)
+{
+   u_index_init();
+   return translate_scalar[in_size_idx(in_index_size)][out_size_idx(out_index_size)]
+                          [in_pv][out_pv][prim_restart][prim];
+}
+
+u_generate_func
+u_index_generate_scalar(unsigned out_index_size, unsigned in_pv,
+                        unsigned out_pv, enum pipe_prim_type prim)
+{
+   u_index_init();
+   return generate_scalar[out_size_idx(out_index_size)][in_pv][out_pv][prim];
+}
@@ -1,3 +1,8 @@
+import argparse
+import contextlib
+import io
+import math
+
 copyright = '''
 /*
  * Copyright 2009 VMware, Inc.
@@ -79,9 +84,11 @@ def prolog():
  */
 
 #include "indices/u_indices_priv.h"
+#include "util/u_cpu_detect.h"
 #include "util/u_debug.h"
 #include "util/u_memory.h"
 
+#include "c11/threads.h"
 #include "c99_compat.h"
 
 static unsigned out_size_idx( unsigned index_size )
@@ -107,9 +114,17 @@ static unsigned in_size_idx( unsigned index_size )
 static u_translate_func translate[IN_COUNT][OUT_COUNT][PV_COUNT][PV_COUNT][PR_COUNT][PRIM_COUNT];
 static u_generate_func  generate[OUT_COUNT][PV_COUNT][PV_COUNT][PRIM_COUNT];
 
+/* Without the SIMD variants, for tests and benchmarks. */
+static u_translate_func translate_scalar[IN_COUNT][OUT_COUNT][PV_COUNT][PV_COUNT][PR_COUNT][PRIM_COUNT];
+static u_generate_func  generate_scalar[OUT_COUNT][PV_COUNT][PV_COUNT][PRIM_COUNT];
+
 
 ''')
 
+# When set, the index expressions of the emitted vertices are appended to
+# this list instead of being printed, see simd_pattern().
+recorded = None
+
 def vert( intype, outtype, v0 ):
     if intype == GENERATE:
         return '(' + outtype + ')(' + v0 + ')'
@@ -117,24 +132,39 @@ def vert( intype, outtype, v0 ):
         return '(' + outtype + ')in[' + v0 + ']'
 
 def point( intype, outtype, ptr, v0 ):
+    if recorded is not None:
+        recorded.append(v0)
+        return
     print('      (' + ptr + ')[0] = ' + vert( intype, outtype, v0 ) + ';')
 
 def line( intype, outtype, ptr, v0, v1 ):
+    if recorded is not None:
+        recorded.extend((v0, v1))
+        return
     print('      (' + ptr + ')[0] = ' + vert( intype, outtype, v0 ) + ';')
     print('      (' + ptr + ')[1] = ' + vert( intype, outtype, v1 ) + ';')
 
 def tri( intype, outtype, ptr, v0, v1, v2 ):
+    if recorded is not None:
+        recorded.extend((v0, v1, v2))
+        return
     print('      (' + ptr + ')[0] = ' + vert( intype, outtype, v0 ) + ';')
     print('      (' + ptr + ')[1] = ' + vert( intype, outtype, v1 ) + ';')
     print('      (' + ptr + ')[2] = ' + vert( intype, outtype, v2 ) + ';')
 
 def lineadj( intype, outtype, ptr, v0, v1, v2, v3 ):
+    if recorded is not None:
+        recorded.extend((v0, v1, v2, v3))
+        return
     print('      (' + ptr + ')[0] = ' + vert( intype, outtype, v0 ) + ';')
     print('      (' + ptr + ')[1] = ' + vert( intype, outtype, v1 ) + ';')
     print('      (' + ptr + ')[2] = ' + vert( intype, outtype, v2 ) + ';')
     print('      (' + ptr + ')[3] = ' + vert( intype, outtype, v3 ) + ';')
 
 def triadj( intype, outtype, ptr, v0, v1, v2, v3, v4, v5 ):
+    if recorded is not None:
+        recorded.extend((v0, v1, v2, v3, v4, v5))
+        return
     print('      (' + ptr + ')[0] = ' + vert( intype, outtype, v0 ) + ';')
     print('      (' + ptr + ')[1] = ' + vert( intype, outtype, v1 ) + ';')
     print('      (' + ptr + ')[2] = ' + vert( intype, outtype, v2 ) + ';')
@@ -437,12 +467,22 @@ def emit_all_inits():
                             init(intype, outtype, inpv, outpv, pr, prim)
 
 def emit_init():
-    print('void u_index_init( void )')
+    print('static void u_index_init_once( void )')
     print('{')
-    print('  static int firsttime = 1;')
-    print('  if (!firsttime) return;')
-    print('  firsttime = 0;')
     emit_all_inits()
+    print('  memcpy(translate_scalar, translate, sizeof(translate));')
+    print('  memcpy(generate_scalar, generate, sizeof(generate));')
+    print('#if defined(USE_SSE41)')
+    print('  util_cpu_detect();')
+    print('  if (util_get_cpu_caps()->has_sse4_1)')
+    print('    u_index_init_sse41(translate, generate);')
+    print('#endif')
+    print('}')
+    print('')
+    print('void u_index_init( void )')
+    print('{')
+    print('  static once_flag once = ONCE_FLAG_INIT;')
+    print('  call_once(&once, u_index_init_once);')
     print('}')
 
 
@@ -452,7 +492,333 @@ def epilog():
     print('#include "indices/u_indices.c"')
 
 
+# SIMD variants
+#
+# Most primitive types read their indices in a fixed pattern that repeats
+# every one or two loop iterations, e.g. (i, i+1, i+2), (i+1, i+3, i+2) for
+# a triangle strip. simd_pattern() records the index expressions emitted by
+# the scalar function of the primitive, and the SIMD function builds each
+# output vector out of one or more unaligned loads of the input, shuffled
+# with pshufb. pshufb also widens or narrows the indices.
+#
+# Line loops, triangle fans and polygons refer back to the first vertex, and
+# are only translated by the scalar functions.
+
+# prim: (inputs consumed per iteration, outputs per iteration)
+SIMD_PRIMS = {
+    'points': (1, 1),
+    'lines': (2, 2),
+    'linestrip': (1, 2),
+    'tris': (3, 3),
+    'tristrip': (1, 3),
+    'quads': (4, 6),
+    'quadstrip': (2, 6),
+    'linesadj': (4, 4),
+    'linestripadj': (1, 4),
+    'trisadj': (6, 6),
+    'tristripadj': (2, 6),
+}
+
+# Primitive types whose scalar function handles primitive restart. The
+# others pass restart indices through like any other index.
+SIMD_RESTART_PRIMS = ('quads', 'quadstrip')
+
+type_size = dict(ubyte=1, ushort=2, uint=4)
+
+def lcm(a, b):
+    return a * b // math.gcd(a, b)
+
+def simd_pattern(prim, inpv, outpv):
+    """Return (period, offsets, reach) for a primitive type.
+
+    period is the number of loop iterations after which the pattern repeats.
+    offsets are the input indices read by the outputs of these iterations,
+    relative to the first input. reach[k] is one past the largest input
+    index read by iteration k of the period, relative to its first input.
+    """
+    global recorded
+    step, outs = SIMD_PRIMS[prim]
+
+    recorded = []
+    with contextlib.redirect_stdout(io.StringIO()):
+        globals()[prim](UINT, UINT, inpv, outpv, PRDISABLE)
+    exprs, recorded = recorded, None
+    branches = len(exprs) // outs
+
+    def iteration(k):
+        # branches alternate, e.g. even and odd triangles
+        b = exprs[(k % branches) * outs:(k % branches + 1) * outs]
+        return [eval(e, {'i': k * step}) for e in b]
+
+    period = 1
+    while any(iteration(k + period) != [o + period * step for o in iteration(k)]
+              for k in range(4)):
+        period *= 2
+    offsets = sum((iteration(k) for k in range(period)), [])
+    reach = [max(iteration(k)) - k * step + 1 for k in range(period)]
+    assert min(offsets) >= 0
+    return period, offsets, reach
+
+def simd_name(intype, outtype, inpv, outpv, pr, prim):
+    return name(intype, outtype, inpv, outpv, pr, prim) + '_sse41'
+
+def simd_shuffle_mask(elements, insize, outsize):
+    """pshufb mask moving input elements to output lanes.
+
+    elements is a list of (output lane, input element in the load).
+    """
+    mask = [-128] * 16
+    for lane, src in elements:
+        for b in range(min(insize, outsize)):
+            mask[lane * outsize + b] = src * insize + b
+    return '_mm_setr_epi8(' + ', '.join(str(m) for m in mask) + ')'
+
+def simd_translate(intype, outtype, inpv, outpv, prim):
+    insize, outsize = type_size[intype], type_size[outtype]
+    in_lanes, out_lanes = 16 // insize, 16 // outsize
+    step, outs = SIMD_PRIMS[prim]
+    period, offsets, reach = simd_pattern(prim, inpv, outpv)
+
+    # a block is a whole number of output vectors and of periods
+    block_outs = lcm(len(offsets), out_lanes)
+    block_periods = block_outs // len(offsets)
+    block_ins = block_periods * period * step
+
+    vectors = []
+    load_end = 0
+    for v in range(block_outs // out_lanes):
+        srcs = []
+        for lane in range(out_lanes):
+            j = v * out_lanes + lane
+            srcs.append((lane, offsets[j % len(offsets)] +
+                         j // len(offsets) * period * step))
+        loads = []
+        while srcs:
+            base = min(src for lane, src in srcs)
+            group = [(lane, src - base) for lane, src in srcs if src < base + in_lanes]
+            srcs = [(lane, src) for lane, src in srcs if src >= base + in_lanes]
+            loads.append((base, group))
+            load_end = max(load_end, base + in_lanes)
+        vectors.append(loads)
+
+    func = name(intype, outtype, inpv, outpv, PRDISABLE, prim)
+    print('static u_translate_func ' + func + '_scalar;')
+    print('')
+    print('static void ' + simd_name(intype, outtype, inpv, outpv, PRDISABLE, prim) + '(')
+    print('    const void * restrict _in,')
+    print('    unsigned start,')
+    print('    unsigned in_nr,')
+    print('    unsigned out_nr,')
+    print('    unsigned restart_index,')
+    print('    void * restrict _out )')
+    print('{')
+    print('  const uint8_t * restrict in = (const uint8_t * restrict)_in;')
+    print('  uint8_t * restrict out = (uint8_t * restrict)_out;')
+    print('  unsigned i = start, j = 0;')
+    if period > 1:
+        print('  if (start % ' + str(period * step) + ' == 0) {')
+    else:
+        print('  {')
+    # never load past the last index the scalar function would read
+    print('    const unsigned iters = DIV_ROUND_UP(out_nr, ' + str(outs) + ');')
+    print('    unsigned in_end = start;')
+    print('    for (unsigned k = iters > ' + str(period) + ' ? iters - ' + str(period) +
+          ' : 0; k < iters; k++) {')
+    print('      static const unsigned reach[] = { ' + ', '.join(str(r) for r in reach) + ' };')
+    print('      in_end = MAX2(in_end, start + k * ' + str(step) + ' + reach[k % ' + str(period) + ']);')
+    print('    }')
+    print('    for (; j + ' + str(block_outs) + ' <= out_nr && i + ' + str(load_end) +
+          ' <= in_end; j += ' + str(block_outs) + ', i += ' + str(block_ins) + ') {')
+    for v, loads in enumerate(vectors):
+        terms = []
+        for base, group in loads:
+            terms.append('_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(in + (i + ' +
+                         str(base) + ') * ' + str(insize) + ')),\n' +
+                         '                         ' +
+                         simd_shuffle_mask(group, insize, outsize) + ')')
+        expr = terms[0]
+        for t in terms[1:]:
+            expr = '_mm_or_si128(' + expr + ',\n                       ' + t + ')'
+        print('      _mm_storeu_si128((__m128i *)(out + (j + ' + str(v * out_lanes) + ') * ' +
+              str(outsize) + '),')
+        print('                       ' + expr + ');')
+    print('    }')
+    print('  }')
+    print('  if (j < out_nr)')
+    print('    ' + func + '_scalar(_in, i, in_nr, out_nr - j, restart_index, out + j * ' +
+          str(outsize) + ');')
+    print('}')
+    print('')
+
+def simd_translate_restart(intype, outtype, inpv, outpv, prim):
+    """Primitive restart variant: without restart indices, the scalar
+    function gives the same result as with restart disabled.
+    """
+    step, outs = SIMD_PRIMS[prim]
+    period, offsets, reach = simd_pattern(prim, inpv, outpv)
+    assert period == 1
+    func = name(intype, outtype, inpv, outpv, PRENABLE, prim)
+    print('static u_translate_func ' + func + '_scalar;')
+    print('')
+    print('static void ' + simd_name(intype, outtype, inpv, outpv, PRENABLE, prim) + '(')
+    print('    const void * restrict _in,')
+    print('    unsigned start,')
+    print('    unsigned in_nr,')
+    print('    unsigned out_nr,')
+    print('    unsigned restart_index,')
+    print('    void * restrict _out )')
+    print('{')
+    print('  const unsigned iters = DIV_ROUND_UP(out_nr, ' + str(outs) + ');')
+    print('  const unsigned in_end = start + (iters - 1) * ' + str(step) + ' + ' + str(reach[0]) + ';')
+    print('  if (!iters || in_end > in_nr ||')
+    print('      has_restart_' + intype + '(_in, start, in_end, restart_index)) {')
+    print('    ' + func + '_scalar(_in, start, in_nr, out_nr, restart_index, _out);')
+    print('    return;')
+    print('  }')
+    print('  ' + simd_name(intype, outtype, inpv, outpv, PRDISABLE, prim) +
+          '(_in, start, in_nr, out_nr, restart_index, _out);')
+    print('}')
+    print('')
+
+def simd_generate(outtype, inpv, outpv, prim):
+    outsize = type_size[outtype]
+    out_lanes = 16 // outsize
+    step, outs = SIMD_PRIMS[prim]
+    period, offsets, reach = simd_pattern(prim, inpv, outpv)
+    block_outs = lcm(len(offsets), out_lanes)
+    block_ins = block_outs // len(offsets) * period * step
+    bits = str(outsize * 8)
+
+    func = name(GENERATE, outtype, inpv, outpv, PRDISABLE, prim)
+    print('static u_generate_func ' + func + '_scalar;')
+    print('')
+    print('static void ' + simd_name(GENERATE, outtype, inpv, outpv, PRDISABLE, prim) + '(')
+    print('    unsigned start,')
+    print('    unsigned out_nr,')
+    print('    void * restrict _out )')
+    print('{')
+    print('  uint8_t * restrict out = (uint8_t * restrict)_out;')
+    print('  unsigned i = start, j = 0;')
+    if period > 1:
+        print('  if (start % ' + str(period * step) + ' == 0) {')
+    else:
+        print('  {')
+    print('    for (; j + ' + str(block_outs) + ' <= out_nr; j += ' + str(block_outs) +
+          ', i += ' + str(block_ins) + ') {')
+    print('      const __m128i base = _mm_set1_epi' + bits + '(i);')
+    for v in range(block_outs // out_lanes):
+        lanes = []
+        for lane in range(out_lanes):
+            j = v * out_lanes + lane
+            lanes.append(str(offsets[j % len(offsets)] + j // len(offsets) * period * step))
+        print('      _mm_storeu_si128((__m128i *)(out + (j + ' + str(v * out_lanes) + ') * ' +
+              str(outsize) + '),')
+        print('                       _mm_add_epi' + bits + '(base, _mm_setr_epi' + bits +
+              '(' + ', '.join(lanes) + ')));')
+    print('    }')
+    print('  }')
+    print('  if (j < out_nr)')
+    print('    ' + func + '_scalar(i, out_nr - j, out + j * ' + str(outsize) + ');')
+    print('}')
+    print('')
+
+def simd_prolog():
+    print('''/* File automatically generated by u_indices_gen.py */''')
+    print(copyright)
+    print(r'''
+/**
+ * @file
+ * SSE4.1 variants of the index translation and generation functions
+ */
+
+#ifdef USE_SSE41
+
+#include <smmintrin.h>
+
+#include "indices/u_indices_priv.h"
+#include "util/macros.h"
+''')
+    # restart detection by compare mask
+    for intype in (UBYTE, USHORT, UINT):
+        size = type_size[intype]
+        bits = str(size * 8)
+        print('static bool')
+        print('has_restart_' + intype + '(const void *_in, unsigned start, unsigned end,')
+        print('                  unsigned restart_index)')
+        print('{')
+        print('  const ' + intype + ' *in = (const ' + intype + ' *)_in;')
+        print('  unsigned i = start;')
+        if size < 4:
+            print('  if (restart_index > ' + str((1 << (size * 8)) - 1) + ')')
+            print('    return false;')
+        print('  const __m128i r = _mm_set1_epi' + bits + '(restart_index);')
+        print('  for (; i + ' + str(16 // size) + ' <= end; i += ' + str(16 // size) + ') {')
+        print('    __m128i v = _mm_loadu_si128((const __m128i *)(in + i));')
+        print('    if (_mm_movemask_epi8(_mm_cmpeq_epi' + bits + '(v, r)))')
+        print('      return true;')
+        print('  }')
+        print('  for (; i < end; i++) {')
+        print('    if (in[i] == restart_index)')
+        print('      return true;')
+        print('  }')
+        print('  return false;')
+        print('}')
+        print('')
+
+def simd_init(intype, outtype, inpv, outpv, pr, prim):
+    idx = ('[' + outtype_idx[outtype] + '][' + pv_idx[inpv] + '][' + pv_idx[outpv] + ']')
+    if intype == GENERATE:
+        entry = 'generate' + idx + '[' + longprim[prim] + ']'
+    else:
+        entry = ('translate[' + intype_idx[intype] + ']' + idx + '[' + pr_idx[pr] +
+                 '][' + longprim[prim] + ']')
+    # the scalar function with restart disabled is the tail of both variants
+    scalar = name(intype, outtype, inpv, outpv, pr, prim)
+    if pr == PRENABLE and prim not in SIMD_RESTART_PRIMS:
+        simd = simd_name(intype, outtype, inpv, outpv, PRDISABLE, prim)
+    else:
+        print('  ' + scalar + '_scalar = ' + entry + ';')
+        simd = simd_name(intype, outtype, inpv, outpv, pr, prim)
+    print('  ' + entry + ' = ' + simd + ';')
+
+def simd_main():
+    simd_prolog()
+    for outtype in OUTTYPES:
+        for inpv in PVS:
+            for outpv in PVS:
+                for prim in SIMD_PRIMS:
+                    simd_generate(outtype, inpv, outpv, prim)
+                    for intype in (UBYTE, USHORT, UINT):
+                        simd_translate(intype, outtype, inpv, outpv, prim)
+                        if prim in SIMD_RESTART_PRIMS:
+                            simd_translate_restart(intype, outtype, inpv, outpv, prim)
+
+    print('void')
+    print('u_index_init_sse41(u_translate_func translate[IN_COUNT][OUT_COUNT][PV_COUNT][PV_COUNT][PR_COUNT][PRIM_COUNT],')
+    print('                   u_generate_func generate[OUT_COUNT][PV_COUNT][PV_COUNT][PRIM_COUNT])')
+    print('{')
+    for outtype in OUTTYPES:
+        for inpv in PVS:
+            for outpv in PVS:
+                for prim in SIMD_PRIMS:
+                    simd_init(GENERATE, outtype, inpv, outpv, PRDISABLE, prim)
+                    for intype in (UBYTE, USHORT, UINT):
+                        for pr in PRS:
+                            simd_init(intype, outtype, inpv, outpv, pr, prim)
+    print('}')
+    print('')
+    print('#endif /* USE_SSE41 */')
+
 def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--sse41', action='store_true',
+                        help='generate the SSE4.1 variants')
+    args = parser.parse_args()
+
+    if args.sse41:
+        simd_main()
+        return
+
     prolog()
     emit_funcs()
     emit_init()
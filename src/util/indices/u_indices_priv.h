@@ -40,4 +40,21 @@
 
 #define PRIM_COUNT   (PIPE_PRIM_TRIANGLE_STRIP_ADJACENCY + 1)
 
+/* Replaces the functions of the tables that have an SSE4.1 variant. */
+void
+u_index_init_sse41(u_translate_func translate[IN_COUNT][OUT_COUNT][PV_COUNT][PV_COUNT][PR_COUNT][PRIM_COUNT],
+                   u_generate_func generate[OUT_COUNT][PV_COUNT][PV_COUNT][PRIM_COUNT]);
+
+/* The plain C functions, for comparison with what u_index_translator() and
+ * u_index_generator() return.
+ */
+u_translate_func
+u_index_translate_scalar(unsigned in_index_size, unsigned out_index_size,
+                         unsigned in_pv, unsigned out_pv,
+                         unsigned prim_restart, enum pipe_prim_type prim);
+
+u_generate_func
+u_index_generate_scalar(unsigned out_index_size, unsigned in_pv,
+                        unsigned out_pv, enum pipe_prim_type prim);
+
 #endif
@@ -0,0 +1,367 @@
+/*
+ * Copyright © 2022 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Checks that the vectorized pack/unpack functions picked at runtime by
+ * util_format_{pack,unpack}_description() give bit identical results to the
+ * generic ones, for every width up to a few vectors so that the scalar tails
+ * are covered too.
+ *
+ * With --bench, prints the throughput of both versions for each format.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "util/format/u_format.h"
+#include "util/half_float.h"
+#include "util/os_time.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_math.h"
+
+#define MAX_WIDTH 67
+#define ROWS 64
+
+#define BENCH_WIDTH 4096
+#define BENCH_ROWS 64
+
+static uint32_t rand_state = 1;
+
+static uint32_t
+next_u32(void)
+{
+   uint32_t hi, lo;
+   rand_state = rand_state * 1103515245 + 12345;
+   hi = rand_state >> 16;
+   rand_state = rand_state * 1103515245 + 12345;
+   lo = rand_state >> 16;
+   return hi << 16 | lo;
+}
+
+static void
+fill_random(void *data, size_t size)
+{
+   uint8_t *p = data;
+   for (size_t i = 0; i < size; i++)
+      p[i] = next_u32();
+}
+
+/* Floats to pack: mostly [0, 1], with out of range values, signed zeroes,
+ * infinities, NaNs and values close to the rounding points mixed in.
+ */
+static void
+fill_random_floats(float *f, size_t count)
+{
+   static const float special[] = {
+      0.0f, -0.0f, 1.0f, -1.0f, 2.0f, 0.5f / 255.0f, 1.5f / 255.0f,
+      254.5f / 255.0f, 1.0f - 1e-7f, 1e-30f, INFINITY, -INFINITY, NAN,
+   };
+
+   for (size_t i = 0; i < count; i++) {
+      uint32_t r = next_u32();
+      switch (r & 7) {
+      case 0:
+         f[i] = special[(r >> 3) % ARRAY_SIZE(special)];
+         break;
+      case 1:
+         f[i] = ((int32_t)r >> 3) / 16777216.0f;
+         break;
+      default:
+         f[i] = (r >> 8) / 16777215.0f;
+         break;
+      }
+   }
+}
+
+static bool
+compare(const char *name, enum pipe_format format,
+        const void *a, const void *b, size_t size)
+{
+   if (memcmp(a, b, size)) {
+      printf("FAILED: %s %s differs from the generic version\n",
+             util_format_short_name(format), name);
+      return false;
+   }
+   return true;
+}
+
+static bool
+test_unpack(enum pipe_format format,
+            const struct util_format_unpack_description *unpack,
+            const struct util_format_unpack_description *generic)
+{
+   unsigned bpp = util_format_get_blocksize(format);
+   unsigned src_stride = MAX_WIDTH * bpp;
+   bool success = true;
+
+   uint8_t *src = malloc(src_stride * ROWS);
+   uint8_t *dst = malloc(MAX_WIDTH * 16);
+   uint8_t *ref = malloc(MAX_WIDTH * 16);
+
+   fill_random(src, src_stride * ROWS);
+
+   for (unsigned y = 0; y < ROWS; y++) {
+      const uint8_t *row = src + y * src_stride;
+
+      for (unsigned w = 1; w <= MAX_WIDTH; w++) {
+         if (unpack->unpack_rgba_8unorm != generic->unpack_rgba_8unorm) {
+            memset(dst, 0xcd, MAX_WIDTH * 4);
+            memset(ref, 0xcd, MAX_WIDTH * 4);
+            unpack->unpack_rgba_8unorm(dst, row, w);
+            generic->unpack_rgba_8unorm(ref, row, w);
+            success &= compare("unpack_rgba_8unorm", format, dst, ref, MAX_WIDTH * 4);
+         }
+         if (unpack->unpack_rgba != generic->unpack_rgba) {
+            memset(dst, 0xcd, MAX_WIDTH * 16);
+            memset(ref, 0xcd, MAX_WIDTH * 16);
+            unpack->unpack_rgba(dst, row, w);
+            generic->unpack_rgba(ref, row, w);
+            success &= compare("unpack_rgba", format, dst, ref, MAX_WIDTH * 16);
+         }
+         if (unpack->unpack_z_float != generic->unpack_z_float) {
+            memset(dst, 0xcd, MAX_WIDTH * 4);
+            memset(ref, 0xcd, MAX_WIDTH * 4);
+            unpack->unpack_z_float((float *)dst, 0, row, 0, w, 1);
+            generic->unpack_z_float((float *)ref, 0, row, 0, w, 1);
+            success &= compare("unpack_z_float", format, dst, ref, MAX_WIDTH * 4);
+         }
+         if (unpack->unpack_s_8uint != generic->unpack_s_8uint) {
+            memset(dst, 0xcd, MAX_WIDTH);
+            memset(ref, 0xcd, MAX_WIDTH);
+            unpack->unpack_s_8uint(dst, 0, row, 0, w, 1);
+            generic->unpack_s_8uint(ref, 0, row, 0, w, 1);
+            success &= compare("unpack_s_8uint", format, dst, ref, MAX_WIDTH);
+         }
+         if (!success)
+            goto out;
+      }
+   }
+
+out:
+   free(src);
+   free(dst);
+   free(ref);
+   return success;
+}
+
+static bool
+test_pack(enum pipe_format format,
+          const struct util_format_pack_description *pack,
+          const struct util_format_pack_description *generic)
+{
+   unsigned bpp = util_format_get_blocksize(format);
+   bool success = true;
+
+   uint8_t *src8 = malloc(MAX_WIDTH * 4 * ROWS);
+   float *srcf = malloc(MAX_WIDTH * 16 * ROWS);
+   uint8_t *dst = malloc(MAX_WIDTH * bpp);
+   uint8_t *ref = malloc(MAX_WIDTH * bpp);
+
+   fill_random(src8, MAX_WIDTH * 4 * ROWS);
+   fill_random_floats(srcf, MAX_WIDTH * 4 * ROWS);
+
+   for (unsigned y = 0; y < ROWS; y++) {
+      for (unsigned w = 1; w <= MAX_WIDTH; w++) {
+         if (pack->pack_rgba_8unorm != generic->pack_rgba_8unorm) {
+            const uint8_t *row = src8 + y * MAX_WIDTH * 4;
+            memset(dst, 0xcd, MAX_WIDTH * bpp);
+            memset(ref, 0xcd, MAX_WIDTH * bpp);
+            pack->pack_rgba_8unorm(dst, 0, row, 0, w, 1);
+            generic->pack_rgba_8unorm(ref, 0, row, 0, w, 1);
+            success &= compare("pack_rgba_8unorm", format, dst, ref, MAX_WIDTH * bpp);
+         }
+         if (pack->pack_rgba_float != generic->pack_rgba_float) {
+            const float *row = srcf + y * MAX_WIDTH * 4;
+            memset(dst, 0xcd, MAX_WIDTH * bpp);
+            memset(ref, 0xcd, MAX_WIDTH * bpp);
+            pack->pack_rgba_float(dst, 0, row, 0, w, 1);
+            generic->pack_rgba_float(ref, 0, row, 0, w, 1);
+            success &= compare("pack_rgba_float", format, dst, ref, MAX_WIDTH * bpp);
+         }
+         if (!success)
+            goto out;
+      }
+   }
+
+out:
+   free(src8);
+   free(srcf);
+   free(dst);
+   free(ref);
+   return success;
+}
+
+/* Small float formats have few enough encodings to try all of them. */
+static bool
+test_exhaustive(enum pipe_format format,
+                const struct util_format_unpack_description *unpack,
+                const struct util_format_unpack_description *generic)
+{
+   const unsigned chunk = 1024;
+   bool success = true;
+
+   if (unpack->unpack_rgba == generic->unpack_rgba)
+      return true;
+
+   uint32_t *src = malloc(chunk * sizeof(uint32_t) * 2);
+   float *dst = malloc(chunk * 16);
+   float *ref = malloc(chunk * 16);
+
+   if (format == PIPE_FORMAT_R16G16B16A16_FLOAT) {
+      for (unsigned base = 0; base < 65536 && success; base += chunk * 4) {
+         uint16_t *h = (uint16_t *)src;
+         for (unsigned i = 0; i < chunk * 4; i++)
+            h[i] = base + i;
+         unpack->unpack_rgba(dst, (uint8_t *)src, chunk);
+         generic->unpack_rgba(ref, (uint8_t *)src, chunk);
+         success &= compare("unpack_rgba (all halves)", format, dst, ref, chunk * 16);
+      }
+   } else if (format == PIPE_FORMAT_R11G11B10_FLOAT) {
+      /* Multiplying by an odd constant permutes the low 22 bits, so every
+       * combination of R and G is seen once, with B spread over the rest.
+       */
+      for (uint32_t base = 0; base < (1u << 22) && success; base += chunk) {
+         for (unsigned i = 0; i < chunk; i++)
+            src[i] = (base + i) * 2654435761u;
+         unpack->unpack_rgba(dst, (uint8_t *)src, chunk);
+         generic->unpack_rgba(ref, (uint8_t *)src, chunk);
+         success &= compare("unpack_rgba (all R and G)", format, dst, ref, chunk * 16);
+      }
+   }
+
+   free(src);
+   free(dst);
+   free(ref);
+   return success;
+}
+
+static void
+bench(enum pipe_format format,
+      const struct util_format_unpack_description *unpack,
+      const struct util_format_unpack_description *unpack_generic,
+      const struct util_format_pack_description *pack,
+      const struct util_format_pack_description *pack_generic)
+{
+   unsigned bpp = util_format_get_blocksize(format);
+   uint8_t *packed = malloc(BENCH_WIDTH * bpp);
+   float *rgba = malloc(BENCH_WIDTH * 16);
+
+   fill_random(packed, BENCH_WIDTH * bpp);
+   fill_random_floats(rgba, BENCH_WIDTH * 4);
+
+#define BENCH(name, simd, generic, ...)                                          \
+   if (simd != generic) {                                                        \
+      int64_t t0 = os_time_get_nano();                                           \
+      for (unsigned i = 0; i < BENCH_ROWS; i++)                                  \
+         generic(__VA_ARGS__);                                                   \
+      int64_t t1 = os_time_get_nano();                                           \
+      for (unsigned i = 0; i < BENCH_ROWS; i++)                                  \
+         simd(__VA_ARGS__);                                                      \
+      int64_t t2 = os_time_get_nano();                                           \
+      double pix = (double)BENCH_WIDTH * BENCH_ROWS * 1000.0;                    \
+      printf("%-24s %-20s %8.1f Mpix/s generic  %8.1f Mpix/s simd\n",            \
+             util_format_short_name(format), name,                               \
+             pix / MAX2(t1 - t0, 1), pix / MAX2(t2 - t1, 1));                    \
+   }
+
+   BENCH("unpack_rgba_8unorm", unpack->unpack_rgba_8unorm,
+         unpack_generic->unpack_rgba_8unorm, (uint8_t *)rgba, packed, BENCH_WIDTH);
+   BENCH("unpack_rgba", unpack->unpack_rgba, unpack_generic->unpack_rgba,
+         rgba, packed, BENCH_WIDTH);
+   BENCH("unpack_z_float", unpack->unpack_z_float, unpack_generic->unpack_z_float,
+         rgba, 0, packed, 0, BENCH_WIDTH, 1);
+   BENCH("unpack_s_8uint", unpack->unpack_s_8uint, unpack_generic->unpack_s_8uint,
+         (uint8_t *)rgba, 0, packed, 0, BENCH_WIDTH, 1);
+   BENCH("pack_rgba_8unorm", pack->pack_rgba_8unorm, pack_generic->pack_rgba_8unorm,
+         packed, 0, (uint8_t *)rgba, 0, BENCH_WIDTH, 1);
+   BENCH("pack_rgba_float", pack->pack_rgba_float, pack_generic->pack_rgba_float,
+         packed, 0, rgba, 0, BENCH_WIDTH, 1);
+
+#undef BENCH
+
+   free(packed);
+   free(rgba);
+}
+
+/* Whether util_format_*_description() should hand out vectorized functions
+ * on this CPU, mirroring the checks done when the tables are set up.
+ */
+static bool
+simd_expected(void)
+{
+   util_cpu_detect();
+
+#if defined(USE_SSE41)
+   if (util_get_cpu_caps()->has_sse4_1)
+      return true;
+#endif
+#if (defined(PIPE_ARCH_AARCH64) || defined(PIPE_ARCH_ARM)) && !defined(NO_FORMAT_ASM) && !defined(__SOFTFP__)
+#ifdef PIPE_ARCH_ARM
+   if (util_get_cpu_caps()->has_neon)
+#endif
+      return true;
+#endif
+
+   return false;
+}
+
+int main(int argc, char **argv)
+{
+   bool do_bench = argc > 1 && !strcmp(argv[1], "--bench");
+   unsigned tested = 0;
+   bool success = true;
+
+   for (enum pipe_format format = PIPE_FORMAT_NONE + 1; format < PIPE_FORMAT_COUNT; format++) {
+      const struct util_format_unpack_description *unpack =
+         util_format_unpack_description(format);
+      const struct util_format_unpack_description *unpack_generic =
+         util_format_unpack_description_generic(format);
+      const struct util_format_pack_description *pack =
+         util_format_pack_description(format);
+      const struct util_format_pack_description *pack_generic =
+         util_format_pack_description_generic(format);
+
+      if (unpack == unpack_generic && pack == pack_generic)
+         continue;
+
+      tested++;
+      success &= test_unpack(format, unpack, unpack_generic);
+      success &= test_pack(format, pack, pack_generic);
+      success &= test_exhaustive(format, unpack, unpack_generic);
+
+      if (do_bench)
+         bench(format, unpack, unpack_generic, pack, pack_generic);
+   }
+
+   if (do_bench)
+      printf("%u formats with vectorized functions\n", tested);
+
+   if (tested == 0 && simd_expected()) {
+      printf("FAILED: the CPU has vectorized pack/unpack functions but none are installed\n");
+      success = false;
+   }
+
+   return success ? 0 : 1;
+}
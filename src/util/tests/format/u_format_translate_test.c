@@ -0,0 +1,199 @@
+/*
+ * Copyright © 2022 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Checks that util_format_translate() gives the same result when a large
+ * rectangle is split across threads as when it is converted in small pieces
+ * on the calling thread, and that the single pass RGBA8 swizzle path matches
+ * unpacking and packing through 8unorm.
+ *
+ * With --bench, prints the time taken for each format pair and size.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "util/format/u_format.h"
+#include "util/os_time.h"
+#include "util/u_math.h"
+
+static const struct {
+   enum pipe_format src, dst;
+} pairs[] = {
+   { PIPE_FORMAT_R8G8B8A8_UNORM, PIPE_FORMAT_B8G8R8A8_UNORM },
+   { PIPE_FORMAT_B8G8R8X8_UNORM, PIPE_FORMAT_R8G8B8A8_UNORM },
+   { PIPE_FORMAT_R8G8B8A8_UNORM, PIPE_FORMAT_A8B8G8R8_UNORM },
+   { PIPE_FORMAT_X8R8G8B8_UNORM, PIPE_FORMAT_B8G8R8A8_UNORM },
+   { PIPE_FORMAT_R8G8B8A8_UNORM, PIPE_FORMAT_R32G32B32A32_FLOAT },
+   { PIPE_FORMAT_R32G32B32A32_FLOAT, PIPE_FORMAT_B8G8R8A8_UNORM },
+   { PIPE_FORMAT_R16G16B16A16_UNORM, PIPE_FORMAT_R8G8B8A8_UNORM },
+   { PIPE_FORMAT_R8G8B8A8_UNORM, PIPE_FORMAT_B5G6R5_UNORM },
+   { PIPE_FORMAT_R16G16B16A16_FLOAT, PIPE_FORMAT_R32G32B32A32_FLOAT },
+   { PIPE_FORMAT_R8G8B8A8_UINT, PIPE_FORMAT_R32G32B32A32_UINT },
+   { PIPE_FORMAT_S8_UINT_Z24_UNORM, PIPE_FORMAT_Z32_FLOAT_S8X24_UINT },
+   { PIPE_FORMAT_DXT1_RGBA, PIPE_FORMAT_R8G8B8A8_UNORM },
+};
+
+static const struct {
+   unsigned width, height;
+} sizes[] = {
+   { 64, 64 },
+   { 1000, 700 },
+   { 2048, 2048 },
+   { 4096, 2160 },
+};
+
+/* Small enough to always be converted on the calling thread */
+#define REF_ROWS 8
+
+static uint32_t rand_state = 1;
+
+static uint8_t
+next_byte(void)
+{
+   rand_state = rand_state * 1103515245 + 12345;
+   return rand_state >> 16;
+}
+
+static unsigned
+stride_for(enum pipe_format format, unsigned width)
+{
+   return util_format_get_stride(format, width);
+}
+
+static bool
+test_pair(enum pipe_format src_format, enum pipe_format dst_format,
+          unsigned width, unsigned height, bool bench)
+{
+   unsigned src_stride = stride_for(src_format, width);
+   unsigned dst_stride = stride_for(dst_format, width);
+   unsigned src_rows = util_format_get_nblocksy(src_format, height);
+   unsigned dst_rows = util_format_get_nblocksy(dst_format, height);
+   unsigned y_step = MAX2(util_format_get_blockheight(src_format),
+                          util_format_get_blockheight(dst_format));
+   bool success = true;
+
+   uint8_t *src = malloc((size_t)src_stride * src_rows);
+   uint8_t *dst = calloc(dst_rows, dst_stride);
+   uint8_t *ref = calloc(dst_rows, dst_stride);
+   if (!src || !dst || !ref) {
+      free(src);
+      free(dst);
+      free(ref);
+      return false;
+   }
+
+   for (size_t i = 0; i < (size_t)src_stride * src_rows; i++)
+      src[i] = next_byte();
+
+   /* float sources are kept in [0, 1] so no NaNs are involved */
+   if (util_format_is_float(src_format) &&
+       util_format_get_component_bits(src_format, UTIL_FORMAT_COLORSPACE_RGB, 0) == 32) {
+      float *f = (float *)src;
+      for (size_t i = 0; i < (size_t)src_stride * src_rows / 4; i++)
+         f[i] = (f[i] != f[i]) ? 0.0f : fabsf(f[i]) / (1.0f + fabsf(f[i]));
+   }
+
+   int64_t start = os_time_get_nano();
+   for (unsigned y = 0; y < height; y += REF_ROWS * y_step) {
+      unsigned h = MIN2(REF_ROWS * y_step, height - y);
+      if (!util_format_translate(dst_format, ref, dst_stride, 0, y,
+                                 src_format, src, src_stride, 0, y,
+                                 width, h)) {
+         success = false;
+         goto out;
+      }
+   }
+   int64_t ref_time = os_time_get_nano() - start;
+
+   start = os_time_get_nano();
+   if (!util_format_translate(dst_format, dst, dst_stride, 0, 0,
+                              src_format, src, src_stride, 0, 0,
+                              width, height)) {
+      success = false;
+      goto out;
+   }
+   int64_t time = os_time_get_nano() - start;
+
+   if (memcmp(dst, ref, (size_t)dst_stride * dst_rows)) {
+      printf("FAILED: %s -> %s %ux%u differs from the strip by strip result\n",
+             util_format_short_name(src_format),
+             util_format_short_name(dst_format), width, height);
+      success = false;
+   }
+
+   /* compare the single pass RGBA8 swizzle with a round trip through 8unorm */
+   const struct util_format_pack_description *pack =
+      util_format_pack_description(dst_format);
+   if (util_format_is_rgba8_variant(util_format_description(src_format)) &&
+       util_format_is_rgba8_variant(util_format_description(dst_format)) &&
+       pack->pack_rgba_8unorm) {
+      uint8_t *tmp = malloc((size_t)width * 4);
+      for (unsigned y = 0; y < height && tmp; y++) {
+         util_format_unpack_rgba_8unorm_rect(src_format, tmp, width * 4,
+                                             src + y * src_stride, src_stride,
+                                             width, 1);
+         pack->pack_rgba_8unorm(ref + y * dst_stride, dst_stride,
+                                tmp, width * 4, width, 1);
+      }
+      free(tmp);
+
+      if (memcmp(dst, ref, (size_t)dst_stride * dst_rows)) {
+         printf("FAILED: %s -> %s %ux%u differs from unpack + pack\n",
+                util_format_short_name(src_format),
+                util_format_short_name(dst_format), width, height);
+         success = false;
+      }
+   }
+
+   if (bench) {
+      printf("%-24s -> %-24s %5ux%-5u  %8.3f ms  (%8.3f ms in strips)\n",
+             util_format_short_name(src_format),
+             util_format_short_name(dst_format), width, height,
+             time / 1000000.0, ref_time / 1000000.0);
+   }
+
+out:
+   free(src);
+   free(dst);
+   free(ref);
+   return success;
+}
+
+int main(int argc, char **argv)
+{
+   bool bench = argc > 1 && !strcmp(argv[1], "--bench");
+   bool success = true;
+
+   for (unsigned p = 0; p < ARRAY_SIZE(pairs); p++) {
+      for (unsigned s = 0; s < ARRAY_SIZE(sizes); s++) {
+         if (!test_pair(pairs[p].src, pairs[p].dst,
+                        sizes[s].width, sizes[s].height, bench))
+            success = false;
+      }
+   }
+
+   return success ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright © 2022 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "util/indices/u_index_minmax.h"
+#include "util/u_cpu_detect.h"
+
+static void
+reference_minmax(const void *indices, unsigned index_size, unsigned count,
+                 bool restart, unsigned restart_index,
+                 unsigned *out_min, unsigned *out_max)
+{
+   unsigned min = ~0u, max = 0;
+
+   for (unsigned i = 0; i < count; i++) {
+      unsigned v = index_size == 4 ? ((const uint32_t *)indices)[i] :
+                   index_size == 2 ? ((const uint16_t *)indices)[i] :
+                                     ((const uint8_t *)indices)[i];
+      if (restart && v == restart_index)
+         continue;
+      min = MIN2(min, v);
+      max = MAX2(max, v);
+   }
+   *out_min = min;
+   *out_max = max;
+}
+
+static void
+check(unsigned index_size, unsigned count, bool restart,
+      unsigned restart_index, unsigned range, unsigned restart_every)
+{
+   uint8_t *data = (uint8_t *)malloc(count * index_size + 1);
+   unsigned base = range == 1 ? 7 : 0;
+
+   for (unsigned i = 0; i < count; i++) {
+      unsigned v = restart_every && i % restart_every == 0 ?
+                   restart_index : base + rand() % range;
+      if (index_size == 4)
+         ((uint32_t *)data)[i] = v;
+      else if (index_size == 2)
+         ((uint16_t *)data)[i] = v;
+      else
+         data[i] = v;
+   }
+
+   unsigned ref_min, ref_max, min, max;
+   reference_minmax(data, index_size, count, restart, restart_index,
+                    &ref_min, &ref_max);
+
+   util_index_minmax(data, index_size, count, restart, restart_index,
+                     &min, &max);
+   EXPECT_EQ(ref_min, min) << index_size << " " << count << " " << restart;
+   EXPECT_EQ(ref_max, max) << index_size << " " << count << " " << restart;
+
+#if defined(USE_SSE41)
+   if (util_get_cpu_caps()->has_sse4_1) {
+      util_index_minmax_sse41(data, index_size, count, restart, restart_index,
+                              &min, &max);
+      EXPECT_EQ(ref_min, min) << index_size << " " << count << " " << restart;
+      EXPECT_EQ(ref_max, max) << index_size << " " << count << " " << restart;
+   }
+#endif
+
+   free(data);
+}
+
+TEST(u_index_minmax, random)
+{
+   for (unsigned size = 1; size <= 4; size *= 2) {
+      unsigned type_max = size == 4 ? ~0u : (1u << (size * 8)) - 1;
+
+      for (unsigned count = 0; count < 300; count++) {
+         check(size, count, false, 0, MIN2(type_max, 5000), 0);
+         check(size, count, false, 0, 1, 0);
+         check(size, count, true, type_max, MIN2(type_max, 5000), 3);
+         check(size, count, true, 3, 50, 0);
+      }
+   }
+}
+
+TEST(u_index_minmax, restart)
+{
+   for (unsigned size = 1; size <= 4; size *= 2) {
+      unsigned type_max = size == 4 ? ~0u : (1u << (size * 8)) - 1;
+
+      for (unsigned count = 0; count < 100; count++) {
+         /* only restart indices */
+         check(size, count, true, type_max, 1, 1);
+         check(size, count, true, 0, 1, 1);
+         /* the restart index doesn't fit, so nothing is skipped */
+         check(size, count, true, 0x10000, 1000, 0);
+         /* the largest index isn't a restart index */
+         check(size, count, true, 0, type_max, 2);
+         /* restart disabled, the restart index is a real index */
+         check(size, count, false, type_max, 1, 5);
+      }
+   }
+}
@@ -174,6 +174,20 @@ util_get_cpu_caps(void)
    return &_util_cpu_caps_state.caps;
 }
 
+/* Runs CPU detection if it hasn't happened yet.  Code which runs once and
+ * caches what it derived from the caps should call this first, because
+ * util_get_cpu_caps() being ATTRIBUTE_CONST lets the compiler drop its
+ * detection step.
+ */
+static inline void
+util_cpu_detect(void)
+{
+   extern void _util_cpu_detect_once(void);
+   extern struct _util_cpu_caps_state_t _util_cpu_caps_state;
+
+   call_once(&_util_cpu_caps_state.once_flag, _util_cpu_detect_once);
+}
+
 #ifdef __cplusplus
 }
 #endif
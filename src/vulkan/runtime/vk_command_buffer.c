@@ -43,6 +43,7 @@ vk_command_buffer_init(struct vk_command_pool *pool,
    vk_dynamic_graphics_state_init(&command_buffer->dynamic_graphics_state);
    command_buffer->record_result = VK_SUCCESS;
    vk_cmd_queue_init(&command_buffer->cmd_queue, &pool->alloc);
+   command_buffer->cmd_queue.free_blocks = &pool->free_cmd_blocks;
    util_dynarray_init(&command_buffer->labels, NULL);
    command_buffer->region_begin = true;
 
@@ -64,6 +64,7 @@ vk_command_pool_init(struct vk_device *device,
    pool->recycle_command_buffers = should_recycle_command_buffers(device);
    list_inithead(&pool->command_buffers);
    list_inithead(&pool->free_command_buffers);
+   list_inithead(&pool->free_cmd_blocks);
 
    return VK_SUCCESS;
 }
@@ -83,6 +84,8 @@ vk_command_pool_finish(struct vk_command_pool *pool)
    }
    assert(list_is_empty(&pool->free_command_buffers));
 
+   vk_cmd_queue_free_blocks(&pool->alloc, &pool->free_cmd_blocks);
+
    vk_object_base_finish(&pool->base);
 }
 
@@ -253,6 +256,8 @@ vk_command_pool_trim(struct vk_command_pool *pool,
       cmd_buffer->ops->destroy(cmd_buffer);
    }
    assert(list_is_empty(&pool->free_command_buffers));
+
+   vk_cmd_queue_free_blocks(&pool->alloc, &pool->free_cmd_blocks);
 }
 
 VKAPI_ATTR void VKAPI_CALL
@@ -55,6 +55,13 @@ struct vk_command_pool {
 
    /** List of freed command buffers for trimming. */
    struct list_head free_command_buffers;
+
+   /** List of vk_cmd_queue_block released by command buffers in this pool
+    *
+    * Command buffers allocated from a pool are externally synchronized with
+    * it so their command queues can share the blocks without locking.
+    */
+   struct list_head free_cmd_blocks;
 };
 
 VK_DEFINE_NONDISP_HANDLE_CASTS(vk_command_pool, base, VkCommandPool,
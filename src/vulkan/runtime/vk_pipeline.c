@@ -23,6 +23,8 @@
 
 #include "vk_pipeline.h"
 
+#include "vk_alloc.h"
+#include "vk_device.h"
 #include "vk_log.h"
 #include "vk_nir.h"
 #include "vk_shader_module.h"
@@ -30,7 +32,10 @@
 
 #include "nir_serialize.h"
 
+#include "util/debug.h"
 #include "util/mesa-sha1.h"
+#include "util/u_atomic.h"
+#include "util/u_queue.h"
 
 bool
 vk_pipeline_shader_stage_is_null(const VkPipelineShaderStageCreateInfo *info)
@@ -203,3 +208,184 @@ vk_pipeline_hash_shader_stage(const VkPipelineShaderStageCreateInfo *info,
 
    _mesa_sha1_final(&ctx, stage_sha1);
 }
+
+/* All Vk*PipelineCreateInfo structs start like this */
+struct vk_pipeline_create_info_header {
+   VkStructureType sType;
+   const void *pNext;
+   VkPipelineCreateFlags flags;
+};
+
+static struct util_queue vk_pipeline_queue;
+static unsigned vk_pipeline_queue_threads;
+static once_flag vk_pipeline_queue_once = ONCE_FLAG_INIT;
+
+static void
+vk_pipeline_queue_init(void)
+{
+   unsigned num_threads = env_var_as_unsigned("MESA_VK_PIPELINE_THREADS", 0);
+   if (num_threads == 0)
+      return;
+
+   if (util_queue_init(&vk_pipeline_queue, "vk_pipeline", 64, num_threads,
+                       UTIL_QUEUE_INIT_RESIZE_IF_FULL |
+                       UTIL_QUEUE_INIT_SET_FULL_THREAD_AFFINITY, NULL))
+      vk_pipeline_queue_threads = num_threads;
+}
+
+struct vk_pipeline_batch {
+   struct vk_device *device;
+   const uint8_t *create_infos;
+   size_t create_info_stride;
+   vk_pipeline_create_func create;
+   void *data;
+   VkPipeline *pipelines;
+   VkResult *results;
+   uint32_t count;
+
+   /* Next entry to pick up */
+   uint32_t next;
+
+   /* Lowest index which failed with EARLY_RETURN_ON_FAILURE, or count */
+   uint32_t early_return;
+};
+
+static void
+vk_pipeline_batch_run(struct vk_pipeline_batch *batch)
+{
+   while (true) {
+      uint32_t i = p_atomic_inc_return(&batch->next) - 1;
+      if (i >= batch->count)
+         break;
+
+      batch->pipelines[i] = VK_NULL_HANDLE;
+      batch->results[i] = VK_SUCCESS;
+
+      /* Something before us asked for an early return, don't bother */
+      if (i > p_atomic_read(&batch->early_return))
+         continue;
+
+      const struct vk_pipeline_create_info_header *info =
+         (const void *)(batch->create_infos + i * batch->create_info_stride);
+
+      VkResult result = batch->create(batch->device, batch->data, i,
+                                      &batch->pipelines[i]);
+      if (result == VK_SUCCESS)
+         continue;
+
+      batch->pipelines[i] = VK_NULL_HANDLE;
+      batch->results[i] = result;
+
+      if (info->flags & VK_PIPELINE_CREATE_EARLY_RETURN_ON_FAILURE_BIT) {
+         uint32_t old = p_atomic_read(&batch->early_return);
+         while (i < old) {
+            uint32_t prev = p_atomic_cmpxchg(&batch->early_return, old, i);
+            if (prev == old)
+               break;
+            old = prev;
+         }
+      }
+   }
+}
+
+static void
+vk_pipeline_batch_job(void *job, void *gdata, int thread_index)
+{
+   vk_pipeline_batch_run(job);
+}
+
+VkResult
+vk_create_pipelines(struct vk_device *device,
+                    uint32_t count, const void *create_infos,
+                    size_t create_info_stride,
+                    const VkAllocationCallbacks *pAllocator,
+                    vk_pipeline_create_func create, void *data,
+                    VkPipeline *pPipelines)
+{
+   VkResult result = VK_SUCCESS;
+
+   call_once(&vk_pipeline_queue_once, vk_pipeline_queue_init);
+
+   if (vk_pipeline_queue_threads == 0 || count <= 1) {
+      uint32_t i = 0;
+      for (; i < count; i++) {
+         const struct vk_pipeline_create_info_header *info =
+            (const void *)((const uint8_t *)create_infos + i * create_info_stride);
+
+         VkResult r = create(device, data, i, &pPipelines[i]);
+         if (r != VK_SUCCESS) {
+            result = r;
+            pPipelines[i] = VK_NULL_HANDLE;
+            if (info->flags & VK_PIPELINE_CREATE_EARLY_RETURN_ON_FAILURE_BIT)
+               break;
+         }
+      }
+      if (result != VK_SUCCESS) {
+         for (; i < count; i++)
+            pPipelines[i] = VK_NULL_HANDLE;
+      }
+
+      return result;
+   }
+
+   /* The calling thread is a worker too */
+   uint32_t num_jobs = MIN2(vk_pipeline_queue_threads, count - 1);
+
+   VkResult *results;
+   struct util_queue_fence *fences;
+   VK_MULTIALLOC(ma);
+   vk_multialloc_add(&ma, &results, VkResult, count);
+   vk_multialloc_add(&ma, &fences, struct util_queue_fence, num_jobs);
+   if (!vk_multialloc_alloc(&ma, &device->alloc,
+                            VK_SYSTEM_ALLOCATION_SCOPE_COMMAND)) {
+      for (uint32_t i = 0; i < count; i++)
+         pPipelines[i] = VK_NULL_HANDLE;
+      return vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
+   }
+
+   struct vk_pipeline_batch batch = {
+      .device = device,
+      .create_infos = create_infos,
+      .create_info_stride = create_info_stride,
+      .create = create,
+      .data = data,
+      .pipelines = pPipelines,
+      .results = results,
+      .count = count,
+      .next = 0,
+      .early_return = count,
+   };
+
+   for (uint32_t j = 0; j < num_jobs; j++) {
+      util_queue_fence_init(&fences[j]);
+      util_queue_add_job(&vk_pipeline_queue, &batch, &fences[j],
+                         vk_pipeline_batch_job, NULL, 0);
+   }
+
+   vk_pipeline_batch_run(&batch);
+
+   for (uint32_t j = 0; j < num_jobs; j++) {
+      util_queue_fence_wait(&fences[j]);
+      util_queue_fence_destroy(&fences[j]);
+   }
+
+   /* Entries past an early return may still have been created by threads
+    * which started on them before the failure was seen.  Throw those away
+    * so the application sees the same thing as with in-order creation.
+    */
+   for (uint32_t i = 0; i < count; i++) {
+      if (i > batch.early_return) {
+         if (pPipelines[i] != VK_NULL_HANDLE) {
+            device->dispatch_table.DestroyPipeline(vk_device_to_handle(device),
+                                                   pPipelines[i], pAllocator);
+            pPipelines[i] = VK_NULL_HANDLE;
+         }
+      } else if (results[i] != VK_SUCCESS) {
+         result = results[i];
+      }
+   }
+
+   vk_free(&device->alloc, results);
+
+   return result;
+}
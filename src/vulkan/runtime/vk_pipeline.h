@@ -62,6 +62,35 @@ void
 vk_pipeline_hash_shader_stage(const VkPipelineShaderStageCreateInfo *info,
                               unsigned char *stage_sha1);
 
+/** Callback creating the pipeline for pCreateInfos[index]
+ *
+ * This may be called from several threads at once by vk_create_pipelines().
+ */
+typedef VkResult (*vk_pipeline_create_func)(struct vk_device *device,
+                                            void *data, uint32_t index,
+                                            VkPipeline *pipeline_out);
+
+/** Create a batch of pipelines, as in vkCreate*Pipelines()
+ *
+ * create_infos points to an array of count create info structs which all
+ * start with sType, pNext and VkPipelineCreateFlags, create_info_stride
+ * bytes apart.  create is called once per entry which needs creating.
+ *
+ * When MESA_VK_PIPELINE_THREADS is set to a non-zero value, the entries of
+ * a single call are spread across a shared pool of that many worker
+ * threads, with the calling thread helping out.  The result is the same as
+ * creating them in order: if an entry with
+ * VK_PIPELINE_CREATE_EARLY_RETURN_ON_FAILURE_BIT fails, every later entry
+ * is VK_NULL_HANDLE, and the last failure before that point is returned.
+ */
+VkResult
+vk_create_pipelines(struct vk_device *device,
+                    uint32_t count, const void *create_infos,
+                    size_t create_info_stride,
+                    const VkAllocationCallbacks *pAllocator,
+                    vk_pipeline_create_func create, void *data,
+                    VkPipeline *pPipelines);
+
 #ifdef __cplusplus
 }
 #endif
@@ -32,6 +32,14 @@
 #include "vk_device.h"
 #include "vk_log.h"
 
+struct vk_sync_timeline_waiter {
+   struct list_head link;
+
+   uint64_t value;
+
+   cnd_t cond;
+};
+
 static struct vk_sync_timeline *
 to_vk_sync_timeline(struct vk_sync *sync)
 {
@@ -69,16 +77,11 @@ vk_sync_timeline_init(struct vk_device *device,
    if (ret != thrd_success)
       return vk_errorf(device, VK_ERROR_UNKNOWN, "mtx_init failed");
 
-   ret = cnd_init(&timeline->cond);
-   if (ret != thrd_success) {
-      mtx_destroy(&timeline->mutex);
-      return vk_errorf(device, VK_ERROR_UNKNOWN, "cnd_init failed");
-   }
-
    timeline->highest_past =
       timeline->highest_pending = initial_value;
    list_inithead(&timeline->pending_points);
    list_inithead(&timeline->free_points);
+   list_inithead(&timeline->waiters);
 
    return VK_SUCCESS;
 }
@@ -102,7 +105,7 @@ vk_sync_timeline_finish(struct vk_device *device,
       vk_free(&device->alloc, point);
    }
 
-   cnd_destroy(&timeline->cond);
+   assert(list_is_empty(&timeline->waiters));
    mtx_destroy(&timeline->mutex);
 }
 
@@ -133,9 +136,15 @@ vk_sync_timeline_alloc_point_locked(struct vk_device *device,
    struct vk_sync_timeline_point *point;
    VkResult result;
 
-   result = vk_sync_timeline_gc_locked(device, timeline, false);
-   if (unlikely(result != VK_SUCCESS))
-      return result;
+   /* Only collect signaled points once we run out of free ones.  This
+    * batches the GC work instead of polling every pending point on every
+    * allocation.
+    */
+   if (list_is_empty(&timeline->free_points)) {
+      result = vk_sync_timeline_gc_locked(device, timeline, false);
+      if (unlikely(result != VK_SUCCESS))
+         return result;
+   }
 
    if (list_is_empty(&timeline->free_points)) {
       const struct vk_sync_timeline_type *ttype =
@@ -289,6 +298,41 @@ vk_sync_timeline_gc_locked(struct vk_device *device,
    return VK_SUCCESS;
 }
 
+/* Wake every waiter whose value is now pending.  The list is sorted so we
+ * can stop at the first one which isn't.
+ */
+static VkResult
+vk_sync_timeline_wake_waiters_locked(struct vk_device *device,
+                                     struct vk_sync_timeline *timeline)
+{
+   list_for_each_entry_safe(struct vk_sync_timeline_waiter, waiter,
+                            &timeline->waiters, link) {
+      if (waiter->value > timeline->highest_pending)
+         break;
+
+      list_delinit(&waiter->link);
+      if (cnd_signal(&waiter->cond) == thrd_error)
+         return vk_errorf(device, VK_ERROR_UNKNOWN, "cnd_signal failed");
+   }
+
+   return VK_SUCCESS;
+}
+
+static void
+vk_sync_timeline_add_waiter_locked(struct vk_sync_timeline *timeline,
+                                   struct vk_sync_timeline_waiter *waiter)
+{
+   /* Waiters tend to come in increasing order so search from the back */
+   list_for_each_entry_rev(struct vk_sync_timeline_waiter, other,
+                           &timeline->waiters, link) {
+      if (other->value <= waiter->value) {
+         list_add(&waiter->link, &other->link);
+         return;
+      }
+   }
+   list_add(&waiter->link, &timeline->waiters);
+}
+
 VkResult
 vk_sync_timeline_point_install(struct vk_device *device,
                                struct vk_sync_timeline_point *point)
@@ -304,14 +348,11 @@ vk_sync_timeline_point_install(struct vk_device *device,
    point->pending = true;
    list_addtail(&point->link, &timeline->pending_points);
 
-   int ret = cnd_broadcast(&timeline->cond);
+   VkResult result = vk_sync_timeline_wake_waiters_locked(device, timeline);
 
    mtx_unlock(&timeline->mutex);
 
-   if (ret == thrd_error)
-      return vk_errorf(device, VK_ERROR_UNKNOWN, "cnd_broadcast failed");
-
-   return VK_SUCCESS;
+   return result;
 }
 
 static VkResult
@@ -381,11 +422,7 @@ vk_sync_timeline_signal_locked(struct vk_device *device,
    assert(timeline->highest_pending == timeline->highest_past);
    timeline->highest_pending = timeline->highest_past = value;
 
-   int ret = cnd_broadcast(&timeline->cond);
-   if (ret == thrd_error)
-      return vk_errorf(device, VK_ERROR_UNKNOWN, "cnd_broadcast failed");
-
-   return VK_SUCCESS;
+   return vk_sync_timeline_wake_waiters_locked(device, timeline);
 }
 
 static VkResult
@@ -422,24 +459,32 @@ vk_sync_timeline_get_value(struct vk_device *device,
 }
 
 static VkResult
-vk_sync_timeline_wait_locked(struct vk_device *device,
-                             struct vk_sync_timeline *timeline,
-                             uint64_t wait_value,
-                             enum vk_sync_wait_flags wait_flags,
-                             uint64_t abs_timeout_ns)
+vk_sync_timeline_wait_pending_locked(struct vk_device *device,
+                                     struct vk_sync_timeline *timeline,
+                                     uint64_t wait_value,
+                                     uint64_t abs_timeout_ns)
 {
-   /* Wait on the queue_submit condition variable until the timeline has a
-    * time point pending that's at least as high as wait_value.
-    */
+   struct vk_sync_timeline_waiter waiter = {
+      .value = wait_value,
+   };
+   VkResult result = VK_SUCCESS;
+
+   if (cnd_init(&waiter.cond) != thrd_success)
+      return vk_errorf(device, VK_ERROR_UNKNOWN, "cnd_init failed");
+
+   vk_sync_timeline_add_waiter_locked(timeline, &waiter);
+
    uint64_t now_ns = os_time_get_nano();
    while (timeline->highest_pending < wait_value) {
-      if (now_ns >= abs_timeout_ns)
-         return VK_TIMEOUT;
+      if (now_ns >= abs_timeout_ns) {
+         result = VK_TIMEOUT;
+         break;
+      }
 
       int ret;
       if (abs_timeout_ns >= INT64_MAX) {
          /* Common infinite wait case */
-         ret = cnd_wait(&timeline->cond, &timeline->mutex);
+         ret = cnd_wait(&waiter.cond, &timeline->mutex);
       } else {
          /* This is really annoying.  The C11 threads API uses CLOCK_REALTIME
           * while all our absolute timeouts are in CLOCK_MONOTONIC.  Best
@@ -452,14 +497,16 @@ vk_sync_timeline_wait_locked(struct vk_device *device,
          timespec_get(&now_ts, TIME_UTC);
          if (timespec_add_nsec(&abs_timeout_ts, &now_ts, rel_timeout_ns)) {
             /* Overflowed; may as well be infinite */
-            ret = cnd_wait(&timeline->cond, &timeline->mutex);
+            ret = cnd_wait(&waiter.cond, &timeline->mutex);
          } else {
-            ret = cnd_timedwait(&timeline->cond, &timeline->mutex,
+            ret = cnd_timedwait(&waiter.cond, &timeline->mutex,
                                 &abs_timeout_ts);
          }
       }
-      if (ret == thrd_error)
-         return vk_errorf(device, VK_ERROR_UNKNOWN, "cnd_timedwait failed");
+      if (ret == thrd_error) {
+         result = vk_errorf(device, VK_ERROR_UNKNOWN, "cnd_timedwait failed");
+         break;
+      }
 
       /* We don't trust the timeout condition on cnd_timedwait() because of
        * the potential clock issues caused by using CLOCK_REALTIME.  Instead,
@@ -468,6 +515,34 @@ vk_sync_timeline_wait_locked(struct vk_device *device,
       now_ns = os_time_get_nano();
    }
 
+   /* On timeout or error we're still registered.  The waker unlinks us
+    * otherwise, so this is a no-op in the common case.
+    */
+   list_delinit(&waiter.link);
+   cnd_destroy(&waiter.cond);
+
+   return result;
+}
+
+static VkResult
+vk_sync_timeline_wait_locked(struct vk_device *device,
+                             struct vk_sync_timeline *timeline,
+                             uint64_t wait_value,
+                             enum vk_sync_wait_flags wait_flags,
+                             uint64_t abs_timeout_ns)
+{
+   /* Register a waiter and sleep on its condition variable until the
+    * timeline has a time point pending that's at least as high as
+    * wait_value.  Whoever installs that point wakes us directly.
+    */
+   if (timeline->highest_pending < wait_value) {
+      VkResult result =
+         vk_sync_timeline_wait_pending_locked(device, timeline, wait_value,
+                                              abs_timeout_ns);
+      if (result != VK_SUCCESS)
+         return result;
+   }
+
    if (wait_flags & VK_SYNC_WAIT_PENDING)
       return VK_SUCCESS;
 
@@ -79,13 +79,19 @@ struct vk_sync_timeline {
    struct vk_sync sync;
 
    mtx_t mutex;
-   cnd_t cond;
 
    uint64_t highest_past;
    uint64_t highest_pending;
 
    struct list_head pending_points;
    struct list_head free_points;
+
+   /* List of vk_sync_timeline_waiter waiting for a time point to become
+    * pending, sorted by increasing value.  Each waiter sleeps on its own
+    * condition variable so that installing a time point only wakes the
+    * waiters it actually satisfies.
+    */
+   struct list_head waiters;
 };
 
 VkResult vk_sync_timeline_init(struct vk_device *device,
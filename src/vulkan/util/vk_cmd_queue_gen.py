@@ -64,6 +64,8 @@ TEMPLATE_H = Template(COPYRIGHT + """\
 
 #pragma once
 
+#include <string.h>
+
 #include "util/list.h"
 
 #define VK_PROTOTYPES
@@ -75,9 +77,33 @@ extern "C" {
 
 struct vk_device_dispatch_table;
 
+/* Size of the blocks commands are allocated from.  Larger allocations get
+ * a block of their own.
+ */
+#define VK_CMD_QUEUE_BLOCK_SIZE (16 * 1024)
+
+struct vk_cmd_queue_block {
+   struct list_head link;
+   size_t size;
+};
+
 struct vk_cmd_queue {
    const VkAllocationCallbacks *alloc;
    struct list_head cmds;
+
+   /* Commands and everything they point to are bump-allocated from a list
+    * of blocks, which are all released at once when the queue is reset.
+    */
+   struct list_head blocks;
+   uint8_t *block_ptr;
+   uint8_t *block_end;
+
+   /* Where released blocks go to be reused.  This points at cached_blocks
+    * unless the queue shares them with others, like the command buffers of
+    * a vk_command_pool do.
+    */
+   struct list_head *free_blocks;
+   struct list_head cached_blocks;
 };
 
 enum vk_cmd_type {
@@ -151,6 +177,25 @@ struct vk_cmd_queue_entry {
 
 % endfor
 
+void *vk_cmd_queue_alloc_block(struct vk_cmd_queue *queue, size_t size);
+
+/* Allocates zeroed memory which lives until the queue is reset */
+static inline void *
+vk_cmd_queue_zalloc(struct vk_cmd_queue *queue, size_t size)
+{
+   size = (size + 7) & ~(size_t)7;
+   if ((size_t)(queue->block_end - queue->block_ptr) < size)
+      return vk_cmd_queue_alloc_block(queue, size);
+
+   void *ptr = queue->block_ptr;
+   queue->block_ptr += size;
+   memset(ptr, 0, size);
+   return ptr;
+}
+
+void vk_cmd_queue_free_blocks(const VkAllocationCallbacks *alloc,
+                              struct list_head *blocks);
+
 void vk_free_queue(struct vk_cmd_queue *queue);
 
 static inline void
@@ -158,6 +203,11 @@ vk_cmd_queue_init(struct vk_cmd_queue *queue, VkAllocationCallbacks *alloc)
 {
    queue->alloc = alloc;
    list_inithead(&queue->cmds);
+   list_inithead(&queue->blocks);
+   list_inithead(&queue->cached_blocks);
+   queue->block_ptr = NULL;
+   queue->block_end = NULL;
+   queue->free_blocks = &queue->cached_blocks;
 }
 
 static inline void
@@ -171,6 +221,7 @@ static inline void
 vk_cmd_queue_finish(struct vk_cmd_queue *queue)
 {
    vk_free_queue(queue);
+   vk_cmd_queue_free_blocks(queue->alloc, &queue->cached_blocks);
    list_inithead(&queue->cmds);
 }
 
@@ -213,25 +264,6 @@ const char *vk_cmd_queue_type_names[] = {
 % if c.guard is not None:
 #ifdef ${c.guard}
 % endif
-static void
-vk_free_${to_underscore(c.name)}(struct vk_cmd_queue *queue,
-${' ' * len('vk_free_' + to_underscore(c.name) + '(')}\\
-struct vk_cmd_queue_entry *cmd)
-{
-   if (cmd->driver_free_cb)
-      cmd->driver_free_cb(queue, cmd);
-   else
-      vk_free(queue->alloc, cmd->driver_data);
-% for p in c.params[1:]:
-% if p.len:
-   vk_free(queue->alloc, (${remove_suffix(p.decl.replace("const", ""), p.name)})cmd->u.${to_struct_field_name(c.name)}.${to_field_name(p.name)});
-% elif '*' in p.decl:
-   ${get_struct_free(c, p, types)}
-% endif
-% endfor
-   vk_free(queue->alloc, cmd);
-}
-
 % if c.name not in manual_commands and c.name not in no_enqueue_commands:
 VkResult vk_enqueue_${to_underscore(c.name)}(struct vk_cmd_queue *queue
 % for p in c.params[1:]:
@@ -239,9 +271,7 @@ VkResult vk_enqueue_${to_underscore(c.name)}(struct vk_cmd_queue *queue
 % endfor
 )
 {
-   struct vk_cmd_queue_entry *cmd = vk_zalloc(queue->alloc,
-                                              sizeof(*cmd), 8,
-                                              VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+   struct vk_cmd_queue_entry *cmd = vk_cmd_queue_zalloc(queue, sizeof(*cmd));
    if (!cmd) return VK_ERROR_OUT_OF_HOST_MEMORY;
 
    cmd->type = ${to_enum_name(c.name)};
@@ -271,8 +301,7 @@ VkResult vk_enqueue_${to_underscore(c.name)}(struct vk_cmd_queue *queue
 
 % if need_error_handling:
 err:
-   if (cmd)
-      vk_free_${to_underscore(c.name)}(queue, cmd);
+   /* whatever was allocated is released with the rest of the queue */
    return VK_ERROR_OUT_OF_HOST_MEMORY;
 % endif
 }
@@ -283,25 +312,75 @@ err:
 
 % endfor
 
+/* vk_cmd_queue_block is only 12 bytes on 32-bit targets, so round it up to
+ * keep the data after it 8-byte aligned like vk_cmd_queue_zalloc() expects.
+ */
+#define VK_CMD_QUEUE_BLOCK_HEADER_SIZE ALIGN_POT(sizeof(struct vk_cmd_queue_block), 8)
+
+void *
+vk_cmd_queue_alloc_block(struct vk_cmd_queue *queue, size_t size)
+{
+   struct vk_cmd_queue_block *block;
+
+   if (size <= VK_CMD_QUEUE_BLOCK_SIZE && !list_is_empty(queue->free_blocks)) {
+      block = list_first_entry(queue->free_blocks,
+                               struct vk_cmd_queue_block, link);
+      list_del(&block->link);
+   } else {
+      const size_t block_size = MAX2(size, VK_CMD_QUEUE_BLOCK_SIZE);
+      block = vk_alloc(queue->alloc,
+                       VK_CMD_QUEUE_BLOCK_HEADER_SIZE + block_size, 8,
+                       VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+      if (!block)
+         return NULL;
+      block->size = block_size;
+   }
+   list_addtail(&block->link, &queue->blocks);
+
+   uint8_t *data = (uint8_t *)block + VK_CMD_QUEUE_BLOCK_HEADER_SIZE;
+
+   /* Keep bumping from the current block if this one is used up */
+   if (block->size - size > (size_t)(queue->block_end - queue->block_ptr)) {
+      queue->block_ptr = data + size;
+      queue->block_end = data + block->size;
+   }
+
+   memset(data, 0, size);
+   return data;
+}
+
+void
+vk_cmd_queue_free_blocks(const VkAllocationCallbacks *alloc,
+                         struct list_head *blocks)
+{
+   list_for_each_entry_safe(struct vk_cmd_queue_block, block, blocks, link)
+      vk_free(alloc, block);
+   list_inithead(blocks);
+}
+
 void
 vk_free_queue(struct vk_cmd_queue *queue)
 {
-   struct vk_cmd_queue_entry *tmp, *cmd;
-   LIST_FOR_EACH_ENTRY_SAFE(cmd, tmp, &queue->cmds, cmd_link) {
-      switch(cmd->type) {
-% for c in commands:
-% if c.guard is not None:
-#ifdef ${c.guard}
-% endif
-      case ${to_enum_name(c.name)}:
-         vk_free_${to_underscore(c.name)}(queue, cmd);
-         break;
-% if c.guard is not None:
-#endif // ${c.guard}
-% endif
-% endfor
-      }
+   list_for_each_entry(struct vk_cmd_queue_entry, cmd, &queue->cmds, cmd_link) {
+      if (cmd->driver_free_cb)
+         cmd->driver_free_cb(queue, cmd);
+      else
+         vk_free(queue->alloc, cmd->driver_data);
    }
+
+   /* Everything else lives in the blocks.  Only regular sized ones are
+    * kept around for reuse.
+    */
+   list_for_each_entry_safe(struct vk_cmd_queue_block, block,
+                            &queue->blocks, link) {
+      if (block->size == VK_CMD_QUEUE_BLOCK_SIZE)
+         list_move_to(&block->link, queue->free_blocks);
+      else
+         vk_free(queue->alloc, block);
+   }
+   list_inithead(&queue->blocks);
+   queue->block_ptr = NULL;
+   queue->block_end = NULL;
 }
 
 void
@@ -425,7 +504,7 @@ def get_array_copy(command, param):
         field_size = "1"
     else:
         field_size = "sizeof(*%s)" % field_name
-    allocation = "%s = vk_zalloc(queue->alloc, %s * %s, 8, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);\n   if (%s == NULL) goto err;\n" % (field_name, field_size, param.len, field_name)
+    allocation = "%s = vk_cmd_queue_zalloc(queue, %s * %s);\n   if (%s == NULL) goto err;\n" % (field_name, field_size, param.len, field_name)
     const_cast = remove_suffix(param.decl.replace("const", ""), param.name)
     copy = "memcpy((%s)%s, %s, %s * %s);" % (const_cast, field_name, param.name, field_size, param.len)
     return "%s\n   %s" % (allocation, copy)
@@ -436,7 +515,7 @@ def get_array_member_copy(struct, src_name, member):
         field_size = "sizeof(*%s)" % (field_name)
     else:
         field_size = "sizeof(*%s) * %s->%s" % (field_name, struct, member.len)
-    allocation = "%s = vk_zalloc(queue->alloc, %s, 8, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);\n   if (%s == NULL) goto err;\n" % (field_name, field_size, field_name)
+    allocation = "%s = vk_cmd_queue_zalloc(queue, %s);\n   if (%s == NULL) goto err;\n" % (field_name, field_size, field_name)
     const_cast = remove_suffix(member.decl.replace("const", ""), member.name)
     copy = "memcpy((%s)%s, %s->%s, %s);" % (const_cast, field_name, src_name, member.name, field_size)
     return "if (%s->%s) {\n   %s\n   %s\n}\n" % (src_name, member.name, allocation, copy)
@@ -466,7 +545,7 @@ def get_struct_copy(dst, src_name, src_type, size, types, level=0):
     global tmp_dst_idx
     global tmp_src_idx
 
-    allocation = "%s = vk_zalloc(queue->alloc, %s, 8, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);\n      if (%s == NULL) goto err;\n" % (dst, size, dst)
+    allocation = "%s = vk_cmd_queue_zalloc(queue, %s);\n      if (%s == NULL) goto err;\n" % (dst, size, dst)
     copy = "memcpy((void*)%s, %s, %s);" % (dst, src_name, size)
 
     level += 1
@@ -485,19 +564,6 @@ def get_struct_copy(dst, src_name, src_type, size, types, level=0):
     if_stmt = "if (%s) {" % src_name
     return "%s\n      %s\n      %s\n   %s\n   %s   \n   %s   } else {\n      %s\n   }" % (if_stmt, allocation, copy, tmp_dst, tmp_src, member_copies, null_assignment)
 
-def get_struct_free(command, param, types):
-    field_name = "cmd->u.%s.%s" % (to_struct_field_name(command.name), to_field_name(param.name))
-    const_cast = remove_suffix(param.decl.replace("const", ""), param.name)
-    struct_free = "vk_free(queue->alloc, (%s)%s);" % (const_cast, field_name)
-    member_frees = ""
-    if (param.type in types):
-        for member in types[param.type].members:
-            if member.len and member.len != 'null-terminated':
-                member_name = "cmd->u.%s.%s->%s" % (to_struct_field_name(command.name), to_field_name(param.name), member.name)
-                const_cast = remove_suffix(member.decl.replace("const", ""), member.name)
-                member_frees += "vk_free(queue->alloc, (%s)%s);\n" % (const_cast, member_name)
-    return "%s      %s\n" % (member_frees, struct_free)
-
 EntrypointType = namedtuple('EntrypointType', 'name enum members extended_by')
 
 def get_types(doc):
@@ -578,7 +644,6 @@ def main():
         'to_struct_name': to_struct_name,
         'get_array_copy': get_array_copy,
         'get_struct_copy': get_struct_copy,
-        'get_struct_free': get_struct_free,
         'types': types,
         'manual_commands': MANUAL_COMMANDS,
         'no_enqueue_commands': NO_ENQUEUE_COMMANDS,
@@ -0,0 +1,588 @@
+/*
+ * Copyright © 2022 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "util/macros.h"
+#include "util/u_atomic.h"
+
+#include "vk_instance.h"
+#include "vk_physical_device.h"
+#include "vk_util.h"
+#include "wsi_common_entrypoints.h"
+#include "wsi_common_headless.h"
+#include "wsi_common_private.h"
+
+#ifdef HAVE_SYS_SHM_H
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+struct wsi_headless {
+   struct wsi_interface base;
+
+   struct wsi_device *wsi;
+
+   const VkAllocationCallbacks *alloc;
+   VkPhysicalDevice physical_device;
+};
+
+struct wsi_headless_image {
+   struct wsi_image base;
+   struct wsi_headless_swapchain *chain;
+   bool busy;
+};
+
+struct wsi_headless_swapchain {
+   struct wsi_swapchain base;
+
+   VkExtent2D extent;
+   VkFormat format;
+
+   /* Index the next acquire starts looking from, so that images get used
+    * round-robin and a capture ring sees them in order.
+    */
+   uint32_t next_image;
+
+   /* Frame capture ring, see wsi_common_headless.h */
+   struct wsi_headless_ring *ring;
+   size_t ring_size;
+
+   struct wsi_headless_image images[0];
+};
+
+VKAPI_ATTR VkResult VKAPI_CALL
+wsi_CreateHeadlessSurfaceEXT(VkInstance _instance,
+                             const VkHeadlessSurfaceCreateInfoEXT *pCreateInfo,
+                             const VkAllocationCallbacks *pAllocator,
+                             VkSurfaceKHR *pSurface)
+{
+   VK_FROM_HANDLE(vk_instance, instance, _instance);
+   VkIcdSurfaceHeadless *surface;
+
+   assert(pCreateInfo->sType == VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT);
+
+   surface = vk_zalloc2(&instance->alloc, pAllocator, sizeof(*surface), 8,
+                        VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+   if (surface == NULL)
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+
+   surface->base.platform = VK_ICD_WSI_PLATFORM_HEADLESS;
+
+   *pSurface = VkIcdSurfaceBase_to_handle(&surface->base);
+
+   return VK_SUCCESS;
+}
+
+static VkResult
+wsi_headless_surface_get_support(VkIcdSurfaceBase *surface,
+                                 struct wsi_device *wsi_device,
+                                 uint32_t queueFamilyIndex,
+                                 VkBool32* pSupported)
+{
+   *pSupported = true;
+
+   return VK_SUCCESS;
+}
+
+static VkResult
+wsi_headless_surface_get_capabilities(VkIcdSurfaceBase *surface,
+                                      struct wsi_device *wsi_device,
+                                      VkSurfaceCapabilitiesKHR* caps)
+{
+   caps->minImageCount = 1;
+   /* There is no real maximum */
+   caps->maxImageCount = 0;
+
+   /* The surface has no size of its own, the swapchain decides */
+   caps->currentExtent = (VkExtent2D) { UINT32_MAX, UINT32_MAX };
+   caps->minImageExtent = (VkExtent2D) { 1, 1 };
+   caps->maxImageExtent = (VkExtent2D) {
+      wsi_device->maxImageDimension2D,
+      wsi_device->maxImageDimension2D,
+   };
+
+   caps->supportedTransforms = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+   caps->currentTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+   caps->maxImageArrayLayers = 1;
+
+   caps->supportedCompositeAlpha =
+      VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR |
+      VK_COMPOSITE_ALPHA_PRE_MULTIPLIED_BIT_KHR;
+
+   caps->supportedUsageFlags =
+      VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+      VK_IMAGE_USAGE_SAMPLED_BIT |
+      VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+      VK_IMAGE_USAGE_STORAGE_BIT |
+      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+      VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+
+   return VK_SUCCESS;
+}
+
+static VkResult
+wsi_headless_surface_get_capabilities2(VkIcdSurfaceBase *surface,
+                                       struct wsi_device *wsi_device,
+                                       const void *info_next,
+                                       VkSurfaceCapabilities2KHR* caps)
+{
+   assert(caps->sType == VK_STRUCTURE_TYPE_SURFACE_CAPABILITIES_2_KHR);
+
+   VkResult result =
+      wsi_headless_surface_get_capabilities(surface, wsi_device,
+                                            &caps->surfaceCapabilities);
+
+   vk_foreach_struct(ext, caps->pNext) {
+      switch (ext->sType) {
+      case VK_STRUCTURE_TYPE_SURFACE_PROTECTED_CAPABILITIES_KHR: {
+         VkSurfaceProtectedCapabilitiesKHR *protected = (void *)ext;
+         protected->supportsProtected = VK_FALSE;
+         break;
+      }
+
+      default:
+         /* Ignored */
+         break;
+      }
+   }
+
+   return result;
+}
+
+static const VkFormat available_surface_formats[] = {
+   VK_FORMAT_B8G8R8A8_SRGB,
+   VK_FORMAT_B8G8R8A8_UNORM,
+};
+
+static void
+get_sorted_vk_formats(struct wsi_device *wsi_device, VkFormat *sorted_formats)
+{
+   for (unsigned i = 0; i < ARRAY_SIZE(available_surface_formats); i++)
+      sorted_formats[i] = available_surface_formats[i];
+
+   if (wsi_device->force_bgra8_unorm_first) {
+      for (unsigned i = 0; i < ARRAY_SIZE(available_surface_formats); i++) {
+         if (sorted_formats[i] == VK_FORMAT_B8G8R8A8_UNORM) {
+            sorted_formats[i] = sorted_formats[0];
+            sorted_formats[0] = VK_FORMAT_B8G8R8A8_UNORM;
+            break;
+         }
+      }
+   }
+}
+
+static VkResult
+wsi_headless_surface_get_formats(VkIcdSurfaceBase *icd_surface,
+                                 struct wsi_device *wsi_device,
+                                 uint32_t* pSurfaceFormatCount,
+                                 VkSurfaceFormatKHR* pSurfaceFormats)
+{
+   VK_OUTARRAY_MAKE_TYPED(VkSurfaceFormatKHR, out, pSurfaceFormats, pSurfaceFormatCount);
+
+   VkFormat sorted_formats[ARRAY_SIZE(available_surface_formats)];
+   get_sorted_vk_formats(wsi_device, sorted_formats);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(sorted_formats); i++) {
+      vk_outarray_append_typed(VkSurfaceFormatKHR, &out, f) {
+         f->format = sorted_formats[i];
+         f->colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+      }
+   }
+
+   return vk_outarray_status(&out);
+}
+
+static VkResult
+wsi_headless_surface_get_formats2(VkIcdSurfaceBase *icd_surface,
+                                  struct wsi_device *wsi_device,
+                                  const void *info_next,
+                                  uint32_t* pSurfaceFormatCount,
+                                  VkSurfaceFormat2KHR* pSurfaceFormats)
+{
+   VK_OUTARRAY_MAKE_TYPED(VkSurfaceFormat2KHR, out, pSurfaceFormats, pSurfaceFormatCount);
+
+   VkFormat sorted_formats[ARRAY_SIZE(available_surface_formats)];
+   get_sorted_vk_formats(wsi_device, sorted_formats);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(sorted_formats); i++) {
+      vk_outarray_append_typed(VkSurfaceFormat2KHR, &out, f) {
+         assert(f->sType == VK_STRUCTURE_TYPE_SURFACE_FORMAT_2_KHR);
+         f->surfaceFormat.format = sorted_formats[i];
+         f->surfaceFormat.colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+      }
+   }
+
+   return vk_outarray_status(&out);
+}
+
+/* Nothing ever scans the images out, so every mode completes a present as
+ * soon as the image is ready and they only differ in what the application
+ * asked for.
+ */
+static const VkPresentModeKHR present_modes[] = {
+   VK_PRESENT_MODE_IMMEDIATE_KHR,
+   VK_PRESENT_MODE_MAILBOX_KHR,
+   VK_PRESENT_MODE_FIFO_KHR,
+   VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+};
+
+static VkResult
+wsi_headless_surface_get_present_modes(VkIcdSurfaceBase *surface,
+                                       uint32_t* pPresentModeCount,
+                                       VkPresentModeKHR* pPresentModes)
+{
+   if (pPresentModes == NULL) {
+      *pPresentModeCount = ARRAY_SIZE(present_modes);
+      return VK_SUCCESS;
+   }
+
+   *pPresentModeCount = MIN2(*pPresentModeCount, ARRAY_SIZE(present_modes));
+   typed_memcpy(pPresentModes, present_modes, *pPresentModeCount);
+
+   if (*pPresentModeCount < ARRAY_SIZE(present_modes))
+      return VK_INCOMPLETE;
+   else
+      return VK_SUCCESS;
+}
+
+static VkResult
+wsi_headless_surface_get_present_rectangles(VkIcdSurfaceBase *surface,
+                                            struct wsi_device *wsi_device,
+                                            uint32_t* pRectCount,
+                                            VkRect2D* pRects)
+{
+   VK_OUTARRAY_MAKE_TYPED(VkRect2D, out, pRects, pRectCount);
+
+   vk_outarray_append_typed(VkRect2D, &out, rect) {
+      /* We don't know a size so just return the usual "I don't know." */
+      *rect = (VkRect2D) {
+         .offset = { 0, 0 },
+         .extent = { UINT32_MAX, UINT32_MAX },
+      };
+   }
+
+   return vk_outarray_status(&out);
+}
+
+#ifdef HAVE_SYS_SHM_H
+/* Images are page aligned inside the ring so they can be imported as host
+ * memory.
+ */
+#define WSI_HEADLESS_RING_ALIGN 4096
+
+static uint8_t *
+wsi_headless_alloc_shm(struct wsi_image *imagew, unsigned size)
+{
+   struct wsi_headless_image *image = (struct wsi_headless_image *)imagew;
+   struct wsi_headless_swapchain *chain = image->chain;
+   const uint64_t slot_size = align64(size, WSI_HEADLESS_RING_ALIGN);
+   const uint64_t slot_offset = align64(sizeof(struct wsi_headless_ring),
+                                        WSI_HEADLESS_RING_ALIGN);
+
+   if (chain->ring == NULL) {
+      const char *name = getenv("MESA_VK_WSI_HEADLESS_RING");
+      if (name == NULL)
+         return NULL;
+
+      size_t ring_size = slot_offset + slot_size * chain->base.image_count;
+
+      int fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+      if (fd < 0)
+         return NULL;
+
+      if (ftruncate(fd, ring_size) < 0) {
+         close(fd);
+         return NULL;
+      }
+
+      void *map = mmap(NULL, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                       fd, 0);
+      close(fd);
+      if (map == MAP_FAILED)
+         return NULL;
+
+      chain->ring = map;
+      chain->ring_size = ring_size;
+
+      struct wsi_headless_ring *ring = chain->ring;
+      uint32_t generation = ring->magic == WSI_HEADLESS_RING_MAGIC ?
+                            ring->generation + 1 : 0;
+      ring->magic = WSI_HEADLESS_RING_MAGIC;
+      ring->version = WSI_HEADLESS_RING_VERSION;
+      ring->format = chain->format;
+      ring->width = chain->extent.width;
+      ring->height = chain->extent.height;
+      ring->row_pitch = 0;
+      ring->slot_count = chain->base.image_count;
+      ring->slot_size = slot_size;
+      ring->slot_offset = slot_offset;
+      ring->last_slot = 0;
+      ring->present_count = 0;
+      p_atomic_set(&ring->generation, generation);
+   }
+
+   /* All images of a swapchain have the same size */
+   if (slot_size != chain->ring->slot_size)
+      return NULL;
+
+   uint32_t index = image - chain->images;
+   return (uint8_t *)chain->ring + slot_offset + index * slot_size;
+}
+#endif
+
+static void
+wsi_headless_image_finish(struct wsi_headless_swapchain *chain,
+                          const VkAllocationCallbacks *allocator,
+                          struct wsi_headless_image *image)
+{
+   wsi_destroy_image(&chain->base, &image->base);
+}
+
+static VkResult
+wsi_headless_image_init(struct wsi_headless_swapchain *chain,
+                        const VkSwapchainCreateInfoKHR *create_info,
+                        const VkAllocationCallbacks *allocator,
+                        struct wsi_headless_image *image)
+{
+   image->chain = chain;
+   image->busy = false;
+
+   VkResult result = wsi_create_image(&chain->base, &chain->base.image_info,
+                                      &image->base);
+   if (result != VK_SUCCESS)
+      return result;
+
+   if (chain->ring)
+      chain->ring->row_pitch = image->base.row_pitches[0];
+
+   return VK_SUCCESS;
+}
+
+static VkResult
+wsi_headless_swapchain_destroy(struct wsi_swapchain *drv_chain,
+                               const VkAllocationCallbacks *allocator)
+{
+   struct wsi_headless_swapchain *chain =
+      (struct wsi_headless_swapchain *) drv_chain;
+
+   for (uint32_t i = 0; i < chain->base.image_count; i++)
+      wsi_headless_image_finish(chain, allocator, &chain->images[i]);
+   wsi_destroy_image_info(&chain->base, &chain->base.image_info);
+
+#ifdef HAVE_SYS_SHM_H
+   if (chain->ring)
+      munmap(chain->ring, chain->ring_size);
+#endif
+
+   wsi_swapchain_finish(&chain->base);
+   vk_free(allocator, chain);
+   return VK_SUCCESS;
+}
+
+static struct wsi_image *
+wsi_headless_get_wsi_image(struct wsi_swapchain *drv_chain,
+                           uint32_t image_index)
+{
+   struct wsi_headless_swapchain *chain =
+      (struct wsi_headless_swapchain *) drv_chain;
+
+   return &chain->images[image_index].base;
+}
+
+static VkResult
+wsi_headless_acquire_next_image(struct wsi_swapchain *drv_chain,
+                                const VkAcquireNextImageInfoKHR *info,
+                                uint32_t *image_index)
+{
+   struct wsi_headless_swapchain *chain =
+      (struct wsi_headless_swapchain *)drv_chain;
+
+   /* Images go back to the swapchain as soon as they're presented, so the
+    * only way to find none is for the application to hold all of them.
+    */
+   for (uint32_t i = 0; i < chain->base.image_count; i++) {
+      uint32_t index = (chain->next_image + i) % chain->base.image_count;
+      if (!chain->images[index].busy) {
+         chain->images[index].busy = true;
+         chain->next_image = (index + 1) % chain->base.image_count;
+         *image_index = index;
+         return VK_SUCCESS;
+      }
+   }
+
+   return info->timeout == 0 ? VK_NOT_READY : VK_TIMEOUT;
+}
+
+static VkResult
+wsi_headless_queue_present(struct wsi_swapchain *drv_chain,
+                           uint32_t image_index,
+                           const VkPresentRegionKHR *damage)
+{
+   struct wsi_headless_swapchain *chain =
+      (struct wsi_headless_swapchain *) drv_chain;
+   assert(image_index < chain->base.image_count);
+   struct wsi_headless_image *image = &chain->images[image_index];
+
+   /* Software drivers have waited for rendering to finish by now, so this
+    * is where the frame becomes visible to a capture ring consumer.
+    */
+   if (chain->ring) {
+      p_atomic_set(&chain->ring->last_slot, image_index);
+      p_atomic_inc(&chain->ring->present_count);
+   }
+
+   image->busy = false;
+
+   return VK_SUCCESS;
+}
+
+static VkResult
+wsi_headless_surface_create_swapchain(
+   VkIcdSurfaceBase *icd_surface,
+   VkDevice device,
+   struct wsi_device *wsi_device,
+   const VkSwapchainCreateInfoKHR *create_info,
+   const VkAllocationCallbacks *allocator,
+   struct wsi_swapchain **swapchain_out)
+{
+   assert(create_info->sType == VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR);
+
+   const unsigned num_images = create_info->minImageCount;
+   struct wsi_headless_swapchain *chain;
+   size_t size = sizeof(*chain) + num_images * sizeof(chain->images[0]);
+
+   chain = vk_zalloc(allocator, size, 8, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+   if (chain == NULL)
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+
+   VkResult result = wsi_swapchain_init(wsi_device, &chain->base, device,
+                                        create_info, allocator, false);
+   if (result != VK_SUCCESS) {
+      vk_free(allocator, chain);
+      return result;
+   }
+
+   chain->base.destroy = wsi_headless_swapchain_destroy;
+   chain->base.get_wsi_image = wsi_headless_get_wsi_image;
+   chain->base.acquire_next_image = wsi_headless_acquire_next_image;
+   chain->base.queue_present = wsi_headless_queue_present;
+   chain->base.present_mode = wsi_swapchain_get_present_mode(wsi_device, create_info);
+   chain->base.image_count = num_images;
+   chain->extent = create_info->imageExtent;
+   chain->format = create_info->imageFormat;
+
+   /* Only software drivers wait for rendering before queue_present, which
+    * the capture ring relies on.
+    */
+   uint8_t *(*alloc_shm)(struct wsi_image *image, unsigned size) = NULL;
+#ifdef HAVE_SYS_SHM_H
+   if (wsi_device->sw)
+      alloc_shm = wsi_headless_alloc_shm;
+#endif
+
+   result = wsi_configure_cpu_image(&chain->base, create_info, alloc_shm,
+                                    &chain->base.image_info);
+   if (result != VK_SUCCESS)
+      goto fail_init;
+
+   for (uint32_t image = 0; image < chain->base.image_count; image++) {
+      result = wsi_headless_image_init(chain, create_info, allocator,
+                                       &chain->images[image]);
+      if (result != VK_SUCCESS) {
+         while (image > 0) {
+            --image;
+            wsi_headless_image_finish(chain, allocator,
+                                      &chain->images[image]);
+         }
+         wsi_destroy_image_info(&chain->base, &chain->base.image_info);
+         goto fail_init;
+      }
+   }
+
+   *swapchain_out = &chain->base;
+
+   return VK_SUCCESS;
+
+fail_init:
+#ifdef HAVE_SYS_SHM_H
+   if (chain->ring)
+      munmap(chain->ring, chain->ring_size);
+#endif
+   wsi_swapchain_finish(&chain->base);
+   vk_free(allocator, chain);
+   return result;
+}
+
+VkResult
+wsi_headless_init_wsi(struct wsi_device *wsi_device,
+                      const VkAllocationCallbacks *alloc,
+                      VkPhysicalDevice physical_device)
+{
+   struct wsi_headless *wsi;
+   VkResult result;
+
+   wsi = vk_alloc(alloc, sizeof(*wsi), 8,
+                  VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE);
+   if (!wsi) {
+      result = VK_ERROR_OUT_OF_HOST_MEMORY;
+      goto fail;
+   }
+
+   wsi->physical_device = physical_device;
+   wsi->alloc = alloc;
+   wsi->wsi = wsi_device;
+
+   wsi->base.get_support = wsi_headless_surface_get_support;
+   wsi->base.get_capabilities2 = wsi_headless_surface_get_capabilities2;
+   wsi->base.get_formats = wsi_headless_surface_get_formats;
+   wsi->base.get_formats2 = wsi_headless_surface_get_formats2;
+   wsi->base.get_present_modes = wsi_headless_surface_get_present_modes;
+   wsi->base.get_present_rectangles = wsi_headless_surface_get_present_rectangles;
+   wsi->base.create_swapchain = wsi_headless_surface_create_swapchain;
+
+   wsi_device->wsi[VK_ICD_WSI_PLATFORM_HEADLESS] = &wsi->base;
+
+   return VK_SUCCESS;
+
+fail:
+   wsi_device->wsi[VK_ICD_WSI_PLATFORM_HEADLESS] = NULL;
+
+   return result;
+}
+
+void
+wsi_headless_finish_wsi(struct wsi_device *wsi_device,
+                        const VkAllocationCallbacks *alloc)
+{
+   struct wsi_headless *wsi =
+      (struct wsi_headless *)wsi_device->wsi[VK_ICD_WSI_PLATFORM_HEADLESS];
+   if (!wsi)
+      return;
+
+   vk_free(alloc, wsi);
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright © 2022 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef WSI_COMMON_HEADLESS_H
+#define WSI_COMMON_HEADLESS_H
+
+#include <stdint.h>
+
+/* Frame capture ring for VK_EXT_headless_surface swapchains.
+ *
+ * When MESA_VK_WSI_HEADLESS_RING is set to a POSIX shared memory object name
+ * (e.g. "/vk-frames") and the device is a software rasterizer, the images of
+ * each headless swapchain are allocated directly inside that object, so the
+ * driver renders into memory another process can map with no copy on
+ * present.
+ *
+ * The object starts with a wsi_headless_ring header, followed by
+ * slot_count images of slot_size bytes each, starting at slot_offset.  Each
+ * image is row_pitch bytes per row.  On every present, the producer stores
+ * the index of the presented slot in last_slot and then increments
+ * present_count, both with release semantics.  A consumer should read
+ * present_count with acquire semantics, then last_slot, and copy or process
+ * that slot before the application can acquire it again.  That takes at
+ * least slot_count - 1 further presents.
+ *
+ * The header is rewritten whenever a new swapchain is created on the
+ * surface, which is signalled by a change of generation.
+ */
+
+#define WSI_HEADLESS_RING_MAGIC   0x474e5248 /* "HRNG" */
+#define WSI_HEADLESS_RING_VERSION 1
+
+struct wsi_headless_ring {
+   uint32_t magic;
+   uint32_t version;
+   uint32_t generation;
+
+   /* VkFormat of the images */
+   uint32_t format;
+   uint32_t width;
+   uint32_t height;
+   uint32_t row_pitch;
+
+   uint32_t slot_count;
+   uint64_t slot_size;
+   uint64_t slot_offset;
+
+   uint32_t last_slot;
+   uint32_t pad;
+   uint64_t present_count;
+};
+
+#endif /* WSI_COMMON_HEADLESS_H */
@@ -285,6 +285,11 @@ VkResult wsi_win32_init_wsi(struct wsi_device *wsi_device,
                          VkPhysicalDevice physical_device);
 void wsi_win32_finish_wsi(struct wsi_device *wsi_device,
                        const VkAllocationCallbacks *alloc);
+VkResult wsi_headless_init_wsi(struct wsi_device *wsi_device,
+                               const VkAllocationCallbacks *alloc,
+                               VkPhysicalDevice physical_device);
+void wsi_headless_finish_wsi(struct wsi_device *wsi_device,
+                             const VkAllocationCallbacks *alloc);
 
 
 VkResult
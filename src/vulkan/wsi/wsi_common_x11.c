@@ -66,6 +66,7 @@ struct wsi_x11_connection {
    bool is_proprietary_x11;
    bool is_xwayland;
    bool has_mit_shm;
+   bool has_shm_put_image;
    bool has_xfixes;
 };
 
@@ -313,28 +314,38 @@ wsi_x11_connection_create(struct wsi_device *wsi_dev,
       wsi_conn->is_proprietary_x11 = true;
 
    wsi_conn->has_mit_shm = false;
-   if (wsi_conn->has_dri3 && wsi_conn->has_present && wants_shm) {
-      bool has_mit_shm = shm_reply->present != 0;
-
+   wsi_conn->has_shm_put_image = false;
+   if (wants_shm && shm_reply && shm_reply->present) {
       xcb_shm_query_version_cookie_t ver_cookie;
       xcb_shm_query_version_reply_t *ver_reply;
 
       ver_cookie = xcb_shm_query_version(conn);
       ver_reply = xcb_shm_query_version_reply(conn, ver_cookie, NULL);
 
-      has_mit_shm = ver_reply->shared_pixmaps;
+      bool shared_pixmaps = ver_reply && ver_reply->shared_pixmaps;
       free(ver_reply);
       xcb_void_cookie_t cookie;
       xcb_generic_error_t *error;
 
-      if (has_mit_shm) {
-         cookie = xcb_shm_detach_checked(conn, 0);
-         if ((error = xcb_request_check(conn, cookie))) {
-            if (error->error_code != BadRequest)
-               wsi_conn->has_mit_shm = true;
-            free(error);
-         }
+      /* Detaching segment 0 fails with BadValue if we can actually use
+       * MIT-SHM and with BadRequest if the server refuses it to us, e.g.
+       * because we're a remote client.
+       */
+      bool shm_usable = false;
+      cookie = xcb_shm_detach_checked(conn, 0);
+      if ((error = xcb_request_check(conn, cookie))) {
+         if (error->error_code != BadRequest)
+            shm_usable = true;
+         free(error);
       }
+
+      wsi_conn->has_mit_shm = shm_usable && shared_pixmaps &&
+                              wsi_conn->has_dri3 && wsi_conn->has_present;
+
+      /* Servers without DRI3/Present (Xvfb, VNC servers, ...) can still
+       * read images straight out of a shared memory segment.
+       */
+      wsi_conn->has_shm_put_image = shm_usable;
    }
 
    free(dri3_reply);
@@ -937,6 +948,11 @@ struct x11_image {
    xcb_shm_seg_t                             shmseg;
    int                                       shmid;
    uint8_t *                                 shmaddr;
+   /* Round trip issued after an ShmPutImage, the server is done reading
+    * the segment once it has been answered.
+    */
+   bool                                      shm_put_pending;
+   xcb_get_input_focus_cookie_t              shm_put_cookie;
 };
 
 struct x11_swapchain {
@@ -944,6 +960,7 @@ struct x11_swapchain {
 
    bool                                         has_dri3_modifiers;
    bool                                         has_mit_shm;
+   bool                                         has_shm_put_image;
 
    xcb_connection_t *                           conn;
    xcb_window_t                                 window;
@@ -1301,6 +1318,21 @@ x11_present_to_x11_dri3(struct x11_swapchain *chain, uint32_t image_index,
    return x11_swapchain_result(chain, VK_SUCCESS);
 }
 
+/**
+ * Wait for the X server to be done reading an image presented with
+ * ShmPutImage and hand it back to the swapchain.
+ */
+static void
+x11_image_wait_shm_put(struct x11_swapchain *chain, struct x11_image *image)
+{
+   if (!image->shm_put_pending)
+      return;
+
+   free(xcb_get_input_focus_reply(chain->conn, image->shm_put_cookie, NULL));
+   image->shm_put_pending = false;
+   image->busy = false;
+}
+
 /**
  * Send image to X server unaccelerated (software drivers).
  */
@@ -1311,6 +1343,30 @@ x11_present_to_x11_sw(struct x11_swapchain *chain, uint32_t image_index,
    struct x11_image *image = &chain->images[image_index];
 
    xcb_void_cookie_t cookie;
+
+   if (image->shmseg) {
+      /* The image lives in the segment already: the server reads it from
+       * there and nothing gets copied on our side or sent over the wire.
+       * The image stays busy until the server is done with it.
+       */
+      cookie = xcb_shm_put_image(chain->conn, chain->window, chain->gc,
+                                 image->base.row_pitches[0] / 4,
+                                 chain->extent.height,
+                                 0, 0,
+                                 chain->extent.width, chain->extent.height,
+                                 0, 0, chain->depth,
+                                 XCB_IMAGE_FORMAT_Z_PIXMAP,
+                                 0 /* send_event */,
+                                 image->shmseg, 0);
+      xcb_discard_reply(chain->conn, cookie.sequence);
+
+      image->shm_put_cookie = xcb_get_input_focus(chain->conn);
+      image->shm_put_pending = true;
+
+      xcb_flush(chain->conn);
+      return x11_swapchain_result(chain, VK_SUCCESS);
+   }
+
    void *myptr = image->base.cpu_map;
    size_t hdr_len = sizeof(xcb_put_image_request_t);
    int stride_b = image->base.row_pitches[0];
@@ -1383,6 +1439,29 @@ x11_acquire_next_image(struct wsi_swapchain *anv_chain,
       return chain->status;
 
    if (chain->base.wsi->sw && !chain->has_mit_shm) {
+      /* Prefer an image the server is known to be done with, otherwise
+       * wait for the one which was handed to the server first.
+       */
+      bool have_idle = false;
+      int pending = -1;
+      for (unsigned i = 0; i < chain->base.image_count; i++) {
+         struct x11_image *image = &chain->images[i];
+         if (!image->busy)
+            have_idle = true;
+
+         if (image->shm_put_pending &&
+             (pending < 0 ||
+              (int32_t)(image->shm_put_cookie.sequence -
+                        chain->images[pending].shm_put_cookie.sequence) < 0))
+            pending = i;
+      }
+
+      if (!have_idle && pending >= 0) {
+         if (timeout == 0)
+            return VK_NOT_READY;
+         x11_image_wait_shm_put(chain, &chain->images[pending]);
+      }
+
       for (unsigned i = 0; i < chain->base.image_count; i++) {
          if (!chain->images[i].busy) {
             *image_index = i;
@@ -1677,6 +1756,12 @@ x11_image_init(VkDevice device_h, struct x11_swapchain *chain,
 
    if (chain->base.wsi->sw) {
       if (!chain->has_mit_shm) {
+         if (chain->has_shm_put_image && image->shmaddr) {
+            image->shmseg = xcb_generate_id(chain->conn);
+            cookie = xcb_shm_attach(chain->conn, image->shmseg,
+                                    image->shmid, true /* read_only */);
+            xcb_discard_reply(chain->conn, cookie.sequence);
+         }
          image->busy = false;
          return VK_SUCCESS;
       }
@@ -1809,6 +1894,11 @@ x11_image_finish(struct x11_swapchain *chain,
 
       cookie = xcb_xfixes_destroy_region(chain->conn, image->update_region);
       xcb_discard_reply(chain->conn, cookie.sequence);
+   } else if (image->shmseg) {
+      x11_image_wait_shm_put(chain, image);
+
+      cookie = xcb_shm_detach(chain->conn, image->shmseg);
+      xcb_discard_reply(chain->conn, cookie.sequence);
    }
 
    wsi_destroy_image(&chain->base, &image->base);
@@ -2052,6 +2142,8 @@ x11_surface_create_swapchain(VkIcdSurfaceBase *icd_surface,
    chain->status = VK_SUCCESS;
    chain->has_dri3_modifiers = wsi_conn->has_dri3_modifiers;
    chain->has_mit_shm = wsi_conn->has_mit_shm;
+   chain->has_shm_put_image = !wsi_conn->has_mit_shm &&
+                              wsi_conn->has_shm_put_image;
 
    /* When images in the swapchain don't fit the window, X can still present them, but it won't
     * happen by flip, only by copy. So this is a suboptimal copy, because if the client would change
@@ -2125,7 +2217,9 @@ x11_surface_create_swapchain(VkIcdSurfaceBase *icd_surface,
 
    if (wsi_device->sw) {
       result = wsi_configure_cpu_image(&chain->base, pCreateInfo,
-                                       chain->has_mit_shm ? &alloc_shm : NULL,
+                                       chain->has_mit_shm ||
+                                       chain->has_shm_put_image ?
+                                       &alloc_shm : NULL,
                                        &chain->base.image_info);
    } else if (chain->base.use_buffer_blit) {
       bool use_modifier = num_tranches > 0;